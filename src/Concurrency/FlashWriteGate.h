@@ -0,0 +1,47 @@
+#ifndef FLASH_WRITE_GATE_H
+#define FLASH_WRITE_GATE_H
+
+#include <atomic>
+
+/**
+ * Keeps the arms still while the network task writes flash. A flash write turns the cache off on both cores, and
+ * the step ISR isn't allocated in IRAM, so it can't run until the write is done: steps due meanwhile would be late
+ * all at once, the arms stopping dead mid-move and going on at full speed. So the network task asks with park(),
+ * the motion task parks the arms the next time they stand still and starts nothing new until release().
+ *
+ * park() stores its request before it loads `parked`, hold() clears `parked` before it loads the request, all
+ * sequentially consistent: park() only sees the arms parked if hold() will see the request on its next loop too,
+ * so a write never overlaps a move the motion task started.
+ */
+class FlashWriteGate {
+    std::atomic<bool> requested{false};
+    std::atomic<bool> parked{false};
+
+public:
+    /** Network side, never blocks: asks for the arms to be parked, true once they are. Write, then release(). */
+    bool park() {
+        requested.store(true);
+        return parked.load();
+    }
+
+    void release() {
+        requested.store(false);
+    }
+
+    /**
+     * Motion side, every loop before anything moves the arms.
+     * @param armsStill no steps queued or due for either arm
+     * @return true to leave the arms be this loop
+     */
+    bool hold(const bool armsStill) {
+        parked.store(false);
+        if (!requested.load() || !armsStill) {
+            return false;
+        }
+
+        parked.store(true);
+        return true;
+    }
+};
+
+#endif //FLASH_WRITE_GATE_H
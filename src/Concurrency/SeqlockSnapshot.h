@@ -0,0 +1,74 @@
+#ifndef SEQLOCK_SNAPSHOT_H
+#define SEQLOCK_SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Latest value of a small struct, published by one writer and read by any number of readers without locks.
+ * The writer never waits; a reader that overlaps a write sees the sequence change and copies again.
+ *
+ * The sequence is odd while a write is in progress. The value is kept as relaxed atomic words rather than a
+ * plain struct so an overlapping copy is a retry, not a data race; the fences order the words against the
+ * sequence on both sides.
+ */
+template<typename T>
+class SeqlockSnapshot {
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshots are copied word by word");
+
+    constexpr static size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> words[WORDS] = {};
+
+public:
+    /** Writer side, from one task only */
+    void write(const T &value) {
+        uint32_t buffer[WORDS] = {};
+        memcpy(buffer, &value, sizeof(T));
+
+        const uint32_t current = sequence.load(std::memory_order_relaxed);
+        sequence.store(current + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+
+        sequence.store(current + 2, std::memory_order_release);
+    }
+
+    /** Reader side, from any task. Spins only while a write is in flight, which takes well under a microsecond. */
+    T read() const {
+        uint32_t buffer[WORDS] = {};
+        uint32_t before = 0;
+        uint32_t after = 0;
+
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+
+            for (size_t i = 0; i < WORDS; i++) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    /** Number of completed writes, so readers can tell whether anything changed */
+    uint32_t getVersion() const {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+};
+
+#endif //SEQLOCK_SNAPSHOT_H
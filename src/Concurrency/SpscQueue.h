@@ -0,0 +1,58 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free ring between exactly one producer and one consumer, which may run on different cores. Each index is
+ * written by one side only; the release store publishing it pairs with the other side's acquire load, so an
+ * item is fully written before the consumer can see it and fully read before the producer reuses its slot.
+ * Neither side ever blocks: push() fails when the ring is full, pop() when it is empty.
+ *
+ * @tparam T        trivially copyable item
+ * @tparam CAPACITY slots, a power of two; one is kept free to tell full from empty
+ */
+template<typename T, uint16_t CAPACITY>
+class SpscQueue {
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+    constexpr static uint16_t MASK = CAPACITY - 1;
+
+    T items[CAPACITY] = {};
+    std::atomic<uint16_t> head{0}; // Written by the producer
+    std::atomic<uint16_t> tail{0}; // Written by the consumer
+
+public:
+    /** Producer side. @return false if the ring is full, the item is not queued */
+    bool push(const T &item) {
+        const uint16_t currentHead = head.load(std::memory_order_relaxed);
+        const uint16_t nextHead = (currentHead + 1) & MASK;
+        if (nextHead == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        items[currentHead] = item;
+        head.store(nextHead, std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer side. @return false if the ring is empty */
+    bool pop(T &item) {
+        const uint16_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = items[currentTail];
+        tail.store((currentTail + 1) & MASK, std::memory_order_release);
+        return true;
+    }
+
+    /** Exact on the consumer side, a snapshot anywhere else */
+    bool isEmpty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif //SPSC_QUEUE_H
@@ -5,52 +5,150 @@
 
 #define LCD_DISPLAY_BLINK_INTERVAL_MS 1000
 
+/**
+ * HD44780 behind a shadow framebuffer. Drawing calls only change the framebuffer; flush() compares it with what
+ * is on the glass and sends the controller a few changed characters per call, so a redraw that changes one
+ * digit costs one character write instead of a clear (~2 ms) and 32 writes.
+ */
 class LcdDisplay {
+public:
+    /** What flushing has cost so far, for loop-time measurements */
+    struct FlushStats {
+        uint32_t flushes = 0; // Calls that wrote anything
+        uint32_t characters = 0;
+        uint32_t cursorMoves = 0;
+        uint32_t totalUs = 0;
+        uint32_t maxUs = 0; // Longest single call
+    };
+
+private:
     constexpr static uint8_t SCREEN_WIDTH = 16;
     constexpr static uint8_t SCREEN_HEIGHT = 2;
+    constexpr static uint8_t CELLS = SCREEN_WIDTH * SCREEN_HEIGHT;
+    // Each character is two 4-bit transfers of ~100 us in LiquidCrystal, one per call keeps loop iterations short
+    constexpr static uint8_t CHARACTERS_PER_FLUSH = 1;
 
     uint32_t tickMs = 0;
     bool isBlinking = false;
 
+    char frame[CELLS] = {}; // What should be shown
+    char glass[CELLS] = {}; // What the controller shows
+    uint8_t drawX = 0;
+    uint8_t drawY = 0;
+    uint8_t glassCursor = CELLS; // Controller's address as a cell, CELLS when unknown or off screen
+    bool isStarted = false;
+
+    FlushStats flushStats;
+
 public:
     LiquidCrystal *screen;
 
     explicit LcdDisplay(LiquidCrystal *lcd) : screen(lcd) {
-        screen->setCursor(0, 0);
-        screen->println("Initializing...");
+        memset(frame, ' ', sizeof(frame));
     }
 
-    void clear() const {
+    /** Initializes the controller, everything after this goes through the framebuffer */
+    void begin() {
+        screen->begin(SCREEN_WIDTH, SCREEN_HEIGHT);
         screen->clear();
+        memset(glass, ' ', sizeof(glass));
+        glassCursor = 0;
+        isStarted = true;
+    }
+
+    /** Blanks the framebuffer; the glass follows as it is flushed, without a blocking controller clear */
+    void clear() {
+        memset(frame, ' ', sizeof(frame));
+        drawX = drawY = 0;
     }
 
     void setBlinking(const bool isBlinking) {
         this->isBlinking = isBlinking;
     }
 
-    void printCentered(const String &text) const {
+    void printCentered(const String &text) {
         setCursorToCenter(text.length());
-        screen->print(text);
+        print(text);
     }
 
-    void print(const String &text) const {
-        screen->print(text);
+    /** Writes at the cursor, clipped at the end of the line */
+    void print(const String &text) {
+        for (size_t i = 0; i < text.length() && drawX < SCREEN_WIDTH; i++) {
+            frame[drawY * SCREEN_WIDTH + drawX++] = text[i];
+        }
     }
 
-    void setCursorToCenter(const uint8_t amountOfChars) const {
+    void setCursorToCenter(const uint8_t amountOfChars) {
         setCursorFromTopLeft((SCREEN_WIDTH - amountOfChars) / 2);
     }
 
-    void setCursorFromTopLeft(const uint8_t x, const uint8_t y = 0) const {
-        screen->setCursor(x, y);
+    void setCursorFromTopLeft(const uint8_t x, const uint8_t y = 0) {
+        drawX = x < SCREEN_WIDTH ? x : SCREEN_WIDTH;
+        drawY = y < SCREEN_HEIGHT ? y : SCREEN_HEIGHT - 1;
+    }
+
+    void setCursorToLine(const uint8_t charOffset = 0, const uint8_t line = 0) {
+        setCursorFromTopLeft(charOffset, line);
+    }
+
+    void setCursorToLineRight(const String &text, const uint8_t line = 0) {
+        setCursorFromTopLeft(text.length() < SCREEN_WIDTH ? SCREEN_WIDTH - text.length() : 0, line);
+    }
+
+    /**
+     * Sends up to `maxCharacters` changed characters to the controller, continuing from where its address
+     * already points so runs of changes need a single cursor move. Call every loop iteration.
+     */
+    void flush(const uint8_t maxCharacters = CHARACTERS_PER_FLUSH) {
+        if (!isStarted) {
+            return;
+        }
+
+        const uint32_t startUs = micros();
+        const uint8_t scanFrom = glassCursor < CELLS ? glassCursor : 0;
+        uint8_t written = 0;
+
+        for (uint8_t i = 0; i < CELLS && written < maxCharacters; i++) {
+            const uint8_t cell = (scanFrom + i) % CELLS;
+            if (frame[cell] == glass[cell]) {
+                continue;
+            }
+
+            if (cell != glassCursor) {
+                screen->setCursor(cell % SCREEN_WIDTH, cell / SCREEN_WIDTH);
+                flushStats.cursorMoves++;
+            }
+
+            screen->write(static_cast<uint8_t>(frame[cell]));
+            glass[cell] = frame[cell];
+            written++;
+
+            // The address runs on past the visible end of a line
+            glassCursor = (cell + 1) % SCREEN_WIDTH == 0 ? CELLS : cell + 1;
+        }
+
+        if (written == 0) {
+            return;
+        }
+
+        const uint32_t elapsedUs = micros() - startUs;
+        flushStats.flushes++;
+        flushStats.characters += written;
+        flushStats.totalUs += elapsedUs;
+        flushStats.maxUs = elapsedUs > flushStats.maxUs ? elapsedUs : flushStats.maxUs;
+    }
+
+    /** Shows the whole framebuffer now, for messages drawn before a blocking wait */
+    void flushAll() {
+        flush(CELLS);
     }
 
-    void setCursorToLine(const uint8_t charOffset = 0, const uint8_t line = 0) const {
-        screen->setCursor(charOffset, line);
+    bool isFlushed() const {
+        return memcmp(frame, glass, sizeof(frame)) == 0;
     }
 
-    void setCursorToLineRight(const String &text, const uint8_t line = 0) const {
-        screen->setCursor(SCREEN_WIDTH - text.length(), line);
+    const FlushStats &getFlushStats() const {
+        return flushStats;
     }
 };
 
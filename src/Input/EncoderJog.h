@@ -0,0 +1,76 @@
+#ifndef ENCODER_JOG_H
+#define ENCODER_JOG_H
+
+#include <Arduino.h>
+
+/**
+ * Turns encoder counts into jog steps, once per loop: a slow turn moves the arm a few steps per detent for fine
+ * positioning, a fast spin up to COARSE_STEPS per detent to cross the workspace. The speed is measured between
+ * loops that saw detents, not per loop, so a single click reads as slow however fast the loop runs, and a loop that
+ * ran late doesn't read as a burst; it is smoothed over about RATE_SMOOTHING_MS.
+ */
+class EncoderJog {
+public:
+    constexpr static long COUNTS_PER_DETENT = 2; // See PulseCounter
+    constexpr static float FINE_STEPS = 4.0f; // Per detent, at or below FINE_DETENTS_PER_S
+    constexpr static float COARSE_STEPS = 96.0f; // Per detent, at or above COARSE_DETENTS_PER_S
+    constexpr static float FINE_DETENTS_PER_S = 4.0f;
+    constexpr static float COARSE_DETENTS_PER_S = 40.0f;
+    constexpr static float RATE_SMOOTHING_MS = 100.0f;
+
+private:
+    long lastCount = 0;
+    unsigned long lastDetentMs = 0;
+    bool idle = true; // No detent since reset(), the next one starts a turn from standstill
+    float detentsPerS = 0.0f;
+    float carriedSteps = 0.0f; // Rounding left over from the last jog, so the scale doesn't drift
+
+public:
+    static float stepsPerDetent(const float detentsPerS) {
+        const float rate = constrain(detentsPerS, FINE_DETENTS_PER_S, COARSE_DETENTS_PER_S);
+        return FINE_STEPS + (COARSE_STEPS - FINE_STEPS) * (rate - FINE_DETENTS_PER_S)
+                            / (COARSE_DETENTS_PER_S - FINE_DETENTS_PER_S);
+    }
+
+    /** Starts counting from `count`, dropping whatever turned before */
+    void reset(const long count, const unsigned long nowMs) {
+        lastCount = count;
+        lastDetentMs = nowMs;
+        idle = true;
+        detentsPerS = 0.0f;
+        carriedSteps = 0.0f;
+    }
+
+    /**
+     * Call every loop with the counter's total.
+     * @return steps to jog by for the detents since the last call, signed
+     */
+    long take(const long count, const unsigned long nowMs) {
+        // Half a detent stays counted for the next call
+        const long detents = (count - lastCount) / COUNTS_PER_DETENT;
+        if (detents == 0) {
+            return 0;
+        }
+        lastCount += detents * COUNTS_PER_DETENT;
+
+        if (idle) {
+            idle = false;
+        } else {
+            const float elapsedMs = std::max(1.0f, static_cast<float>(nowMs - lastDetentMs));
+            const float rate = abs(detents) * 1000.0f / elapsedMs;
+            detentsPerS += (rate - detentsPerS) * std::min(1.0f, elapsedMs / RATE_SMOOTHING_MS);
+        }
+        lastDetentMs = nowMs;
+
+        const float steps = detents * stepsPerDetent(detentsPerS) + carriedSteps;
+        const long rounded = lroundf(steps);
+        carriedSteps = steps - rounded;
+        return rounded;
+    }
+
+    float getDetentsPerS() const {
+        return detentsPerS;
+    }
+};
+
+#endif //ENCODER_JOG_H
@@ -2,45 +2,85 @@
 #define INPUT_H
 
 #include <Arduino.h>
-constexpr uint8_t minimumTriggerDelayMs = 200;
 
+#include "InputEventQueue.h"
+
+/**
+ * A switch on an interrupt GPIO, pressed while the GPIO is high, debounced on the timestamps of its edges: an edge
+ * that changes the level counts straight away, and any edge within `debounceUs` after it is bounce. Once that
+ * window has passed the level is read back, so bounce that ended on the other level still settles right.
+ *
+ * Times are compared as signed differences: an edge queued after the clock was read is newer than "now", and
+ * still within its window rather than an age away.
+ */
 class Input {
     uint8_t gpio;
+    uint32_t debounceUs;
 
-    bool canTakeAction = false;
+    bool pressed = false; // Debounced
+    bool pressPending = false; // Pressed since takePress()
+    bool settling = false; // Within debounceUs of the last edge taken
+    uint32_t lastEdgeUs = 0;
 
-    ulong triggeredAtMs = 0;
-    ulong canBeTriggerAtMs = 0;
+    bool isWithinWindow(const uint32_t atUs) const {
+        return static_cast<int32_t>(atUs - lastEdgeUs) < static_cast<int32_t>(debounceUs);
+    }
 
-    void takeAction() {
-        canTakeAction = false;
-        canBeTriggerAtMs = millis() + minimumTriggerDelayMs;
+    void setPressed(const bool level, const uint32_t atUs) {
+        pressed = level;
+        pressPending |= level;
+        settling = true;
+        lastEdgeUs = atUs;
     }
 
 public:
-    explicit Input(const uint8_t gpio) : gpio(gpio) {
+    Input(const uint8_t gpio, const uint32_t debounceUs) : gpio(gpio), debounceUs(debounceUs) {
     }
 
     uint8_t getGPIO() const {
         return gpio;
     }
 
-    void trigger() {
-        canTakeAction = true;
-        triggeredAtMs = millis();
+    /** @return false if the edge was bounce and changed nothing */
+    bool onEdge(const InputEvent &event) {
+        if (event.rising == pressed || (settling && isWithinWindow(event.atUs))) {
+            return false;
+        }
+
+        setPressed(event.rising, event.atUs);
+        return true;
+    }
+
+    /** Call every loop: reads the level back once the bounce window is over */
+    void settle(const uint32_t nowUs) {
+        if (!settling || isWithinWindow(nowUs)) {
+            return;
+        }
+
+        settling = false;
+        const bool level = digitalRead(gpio) == HIGH;
+        if (level != pressed) {
+            setPressed(level, nowUs);
+        }
     }
 
-    bool takeActionIfPossible() {
-        if (canTakeAction && canBeTriggerAtMs <= millis()) {
-            takeAction();
-            return true;
+    /** Takes the level as it is, for edges that were never queued */
+    void sync(const uint32_t nowUs) {
+        const bool level = digitalRead(gpio) == HIGH;
+        if (level != pressed) {
+            setPressed(level, nowUs);
         }
+    }
 
-        return false;
+    bool isPressed() const {
+        return pressed;
     }
 
-    void preventTriggerForMs(const ulong delayMs = 500) {
-        canBeTriggerAtMs = millis() + delayMs;
+    /** Whether it was pressed since the last call */
+    bool takePress() {
+        const bool pending = pressPending;
+        pressPending = false;
+        return pending;
     }
 };
 
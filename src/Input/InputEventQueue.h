@@ -0,0 +1,93 @@
+#ifndef INPUT_EVENT_QUEUE_H
+#define INPUT_EVENT_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "Concurrency/SpscQueue.h"
+
+/** An edge on an input GPIO, as its interrupt saw it */
+struct InputEvent {
+    uint32_t atUs; // micros() in the ISR
+    uint8_t gpio;
+    bool rising;
+};
+
+/**
+ * Edges from GPIO interrupts in the order they fired, for the task handling those inputs. Every edge is its own
+ * event, so switches going off together don't overwrite each other.
+ *
+ * All GPIO interrupts are serviced by one handler on the core that attached the first of them, one pin after
+ * another, so the ISRs together are the single producer SpscQueue needs.
+ */
+class InputEventQueue {
+public:
+    constexpr static uint16_t CAPACITY = 64; // Holds every input bouncing at once for a few loops
+
+    struct Stats {
+        uint32_t handled;
+        uint32_t bounces; // Edges debouncing discarded
+        uint32_t dropped; // Queue full, the levels were read back instead
+        uint32_t maxLatencyUs; // From the interrupt to handling
+        uint32_t latencyUsTotal;
+    };
+
+private:
+    SpscQueue<InputEvent, CAPACITY> events;
+    std::atomic<uint32_t> dropped{0};
+
+    // Written by the consumer
+    std::atomic<uint32_t> handled{0};
+    std::atomic<uint32_t> bounces{0};
+    std::atomic<uint32_t> maxLatencyUs{0};
+    std::atomic<uint32_t> latencyUsTotal{0};
+    uint32_t droppedSeen = 0;
+
+public:
+    /** From the GPIO's ISR */
+    void IRAM_ATTR onInterrupt(const uint8_t gpio) {
+        const InputEvent event = {static_cast<uint32_t>(micros()), gpio, digitalRead(gpio) == HIGH};
+        if (!events.push(event)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /** Consumer side */
+    bool pop(InputEvent &event) {
+        return events.pop(event);
+    }
+
+    /** Consumer side, for an event popped at `nowUs`; one queued since `nowUs` was read counts as no latency */
+    void countHandled(const InputEvent &event, const uint32_t nowUs, const bool bounce) {
+        const int32_t sinceEdgeUs = static_cast<int32_t>(nowUs - event.atUs);
+        const uint32_t latencyUs = sinceEdgeUs > 0 ? static_cast<uint32_t>(sinceEdgeUs) : 0;
+        handled.store(handled.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        latencyUsTotal.store(latencyUsTotal.load(std::memory_order_relaxed) + latencyUs, std::memory_order_relaxed);
+        if (latencyUs > maxLatencyUs.load(std::memory_order_relaxed)) {
+            maxLatencyUs.store(latencyUs, std::memory_order_relaxed);
+        }
+        if (bounce) {
+            bounces.store(bounces.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    /** Consumer side: whether edges were dropped since the last call */
+    bool takeDropped() {
+        const uint32_t current = dropped.load(std::memory_order_relaxed);
+        const bool any = current != droppedSeen;
+        droppedSeen = current;
+        return any;
+    }
+
+    Stats getStats() const {
+        return {
+            handled.load(std::memory_order_relaxed),
+            bounces.load(std::memory_order_relaxed),
+            dropped.load(std::memory_order_relaxed),
+            maxLatencyUs.load(std::memory_order_relaxed),
+            latencyUsTotal.load(std::memory_order_relaxed)
+        };
+    }
+};
+
+#endif //INPUT_EVENT_QUEUE_H
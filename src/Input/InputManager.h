@@ -2,35 +2,72 @@
 #define INPUT_MANAGER_H
 
 #include "Input.h"
+#include "InputEventQueue.h"
 
+/**
+ * The switches and the queues their interrupts feed: the limit switches are handled by the motion task, the
+ * encoder button by the network/UI task, each only ever touching its own inputs.
+ */
 class InputManager {
+    constexpr static uint32_t LIMIT_SWITCH_DEBOUNCE_US = 5000;
+    constexpr static uint32_t ENCODER_BUTTON_DEBOUNCE_US = 20000;
+
+    /** The clock is read after each pop and after draining: an ISR on another core may queue edges meanwhile */
+    static void handle(InputEventQueue &queue, Input *const *inputs, const uint8_t count) {
+        InputEvent event = {};
+
+        while (queue.pop(event)) {
+            bool taken = false;
+            for (uint8_t i = 0; i < count; i++) {
+                if (inputs[i]->getGPIO() == event.gpio) {
+                    taken = inputs[i]->onEdge(event);
+                }
+            }
+            queue.countHandled(event, micros(), !taken);
+        }
+
+        const uint32_t nowUs = micros();
+        const bool dropped = queue.takeDropped();
+        for (uint8_t i = 0; i < count; i++) {
+            if (dropped) {
+                inputs[i]->sync(nowUs);
+            }
+            inputs[i]->settle(nowUs);
+        }
+    }
+
 public:
+    InputEventQueue limitSwitchEvents;
+    InputEventQueue encoderButtonEvents;
+
     Input limitSwitchA;
     Input limitSwitchB;
     Input encoderButton;
 
     InputManager(const uint8_t limitSwitchAGpio, const uint8_t limitSwitchBGpio, const uint8_t encoderButtonGpio)
-        : limitSwitchA(limitSwitchAGpio), limitSwitchB(limitSwitchBGpio), encoderButton(encoderButtonGpio) {
+        : limitSwitchA(limitSwitchAGpio, LIMIT_SWITCH_DEBOUNCE_US),
+          limitSwitchB(limitSwitchBGpio, LIMIT_SWITCH_DEBOUNCE_US),
+          encoderButton(encoderButtonGpio, ENCODER_BUTTON_DEBOUNCE_US) {
     }
 
-    void handleInput(volatile uint8_t &triggeredGpio) {
-        if (triggeredGpio == 0) {
-            return;
-        }
-
-        if (triggeredGpio == limitSwitchA.getGPIO()) {
-            limitSwitchA.trigger();
-        } else if (triggeredGpio == limitSwitchB.getGPIO()) {
-            limitSwitchB.trigger();
-        } else if (triggeredGpio == encoderButton.getGPIO()) {
-            encoderButton.trigger();
-        }
+    /** Once the pins are set up, before the tasks start: a switch already pressed counts as a press */
+    void begin() {
+        const uint32_t nowUs = micros();
+        limitSwitchA.sync(nowUs);
+        limitSwitchB.sync(nowUs);
+        encoderButton.sync(nowUs);
+    }
 
-        triggeredGpio = 0;
+    /** Motion task, every loop */
+    void handleLimitSwitches() {
+        Input *const inputs[] = {&limitSwitchA, &limitSwitchB};
+        handle(limitSwitchEvents, inputs, 2);
     }
 
-    void preventTriggerForMs(const ulong delayMs = 1000) {
-        encoderButton.preventTriggerForMs(delayMs);
+    /** Network/UI task, every loop */
+    void handleEncoderButton() {
+        Input *const inputs[] = {&encoderButton};
+        handle(encoderButtonEvents, inputs, 1);
     }
 };
 
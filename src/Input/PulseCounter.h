@@ -0,0 +1,96 @@
+#ifndef PULSE_COUNTER_H
+#define PULSE_COUNTER_H
+
+#include <stdint.h>
+
+/**
+ * Running total of a hardware pulse counter that starts over from 0 at ±LIMIT, kept from the difference between
+ * reads. A reset changes the count by LIMIT, which leaves it the same modulo LIMIT, so the difference taken
+ * modulo LIMIT is right as long as fewer than LIMIT / 2 counts pass between two reads; nothing has to catch the
+ * reset as it happens.
+ */
+class WrappedPulseCount {
+public:
+    constexpr static int16_t LIMIT = 16384;
+
+private:
+    int16_t last = 0;
+    long total = 0;
+
+public:
+    /** @param count as the hardware reads now */
+    long update(const int16_t count) {
+        long difference = (static_cast<long>(count) - last) % LIMIT;
+        if (difference >= LIMIT / 2) {
+            difference -= LIMIT;
+        } else if (difference < -LIMIT / 2) {
+            difference += LIMIT;
+        }
+
+        last = count;
+        total += difference;
+        return total;
+    }
+};
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <driver/pcnt.h>
+
+/**
+ * Quadrature decoding in the ESP32 pulse counter (PCNT): every edge of the pulse pin counts, up or down depending
+ * on the control pin, however long the loop reading it takes. Both edges count, so a detent that takes the pulse
+ * pin through a full cycle counts 2.
+ *
+ * The hardware counter is 16 bit and starts over from 0 at ±LIMIT; WrappedPulseCount carries on past that.
+ */
+class PulseCounter {
+    constexpr static int16_t LIMIT = WrappedPulseCount::LIMIT;
+    constexpr static uint16_t FILTER_APB_CYCLES = 1000; // 12.5 µs, longer than contact bounce spikes on the lines
+
+    pcnt_unit_t unit;
+    WrappedPulseCount total;
+
+public:
+    explicit PulseCounter(const pcnt_unit_t unit = PCNT_UNIT_0) : unit(unit) {
+    }
+
+    void begin(const uint8_t pulsePin, const uint8_t controlPin) {
+        pcnt_config_t config = {};
+        config.pulse_gpio_num = pulsePin;
+        config.ctrl_gpio_num = controlPin;
+        config.channel = PCNT_CHANNEL_0;
+        config.unit = unit;
+        // Turning forward, the pulse pin rises with the control pin high and falls with it low
+        config.pos_mode = PCNT_COUNT_INC;
+        config.neg_mode = PCNT_COUNT_DEC;
+        config.hctrl_mode = PCNT_MODE_KEEP;
+        config.lctrl_mode = PCNT_MODE_REVERSE;
+        config.counter_h_lim = LIMIT;
+        config.counter_l_lim = -LIMIT;
+        pcnt_unit_config(&config);
+
+        pcnt_set_filter_value(unit, FILTER_APB_CYCLES);
+        pcnt_filter_enable(unit);
+
+        pcnt_counter_pause(unit);
+        pcnt_counter_clear(unit);
+        pcnt_counter_resume(unit);
+    }
+
+    /** Counts since begin(), from one task, read at least every LIMIT / 2 counts (4096 detents) */
+    long read() {
+        int16_t count = 0;
+        pcnt_get_counter_value(unit, &count);
+        return total.update(count);
+    }
+};
+
+#else
+
+#include "Simulation/SimulatedPulseCounter.h"
+
+#endif
+
+#endif //PULSE_COUNTER_H
@@ -0,0 +1,258 @@
+#ifndef COMPACT_PATH_DECODER_H
+#define COMPACT_PATH_DECODER_H
+
+#include "CompactPathFormat.h"
+
+/**
+ * Streaming CompactPathFormat decoder: bytes go in as they are read, in chunks of any size, and commands come
+ * out one at a time. Memory use is the header and a few counters, whatever the job size.
+ */
+class CompactPathDecoder {
+public:
+    enum State : uint8_t {
+        readingHeader,
+        readingBody,
+        finished,
+        failed
+    };
+
+    enum Error : uint8_t {
+        none,
+        badMagic,
+        unsupportedVersion,
+        wrongGeometry,
+        badOpcode,
+        truncated,
+        badChecksum,
+        wrongMoveCount
+    };
+
+private:
+    uint32_t expectedGeometryHash;
+
+    State state = readingHeader;
+    Error error = none;
+
+    uint8_t header[CompactPathFormat::HEADER_SIZE] = {};
+    uint8_t headerLength = 0;
+    CompactPathFormat::Header info = {};
+
+    uint32_t bodyRead = 0;
+    uint32_t bodyCrc = 0;
+    uint32_t moveCount = 0;
+
+    // Record being decoded
+    uint8_t opcode = 0;
+    uint8_t operandIndex = 0;
+    uint32_t operands[2] = {};
+    uint8_t varintShift = 0;
+
+    CompactPathFormat::Predictor predictor;
+    float speed = 0.0;
+
+    PathCommand command = {};
+    bool commandReady = false;
+
+    void fail(const Error reason) {
+        state = failed;
+        error = reason;
+    }
+
+    void acceptHeader() {
+        if (memcmp(header, CompactPathFormat::MAGIC, sizeof(CompactPathFormat::MAGIC)) != 0) {
+            fail(badMagic);
+            return;
+        }
+
+        if (header[4] != CompactPathFormat::VERSION || header[5] != CompactPathFormat::HEADER_SIZE) {
+            fail(unsupportedVersion);
+            return;
+        }
+
+        info.geometryHash = CompactPathFormat::readUint32(header + 8);
+        info.moveCount = CompactPathFormat::readUint32(header + 12);
+        info.bodyLength = CompactPathFormat::readUint32(header + 16);
+        info.bodyCrc = CompactPathFormat::readUint32(header + 20);
+
+        if (info.geometryHash != expectedGeometryHash) {
+            fail(wrongGeometry);
+            return;
+        }
+
+        state = readingBody;
+    }
+
+    static uint8_t operandCount(const uint8_t opcode) {
+        switch (opcode) {
+            case CompactPathFormat::opMove:
+                return 2;
+            case CompactPathFormat::opSpeed:
+            case CompactPathFormat::opDwell:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    void emitMove(const long residualA, const long residualB) {
+        const long a = predictor.position[0] + predictor.velocity[0] + residualA;
+        const long b = predictor.position[1] + predictor.velocity[1] + residualB;
+        predictor.apply(a, b);
+        moveCount++;
+
+        command = {PathCommand::move, a, b, speed};
+        commandReady = true;
+    }
+
+    /** Executes the record once all its operands are in */
+    void completeRecord() {
+        switch (opcode) {
+            case CompactPathFormat::opMove:
+                emitMove(CompactPathFormat::unzigzag(operands[0]), CompactPathFormat::unzigzag(operands[1]));
+                break;
+            case CompactPathFormat::opPenUp:
+            case CompactPathFormat::opPenDown:
+                predictor.stop();
+                command = {opcode == CompactPathFormat::opPenUp ? PathCommand::penUp : PathCommand::penDown};
+                commandReady = true;
+                break;
+            case CompactPathFormat::opSpeed:
+                speed = static_cast<float>(operands[0]);
+                break;
+            case CompactPathFormat::opDwell:
+                predictor.stop();
+                command = {PathCommand::dwell, 0, 0, static_cast<float>(operands[0])};
+                commandReady = true;
+                break;
+            case CompactPathFormat::opHome:
+                predictor = {};
+                command = {PathCommand::home};
+                commandReady = true;
+                break;
+            case CompactPathFormat::opEnd:
+                if (bodyRead != info.bodyLength) {
+                    fail(truncated);
+                } else if (bodyCrc != info.bodyCrc) {
+                    fail(badChecksum);
+                } else if (moveCount != info.moveCount) {
+                    fail(wrongMoveCount);
+                } else {
+                    state = finished;
+                }
+                break;
+            default:
+                fail(badOpcode);
+        }
+
+        opcode = 0;
+    }
+
+    void acceptBodyByte(const uint8_t byte) {
+        bodyRead++;
+        bodyCrc = CompactPathFormat::updateCrc(bodyCrc, byte);
+
+        if (bodyRead > info.bodyLength) {
+            fail(truncated);
+            return;
+        }
+
+        // Inside a varint operand
+        if (opcode != 0) {
+            operands[operandIndex] |= static_cast<uint32_t>(byte & 0x7F) << varintShift;
+            varintShift += 7;
+
+            if (byte & 0x80) {
+                if (varintShift >= 35) {
+                    fail(badOpcode);
+                }
+                return;
+            }
+
+            varintShift = 0;
+            if (++operandIndex == operandCount(opcode)) {
+                completeRecord();
+            }
+            return;
+        }
+
+        if (byte <= CompactPathFormat::SHORT_MOVE_LAST) {
+            constexpr uint8_t SPAN = 2 * CompactPathFormat::SHORT_RESIDUAL_LIMIT + 1;
+            emitMove(byte / SPAN - CompactPathFormat::SHORT_RESIDUAL_LIMIT,
+                     byte % SPAN - CompactPathFormat::SHORT_RESIDUAL_LIMIT);
+            return;
+        }
+
+        opcode = byte;
+        operandIndex = 0;
+        operands[0] = operands[1] = 0;
+        varintShift = 0;
+
+        if (operandCount(opcode) == 0) {
+            completeRecord();
+        }
+    }
+
+public:
+    explicit CompactPathDecoder(const uint32_t geometryHash) : expectedGeometryHash(geometryHash) {
+    }
+
+    void reset() {
+        *this = CompactPathDecoder(expectedGeometryHash);
+    }
+
+    /**
+     * Decodes until a command is ready or the data runs out.
+     * @return bytes consumed
+     */
+    size_t feed(const uint8_t *data, const size_t length) {
+        size_t consumed = 0;
+
+        while (consumed < length && !commandReady && (state == readingHeader || state == readingBody)) {
+            const uint8_t byte = data[consumed++];
+
+            if (state == readingHeader) {
+                header[headerLength++] = byte;
+                if (headerLength == CompactPathFormat::HEADER_SIZE) {
+                    acceptHeader();
+                }
+            } else {
+                acceptBodyByte(byte);
+            }
+        }
+
+        return consumed;
+    }
+
+    /** The data ended: anything short of the end record is a truncated job */
+    void end() {
+        if (state == readingHeader || state == readingBody) {
+            fail(truncated);
+        }
+    }
+
+    bool hasCommand() const {
+        return commandReady;
+    }
+
+    const PathCommand &getCommand() const {
+        return command;
+    }
+
+    void takeCommand() {
+        commandReady = false;
+    }
+
+    State getState() const {
+        return state;
+    }
+
+    Error getError() const {
+        return error;
+    }
+
+    const CompactPathFormat::Header &getHeader() const {
+        return info;
+    }
+};
+
+#endif //COMPACT_PATH_DECODER_H
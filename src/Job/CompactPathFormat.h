@@ -0,0 +1,211 @@
+#ifndef COMPACT_PATH_FORMAT_H
+#define COMPACT_PATH_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "PathSource.h"
+
+/**
+ * Binary job format, about a quarter the size of pathSteps.
+ *
+ * Header, 24 bytes, little endian:
+ *   "SPJC", uint8 version, uint8 header size, uint16 reserved,
+ *   uint32 geometry hash (PlotterKinematics::GEOMETRY_HASH), uint32 move count, uint32 body length, uint32 body CRC-32
+ *
+ * Body, a sequence of records. Moves are coded as the residual against a constant-velocity prediction: the next
+ * point is expected one more last-step-delta away, which on smooth curves is off by a step or two at most.
+ *   0x00-0xE0  short move, (residualA + 7) * 15 + (residualB + 7), residuals in [-7, 7]
+ *   0xF0       move, zigzag varint residualA, zigzag varint residualB
+ *   0xF1       pen up          0xF2  pen down
+ *   0xF3       varint path speed limit in joint steps/s, 0 for none, applies to the following moves
+ *   0xF4       varint dwell in ms
+ *   0xF5       home
+ *   0xFF       end of job
+ * Pen, dwell and home records reset the predicted velocity to zero, home also the position.
+ */
+class CompactPathFormat {
+public:
+    constexpr static uint8_t MAGIC[4] = {'S', 'P', 'J', 'C'};
+    constexpr static uint8_t VERSION = 1;
+    constexpr static uint8_t HEADER_SIZE = 24;
+
+    constexpr static int8_t SHORT_RESIDUAL_LIMIT = 7;
+    constexpr static uint8_t SHORT_MOVE_LAST = 15 * 15 - 1;
+
+    enum Opcode : uint8_t {
+        opMove = 0xF0,
+        opPenUp = 0xF1,
+        opPenDown = 0xF2,
+        opSpeed = 0xF3,
+        opDwell = 0xF4,
+        opHome = 0xF5,
+        opEnd = 0xFF,
+    };
+
+    struct Header {
+        uint32_t geometryHash;
+        uint32_t moveCount;
+        uint32_t bodyLength;
+        uint32_t bodyCrc;
+    };
+
+    /** Position and velocity the move prediction runs on, shared by encoder and decoder */
+    struct Predictor {
+        long position[2] = {};
+        long velocity[2] = {};
+
+        void apply(const long a, const long b) {
+            velocity[0] = a - position[0];
+            velocity[1] = b - position[1];
+            position[0] = a;
+            position[1] = b;
+        }
+
+        void stop() {
+            velocity[0] = velocity[1] = 0;
+        }
+    };
+
+    /** CRC-32 (IEEE 802.3), nibble at a time from a 16-entry table */
+    static uint32_t updateCrc(uint32_t crc, const uint8_t byte) {
+        constexpr static uint32_t TABLE[16] = {
+            0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+            0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+        };
+
+        crc = ~crc;
+        crc = TABLE[(crc ^ byte) & 0x0F] ^ crc >> 4;
+        crc = TABLE[(crc ^ byte >> 4) & 0x0F] ^ crc >> 4;
+        return ~crc;
+    }
+
+    static uint32_t zigzag(const long value) {
+        return static_cast<uint32_t>(value) << 1 ^ static_cast<uint32_t>(value < 0 ? -1 : 0);
+    }
+
+    static long unzigzag(const uint32_t value) {
+        return static_cast<long>(value >> 1) ^ -static_cast<long>(value & 1);
+    }
+
+    static void writeUint32(uint8_t *out, const uint32_t value) {
+        for (uint8_t i = 0; i < 4; i++) {
+            out[i] = value >> (8 * i) & 0xFF;
+        }
+    }
+
+    static uint32_t readUint32(const uint8_t *in) {
+        return in[0] | in[1] << 8 | in[2] << 16 | static_cast<uint32_t>(in[3]) << 24;
+    }
+};
+
+/**
+ * Writes commands in CompactPathFormat into a caller-provided buffer, the first HEADER_SIZE bytes are
+ * reserved for the header and filled by finish().
+ */
+class CompactPathEncoder {
+    uint8_t *buffer;
+    size_t capacity;
+    size_t length = CompactPathFormat::HEADER_SIZE;
+    bool overflowed = false;
+
+    uint32_t geometryHash;
+    uint32_t moveCount = 0;
+    uint32_t bodyCrc = 0;
+    float speed = 0.0;
+    CompactPathFormat::Predictor predictor;
+
+    void put(const uint8_t byte) {
+        if (length >= capacity) {
+            overflowed = true;
+            return;
+        }
+
+        buffer[length++] = byte;
+        bodyCrc = CompactPathFormat::updateCrc(bodyCrc, byte);
+    }
+
+    void putVarint(uint32_t value) {
+        while (value >= 0x80) {
+            put(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        put(static_cast<uint8_t>(value));
+    }
+
+    void putMove(const long a, const long b) {
+        const long residualA = a - predictor.position[0] - predictor.velocity[0];
+        const long residualB = b - predictor.position[1] - predictor.velocity[1];
+        constexpr long LIMIT = CompactPathFormat::SHORT_RESIDUAL_LIMIT;
+
+        if (residualA >= -LIMIT && residualA <= LIMIT && residualB >= -LIMIT && residualB <= LIMIT) {
+            put(static_cast<uint8_t>((residualA + LIMIT) * (2 * LIMIT + 1) + residualB + LIMIT));
+        } else {
+            put(CompactPathFormat::opMove);
+            putVarint(CompactPathFormat::zigzag(residualA));
+            putVarint(CompactPathFormat::zigzag(residualB));
+        }
+
+        predictor.apply(a, b);
+        moveCount++;
+    }
+
+public:
+    CompactPathEncoder(uint8_t *buffer, const size_t capacity, const uint32_t geometryHash)
+        : buffer(buffer), capacity(capacity), geometryHash(geometryHash) {
+        overflowed = capacity < CompactPathFormat::HEADER_SIZE;
+    }
+
+    void add(const PathCommand &command) {
+        switch (command.type) {
+            case PathCommand::move:
+                if (command.value != speed) {
+                    speed = command.value;
+                    put(CompactPathFormat::opSpeed);
+                    putVarint(static_cast<uint32_t>(speed + 0.5f));
+                }
+                putMove(command.a, command.b);
+                break;
+            case PathCommand::penUp:
+            case PathCommand::penDown:
+                put(command.type == PathCommand::penUp ? CompactPathFormat::opPenUp : CompactPathFormat::opPenDown);
+                predictor.stop();
+                break;
+            case PathCommand::dwell:
+                put(CompactPathFormat::opDwell);
+                putVarint(static_cast<uint32_t>(command.value + 0.5f));
+                predictor.stop();
+                break;
+            case PathCommand::home:
+                put(CompactPathFormat::opHome);
+                predictor = {};
+                break;
+            case PathCommand::reportPosition:
+                break; // Interactive only
+        }
+    }
+
+    /**
+     * Ends the body and writes the header.
+     * @return total length, 0 if the buffer was too small
+     */
+    size_t finish() {
+        put(CompactPathFormat::opEnd);
+        if (overflowed) {
+            return 0;
+        }
+
+        memcpy(buffer, CompactPathFormat::MAGIC, sizeof(CompactPathFormat::MAGIC));
+        buffer[4] = CompactPathFormat::VERSION;
+        buffer[5] = CompactPathFormat::HEADER_SIZE;
+        buffer[6] = buffer[7] = 0;
+        CompactPathFormat::writeUint32(buffer + 8, geometryHash);
+        CompactPathFormat::writeUint32(buffer + 12, moveCount);
+        CompactPathFormat::writeUint32(buffer + 16, length - CompactPathFormat::HEADER_SIZE);
+        CompactPathFormat::writeUint32(buffer + 20, bodyCrc);
+        return length;
+    }
+};
+
+#endif //COMPACT_PATH_FORMAT_H
@@ -0,0 +1,61 @@
+#ifndef COMPACT_PATH_READER_H
+#define COMPACT_PATH_READER_H
+
+#include "CompactPathDecoder.h"
+#include "Kinematics/RhombusKinematics.h"
+
+/** Draws a CompactPathFormat job that is entirely in memory, decoding it as the coordinator asks */
+class CompactPathReader : public PathSource {
+    const uint8_t *data;
+    size_t length;
+    size_t offset = 0;
+    CompactPathDecoder decoder;
+
+    void decodeMore() {
+        if (decoder.hasCommand()) {
+            return;
+        }
+
+        offset += decoder.feed(data + offset, length - offset);
+        if (offset == length && !decoder.hasCommand()) {
+            decoder.end();
+        }
+    }
+
+public:
+    CompactPathReader(const uint8_t *data, const size_t length)
+        : data(data), length(length), decoder(PlotterKinematics::GEOMETRY_HASH) {
+    }
+
+    void rewind() {
+        offset = 0;
+        decoder.reset();
+    }
+
+    const CompactPathDecoder &getDecoder() const {
+        return decoder;
+    }
+
+    bool peek(PathCommand &command) override {
+        decodeMore();
+        if (!decoder.hasCommand()) {
+            return false;
+        }
+
+        command = decoder.getCommand();
+        return true;
+    }
+
+    void pop() override {
+        decoder.takeCommand();
+    }
+
+    /** Also true once a corrupt job has stopped decoding, see getDecoder().getError() */
+    bool isFinished() const override {
+        return !decoder.hasCommand()
+               && (decoder.getState() == CompactPathDecoder::finished
+                   || decoder.getState() == CompactPathDecoder::failed);
+    }
+};
+
+#endif //COMPACT_PATH_READER_H
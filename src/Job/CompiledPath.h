@@ -0,0 +1,14 @@
+#ifndef COMPILED_PATH_H
+#define COMPILED_PATH_H
+
+#include "CompactPathReader.h"
+#include "compiledJob.h"
+
+/** The job built into the firmware image (compiledJob.h, exported by the web slicer) */
+class CompiledPath : public CompactPathReader {
+public:
+    CompiledPath() : CompactPathReader(compiledJob, sizeof(compiledJob)) {
+    }
+};
+
+#endif //COMPILED_PATH_H
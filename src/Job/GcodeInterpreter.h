@@ -0,0 +1,357 @@
+#ifndef GCODE_INTERPRETER_H
+#define GCODE_INTERPRETER_H
+
+#include <cmath>
+#include <stddef.h>
+
+#include "GcodeParser.h"
+#include "PathSource.h"
+#include "Kinematics/RhombusKinematics.h"
+
+/**
+ * Turns a G-code byte stream into path commands for the coordinator. Bytes can come from anywhere (serial,
+ * telnet, a file) in chunks of any size; only as many are consumed as the command queue has room for, so the
+ * byte source is the buffer and memory use is fixed.
+ *
+ * Supported: G0/G1 X Y Z F, G4 P(ms)/S(s), G20/G21, G28 (homing cycle), G90/G91, M3/M4/M5 (pen down/up),
+ * M2/M30 (end of program), M114. Z <= 0 lowers the pen, Z > 0 lifts it. Other codes are skipped and counted.
+ *
+ * X/Y are millimetres in the web slicer's frame: origin at the arm pivots, y pointing away from the base.
+ * G1 lines are split into segments of at most MAX_SEGMENT_LENGTH, each solved by the inverse kinematics as the
+ * queue drains, so the pen follows a straight line. G0 travels straight in joint space, which is faster.
+ * Segment ends out of reach are skipped with the pen lifted, so nothing is drawn across them; it drops again at
+ * the next reachable one.
+ */
+class GcodeInterpreter : public PathSource {
+public:
+    /** @return false if the point can't be reached, the move is then skipped */
+    using JointMapper = bool (*)(float x, float y, long &a, long &b);
+    using JointForwardMapper = void (*)(long a, long b, float &x, float &y);
+
+    constexpr static uint8_t QUEUE_SIZE = 8; // Power of two
+    // Each G/M code can queue one command (G4, G28, M3/M5, M114), and a Z word one more pen command
+    constexpr static uint8_t MAX_COMMANDS_PER_LINE = GcodeParser::MAX_CODES + 1;
+    static_assert(MAX_COMMANDS_PER_LINE <= QUEUE_SIZE - 1, "A whole line's commands must fit the queue");
+    constexpr static float MAX_SEGMENT_LENGTH = 2.0; // mm, the web slicer's sampling step
+
+private:
+    constexpr static uint8_t MASK = QUEUE_SIZE - 1;
+
+    GcodeParser parser;
+    JointMapper mapper;
+    JointForwardMapper mapperForward;
+
+    PathCommand queue[QUEUE_SIZE] = {};
+    uint8_t head = 0;
+    uint8_t tail = 0;
+
+    // Modal state
+    bool absolute = true;
+    float unitScale = 1.0; // G20 inches to mm
+    float feedRate = 0.0; // Units/min, 0 until the first F
+    uint8_t motionMode = 0;
+    float x = 0.0;
+    float y = 0.0;
+    long jointA = 0;
+    long jointB = 0;
+    int8_t penDown = -1; // Unknown until the first pen command
+    bool liftedOverGap = false; // Pen down as far as the program goes, but lifted over segments out of reach
+    bool targetOutOfReach = false; // The last segment end was skipped, the arms are short of x/y
+
+    // Move being split into segments
+    float segmentFromX = 0.0;
+    float segmentFromY = 0.0;
+    float segmentSpeed = 0.0; // mm/s, 0 for as fast as possible
+    uint16_t segmentCount = 0;
+    uint16_t segmentIndex = 0;
+
+    bool programEnded = false;
+    uint16_t pendingAcknowledgements = 0;
+    uint32_t unsupportedCount = 0;
+    uint32_t unreachableCount = 0;
+
+    uint8_t size() const {
+        return (head - tail) & MASK;
+    }
+
+    void push(const PathCommand &command) {
+        queue[head] = command;
+        head = (head + 1) & MASK;
+    }
+
+    void setPen(const bool down) {
+        // Lowered out of reach: wait for the next reachable segment too, rather than drop where the arms were left
+        if (down && targetOutOfReach && !liftedOverGap) {
+            liftedOverGap = true;
+            penDown = 1;
+            return;
+        }
+
+        // Already up, and lowered at the next reachable segment if still down by then
+        if (liftedOverGap) {
+            liftedOverGap = down;
+            penDown = down;
+            return;
+        }
+
+        if (penDown != static_cast<int8_t>(down)) {
+            push({down ? PathCommand::penDown : PathCommand::penUp});
+            penDown = down;
+        }
+    }
+
+    bool hasRoomForLine() const {
+        return segmentIndex == segmentCount && QUEUE_SIZE - 1 - size() >= MAX_COMMANDS_PER_LINE;
+    }
+
+    /** Position after homing, with both arms on the y axis */
+    void resetPosition() {
+        jointA = jointB = 0;
+        targetOutOfReach = false;
+        mapperForward(0, 0, x, y);
+    }
+
+    void moveTo(const float newX, const float newY) {
+        const float length = hypotf(newX - x, newY - y);
+
+        segmentFromX = x;
+        segmentFromY = y;
+        segmentSpeed = motionMode == 1 ? feedRate / 60.0f : 0.0f;
+        segmentCount = motionMode == 1 ? static_cast<uint16_t>(ceilf(length / MAX_SEGMENT_LENGTH)) : 1;
+        segmentIndex = 0;
+
+        x = newX;
+        y = newY;
+        emitSegments();
+    }
+
+    /** Solves and queues as many pending segments as fit: up to two commands each, the move and a pen drop */
+    void emitSegments() {
+        while (segmentIndex < segmentCount && size() < QUEUE_SIZE - 2) {
+            segmentIndex++;
+            const float fraction = static_cast<float>(segmentIndex) / segmentCount;
+            const float segmentX = segmentFromX + (x - segmentFromX) * fraction;
+            const float segmentY = segmentFromY + (y - segmentFromY) * fraction;
+
+            const float previousFraction = static_cast<float>(segmentIndex - 1) / segmentCount;
+            const float length = hypotf(x - segmentFromX, y - segmentFromY) * (fraction - previousFraction);
+
+            long a = 0;
+            long b = 0;
+            if (!mapper(segmentX, segmentY, a, b)) {
+                unreachableCount++;
+                targetOutOfReach = true;
+                if (penDown == 1 && !liftedOverGap) {
+                    push({PathCommand::penUp});
+                    liftedOverGap = true;
+                }
+                continue;
+            }
+
+            targetOutOfReach = false;
+            if (liftedOverGap) {
+                push({PathCommand::move, a, b, 0.0});
+                push({PathCommand::penDown});
+                liftedOverGap = false;
+                jointA = a;
+                jointB = b;
+                continue;
+            }
+
+            if (a == jointA && b == jointB) {
+                continue;
+            }
+
+            // Feed is along the drawn line, the planner limits speed along the joint-space path
+            float speedLimit = 0.0;
+            if (segmentSpeed > 0.0f && length > 0.0f) {
+                const float jointLength = hypotf(static_cast<float>(a - jointA), static_cast<float>(b - jointB));
+                speedLimit = segmentSpeed * jointLength / length;
+            }
+
+            jointA = a;
+            jointB = b;
+            push({PathCommand::move, a, b, speedLimit});
+        }
+    }
+
+    void execute(const GcodeParser::Line &line) {
+        bool homing = false;
+
+        for (uint8_t i = 0; i < line.codeCount; i++) {
+            const GcodeParser::Code &code = line.codes[i];
+
+            if (code.letter == 'G') {
+                switch (code.number) {
+                    case 0:
+                    case 1:
+                        motionMode = code.number;
+                        break;
+                    case 4:
+                        push({PathCommand::dwell, 0, 0, line.has('P') ? line.get('P') : line.get('S') * 1000.0f});
+                        break;
+                    case 20:
+                        unitScale = 25.4f;
+                        break;
+                    case 21:
+                        unitScale = 1.0f;
+                        break;
+                    case 28:
+                        push({PathCommand::home});
+                        homing = true;
+                        penDown = 0; // Homing lifts the pen
+                        liftedOverGap = false;
+                        resetPosition();
+                        break;
+                    case 90:
+                        absolute = true;
+                        break;
+                    case 91:
+                        absolute = false;
+                        break;
+                    default:
+                        // The line's words may mean something else entirely (G2 arcs, G92 offsets), skip it whole
+                        unsupportedCount++;
+                        return;
+                }
+            } else {
+                switch (code.number) {
+                    case 2:
+                    case 30:
+                        programEnded = true;
+                        break;
+                    case 3:
+                    case 4:
+                        setPen(true);
+                        break;
+                    case 5:
+                        setPen(false);
+                        break;
+                    case 114:
+                        push({PathCommand::reportPosition});
+                        break;
+                    default:
+                        unsupportedCount++;
+                }
+            }
+        }
+
+        if (line.has('F')) {
+            feedRate = line.get('F') * unitScale;
+        }
+
+        if (line.has('Z')) {
+            setPen(line.get('Z') <= 0.0f);
+        }
+
+        // Like most controllers, a bare "X10 Y5" repeats the last motion mode. G28 X Y points are ignored.
+        if (!homing && (line.has('X') || line.has('Y'))) {
+            const float newX = line.has('X') ? line.get('X') * unitScale + (absolute ? 0.0f : x) : x;
+            const float newY = line.has('Y') ? line.get('Y') * unitScale + (absolute ? 0.0f : y) : y;
+            moveTo(newX, newY);
+        }
+    }
+
+public:
+    explicit GcodeInterpreter(const JointMapper mapper = PlotterKinematics::inverseMillimetres,
+                              const JointForwardMapper mapperForward = PlotterKinematics::forwardMillimetres)
+        : mapper(mapper), mapperForward(mapperForward) {
+        resetPosition();
+    }
+
+    /** True if the next line will fit the command queue */
+    bool canAccept() const {
+        return (!programEnded || head == tail) && hasRoomForLine();
+    }
+
+    /**
+     * Parses as much of the given bytes as fits.
+     * @return bytes consumed, the rest should be offered again later
+     */
+    size_t feed(const char *data, const size_t length) {
+        // A new program may start once the previous one has been fully executed
+        if (programEnded && head == tail && segmentIndex == segmentCount) {
+            programEnded = false;
+        }
+
+        size_t consumed = 0;
+        while (consumed < length && !programEnded && hasRoomForLine()) {
+            if (parser.feed(data[consumed++])) {
+                execute(parser.getLine());
+                pendingAcknowledgements++;
+            }
+        }
+
+        return consumed;
+    }
+
+    /** The byte source closed: the program ends once everything queued is executed. Needs canAccept(). */
+    void end() {
+        // Last line without a newline
+        if (parser.feed('\n')) {
+            execute(parser.getLine());
+            pendingAcknowledgements++;
+        }
+        programEnded = true;
+    }
+
+    /** Lines parsed since the last call, answered with "ok" by line-oriented senders */
+    uint16_t takeAcknowledgements() {
+        const uint16_t acknowledgements = pendingAcknowledgements;
+        pendingAcknowledgements = 0;
+        return acknowledgements;
+    }
+
+    /** True if there's something for the coordinator to execute */
+    bool hasCommands() const {
+        return head != tail || segmentIndex < segmentCount;
+    }
+
+    uint32_t getLineCount() const {
+        return parser.getLineCount();
+    }
+
+    uint32_t getErrorCount() const {
+        return parser.getErrorCount();
+    }
+
+    uint32_t getUnsupportedCount() const {
+        return unsupportedCount;
+    }
+
+    uint32_t getUnreachableCount() const {
+        return unreachableCount;
+    }
+
+    bool peek(PathCommand &command) override {
+        if (head == tail) {
+            emitSegments();
+        }
+
+        if (head == tail) {
+            return false;
+        }
+
+        command = queue[tail];
+        return true;
+    }
+
+    void pop() override {
+        tail = (tail + 1) & MASK;
+        emitSegments();
+    }
+
+    bool isFinished() const override {
+        return programEnded && head == tail && segmentIndex == segmentCount;
+    }
+
+    /** Drops what is queued, lines still to come start a new job. The coordinator left the pen up. */
+    void cancel() override {
+        tail = head;
+        segmentIndex = segmentCount;
+        penDown = -1;
+        liftedOverGap = false;
+    }
+};
+
+#endif //GCODE_INTERPRETER_H
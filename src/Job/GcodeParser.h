@@ -0,0 +1,210 @@
+#ifndef GCODE_PARSER_H
+#define GCODE_PARSER_H
+
+#include <stdint.h>
+
+/**
+ * Character-at-a-time G-code tokenizer. Words are decoded as the bytes arrive, so there is no line buffer,
+ * no string handling and nothing allocated; a line is available as soon as its newline is fed.
+ *
+ * Handles "; comments", "(comments)", N line numbers and *checksums (both ignored), any letter case and
+ * spaces inside words ("G1 X 10"). Numbers are plain decimals, without exponents.
+ */
+class GcodeParser {
+public:
+    constexpr static uint8_t MAX_CODES = 4; // G/M codes per line, e.g. "G90 G21 G1"
+
+    struct Code {
+        char letter; // 'G' or 'M'
+        uint16_t number;
+    };
+
+    struct Line {
+        Code codes[MAX_CODES];
+        uint8_t codeCount;
+        uint32_t presentWords; // Bit (letter - 'A') per parameter word
+        float words[26];
+
+        bool has(const char letter) const {
+            return presentWords & 1UL << (letter - 'A');
+        }
+
+        float get(const char letter, const float fallback = 0.0f) const {
+            return has(letter) ? words[letter - 'A'] : fallback;
+        }
+
+        bool hasCode(const char letter, const uint16_t number) const {
+            for (uint8_t i = 0; i < codeCount; i++) {
+                if (codes[i].letter == letter && codes[i].number == number) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+private:
+    enum Mode : uint8_t {
+        code,
+        parenComment,
+        skipToEnd // ; comment or checksum
+    };
+
+    Line line = {};
+    Mode mode = code;
+    bool failed = false;
+    bool ended = false; // Line ended, cleared on the next character so getLine() stays valid until then
+
+    char letter = 0;
+    uint32_t mantissa = 0;
+    uint8_t decimals = 0;
+    bool negative = false;
+    bool seenDigit = false;
+    bool seenDot = false;
+
+    uint32_t lineCount = 0;
+    uint32_t errorCount = 0;
+
+    static float scale(const uint32_t value, const uint8_t decimals) {
+        constexpr static float POWERS[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f};
+        return static_cast<float>(value) / POWERS[decimals];
+    }
+
+    void finishWord() {
+        if (letter == 0) {
+            return;
+        }
+
+        if (!seenDigit) {
+            failed = true;
+        } else if (letter == 'G' || letter == 'M') {
+            // Sub-codes such as G38.2 aren't used by the plotter, they're read as the whole number
+            if (line.codeCount < MAX_CODES && !negative) {
+                line.codes[line.codeCount++] = {letter, static_cast<uint16_t>(scale(mantissa, decimals))};
+            } else {
+                failed = true;
+            }
+        } else if (letter != 'N') {
+            const float value = scale(mantissa, decimals);
+            line.words[letter - 'A'] = negative ? -value : value;
+            line.presentWords |= 1UL << (letter - 'A');
+        }
+
+        letter = 0;
+    }
+
+    void startWord(const char newLetter) {
+        finishWord();
+        letter = newLetter;
+        mantissa = 0;
+        decimals = 0;
+        negative = false;
+        seenDigit = false;
+        seenDot = false;
+    }
+
+    void addToNumber(const char c) {
+        if (letter == 0) {
+            failed = true;
+            return;
+        }
+
+        if (c == '-' || c == '+') {
+            if (seenDigit || seenDot || negative) {
+                failed = true;
+            }
+            negative = c == '-';
+        } else if (c == '.') {
+            failed |= seenDot;
+            seenDot = true;
+        } else if (mantissa < 100000000 && decimals < 9) {
+            // Digits past float precision are dropped
+            mantissa = mantissa * 10 + (c - '0');
+            decimals += seenDot;
+            seenDigit = true;
+        } else {
+            seenDigit = true;
+            failed |= !seenDot; // Integer part too large
+        }
+    }
+
+    void reset() {
+        line.codeCount = 0;
+        line.presentWords = 0;
+        mode = code;
+        failed = false;
+        ended = false;
+        letter = 0;
+    }
+
+public:
+    /**
+     * Feeds one character.
+     * @return true when a line ended that holds at least one word, see getLine()
+     */
+    bool feed(char c) {
+        if (ended) {
+            reset();
+        }
+
+        if (c == '\n' || c == '\r') {
+            finishWord();
+
+            const bool complete = !failed && (line.codeCount > 0 || line.presentWords != 0);
+            if (failed) {
+                errorCount++;
+            }
+            if (complete) {
+                lineCount++;
+            }
+            ended = true;
+            return complete;
+        }
+
+        if (mode == parenComment) {
+            if (c == ')') {
+                mode = code;
+            }
+            return false;
+        }
+
+        if (mode == skipToEnd) {
+            return false;
+        }
+
+        if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+
+        if (c >= 'A' && c <= 'Z') {
+            startWord(c);
+        } else if ((c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+') {
+            addToNumber(c);
+        } else if (c == '(') {
+            mode = parenComment;
+        } else if (c == ';' || c == '*' || c == '%') {
+            finishWord();
+            mode = skipToEnd;
+        } else if (c != ' ' && c != '\t') {
+            failed = true;
+        }
+
+        return false;
+    }
+
+    /** Valid until the next call to feed() */
+    const Line &getLine() const {
+        return line;
+    }
+
+    uint32_t getLineCount() const {
+        return lineCount;
+    }
+
+    /** Lines dropped as malformed */
+    uint32_t getErrorCount() const {
+        return errorCount;
+    }
+};
+
+#endif //GCODE_PARSER_H
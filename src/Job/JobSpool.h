@@ -0,0 +1,458 @@
+#ifndef JOB_SPOOL_H
+#define JOB_SPOOL_H
+
+#include <FS.h>
+#include <Preferences.h>
+#include <cstdarg>
+
+#include "SpooledJob.h"
+#include "WorkspaceCheck.h"
+#include "Concurrency/FlashWriteGate.h"
+
+#define SPOOL_NAMESPACE "spool"
+#define SPOOL_KEY_CHECKPOINT "ckpt"
+
+/**
+ * Queue of compact jobs (CompactPathFormat, as exported by the web slicer) in the flash filesystem, drawn in upload
+ * order through a SpooledJob, with the current job's progress checkpointed to NVS so it survives a reset or
+ * brown-out: after a reboot the plotter homes and carries on from the last checkpointed stroke boundary.
+ *
+ * Jobs are files /jobs/NNNNNNNN.spj, numbered as uploaded. A job is checked end to end (geometry, CRC, every move
+ * within reach) before it joins the queue, is deleted once drawn or aborted, and renamed to .bad if it fails while
+ * drawing.
+ *
+ * NVS appends every write and erases whole pages once they fill up, so checkpoints are batched: the first stroke
+ * of a job, then at most one every CHECKPOINT_INTERVAL_MS, and a clear when the job ends. A ten hour job makes
+ * 1800 checkpoints of about 100 bytes of entries, some ten erases of each page of the default 20 KB partition,
+ * against an endurance of 100 000.
+ *
+ * Writing turns the flash cache off, which holds off the step ISR as well as the motion task; the step queue's
+ * lead only covers the motion task. So checkpoints and the flash work of a finished job wait until the arms are
+ * parked through the FlashWriteGate, at the next standstill, which for a checkpoint is the pen lift that ended
+ * the stroke. Uploads and deletes come from the HTTP and telnet handlers, which park the arms around them.
+ *
+ * Network task only, SpooledJob carries the job over to the motion task.
+ */
+class JobSpool {
+public:
+    constexpr static uint32_t CHECKPOINT_INTERVAL_MS = 20000;
+
+    /** Stored in NVS while a job is being drawn */
+    struct Checkpoint {
+        uint32_t jobId; // 0 for none
+        uint32_t jobCrc; // Body CRC from the job's header, tells a re-uploaded id apart
+        SpooledJob::Progress progress;
+    };
+
+    enum UploadResult : uint8_t {
+        queued,
+        notStarted,
+        writeFailed, // Flash full, most likely
+        invalidJob, // See getUploadError()
+        unreachableJob // Decodes, but moves out of reach; see getUploadWorkspace()
+    };
+
+private:
+    constexpr static const char *DIRECTORY = "/jobs";
+    constexpr static const char *UPLOAD_PATH = "/jobs/upload.tmp";
+    constexpr static size_t PATH_SIZE = 32;
+    constexpr static size_t CHUNK_SIZE = 512;
+    constexpr static uint8_t CHUNKS_PER_LOOP = 4; // Enough to skip through a resumed job in well under a second
+
+    fs::FS &fs;
+    SpooledJob &job;
+    FlashWriteGate &flashGate;
+    Preferences preferences;
+
+    uint32_t lastId = 0; // Highest job number on flash
+    uint32_t queuedJobs = 0;
+
+    // The job being drawn, 0 for none
+    uint32_t activeId = 0;
+    uint32_t activeCrc = 0;
+    File activeFile;
+    uint8_t chunk[CHUNK_SIZE] = {};
+    size_t chunkLength = 0;
+    size_t chunkOffset = 0;
+
+    Checkpoint saved = {}; // As in NVS
+    unsigned long savedAtMs = 0;
+    uint32_t checkpointWrites = 0;
+
+    File upload;
+    bool uploadFailed = false;
+    CompactPathDecoder::Error uploadError = CompactPathDecoder::none;
+    WorkspaceCheck uploadWorkspace;
+
+    /** Adds to `text` if the whole line fits */
+    static void append(char *text, const size_t size, size_t &length, const char *format, ...)
+        __attribute__((format(printf, 4, 5))) {
+        va_list args;
+        va_start(args, format);
+        const int written = vsnprintf(text + length, size - length, format, args);
+        va_end(args);
+
+        if (written > 0 && static_cast<size_t>(written) < size - length) {
+            length += written;
+        } else {
+            text[length] = '\0';
+        }
+    }
+
+    static void jobPath(char *path, const uint32_t id, const char *extension = "spj") {
+        snprintf(path, PATH_SIZE, "%s/%08lu.%s", DIRECTORY, static_cast<unsigned long>(id), extension);
+    }
+
+    /** Job number of a queued job's file name, 0 for anything else */
+    static uint32_t jobId(const char *name) {
+        const char *base = strrchr(name, '/');
+        base = base ? base + 1 : name;
+
+        char *end = nullptr;
+        const unsigned long id = strtoul(base, &end, 10);
+        return end == base + 8 && strcmp(end, ".spj") == 0 ? id : 0;
+    }
+
+    /** Lowest queued job number above `after`, 0 if none; also counts the queue and finds the highest number */
+    uint32_t scan(const uint32_t after = 0) {
+        uint32_t next = 0;
+        queuedJobs = 0;
+
+        File directory = fs.open(DIRECTORY);
+        if (!directory || !directory.isDirectory()) {
+            return 0;
+        }
+
+        for (File file = directory.openNextFile(); file; file = directory.openNextFile()) {
+            const uint32_t id = jobId(file.name());
+            if (id == 0) {
+                continue;
+            }
+
+            queuedJobs++;
+            lastId = std::max(lastId, id);
+            if (id > after && (next == 0 || id < next)) {
+                next = id;
+            }
+        }
+
+        return next;
+    }
+
+    static bool readHeader(File &file, CompactPathFormat::Header &header) {
+        uint8_t bytes[CompactPathFormat::HEADER_SIZE];
+        if (file.read(bytes, sizeof(bytes)) != sizeof(bytes)) {
+            return false;
+        }
+
+        header.geometryHash = CompactPathFormat::readUint32(bytes + 8);
+        header.moveCount = CompactPathFormat::readUint32(bytes + 12);
+        header.bodyLength = CompactPathFormat::readUint32(bytes + 16);
+        header.bodyCrc = CompactPathFormat::readUint32(bytes + 20);
+        return true;
+    }
+
+    /** Decodes a whole file, as the motion task will, and checks its moves into `workspace` */
+    static CompactPathDecoder::Error validate(File &file, WorkspaceCheck &workspace) {
+        CompactPathDecoder decoder(PlotterKinematics::GEOMETRY_HASH);
+        uint8_t bytes[CHUNK_SIZE];
+        size_t length = 0;
+
+        while ((length = file.read(bytes, sizeof(bytes))) > 0) {
+            size_t offset = 0;
+            while (offset < length && (decoder.getState() == CompactPathDecoder::readingHeader
+                                       || decoder.getState() == CompactPathDecoder::readingBody)) {
+                offset += decoder.feed(bytes + offset, length - offset);
+                if (decoder.hasCommand()) {
+                    workspace.check(decoder.getCommand());
+                    decoder.takeCommand();
+                }
+            }
+        }
+
+        decoder.end();
+        return decoder.getState() == CompactPathDecoder::finished ? CompactPathDecoder::none : decoder.getError();
+    }
+
+    void writeCheckpoint(const Checkpoint &checkpoint, const unsigned long nowMs) {
+        if (!preferences.begin(SPOOL_NAMESPACE, false)) return;
+        if (checkpoint.jobId == 0) {
+            preferences.remove(SPOOL_KEY_CHECKPOINT);
+        } else {
+            preferences.putBytes(SPOOL_KEY_CHECKPOINT, &checkpoint, sizeof(checkpoint));
+        }
+        preferences.end();
+
+        saved = checkpoint;
+        savedAtMs = nowMs;
+        checkpointWrites++;
+    }
+
+    void checkpoint(const unsigned long nowMs) {
+        const SpooledJob::Progress progress = job.getProgress();
+        const bool sameJob = saved.jobId == activeId;
+
+        if (progress.commands == 0 || (sameJob && progress.commands <= saved.progress.commands)) {
+            return;
+        }
+
+        if (sameJob && nowMs - savedAtMs < CHECKPOINT_INTERVAL_MS) {
+            return;
+        }
+
+        if (!flashGate.park()) {
+            return; // Asked again next loop, the arms park at their next standstill
+        }
+        writeCheckpoint({activeId, activeCrc, progress}, nowMs);
+        flashGate.release();
+    }
+
+    void feed() {
+        for (uint8_t i = 0; i < CHUNKS_PER_LOOP; i++) {
+            if (chunkOffset == chunkLength) {
+                chunkLength = activeFile.read(chunk, sizeof(chunk));
+                chunkOffset = 0;
+
+                if (chunkLength == 0) {
+                    job.endInput();
+                    return;
+                }
+            }
+
+            chunkOffset += job.feed(chunk + chunkOffset, chunkLength - chunkOffset);
+            if (chunkOffset < chunkLength) {
+                return; // Ring full
+            }
+        }
+    }
+
+    void finishActive(const SpooledJob::State state, const unsigned long nowMs) {
+        activeFile.close();
+
+        char path[PATH_SIZE];
+        jobPath(path, activeId);
+        if (state != SpooledJob::failed) {
+            fs.remove(path);
+        } else {
+            char badPath[PATH_SIZE];
+            jobPath(badPath, activeId, "bad");
+            fs.rename(path, badPath);
+        }
+
+        if (saved.jobId != 0) {
+            writeCheckpoint({}, nowMs);
+        }
+
+        if (state == SpooledJob::completed) {
+            printLn("Spooled job %lu done", static_cast<unsigned long>(activeId));
+        } else if (state == SpooledJob::aborted) {
+            printLn("Spooled job %lu aborted, deleted", static_cast<unsigned long>(activeId));
+        } else {
+            // Error 0: it decoded, but not to where the checkpoint it resumed from said
+            printLn("Spooled job %lu FAILED (decoder error %d), kept as .bad", static_cast<unsigned long>(activeId),
+                    static_cast<int>(job.getDecoder().getError()));
+        }
+        activeId = 0;
+        job.reset();
+        scan();
+    }
+
+public:
+    JobSpool(fs::FS &fs, SpooledJob &job, FlashWriteGate &flashGate) : fs(fs), job(job), flashGate(flashGate) {
+    }
+
+    /** Mounts nothing, the caller has begun the filesystem. Reads the queue and the checkpoint of an interrupted job. */
+    void begin() {
+        fs.mkdir(DIRECTORY);
+        fs.remove(UPLOAD_PATH);
+        scan();
+
+        if (preferences.begin(SPOOL_NAMESPACE, true)) {
+            if (preferences.getBytesLength(SPOOL_KEY_CHECKPOINT) == sizeof(Checkpoint)) {
+                preferences.getBytes(SPOOL_KEY_CHECKPOINT, &saved, sizeof(Checkpoint));
+            }
+            preferences.end();
+        }
+    }
+
+    /**
+     * Opens the next queued job into the SpooledJob, resuming it if the checkpoint is for it. The motion task
+     * starts drawing it once it sees a new generation, see SpooledJob::getGeneration().
+     * @return false if a job is open already or the queue is empty
+     */
+    bool startNext() {
+        if (activeId != 0 || queuedJobs == 0 || job.getState() != SpooledJob::idle) {
+            return false;
+        }
+
+        const uint32_t id = scan();
+        char path[PATH_SIZE];
+        jobPath(path, id);
+
+        activeFile = fs.open(path, FILE_READ);
+        CompactPathFormat::Header header = {};
+        if (!activeFile || !readHeader(activeFile, header) || !activeFile.seek(0)) {
+            activeFile.close();
+            return false;
+        }
+
+        activeId = id;
+        activeCrc = header.bodyCrc;
+        chunkLength = chunkOffset = 0;
+
+        const bool resuming = saved.jobId == id && saved.jobCrc == activeCrc;
+        job.begin(resuming ? saved.progress : SpooledJob::Progress{});
+        if (resuming) {
+            printLn("Resuming spooled job %lu after stroke %lu", static_cast<unsigned long>(id),
+                    static_cast<unsigned long>(saved.progress.strokes));
+        } else {
+            printLn("Starting spooled job %lu", static_cast<unsigned long>(id));
+        }
+        return true;
+    }
+
+    /**
+     * Every network loop: keeps the job's ring topped up, checkpoints, and closes a finished job once the motion
+     * task has drawn it.
+     * @param motionIdle the coordinator has finished the job too (homed, not moving)
+     */
+    void loop(const bool motionIdle, const unsigned long nowMs) {
+        if (activeId == 0) {
+            return;
+        }
+
+        feed();
+        checkpoint(nowMs);
+
+        if (job.isFinished() && motionIdle && flashGate.park()) {
+            finishActive(job.getState(), nowMs);
+            flashGate.release();
+        }
+    }
+
+    /** Starts receiving a job, replacing an unfinished upload. Uploads and remove() write flash, see the class. */
+    void beginUpload() {
+        upload.close();
+        upload = fs.open(UPLOAD_PATH, FILE_WRITE);
+        uploadFailed = !upload;
+        uploadError = CompactPathDecoder::none;
+        uploadWorkspace.reset();
+    }
+
+    void writeUpload(const uint8_t *data, const size_t length) {
+        if (!uploadFailed && upload.write(data, length) != length) {
+            uploadFailed = true;
+        }
+    }
+
+    /** Checks the upload and queues it under the next job number */
+    UploadResult finishUpload() {
+        if (!upload) {
+            return notStarted;
+        }
+
+        upload.close();
+        if (uploadFailed) {
+            fs.remove(UPLOAD_PATH);
+            return writeFailed;
+        }
+
+        File file = fs.open(UPLOAD_PATH, FILE_READ);
+        uploadError = validate(file, uploadWorkspace);
+        file.close();
+
+        if (uploadError != CompactPathDecoder::none || !uploadWorkspace.isValid()) {
+            fs.remove(UPLOAD_PATH);
+            return uploadError != CompactPathDecoder::none ? invalidJob : unreachableJob;
+        }
+
+        char path[PATH_SIZE];
+        jobPath(path, lastId + 1);
+        if (!fs.rename(UPLOAD_PATH, path)) {
+            fs.remove(UPLOAD_PATH);
+            return writeFailed;
+        }
+
+        scan();
+        return queued;
+    }
+
+    CompactPathDecoder::Error getUploadError() const {
+        return uploadError;
+    }
+
+    /** The last upload's moves against the workspace */
+    const WorkspaceCheck &getUploadWorkspace() const {
+        return uploadWorkspace;
+    }
+
+    /**
+     * Drops a queued job. The one being drawn stays, it is the motion task's until it ends.
+     * @return false if it isn't queued or is being drawn
+     */
+    bool remove(const uint32_t id, const unsigned long nowMs) {
+        char path[PATH_SIZE];
+        jobPath(path, id);
+        if (id == 0 || id == activeId || !fs.remove(path)) {
+            return false;
+        }
+
+        if (saved.jobId == id) {
+            writeCheckpoint({}, nowMs);
+        }
+        scan();
+        return true;
+    }
+
+    /** Job number of the newest upload */
+    uint32_t getLastId() const {
+        return lastId;
+    }
+
+    /** Including the one being drawn */
+    uint32_t getQueuedJobs() const {
+        return queuedJobs;
+    }
+
+    uint32_t getActiveId() const {
+        return activeId;
+    }
+
+    const Checkpoint &getSavedCheckpoint() const {
+        return saved;
+    }
+
+    uint32_t getCheckpointWrites() const {
+        return checkpointWrites;
+    }
+
+    /** The queue as text, one job per line, for /jobs and telnet */
+    size_t list(char *text, const size_t size) {
+        size_t length = 0;
+        text[0] = '\0';
+
+        for (uint32_t id = scan(); id != 0; id = scan(id)) {
+            char path[PATH_SIZE];
+            jobPath(path, id);
+            File file = fs.open(path, FILE_READ);
+            const unsigned long bytes = file ? file.size() : 0;
+
+            if (id != activeId) {
+                append(text, size, length, "%lu %lu bytes\n", static_cast<unsigned long>(id), bytes);
+                continue;
+            }
+
+            const SpooledJob::Progress progress = job.getProgress();
+            append(text, size, length, "%lu %lu bytes, drawing, %lu strokes done\n", static_cast<unsigned long>(id),
+                   bytes, static_cast<unsigned long>(progress.strokes));
+        }
+        scan();
+
+        if (length == 0) {
+            append(text, size, length, "No jobs queued\n");
+        }
+        return length;
+    }
+};
+
+#endif //JOB_SPOOL_H
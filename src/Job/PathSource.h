@@ -0,0 +1,116 @@
+#ifndef PATH_SOURCE_H
+#define PATH_SOURCE_H
+
+#include <Arduino.h>
+
+/** Joint-space point, in the layout of pathSteps (B first). Both at or above 4096 means "pen up". */
+struct PathPoint {
+    constexpr static int16_t PEN_UP = 32767;
+
+    int16_t b;
+    int16_t a;
+
+    bool isPenUp() const {
+        return a >= 4096 && b >= 4096;
+    }
+};
+
+/** One step of a job, as executed by the coordinator's drawingPath state */
+struct PathCommand {
+    enum Type : uint8_t {
+        move,
+        penUp,
+        penDown,
+        dwell,
+        home,
+        reportPosition,
+    };
+
+    Type type = move;
+    long a = 0;
+    long b = 0;
+    float value = 0; // move: path speed limit in joint steps/s, 0 for the axis maximum; dwell: ms
+};
+
+/** Where the coordinator's drawingPath state takes its commands from */
+class PathSource {
+public:
+    virtual ~PathSource() = default;
+
+    /** @return false if no command is available right now */
+    virtual bool peek(PathCommand &command) = 0;
+
+    virtual void pop() = 0;
+
+    /** True once every command has been popped and no more will come */
+    virtual bool isFinished() const = 0;
+
+    /** The job was aborted, nothing more will be taken from it */
+    virtual void cancel() {
+    }
+};
+
+/**
+ * Source of pathSteps-style points: a pen-up marker lifts the pen, the next point is travelled to
+ * with the pen up and the pen is lowered there.
+ */
+class PointPathSource : public PathSource {
+    bool penDown = false;
+    bool penDownPending = false;
+
+protected:
+    virtual bool peekPoint(PathPoint &point) = 0;
+
+    virtual void popPoint() = 0;
+
+    virtual bool hasNoMorePoints() const = 0;
+
+    void restart() {
+        penDown = false;
+        penDownPending = false;
+    }
+
+public:
+    bool peek(PathCommand &command) override {
+        if (penDownPending) {
+            command = {PathCommand::penDown};
+            return true;
+        }
+
+        PathPoint point = {};
+        if (!peekPoint(point)) {
+            return false;
+        }
+
+        command = point.isPenUp()
+                      ? PathCommand{PathCommand::penUp}
+                      : PathCommand{PathCommand::move, point.a, point.b};
+        return true;
+    }
+
+    void pop() override {
+        if (penDownPending) {
+            penDownPending = false;
+            penDown = true;
+            return;
+        }
+
+        PathPoint point = {};
+        if (!peekPoint(point)) {
+            return;
+        }
+        popPoint();
+
+        if (point.isPenUp()) {
+            penDown = false;
+        } else if (!penDown) {
+            penDownPending = true;
+        }
+    }
+
+    bool isFinished() const override {
+        return !penDownPending && hasNoMorePoints();
+    }
+};
+
+#endif //PATH_SOURCE_H
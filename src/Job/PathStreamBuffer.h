@@ -0,0 +1,220 @@
+#ifndef PATH_STREAM_BUFFER_H
+#define PATH_STREAM_BUFFER_H
+
+#include <atomic>
+
+#include "Kinematics/RhombusKinematics.h"
+#include "PathSource.h"
+
+/**
+ * Fixed-size ring of points received over the network, drawn as they arrive.
+ *
+ * Wire protocol (little endian):
+ *   client -> plotter  "SPJ1", then 4-byte points {int16 B, int16 A} as in pathSteps,
+ *                      {32767, 32767} lifts the pen, {-32768, -32768} ends the job
+ *   plotter -> client  'C' uint16 n   the client may send n more points
+ *                      'B'            busy, another job is running; the connection is closed
+ *
+ * A point out of reach is stored as a pen lift, so the pen skips over it rather than the arms being driven there,
+ * and is counted.
+ *
+ * Flow control is credit based: the client never sends more points than it was granted, and grants never exceed
+ * free space in the ring, so the plotter never has to drop or block on data.
+ *
+ * The network task receives and the motion task draws, on different cores: head and state are written by the
+ * receiving side, tail by the drawing side, and the end of a drained job is claimed by whichever sees it first.
+ */
+class PathStreamBuffer : public PointPathSource {
+public:
+    constexpr static uint16_t CAPACITY = 1024; // Power of two
+    constexpr static uint8_t MAGIC[4] = {'S', 'P', 'J', '1'};
+    constexpr static int16_t END_OF_JOB = -32768;
+
+    enum State {
+        idle,
+        receiving,
+        draining // End marker received, points still being drawn
+    };
+
+private:
+    constexpr static uint16_t MASK = CAPACITY - 1;
+    constexpr static uint16_t GRANT_BATCH = CAPACITY / 4;
+
+    PathPoint points[CAPACITY] = {};
+    std::atomic<uint16_t> head{0}; // Written by the receiving side
+    std::atomic<uint16_t> tail{0}; // Written by the drawing side
+
+    std::atomic<State> state{idle};
+    uint16_t outstandingCredits = 0;
+
+    uint8_t partial[4] = {};
+    uint8_t partialLength = 0;
+    uint8_t magicMatched = 0;
+    uint32_t unreachablePoints = 0;
+
+    uint16_t size() const {
+        return (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire)) & MASK;
+    }
+
+    uint16_t freeSpace() const {
+        return CAPACITY - 1 - size();
+    }
+
+    void finishIfDrained() {
+        State expected = draining;
+        if (head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire)) {
+            state.compare_exchange_strong(expected, idle, std::memory_order_acq_rel);
+        }
+    }
+
+    void acceptRecord() {
+        PathPoint point = {
+            static_cast<int16_t>(partial[0] | partial[1] << 8),
+            static_cast<int16_t>(partial[2] | partial[3] << 8)
+        };
+        partialLength = 0;
+
+        if (outstandingCredits > 0) {
+            outstandingCredits--;
+        }
+
+        if (point.a == END_OF_JOB && point.b == END_OF_JOB) {
+            end();
+            return;
+        }
+
+        if (!point.isPenUp() && !PlotterKinematics::isReachable(point.a, point.b)) {
+            unreachablePoints++;
+            point = {PathPoint::PEN_UP, PathPoint::PEN_UP};
+        }
+
+        const uint16_t currentHead = head.load(std::memory_order_relaxed);
+        points[currentHead] = point;
+        head.store((currentHead + 1) & MASK, std::memory_order_release);
+    }
+
+protected:
+    bool peekPoint(PathPoint &point) override {
+        const uint16_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        point = points[currentTail];
+        return true;
+    }
+
+    void popPoint() override {
+        tail.store((tail.load(std::memory_order_relaxed) + 1) & MASK, std::memory_order_release);
+        finishIfDrained();
+    }
+
+    bool hasNoMorePoints() const override {
+        return state.load(std::memory_order_acquire) != receiving
+               && head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+    }
+
+public:
+    /** Starts a new job, returns false if one is still in progress */
+    bool begin() {
+        if (getState() != idle) {
+            return false;
+        }
+
+        // Nothing draws from an idle stream, so the drawing side's state can be reset from here
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        partialLength = 0;
+        magicMatched = 0;
+        outstandingCredits = 0;
+        restart();
+        state.store(receiving, std::memory_order_release);
+        return true;
+    }
+
+    /** Connection lost: whatever arrived is drawn, then the job ends */
+    void end() {
+        State expected = receiving;
+        if (state.compare_exchange_strong(expected, draining, std::memory_order_acq_rel)) {
+            finishIfDrained();
+        }
+    }
+
+    /** Drawing side, the job was aborted: the stream ends, and the receiving side closes the connection */
+    void cancel() override {
+        State current = getState();
+        while (current != idle && !state.compare_exchange_weak(current, idle, std::memory_order_acq_rel)) {
+        }
+    }
+
+    State getState() const {
+        return state.load(std::memory_order_acquire);
+    }
+
+    /** Receiving side: points stored as pen lifts since boot */
+    uint32_t getUnreachablePoints() const {
+        return unreachablePoints;
+    }
+
+    /** Bytes the caller may read from the connection without overrunning the granted credit */
+    size_t acceptableBytes() const {
+        if (getState() != receiving) {
+            return 0;
+        }
+
+        if (magicMatched < sizeof(MAGIC)) {
+            return sizeof(MAGIC) - magicMatched;
+        }
+
+        return outstandingCredits * 4 - partialLength;
+    }
+
+    /**
+     * Parses received bytes.
+     * @return false on a protocol error, the job is then ended
+     */
+    bool receive(const uint8_t *data, const size_t length) {
+        for (size_t i = 0; i < length && getState() == receiving; i++) {
+            if (magicMatched < sizeof(MAGIC)) {
+                if (data[i] != MAGIC[magicMatched]) {
+                    end();
+                    return false;
+                }
+                magicMatched++;
+                continue;
+            }
+
+            if (outstandingCredits == 0) {
+                end();
+                return false;
+            }
+
+            partial[partialLength++] = data[i];
+            if (partialLength == sizeof(partial)) {
+                acceptRecord();
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Credits to send to the client now, 0 if not worth a message yet.
+     * Granted credits are counted as outstanding until the matching points arrive.
+     */
+    uint16_t takeCredits() {
+        if (getState() != receiving || magicMatched < sizeof(MAGIC)) {
+            return 0;
+        }
+
+        const uint16_t grantable = freeSpace() - outstandingCredits;
+        if (grantable < GRANT_BATCH && outstandingCredits > 0) {
+            return 0;
+        }
+
+        outstandingCredits += grantable;
+        return grantable;
+    }
+};
+
+#endif //PATH_STREAM_BUFFER_H
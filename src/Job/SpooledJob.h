@@ -0,0 +1,226 @@
+#ifndef SPOOLED_JOB_H
+#define SPOOLED_JOB_H
+
+#include <atomic>
+
+#include "CompactPathDecoder.h"
+#include "Concurrency/SeqlockSnapshot.h"
+#include "Concurrency/SpscQueue.h"
+#include "Kinematics/RhombusKinematics.h"
+
+/**
+ * The job JobSpool is drawing: the network task reads it from flash into a byte ring, the motion task decodes and
+ * draws it, so flash access stays off the motion core.
+ *
+ * The motion task publishes its progress at every stroke boundary (a popped pen lift), which JobSpool checkpoints.
+ * A job resumed from a checkpoint is decoded from the start, since moves are coded against the ones before, and
+ * everything up to the checkpoint is dropped; the position it leaves must be where the checkpointed stroke ended,
+ * or the job fails rather than draw in the wrong place.
+ *
+ * begin() and reset() belong to the network task and only run while the motion task leaves the job alone (idle,
+ * or finished); `state` is otherwise advanced by the motion task.
+ */
+class SpooledJob : public PathSource {
+public:
+    constexpr static uint16_t CAPACITY = 4096; // Bytes, a power of two
+
+    enum State : uint8_t {
+        idle,
+        drawing,
+        completed, // Every command handed to the coordinator
+        failed, // Didn't decode, or didn't match the checkpoint it resumed from
+        aborted // By the user, see StepperMotorCoordinator::abort()
+    };
+
+    /** Where the job stood after its last stroke, with the pen up */
+    struct Progress {
+        uint32_t commands; // Popped, up to and including the pen lift
+        uint32_t strokes;
+        long a; // Where the pen lifted
+        long b;
+    };
+
+private:
+    SpscQueue<uint8_t, CAPACITY> bytes;
+    std::atomic<State> state{idle};
+    std::atomic<bool> inputEnded{false};
+    std::atomic<uint32_t> generation{0}; // Jobs begun, so the motion task can tell a new one from the last
+    SeqlockSnapshot<Progress> progress;
+
+    // Motion side
+    CompactPathDecoder decoder{PlotterKinematics::GEOMETRY_HASH};
+    Progress resumeAt = {};
+    Progress current = {};
+
+    void decodeMore() {
+        if (decoder.hasCommand()) {
+            return;
+        }
+
+        // Read first: once the end is flagged every byte is in the ring, so running dry means the data ended
+        const bool ended = inputEnded.load(std::memory_order_acquire);
+        uint8_t byte = 0;
+        bool drained = false;
+
+        while (!decoder.hasCommand() && (decoder.getState() == CompactPathDecoder::readingHeader
+                                         || decoder.getState() == CompactPathDecoder::readingBody)) {
+            if (!bytes.pop(byte)) {
+                drained = true;
+                break;
+            }
+            decoder.feed(&byte, 1);
+        }
+
+        if (drained && ended) {
+            decoder.end();
+        }
+    }
+
+    void track(const PathCommand &command) {
+        current.commands++;
+
+        if (command.type == PathCommand::move) {
+            current.a = command.a;
+            current.b = command.b;
+        } else if (command.type == PathCommand::penUp) {
+            current.strokes++;
+        }
+    }
+
+    /** Drops what was drawn before the checkpoint, as far as the bytes received so far go */
+    bool skipToResume() {
+        while (current.commands < resumeAt.commands) {
+            decodeMore();
+            if (!decoder.hasCommand()) {
+                return false;
+            }
+
+            track(decoder.getCommand());
+            decoder.takeCommand();
+
+            if (current.commands == resumeAt.commands
+                && (current.a != resumeAt.a || current.b != resumeAt.b || current.strokes != resumeAt.strokes)) {
+                state.store(failed, std::memory_order_release);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void settle() {
+        if (decoder.hasCommand() || state.load(std::memory_order_relaxed) != drawing) {
+            return;
+        }
+
+        if (decoder.getState() == CompactPathDecoder::finished) {
+            state.store(completed, std::memory_order_release);
+        } else if (decoder.getState() == CompactPathDecoder::failed) {
+            state.store(failed, std::memory_order_release);
+        }
+    }
+
+public:
+    /**
+     * Network side: starts a job, from the beginning or from a checkpoint, once the last one was reset.
+     * @return false if a job is still in progress
+     */
+    bool begin(const Progress &from = {}) {
+        if (getState() != idle) {
+            return false;
+        }
+
+        // Nothing reads an idle job, so the motion side can be reset from here
+        uint8_t byte = 0;
+        while (bytes.pop(byte)) {
+        }
+        decoder.reset();
+        resumeAt = from;
+        current = {};
+        progress.write(from);
+        inputEnded.store(false, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_relaxed);
+        state.store(drawing, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Network side: queues bytes of the job file.
+     * @return bytes taken, less than `length` once the ring is full
+     */
+    size_t feed(const uint8_t *data, const size_t length) {
+        size_t taken = 0;
+        while (taken < length && bytes.push(data[taken])) {
+            taken++;
+        }
+        return taken;
+    }
+
+    /** Network side: the whole file has been fed */
+    void endInput() {
+        inputEnded.store(true, std::memory_order_release);
+    }
+
+    /** Network side, once the job is finished and the motion task is done with it */
+    void reset() {
+        state.store(idle, std::memory_order_release);
+    }
+
+    State getState() const {
+        return state.load(std::memory_order_acquire);
+    }
+
+    uint32_t getGeneration() const {
+        return generation.load(std::memory_order_relaxed);
+    }
+
+    /** Any task: the last stroke boundary */
+    Progress getProgress() const {
+        return progress.read();
+    }
+
+    /** Motion side, for the log when a resumed job fails */
+    const CompactPathDecoder &getDecoder() const {
+        return decoder;
+    }
+
+    bool peek(PathCommand &command) override {
+        if (getState() != drawing || !skipToResume()) {
+            return false;
+        }
+
+        decodeMore();
+        settle();
+        if (!decoder.hasCommand()) {
+            return false;
+        }
+
+        command = decoder.getCommand();
+        return true;
+    }
+
+    void pop() override {
+        if (!decoder.hasCommand()) {
+            return;
+        }
+
+        const PathCommand command = decoder.getCommand();
+        decoder.takeCommand();
+        track(command);
+
+        if (command.type == PathCommand::penUp) {
+            progress.write(current);
+        }
+    }
+
+    bool isFinished() const override {
+        const State currentState = getState();
+        return currentState == completed || currentState == failed || currentState == aborted;
+    }
+
+    void cancel() override {
+        state.store(aborted, std::memory_order_release);
+    }
+};
+
+#endif //SPOOLED_JOB_H
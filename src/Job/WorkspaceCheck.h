@@ -0,0 +1,74 @@
+#ifndef WORKSPACE_CHECK_H
+#define WORKSPACE_CHECK_H
+
+#include "Kinematics/RhombusKinematics.h"
+#include "PathSource.h"
+
+/**
+ * Checks the moves of a job against the plotter's joint space as they go by, so a job can be refused before it
+ * is drawn instead of sending the arms somewhere they can't go. Each move costs a few comparisons, see
+ * PlotterKinematics::isReachable(); the segments between moves need no check of their own, as the workspace is
+ * convex in joint space.
+ */
+class WorkspaceCheck {
+public:
+    /** A move that leaves the workspace */
+    struct Violation {
+        uint32_t command; // Index in the job, from 0
+        long a;
+        long b;
+    };
+
+private:
+    uint32_t commands = 0;
+    uint32_t moves = 0;
+    uint32_t violations = 0;
+    Violation first = {};
+
+public:
+    void reset() {
+        commands = moves = violations = 0;
+        first = {};
+    }
+
+    /** @return false if the command is a move out of reach */
+    bool check(const PathCommand &command) {
+        const uint32_t index = commands++;
+        if (command.type != PathCommand::move) {
+            return true;
+        }
+
+        moves++;
+        if (PlotterKinematics::isReachable(command.a, command.b)) {
+            return true;
+        }
+
+        if (violations++ == 0) {
+            first = {index, command.a, command.b};
+        }
+        return false;
+    }
+
+    bool isValid() const {
+        return violations == 0;
+    }
+
+    uint32_t getCommands() const {
+        return commands;
+    }
+
+    uint32_t getMoves() const {
+        return moves;
+    }
+
+    uint32_t getViolations() const {
+        return violations;
+    }
+
+    /** Meaningless while isValid() */
+    const Violation &getFirst() const {
+        return first;
+    }
+};
+
+#endif //WORKSPACE_CHECK_H
@@ -0,0 +1,38 @@
+#ifndef COMPILED_JOB_H
+#define COMPILED_JOB_H
+
+#include <Arduino.h>
+
+// Auto-generated by the web slicer, CompactPathFormat (440 bytes)
+const uint8_t compiledJob[] = {
+  0x53, 0x50, 0x4A, 0x43, 0x01, 0x18, 0x00, 0x00, 0x40, 0xA2, 0x51, 0xB9, 0x74, 0x01, 0x00, 0x00,
+  0xA0, 0x01, 0x00, 0x00, 0x4F, 0xDF, 0xC6, 0x27, 0xF0, 0xF7, 0x10, 0xF6, 0x06, 0xF2, 0xF0, 0x16,
+  0x0A, 0x62, 0x6F, 0x7F, 0x62, 0x6F, 0x7E, 0x62, 0x70, 0x7E, 0x62, 0x6F, 0x7F, 0x61, 0x70, 0x7F,
+  0x60, 0x71, 0x6F, 0x80, 0x60, 0x70, 0x7F, 0xF0, 0x0F, 0x15, 0x41, 0x8E, 0x61, 0x6F, 0x71, 0x7F,
+  0x70, 0x60, 0x80, 0x70, 0x6F, 0x80, 0x61, 0x7E, 0x62, 0x7F, 0x6F, 0x71, 0x7E, 0x62, 0x6F, 0x80,
+  0xF0, 0x00, 0x12, 0xF0, 0x01, 0x14, 0x7F, 0x70, 0x61, 0x7F, 0x70, 0x6F, 0x80, 0x61, 0x6F, 0x80,
+  0x60, 0x80, 0x6F, 0x70, 0x71, 0x6F, 0x70, 0x70, 0x71, 0x7E, 0x61, 0x89, 0xF0, 0x02, 0x15, 0x71,
+  0x7E, 0x70, 0x61, 0x7F, 0x6F, 0x71, 0x6F, 0x80, 0x60, 0x7F, 0x61, 0x7E, 0x71, 0x7E, 0x61, 0x7F,
+  0x6F, 0x71, 0x6F, 0x7F, 0x62, 0xF0, 0x21, 0x2E, 0x6F, 0x80, 0x60, 0x80, 0x7E, 0x61, 0x7E, 0x71,
+  0x70, 0x6F, 0x7F, 0x62, 0x7E, 0x70, 0x70, 0x7F, 0x61, 0x7F, 0x61, 0x7F, 0x6F, 0x80, 0xF0, 0x12,
+  0x15, 0x9B, 0x6F, 0x71, 0x6F, 0x61, 0x8E, 0x61, 0x70, 0x6F, 0x71, 0x7E, 0x61, 0x7F, 0x6F, 0x70,
+  0x71, 0x6F, 0x6F, 0x71, 0x7E, 0x70, 0x6F, 0xF0, 0x1D, 0x18, 0xF0, 0x11, 0x0E, 0x70, 0x70, 0x7E,
+  0x70, 0x70, 0x70, 0x7E, 0x61, 0x7F, 0x70, 0x70, 0x7E, 0x62, 0x7E, 0x70, 0x71, 0x6F, 0x6F, 0x71,
+  0x7F, 0x61, 0xD7, 0xF0, 0x12, 0x03, 0x70, 0x7F, 0x61, 0x70, 0x7E, 0x62, 0x7F, 0x60, 0x7F, 0x71,
+  0x60, 0x7F, 0x70, 0x70, 0x6F, 0x71, 0x6F, 0x71, 0x6F, 0x70, 0x71, 0x42, 0xF0, 0x1F, 0x02, 0x61,
+  0x70, 0x7F, 0x60, 0x80, 0x60, 0x7F, 0x70, 0x61, 0x7F, 0x70, 0x6F, 0x61, 0x80, 0x6F, 0x70, 0x70,
+  0x61, 0x7E, 0x71, 0x6F, 0x71, 0xF0, 0x16, 0x0E, 0x9E, 0x61, 0x7F, 0x62, 0x7E, 0x70, 0x70, 0x70,
+  0x70, 0x80, 0x60, 0x7F, 0x61, 0x7F, 0x70, 0x70, 0x80, 0x60, 0x70, 0x7F, 0x70, 0x70, 0xF0, 0x15,
+  0x13, 0x10, 0x7F, 0x70, 0x70, 0x70, 0x70, 0x60, 0x80, 0x6F, 0x71, 0x6F, 0x70, 0x70, 0x70, 0x6F,
+  0x71, 0x70, 0x6F, 0x7F, 0x62, 0x6F, 0x70, 0xA4, 0xF0, 0x06, 0x12, 0x71, 0x6F, 0x70, 0x70, 0x80,
+  0x60, 0x70, 0x80, 0x6F, 0x62, 0x7E, 0x71, 0x6F, 0x71, 0x6F, 0x80, 0x61, 0x7F, 0x60, 0x80, 0x70,
+  0x5D, 0xF0, 0x07, 0x23, 0x7F, 0x70, 0x70, 0x80, 0x60, 0x80, 0x70, 0x6F, 0x71, 0x7F, 0x70, 0x70,
+  0x71, 0x6F, 0x7F, 0x62, 0x7E, 0x71, 0x6F, 0x80, 0x61, 0x7F, 0xF0, 0x11, 0x12, 0x70, 0x70, 0x6F,
+  0x71, 0x60, 0x80, 0x60, 0x7F, 0x60, 0x71, 0x6F, 0x70, 0x70, 0x70, 0x70, 0x6F, 0x61, 0x7F, 0x61,
+  0x6F, 0x80, 0x60, 0xF0, 0x20, 0x04, 0xBC, 0x70, 0x7F, 0x61, 0x70, 0x70, 0x7E, 0x62, 0x6F, 0x71,
+  0x6F, 0x70, 0x70, 0x70, 0x70, 0x70, 0x70, 0x70, 0x61, 0x7E, 0x71, 0x6F, 0xF0, 0x0F, 0x03, 0xF0,
+  0x11, 0x03, 0x7E, 0x70, 0x71, 0x6F, 0x70, 0x70, 0x80, 0x60, 0x70, 0x7F, 0x70, 0x70, 0x70, 0x70,
+  0x70, 0x70, 0x70, 0x7E, 0x62, 0x7F, 0x70, 0xFF,
+};
+
+#endif //COMPILED_JOB_H
@@ -0,0 +1,169 @@
+#ifndef FIXED_POINT_MATH_H
+#define FIXED_POINT_MATH_H
+
+#include <stdint.h>
+
+/** Lookup tables of FixedPointMath, computed by the compiler from series good to double precision */
+struct FixedPointTables {
+    constexpr static uint16_t SIZE = 256;
+    constexpr static double RADIANS_PER_HALF_TURN = 3.14159265358979323846;
+
+    uint32_t atan[SIZE + 1] = {}; // atan(i / 256) in binary angle, up to an eighth of a turn
+    uint32_t sqrt[SIZE + 1] = {}; // sqrt(i * 2^24) in Q8, only i >= 64 is used
+    uint32_t sine[SIZE + 1] = {}; // sin over a quarter turn, Q30
+
+    static constexpr double seriesSin(const double x) {
+        double term = x;
+        double sum = x;
+        for (int n = 1; n < 20; n++) {
+            term *= -x * x / ((2 * n) * (2 * n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    /** Euler's series, converges on the whole [0, 1] table range */
+    static constexpr double seriesAtan(const double x) {
+        const double ratio = x * x / (1 + x * x);
+        double term = x / (1 + x * x);
+        double sum = term;
+        for (int n = 1; n < 80; n++) {
+            term *= ratio * (2 * n) / (2 * n + 1);
+            sum += term;
+        }
+        return sum;
+    }
+
+    static constexpr double newtonSqrt(const double x) {
+        double root = x > 1 ? x : 1;
+        for (int i = 0; i < 64; i++) {
+            root = 0.5 * (root + x / root);
+        }
+        return root;
+    }
+
+    constexpr FixedPointTables() {
+        for (uint16_t i = 0; i <= SIZE; i++) {
+            atan[i] = static_cast<uint32_t>(seriesAtan(i / 256.0) / RADIANS_PER_HALF_TURN * 2147483648.0 + 0.5);
+            sqrt[i] = static_cast<uint32_t>(newtonSqrt(i * 16777216.0) * 256.0 + 0.5);
+            sine[i] = static_cast<uint32_t>(seriesSin(i * RADIANS_PER_HALF_TURN / 512.0) * 1073741824.0 + 0.5);
+        }
+    }
+};
+
+/**
+ * Integer atan2, sqrt and sine on interpolated lookup tables, for code that runs every segment.
+ *
+ * Angles are binary angles: a full turn is 2^32, so they wrap like the hardware does and the sign bit
+ * splits the circle in half. The tables are computed at compile time and end up in flash.
+ */
+class FixedPointMath {
+public:
+    constexpr static int64_t HALF_TURN = 1LL << 31;
+    constexpr static int64_t QUARTER_TURN = 1LL << 30;
+    constexpr static uint8_t SINE_BITS = 30; // sin() and cos() return Q30
+
+private:
+    constexpr static uint16_t TABLE_SIZE = FixedPointTables::SIZE;
+    constexpr static FixedPointTables TABLES = {};
+
+    static uint32_t interpolate(const uint32_t *table, const uint32_t index, const uint32_t fraction16) {
+        const uint32_t from = table[index];
+        const uint32_t to = table[index + 1];
+        return from + static_cast<uint32_t>(static_cast<uint64_t>(to - from) * fraction16 >> 16);
+    }
+
+    /** atan of ratio / 2^24, ratio in [0, 2^24] */
+    static uint32_t atanRatio(const uint32_t ratio) {
+        if (ratio >= 1UL << 24) {
+            return TABLES.atan[TABLE_SIZE];
+        }
+        return interpolate(TABLES.atan, ratio >> 16, ratio & 0xFFFF);
+    }
+
+    /** smaller / larger in Q24, larger in [2^23, 2^24), as three 32-bit long division digits */
+    static uint32_t divideQ24(const uint32_t smaller, const uint32_t larger) {
+        uint32_t quotient = 0;
+        uint32_t remainder = smaller;
+        for (uint8_t digit = 0; digit < 3; digit++) {
+            remainder <<= 8;
+            quotient = quotient << 8 | remainder / larger;
+            remainder %= larger;
+        }
+        return quotient;
+    }
+
+public:
+    /** Angle of (x, y) from the x axis, in binary angle, positive counterclockwise */
+    static int32_t atan2(const int32_t y, const int32_t x) {
+        uint32_t ax = x < 0 ? -static_cast<uint32_t>(x) : x;
+        uint32_t ay = y < 0 ? -static_cast<uint32_t>(y) : y;
+
+        if (ax == 0 && ay == 0) {
+            return 0;
+        }
+
+        // Scale the larger one into [2^23, 2^24), so the ratio keeps 24 bits without overflowing
+        const uint32_t larger = ax > ay ? ax : ay;
+        const int shift = 24 - (32 - __builtin_clz(larger));
+        if (shift < 0) {
+            ax >>= -shift;
+            ay >>= -shift;
+        } else {
+            ax <<= shift;
+            ay <<= shift;
+        }
+
+        int64_t angle = ax >= ay
+                            ? atanRatio(divideQ24(ay, ax))
+                            : QUARTER_TURN - atanRatio(divideQ24(ax, ay));
+
+        if (x < 0) {
+            angle = HALF_TURN - angle;
+        }
+
+        return static_cast<int32_t>(y < 0 ? -angle : angle);
+    }
+
+    /** Rounded square root */
+    static uint32_t sqrt(const uint64_t value) {
+        if (value == 0) {
+            return 0;
+        }
+
+        // Normalize into [2^30, 2^32) by an even shift, sqrt(value) = sqrt(normalized) * 2^(shift / 2)
+        int shift = 64 - __builtin_clzll(value) - 32;
+        shift += shift & 1;
+        const uint32_t normalized = static_cast<uint32_t>(shift >= 0 ? value >> shift : value << -shift);
+
+        const uint32_t root = interpolate(TABLES.sqrt, normalized >> 24, normalized >> 8 & 0xFFFF); // Q8
+
+        if (shift >= 8 * 2) {
+            return root << (shift / 2 - 8);
+        }
+        const int down = 8 - shift / 2;
+        return (root + (1UL << (down - 1))) >> down;
+    }
+
+    /** Q30 sine of a binary angle */
+    static int32_t sin(const uint32_t angle) {
+        const uint8_t quadrant = angle >> 30;
+        uint32_t offset = angle & 0x3FFFFFFF;
+
+        if (quadrant & 1) {
+            offset = 0x40000000 - offset;
+        }
+
+        const uint32_t value = offset >= 0x40000000
+                                   ? TABLES.sine[TABLE_SIZE]
+                                   : interpolate(TABLES.sine, offset >> 22, offset >> 6 & 0xFFFF);
+
+        return quadrant & 2 ? -static_cast<int32_t>(value) : static_cast<int32_t>(value);
+    }
+
+    static int32_t cos(const uint32_t angle) {
+        return sin(angle + 0x40000000);
+    }
+};
+
+#endif //FIXED_POINT_MATH_H
@@ -0,0 +1,215 @@
+#ifndef RHOMBUS_KINEMATICS_H
+#define RHOMBUS_KINEMATICS_H
+
+#include <cmath>
+
+#include "FixedPointMath.h"
+
+/** FNV-1a over the geometry parameters as little-endian int32, as computed by the web slicer */
+constexpr uint32_t hashGeometry(const int32_t armLength, const int32_t fullSteps, const int32_t fullDegrees,
+                                const int32_t minDistance, const int32_t maxDistance, const int32_t armRange) {
+    const int32_t parameters[] = {armLength, fullSteps, fullDegrees, minDistance, maxDistance, armRange};
+    uint32_t hash = 2166136261u;
+    for (const int32_t parameter : parameters) {
+        for (uint8_t byte = 0; byte < 4; byte++) {
+            hash ^= static_cast<uint32_t>(parameter) >> (8 * byte) & 0xFF;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Forward and inverse kinematics of the two-arm rhombus linkage, same model as computeRhombusKinematics in
+ * the web slicer: both arms pivot at the origin, y points away from the base, and each motor angle is
+ * measured from the y axis. Geometry is compile-time, so every constant below folds into the code.
+ *
+ * Coordinates are fixed point, 1/256 mm. Joint positions are motor steps as in pathSteps:
+ * A is the arm clockwise of the pen direction (the slicer's "b"), B the counterclockwise one.
+ *
+ * @tparam ARM_LENGTH    mm, all four rhombus sides
+ * @tparam FULL_STEPS    steps over FULL_DEGREES of motor rotation
+ * @tparam FULL_DEGREES  degrees of motor rotation
+ * @tparam MIN_DISTANCE  mm, closest reachable pen distance from the origin
+ * @tparam MAX_DISTANCE  mm, farthest one
+ * @tparam ARM_RANGE     steps each arm may sweep, centred on the y axis
+ */
+template<int32_t ARM_LENGTH, int32_t FULL_STEPS, int32_t FULL_DEGREES,
+    int32_t MIN_DISTANCE, int32_t MAX_DISTANCE, int32_t ARM_RANGE>
+class RhombusKinematics {
+public:
+    constexpr static uint8_t FRACTION_BITS = 8;
+    constexpr static int32_t ONE = 1 << FRACTION_BITS; // 1 mm
+
+    static_assert(MIN_DISTANCE > 0 && MIN_DISTANCE < MAX_DISTANCE, "Empty workspace");
+    static_assert(MAX_DISTANCE <= 2 * ARM_LENGTH, "Workspace beyond arm reach");
+    static_assert(2 * ARM_LENGTH * ONE < 1 << 23, "Squares must leave 16 bits of headroom in 64 bits");
+
+    constexpr static int32_t ARM_RANGE_STEPS = ARM_RANGE;
+    constexpr static double RADIANS_PER_STEP = FULL_DEGREES * FixedPointTables::RADIANS_PER_HALF_TURN / 180.0
+                                               / FULL_STEPS;
+
+    /** Identifies the geometry joint-space jobs were sliced for */
+    constexpr static uint32_t GEOMETRY_HASH =
+            hashGeometry(ARM_LENGTH, FULL_STEPS, FULL_DEGREES, MIN_DISTANCE, MAX_DISTANCE, ARM_RANGE);
+
+private:
+    constexpr static uint64_t square(const int64_t value) {
+        return static_cast<uint64_t>(value * value);
+    }
+
+    constexpr static uint64_t MIN_DISTANCE_SQUARED = square(static_cast<int64_t>(MIN_DISTANCE) * ONE);
+    constexpr static uint64_t MAX_DISTANCE_SQUARED = square(static_cast<int64_t>(MAX_DISTANCE) * ONE);
+    constexpr static uint64_t REACH_SQUARED = square(static_cast<int64_t>(2 * ARM_LENGTH) * ONE);
+
+    // Binary angle to steps: steps = angle * STEP_SCALE >> STEP_SHIFT
+    constexpr static uint8_t STEP_SCALE_BITS = 16;
+    constexpr static uint8_t STEP_SHIFT = 32 + STEP_SCALE_BITS;
+    constexpr static int64_t STEP_SCALE =
+            (360LL * FULL_STEPS * (1LL << STEP_SCALE_BITS) + FULL_DEGREES / 2) / FULL_DEGREES;
+
+    // Steps to binary angle: angle = steps * ANGLE_SCALE >> ANGLE_SCALE_BITS
+    constexpr static uint8_t ANGLE_SCALE_BITS = 16;
+    constexpr static int64_t ANGLE_SCALE =
+            ((static_cast<int64_t>(FULL_DEGREES) << (32 + ANGLE_SCALE_BITS)) + 180LL * FULL_STEPS)
+            / (360LL * FULL_STEPS);
+
+    // Half of ARM_RANGE, before rounding
+    constexpr static int64_t JOINT_LIMIT = static_cast<int64_t>(ARM_RANGE) << (STEP_SHIFT - 1);
+
+    /** Pen distance from the origin in mm with the arms B - A steps apart */
+    constexpr static double openingDistance(const long opening) {
+        return 2.0 * ARM_LENGTH * FixedPointTables::seriesSin(
+                   FixedPointTables::RADIANS_PER_HALF_TURN / 2 - opening * RADIANS_PER_STEP / 2);
+    }
+
+    constexpr static long narrowestOpening() {
+        long opening = 0;
+        while (openingDistance(opening) > MAX_DISTANCE) {
+            opening++;
+        }
+        return opening;
+    }
+
+    constexpr static long widestOpening() {
+        long opening = narrowestOpening();
+        while (openingDistance(opening + 1) >= MIN_DISTANCE) {
+            opening++;
+        }
+        return opening;
+    }
+
+public:
+    /**
+     * The workspace in joint space, where it is a band across a square: each arm within ARM_LIMIT_STEPS of the y
+     * axis, and B ahead of A by OPENING_MIN_STEPS to OPENING_MAX_STEPS. The narrowest opening keeps the arms from
+     * closing in on each other as the pen reaches MAX_DISTANCE, the widest keeps the pen off MIN_DISTANCE.
+     * All of it is convex, and the arms move linearly in joint space, so a move between two reachable points
+     * stays reachable all the way, but for the step the minor axis rounds by.
+     */
+    constexpr static long ARM_LIMIT_STEPS = ARM_RANGE / 2;
+    constexpr static long OPENING_MIN_STEPS = narrowestOpening();
+    constexpr static long OPENING_MAX_STEPS = widestOpening();
+
+    static_assert(OPENING_MIN_STEPS < OPENING_MAX_STEPS && OPENING_MAX_STEPS <= 2 * ARM_LIMIT_STEPS,
+                  "Empty joint space");
+
+    /** Whether the arms may be sent to (a, b): a few comparisons, for checking every point of a job */
+    static bool isReachable(const long a, const long b) {
+        const long opening = b - a;
+        return a >= -ARM_LIMIT_STEPS && a <= ARM_LIMIT_STEPS && b >= -ARM_LIMIT_STEPS && b <= ARM_LIMIT_STEPS
+               && opening >= OPENING_MIN_STEPS && opening <= OPENING_MAX_STEPS;
+    }
+
+private:
+    /** Motors turn the opposite way to the angles */
+    static bool toSteps(const int64_t angle, long &steps) {
+        const int64_t scaled = -angle * STEP_SCALE;
+        if (scaled > JOINT_LIMIT || scaled < -JOINT_LIMIT) {
+            return false;
+        }
+
+        steps = static_cast<long>((scaled + (1LL << (STEP_SHIFT - 1))) >> STEP_SHIFT);
+        return true;
+    }
+
+    static int64_t toAngle(const long steps) {
+        return -(static_cast<int64_t>(steps) * ANGLE_SCALE >> ANGLE_SCALE_BITS);
+    }
+
+public:
+    /**
+     * Joint steps that put the pen at (x, y).
+     * @return false if the point is outside the workspace or needs an arm past its range; otherwise the steps
+     *         are isReachable(), also where rounding them lands right on the edge
+     */
+    static bool inverse(const int32_t x, const int32_t y, long &a, long &b) {
+        const uint64_t distanceSquared = square(x) + square(y);
+        if (distanceSquared < MIN_DISTANCE_SQUARED || distanceSquared > MAX_DISTANCE_SQUARED) {
+            return false;
+        }
+
+        // The pen direction, then each elbow sits at the half-opening angle acos(d / 2L) to either side of it
+        const int32_t direction = FixedPointMath::atan2(x, y);
+        // Roots in Q16 rather than Q8, the angle is only as precise as they are
+        const int32_t halfOpening = FixedPointMath::atan2(
+            FixedPointMath::sqrt((REACH_SQUARED - distanceSquared) << 16),
+            FixedPointMath::sqrt(distanceSquared << 16)
+        );
+
+        long stepsA = 0;
+        long stepsB = 0;
+        if (!toSteps(static_cast<int64_t>(direction) + halfOpening, stepsA)
+            || !toSteps(static_cast<int64_t>(direction) - halfOpening, stepsB) || !isReachable(stepsA, stepsB)) {
+            return false;
+        }
+
+        a = stepsA;
+        b = stepsB;
+        return true;
+    }
+
+    /** Pen position for the given joint steps */
+    static void forward(const long a, const long b, int32_t &x, int32_t &y) {
+        const int64_t angleA = toAngle(a);
+        const int64_t angleB = toAngle(b);
+        const uint32_t direction = static_cast<uint32_t>((angleA + angleB) / 2);
+        const uint32_t halfOpening = static_cast<uint32_t>((angleA - angleB) / 2);
+
+        constexpr uint8_t BITS = FixedPointMath::SINE_BITS;
+        const int64_t distance = static_cast<int64_t>(2 * ARM_LENGTH * ONE) * FixedPointMath::cos(halfOpening);
+
+        // distance is Q(8 + 30), the products Q(8 + 60) would overflow, so drop 30 bits first
+        const int64_t roundedDistance = (distance + (1LL << (BITS - 1))) >> BITS;
+        x = static_cast<int32_t>((roundedDistance * FixedPointMath::sin(direction) + (1LL << (BITS - 1))) >> BITS);
+        y = static_cast<int32_t>((roundedDistance * FixedPointMath::cos(direction) + (1LL << (BITS - 1))) >> BITS);
+    }
+
+    /** inverse() for millimetres */
+    static bool inverseMillimetres(const float x, const float y, long &a, long &b) {
+        return inverse(lroundf(x * ONE), lroundf(y * ONE), a, b);
+    }
+
+    static void forwardMillimetres(const long a, const long b, float &x, float &y) {
+        int32_t fixedX = 0;
+        int32_t fixedY = 0;
+        forward(a, b, fixedX, fixedY);
+        x = static_cast<float>(fixedX) / ONE;
+        y = static_cast<float>(fixedY) / ONE;
+    }
+
+    /** Floating-point forward() in mm, for the fractional joint positions host-side tools interpolate */
+    static void forwardExact(const double a, const double b, double &x, double &y) {
+        const double angleA = -a * RADIANS_PER_STEP;
+        const double angleB = -b * RADIANS_PER_STEP;
+        const double distance = 2.0 * ARM_LENGTH * std::cos((angleA - angleB) / 2);
+
+        x = distance * std::sin((angleA + angleB) / 2);
+        y = distance * std::cos((angleA + angleB) / 2);
+    }
+};
+
+/** This plotter, as configured in the web slicer */
+using PlotterKinematics = RhombusKinematics<150, 2900, 200, 50, 290, 2900>;
+
+#endif //RHOMBUS_KINEMATICS_H
@@ -2,42 +2,179 @@
 #define PREFERENCES_MANAGER_H
 
 #define PREFERENCES_NAMESPACE "ns"
-#define PREFERENCES_KEY_SETTINGS "set"
+#define PREFERENCES_KEY_SETTINGS_V1 "set" // The first firmware's
+#define PREFERENCES_KEY_SETTINGS "set2" // PrefsData, each layout under a key of its own
+#define PREFERENCES_KEY_VERSION "ver" // Of the newest layout written
 
 #include <Preferences.h>
+#include <type_traits>
 
+#include "StepperMotor/MotionConfig.h"
+
+/** Layout of the first firmware, stored without a version key. Frozen, read() migrates it. */
+struct PrefsDataV1 {
+    bool enableAp;
+    bool enableWifi;
+    char wifiSSID[64];
+    char wifiPassword[64];
+} __attribute__((packed));
+
+static_assert(sizeof(PrefsDataV1) == 130, "PrefsDataV1 is what old firmware stored, it must not change");
+
+/**
+ * Stored as one blob under a key of its own, next to its version. Any change to the layout needs a new
+ * PREFS_VERSION and key, the old layout frozen like PrefsDataV1 and a migration in PreferencesManager::read(), so
+ * an update keeps what was set.
+ */
 struct PrefsData {
+    constexpr static uint16_t PREFS_VERSION = 2;
+
     bool enableAp = true;
     bool enableWifi = true;
     char wifiSSID[64] = "";
     char wifiPassword[64] = "";
-} __attribute__((packed));
+    MotionConfig motion;
+};
+
+static_assert(std::is_trivially_copyable<PrefsData>::value, "Stored as raw bytes");
+static_assert(sizeof(PrefsData) == 188, "PrefsData layout changed: bump PREFS_VERSION, freeze the old layout and "
+                                        "migrate it in PreferencesManager::read()");
 
 class PreferencesManager {
+public:
+    /** What read() found */
+    enum LoadResult : uint8_t {
+        empty, // Nothing stored, defaults
+        loaded,
+        migrated, // From an older version, and saved back as the current one
+        motionReset, // Network settings loaded, invalid motion values back at the defaults until the next save
+        unreadable // Unknown version or wrong size: defaults, the stored data is left alone
+    };
+
+private:
     Preferences preferences;
 
+    LoadResult loadResult = empty;
+    uint16_t storedVersion = 0;
+
+    static void terminate(char *text, const size_t size) {
+        text[size - 1] = '\0';
+    }
+
+    static void migrateFromV1(const PrefsDataV1 &old, PrefsData &data) {
+        data.enableAp = old.enableAp;
+        data.enableWifi = old.enableWifi;
+        memcpy(data.wifiSSID, old.wifiSSID, sizeof(data.wifiSSID));
+        memcpy(data.wifiPassword, old.wifiPassword, sizeof(data.wifiPassword));
+        // Motion settings didn't exist yet, they start at the firmware defaults
+    }
+
+    /** Reads the newest layout stored into `settings`, converting older ones */
+    LoadResult load() {
+        if (storedVersion > PrefsData::PREFS_VERSION) {
+            // Written by newer firmware, perhaps before a downgrade: keep it for when that firmware is back
+            return unreadable;
+        }
+
+        size_t length = preferences.getBytesLength(PREFERENCES_KEY_SETTINGS);
+        if (length > 0) {
+            storedVersion = PrefsData::PREFS_VERSION;
+            if (length != sizeof(PrefsData)) {
+                return unreadable;
+            }
+
+            preferences.getBytes(PREFERENCES_KEY_SETTINGS, &settings, sizeof(PrefsData));
+            if (!settings.motion.isValid()) {
+                // Still reachable over the network to fix the motion settings
+                settings.motion = MotionConfig();
+                return motionReset;
+            }
+            return loaded;
+        }
+
+        length = preferences.getBytesLength(PREFERENCES_KEY_SETTINGS_V1);
+        if (length > 0) {
+            storedVersion = 1;
+            if (length != sizeof(PrefsDataV1)) {
+                return unreadable;
+            }
+
+            PrefsDataV1 old = {};
+            preferences.getBytes(PREFERENCES_KEY_SETTINGS_V1, &old, sizeof(old));
+            migrateFromV1(old, settings);
+            return migrated;
+        }
+
+        return empty;
+    }
+
 public:
     PrefsData settings = {};
 
     void read() {
-        if (preferences.begin(PREFERENCES_NAMESPACE, true)) {
-            if (preferences.getBytesLength(PREFERENCES_KEY_SETTINGS) == sizeof(PrefsData)) {
-                preferences.getBytes(PREFERENCES_KEY_SETTINGS, &settings, sizeof(PrefsData));
-            } else {
-                settings = PrefsData();
-            }
-            preferences.end();
-        } else {
+        settings = PrefsData();
+        loadResult = empty;
+        storedVersion = 0;
+
+        if (!preferences.begin(PREFERENCES_NAMESPACE, true)) {
+            return;
+        }
+
+        // The first firmware stored no version
+        storedVersion = preferences.getUShort(PREFERENCES_KEY_VERSION, 1);
+        loadResult = load();
+        preferences.end();
+
+        if (loadResult == unreadable) {
             settings = PrefsData();
         }
-    }
 
+        terminate(settings.wifiSSID, sizeof(settings.wifiSSID));
+        terminate(settings.wifiPassword, sizeof(settings.wifiPassword));
 
+        if (loadResult == migrated) {
+            save();
+        }
+    }
+
+    /**
+     * The older layout is deleted only once this one is written, so a power cut part way through a migration
+     * leaves one or the other to read.
+     */
     void save() {
         if (!preferences.begin(PREFERENCES_NAMESPACE, false)) return;
-        preferences.putBytes(PREFERENCES_KEY_SETTINGS, &settings, sizeof(PrefsData));
+        if (preferences.putBytes(PREFERENCES_KEY_SETTINGS, &settings, sizeof(PrefsData)) == sizeof(PrefsData)) {
+            preferences.putUShort(PREFERENCES_KEY_VERSION, PrefsData::PREFS_VERSION);
+            if (preferences.getBytesLength(PREFERENCES_KEY_SETTINGS_V1) > 0) {
+                preferences.remove(PREFERENCES_KEY_SETTINGS_V1);
+            }
+        }
         preferences.end();
     }
+
+    LoadResult getLoadResult() const {
+        return loadResult;
+    }
+
+    const char *getLoadResultName() const {
+        switch (loadResult) {
+            case loaded:
+                return "loaded";
+            case migrated:
+                return "migrated";
+            case motionReset:
+                return "invalid motion settings, using their defaults";
+            case unreadable:
+                return "unreadable, using defaults";
+            default:
+                return "empty, using defaults";
+        }
+    }
+
+    /** Of the data read() found, 0 if there was none */
+    uint16_t getStoredVersion() const {
+        return loadResult == empty ? 0 : storedVersion;
+    }
 };
 
 #endif //PREFERENCES_MANAGER_H
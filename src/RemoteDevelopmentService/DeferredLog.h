@@ -0,0 +1,315 @@
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+/** One log line as queued: the format string and its arguments, not yet formatted */
+struct LogRecord {
+    constexpr static uint8_t MAX_ARGUMENTS = 6;
+    constexpr static uint8_t STRING_CAPACITY = 48; // For copies of all string arguments together
+
+    enum Type : uint8_t {
+        signedInteger,
+        unsignedInteger,
+        floatingPoint,
+        string
+    };
+
+    union Value {
+        int64_t signedValue;
+        uint64_t unsignedValue;
+        double floatValue;
+        uint8_t stringOffset;
+    };
+
+    const char *format;
+    uint8_t argumentCount;
+    uint8_t stringLength;
+    bool truncated; // Arguments or string bytes didn't fit
+    Type types[MAX_ARGUMENTS];
+    Value values[MAX_ARGUMENTS];
+    char strings[STRING_CAPACITY];
+
+    Value *add(const Type type) {
+        if (argumentCount == MAX_ARGUMENTS) {
+            truncated = true;
+            return nullptr;
+        }
+
+        types[argumentCount] = type;
+        return &values[argumentCount++];
+    }
+};
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+appendLogArgument(LogRecord &record, const T value) {
+    if constexpr (std::is_signed<T>::value || std::is_enum<T>::value) {
+        if (LogRecord::Value *slot = record.add(LogRecord::signedInteger)) {
+            slot->signedValue = static_cast<int64_t>(value);
+        }
+    } else if (LogRecord::Value *slot = record.add(LogRecord::unsignedInteger)) {
+        slot->unsignedValue = static_cast<uint64_t>(value);
+    }
+}
+
+inline void appendLogArgument(LogRecord &record, const double value) {
+    if (LogRecord::Value *slot = record.add(LogRecord::floatingPoint)) {
+        slot->floatValue = value;
+    }
+}
+
+/** Strings are copied, the caller's buffer may be gone by the time the line is formatted */
+inline void appendLogArgument(LogRecord &record, const char *value) {
+    LogRecord::Value *slot = record.add(LogRecord::string);
+    if (!slot) {
+        return;
+    }
+
+    slot->stringOffset = record.stringLength;
+    const char *text = value ? value : "(null)";
+    while (*text && record.stringLength < LogRecord::STRING_CAPACITY - 1) {
+        record.strings[record.stringLength++] = *text++;
+    }
+    record.truncated |= *text != '\0';
+    record.strings[record.stringLength++] = '\0';
+}
+
+/**
+ * Log lines queued by any task and formatted later by one low-priority drain, so logging from the motion path
+ * costs a few copies instead of formatting and a blocking Serial write, and never touches the heap.
+ *
+ * Records live in a fixed arena of slots, a bounded multi-producer queue: a producer claims a slot by advancing
+ * the enqueue position with a compare-and-swap, fills it, and hands it over through the slot's sequence number.
+ * A full arena drops the line and counts it rather than waiting.
+ *
+ * Format strings are stored by pointer and must be literals; arguments are stored widened, so length modifiers
+ * in the format are ignored. Supported conversions: d i u x X o c f F e E g G s and %%.
+ */
+class DeferredLog {
+public:
+    constexpr static uint8_t CAPACITY = 64; // Power of two
+    constexpr static uint8_t LINE_LENGTH = 128; // Formatted, including the terminator
+
+    struct Stats {
+        uint32_t logged;
+        uint32_t dropped; // Arena full
+        uint32_t truncated; // Too many arguments or too long strings, logged anyway
+    };
+
+private:
+    constexpr static uint32_t MASK = CAPACITY - 1;
+
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        LogRecord record;
+    };
+
+    Slot slots[CAPACITY];
+    std::atomic<uint32_t> enqueuePosition{0};
+    uint32_t dequeuePosition = 0; // Drain only
+
+    std::atomic<uint32_t> logged{0};
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint32_t> truncated{0};
+
+    /** Claims the next free slot for writing, or nullptr if the arena is full */
+    Slot *claim(uint32_t &position) {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot &slot = slots[position & MASK];
+            const int32_t lag = static_cast<int32_t>(slot.sequence.load(std::memory_order_acquire) - position);
+
+            if (lag == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    return &slot;
+                }
+            } else if (lag < 0) {
+                return nullptr;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static void appendText(char *line, size_t &length, const char *text) {
+        while (*text && length < LINE_LENGTH - 1) {
+            line[length++] = *text++;
+        }
+    }
+
+    static void appendFormatted(size_t &length, const int written) {
+        if (written > 0) {
+            length = std::min(length + written, static_cast<size_t>(LINE_LENGTH - 1));
+        }
+    }
+
+    /** One conversion, `spec` being its flags, width and precision after the '%' */
+    static void formatArgument(const LogRecord &record, const uint8_t index, const char *spec, const char conversion,
+                               char *line, size_t &length) {
+        char specifier[16];
+        const LogRecord::Type type = record.types[index];
+        const LogRecord::Value &value = record.values[index];
+        const size_t space = LINE_LENGTH - length;
+
+        if (conversion == 's') {
+            snprintf(specifier, sizeof(specifier), "%%%ss", spec);
+            appendFormatted(length, snprintf(line + length, space, specifier,
+                                                   type == LogRecord::string
+                                                       ? record.strings + value.stringOffset
+                                                       : "?"));
+            return;
+        }
+
+        if (type == LogRecord::string) {
+            appendText(line, length, "?");
+            return;
+        }
+
+        if (strchr("fFeEgG", conversion)) {
+            const double number = type == LogRecord::floatingPoint
+                                      ? value.floatValue
+                                      : type == LogRecord::signedInteger
+                                            ? static_cast<double>(value.signedValue)
+                                            : static_cast<double>(value.unsignedValue);
+            snprintf(specifier, sizeof(specifier), "%%%s%c", spec, conversion);
+            appendFormatted(length, snprintf(line + length, space, specifier, number));
+            return;
+        }
+
+        const int64_t integer = type == LogRecord::floatingPoint
+                                    ? static_cast<int64_t>(value.floatValue)
+                                    : type == LogRecord::signedInteger
+                                          ? value.signedValue
+                                          : static_cast<int64_t>(value.unsignedValue);
+
+        if (conversion == 'c') {
+            snprintf(specifier, sizeof(specifier), "%%%sc", spec);
+            appendFormatted(length, snprintf(line + length, space, specifier, static_cast<int>(integer)));
+        } else if (conversion == 'd' || conversion == 'i') {
+            snprintf(specifier, sizeof(specifier), "%%%slld", spec);
+            appendFormatted(length, snprintf(line + length, space, specifier, static_cast<long long>(integer)));
+        } else {
+            snprintf(specifier, sizeof(specifier), "%%%sll%c", spec, conversion);
+            appendFormatted(length, snprintf(line + length, space, specifier,
+                                                   static_cast<unsigned long long>(integer)));
+        }
+    }
+
+public:
+    DeferredLog() {
+        for (uint32_t i = 0; i < CAPACITY; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Queues a line from any task. Never blocks and never allocates.
+     * @return false if the arena was full and the line was dropped
+     */
+    template<typename... Args>
+    bool log(const char *format, const Args &... args) {
+        uint32_t position = 0;
+        Slot *slot = claim(position);
+        if (!slot) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        LogRecord &record = slot->record;
+        record.format = format;
+        record.argumentCount = 0;
+        record.stringLength = 0;
+        record.truncated = false;
+        (appendLogArgument(record, args), ...);
+
+        if (record.truncated) {
+            truncated.fetch_add(1, std::memory_order_relaxed);
+        }
+        logged.fetch_add(1, std::memory_order_relaxed);
+
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Drain side, one task only: copies out the oldest complete line, false if there is none yet */
+    bool take(LogRecord &record) {
+        Slot &slot = slots[dequeuePosition & MASK];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            return false;
+        }
+
+        record = slot.record;
+        slot.sequence.store(dequeuePosition + CAPACITY, std::memory_order_release);
+        dequeuePosition++;
+        return true;
+    }
+
+    Stats getStats() const {
+        return {
+            logged.load(std::memory_order_relaxed),
+            dropped.load(std::memory_order_relaxed),
+            truncated.load(std::memory_order_relaxed)
+        };
+    }
+
+    /**
+     * printf()s a record into `line` (LINE_LENGTH bytes), cutting it short if it doesn't fit.
+     * @return the line's length
+     */
+    static size_t format(const LogRecord &record, char *line) {
+        size_t length = 0;
+        uint8_t argument = 0;
+        const char *cursor = record.format;
+
+        while (*cursor && length < LINE_LENGTH - 1) {
+            if (*cursor != '%') {
+                line[length++] = *cursor++;
+                continue;
+            }
+
+            cursor++;
+            if (*cursor == '%') {
+                line[length++] = *cursor++;
+                continue;
+            }
+
+            // Flags, width and precision are kept, length modifiers dropped
+            char spec[8];
+            uint8_t specLength = 0;
+            while (*cursor && strchr("-+ #0123456789.", *cursor)) {
+                if (specLength < sizeof(spec) - 1) {
+                    spec[specLength++] = *cursor;
+                }
+                cursor++;
+            }
+            spec[specLength] = '\0';
+
+            while (*cursor && strchr("hlLqjzt", *cursor)) {
+                cursor++;
+            }
+
+            const char conversion = *cursor;
+            if (!conversion) {
+                break;
+            }
+            cursor++;
+
+            if (!strchr("diuxXocfFeEgGs", conversion) || argument >= record.argumentCount) {
+                appendText(line, length, "?");
+                continue;
+            }
+
+            formatArgument(record, argument++, spec, conversion, line, length);
+        }
+
+        line[length] = '\0';
+        return length;
+    }
+};
+
+#endif //DEFERRED_LOG_H
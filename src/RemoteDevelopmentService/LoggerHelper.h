@@ -1,21 +1,51 @@
 #ifndef LOGGER_HELPER
 #define LOGGER_HELPER
 
+#include "DeferredLog.h"
 #include "RemoteDevelopmentService.h"
 
 extern RemoteDevelopmentService *gRemoteDevelopmentService;
+extern DeferredLog gLog;
 
-inline void printLn(const char *format, ...) {
-    char buf[256];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buf, sizeof(buf), format, args);
-    va_end(args);
-
-    Serial.println(buf);
-    // if (!!gRemoteDevelopmentService) {
-    //     gRemoteDevelopmentService->remotePrintLn("%s", buf);
-    // };
+inline void appendLogArgument(LogRecord &record, const String &value) {
+    appendLogArgument(record, value.c_str());
+}
+
+/** Queues a line for drainLog(), safe and cheap from any task. `format` must be a literal. */
+template<typename... Args>
+void printLn(const char *format, const Args &... args) {
+    gLog.log(format, args...);
+}
+
+/**
+ * Formats queued lines and writes them to Serial and telnet, at most `maxLines` per call. Runs on the network
+ * task (and in setup() before the tasks start), the only place the blocking writes may happen.
+ */
+inline void drainLog(const uint8_t maxLines = 8) {
+    static uint32_t reportedDrops = 0;
+    char line[DeferredLog::LINE_LENGTH];
+
+    const DeferredLog::Stats stats = gLog.getStats();
+    if (stats.dropped != reportedDrops) {
+        snprintf(line, sizeof(line), "(%u log lines dropped)",
+                 static_cast<unsigned>(stats.dropped - reportedDrops));
+        reportedDrops = stats.dropped;
+
+        Serial.println(line);
+        if (gRemoteDevelopmentService) {
+            gRemoteDevelopmentService->remotePrintLn(line);
+        }
+    }
+
+    LogRecord record = {};
+    for (uint8_t i = 0; i < maxLines && gLog.take(record); i++) {
+        DeferredLog::format(record, line);
+
+        Serial.println(line);
+        if (gRemoteDevelopmentService) {
+            gRemoteDevelopmentService->remotePrintLn(line);
+        }
+    }
 }
 
 #endif //LOGGER_HELPER
@@ -5,6 +5,19 @@
 #include "LoggerHelper.h"
 #include "../../src/PreferencesManager.h"
 #include "Display/LcdDisplay.h"
+#include "Job/JobSpool.h"
+#include "StepperMotor/MotionChannel.h"
+#include "Telemetry/MetricsText.h"
+
+/** Feed hold commands, at POST /NAME and as telnet commands; the motion task ignores them when there is no job */
+static const struct {
+    const char *name;
+    MotionCommand::Type type;
+} JOB_CONTROLS[] = {
+    {"hold", MotionCommand::holdJob},
+    {"resume", MotionCommand::resumeJob},
+    {"abort", MotionCommand::abortJob}
+};
 
 void RemoteDevelopmentService::setupOTA() {
     if (!isAnyNetworkingActive()) {
@@ -22,6 +35,120 @@ void RemoteDevelopmentService::setupOTA() {
         OTAServer->send(200, "text/html", html);
     });
 
+    OTAServer->on("/metrics", HTTP_GET, [this] {
+        buildMetrics();
+        OTAServer->send(200, "text/plain; version=0.0.4", metricsText);
+    });
+
+    OTAServer->on("/config", HTTP_GET, [this] {
+        buildConfig();
+        OTAServer->send(200, "text/plain", configText);
+    });
+
+    // Form fields named like the settings, all or nothing; `defaults` starts from the firmware's defaults
+    OTAServer->on("/config", HTTP_POST, [this] {
+        MotionConfig config = OTAServer->hasArg("defaults") ? MotionConfig() : preferencesManager->settings.motion;
+
+        for (int i = 0; i < OTAServer->args(); i++) {
+            const String name = OTAServer->argName(i);
+            if (name != "defaults" && !config.set(name.c_str(), OTAServer->arg(i).c_str())) {
+                OTAServer->send(400, "text/plain", "Unknown setting or bad value: " + name + "\n");
+                return;
+            }
+        }
+
+        if (!updateMotionConfig(config)) {
+            OTAServer->send(400, "text/plain", "Settings contradict each other, nothing saved\n");
+            return;
+        }
+
+        buildConfig();
+        OTAServer->send(200, "text/plain", configText);
+    });
+
+    for (const auto &control: JOB_CONTROLS) {
+        const MotionCommand::Type type = control.type;
+        OTAServer->on(String("/") + control.name, HTTP_POST, [this, type] {
+            if (motionChannel->send({type})) {
+                OTAServer->send(202, "text/plain", "Sent\n");
+            } else {
+                OTAServer->send(503, "text/plain", "Motion task busy, try again\n");
+            }
+        });
+    }
+
+    OTAServer->on("/jobs", HTTP_GET, [this] {
+        jobSpool->list(jobsText, sizeof(jobsText));
+        OTAServer->send(200, "text/plain", jobsText);
+    });
+
+    // A compact job (.spj, as the web slicer exports it) as a multipart file, queued once it decodes end to end
+    OTAServer->on(
+        "/jobs",
+        HTTP_POST,
+        [this] {
+            parkForFlash();
+            const JobSpool::UploadResult result = jobSpool->finishUpload();
+            releaseFlash();
+
+            switch (result) {
+                case JobSpool::queued:
+                    printLn("Job %lu queued", static_cast<unsigned long>(jobSpool->getLastId()));
+                    OTAServer->send(200, "text/plain", "Queued as job " + String(jobSpool->getLastId()) + "\n");
+                    break;
+                case JobSpool::invalidJob:
+                    OTAServer->send(400, "text/plain", "Not a job for this plotter, decoder error "
+                                                       + String(static_cast<int>(jobSpool->getUploadError())) + "\n");
+                    break;
+                case JobSpool::unreachableJob: {
+                    const WorkspaceCheck &workspace = jobSpool->getUploadWorkspace();
+                    char message[96];
+                    snprintf(message, sizeof(message),
+                             "%lu of %lu moves out of reach, first at command %lu (A:%ld B:%ld)",
+                             static_cast<unsigned long>(workspace.getViolations()),
+                             static_cast<unsigned long>(workspace.getMoves()),
+                             static_cast<unsigned long>(workspace.getFirst().command), workspace.getFirst().a,
+                             workspace.getFirst().b);
+                    printLn("Job refused: %s", message);
+                    OTAServer->send(422, "text/plain", String(message) + "\n");
+                    break;
+                }
+                case JobSpool::writeFailed:
+                    OTAServer->send(507, "text/plain", "Couldn't store the job, flash full?\n");
+                    break;
+                default:
+                    OTAServer->send(400, "text/plain", "No file uploaded\n");
+                    break;
+            }
+        },
+        [this] {
+            HTTPUpload &upload = OTAServer->upload();
+            if (upload.status == UPLOAD_FILE_START) {
+                parkForFlash();
+                jobSpool->beginUpload();
+                releaseFlash();
+            } else if (upload.status == UPLOAD_FILE_WRITE) {
+                parkForFlash();
+                jobSpool->writeUpload(upload.buf, upload.currentSize);
+                releaseFlash();
+            }
+        }
+    );
+
+    OTAServer->on("/jobs/delete", HTTP_POST, [this] {
+        parkForFlash();
+        const bool removed = jobSpool->remove(OTAServer->arg("id").toInt(), millis());
+        releaseFlash();
+
+        if (!removed) {
+            OTAServer->send(400, "text/plain", "Not queued, or being drawn\n");
+            return;
+        }
+
+        jobSpool->list(jobsText, sizeof(jobsText));
+        OTAServer->send(200, "text/plain", jobsText);
+    });
+
     OTAServer->on("/connect", HTTP_POST, [this] {
         if (OTAServer->hasArg("ssid") && OTAServer->hasArg("password")) {
             const String newSSID = OTAServer->arg("ssid");
@@ -37,14 +164,18 @@ void RemoteDevelopmentService::setupOTA() {
                     sizeof(preferencesManager->settings.wifiPassword));
             preferencesManager->settings.wifiPassword[sizeof(preferencesManager->settings.wifiPassword) - 1] = '\0';
 
+            parkForFlash();
             preferencesManager->save();
+            releaseFlash();
 
             printLn("SAVED");
 
             lcdDisplay->clear();
             lcdDisplay->setCursorToLine();
             lcdDisplay->print("Credentials saved! Rebooting...");
+            lcdDisplay->flushAll();
             printLn("Credentials saved! Rebooting...");
+            drainLog(DeferredLog::CAPACITY);
 
             OTAServer->send(200, "text/html", "Credentials saved! Rebooting...");
             delay(1000);
@@ -68,8 +199,8 @@ void RemoteDevelopmentService::setupOTA() {
             HTTPUpload &upload = OTAServer->upload();
             if (upload.status == UPLOAD_FILE_START) {
                 if (telnetClient && telnetClient.connected()) {
-                    telnetFlushLogBuffer();
                     printLn(">>>>   OTA update started   <<<<");
+                    drainLog(DeferredLog::CAPACITY);
                     telnetClient.stop();
                     telnetServer->close();
                 }
@@ -101,33 +232,52 @@ void RemoteDevelopmentService::setupTelnet() {
     isTelnetActive = true;
 }
 
-void RemoteDevelopmentService::remotePrintLn(const char *format, ...) {
-    char buf[256];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buf, sizeof(buf), format, args);
-    va_end(args);
+void RemoteDevelopmentService::setupJobStream() {
+    if (!isAnyNetworkingActive()) {
+        return;
+    }
+
+    jobServer = new WiFiServer(JOB_STREAM_PORT);
 
+    jobServer->begin();
+    jobServer->setNoDelay(true);
+
+    isJobStreamActive = true;
+}
+
+void RemoteDevelopmentService::remotePrintLn(const char *line) {
     if (isWifiActive && telnetClient && telnetClient.connected()) {
-        telnetClient.println(buf);
+        telnetClient.println(line);
+        return;
+    }
+
+    // Oldest line is overwritten once the history is full
+    const uint8_t slot = (logHistoryStart + logHistoryCount) % MAX_LOGS;
+    strncpy(logHistory[slot], line, DeferredLog::LINE_LENGTH - 1);
+    logHistory[slot][DeferredLog::LINE_LENGTH - 1] = '\0';
+
+    if (logHistoryCount < MAX_LOGS) {
+        logHistoryCount++;
     } else {
-        if (logBuffer.size() >= MAX_LOGS) {
-            logBuffer.pop_front();
-        }
-        logBuffer.emplace_back(buf);
+        logHistoryStart = (logHistoryStart + 1) % MAX_LOGS;
     }
 }
 
 void RemoteDevelopmentService::telnetFlushLogBuffer() {
-    while (!logBuffer.empty()) {
-        telnetClient.println(logBuffer.front());
-        logBuffer.pop_front();
+    for (; logHistoryCount > 0; logHistoryCount--) {
+        telnetClient.println(logHistory[logHistoryStart]);
+        logHistoryStart = (logHistoryStart + 1) % MAX_LOGS;
     }
 }
 
-void RemoteDevelopmentService::init(PreferencesManager &_preferencesManager, LcdDisplay &_lcdDisplay) {
+void RemoteDevelopmentService::init(PreferencesManager &_preferencesManager, LcdDisplay &_lcdDisplay,
+                                    PathStreamBuffer &_pathStream, MotionChannel &_motionChannel,
+                                    JobSpool &_jobSpool) {
     preferencesManager = &_preferencesManager;
     lcdDisplay = &_lcdDisplay;
+    pathStream = &_pathStream;
+    motionChannel = &_motionChannel;
+    jobSpool = &_jobSpool;
 
     const String savedSSID = preferencesManager->settings.wifiSSID;
     const String savedPassword = preferencesManager->settings.wifiPassword;
@@ -149,6 +299,7 @@ void RemoteDevelopmentService::init(PreferencesManager &_preferencesManager, Lcd
     printLn("SSID %s", savedSSID);
     lcdDisplay->setCursorToLine(0, 1);
     lcdDisplay->print("PASS " + savedPassword);
+    lcdDisplay->flushAll();
     printLn("PASS %s", savedPassword);
 
     while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < timeout) {
@@ -164,6 +315,7 @@ void RemoteDevelopmentService::init(PreferencesManager &_preferencesManager, Lcd
         printLn("AP SSID: %s", WiFi.SSID());
         lcdDisplay->setCursorToLine(0, 1);
         lcdDisplay->print(WiFi.localIP().toString());
+        lcdDisplay->flushAll();
         printLn("AP IP: %s", WiFi.localIP().toString());
 
         isWifiActive = true;
@@ -171,6 +323,7 @@ void RemoteDevelopmentService::init(PreferencesManager &_preferencesManager, Lcd
 
     setupOTA();
     setupTelnet();
+    setupJobStream();
 }
 
 void RemoteDevelopmentService::enableAP() {
@@ -185,6 +338,7 @@ void RemoteDevelopmentService::enableAP() {
     lcdDisplay->print(F("12345678"));
     lcdDisplay->setCursorToLine(0, 1);
     lcdDisplay->print(WiFi.softAPIP().toString());
+    lcdDisplay->flushAll();
     printLn("AP IP: %s", WiFi.softAPIP().toString());
 
     delay(5000);
@@ -197,6 +351,130 @@ void RemoteDevelopmentService::disableAP() {
     isAPActive = false;
 }
 
+void RemoteDevelopmentService::parkForFlash() {
+    // The motion task parks the arms at their next standstill, at the latest once the job's moves run out
+    while (!motionChannel->flashWrites.park()) {
+        delay(1);
+    }
+}
+
+void RemoteDevelopmentService::releaseFlash() {
+    motionChannel->flashWrites.release();
+}
+
+size_t RemoteDevelopmentService::buildMetrics() {
+    MetricsText metrics(metricsText, sizeof(metricsText));
+    writeMetrics(metrics);
+
+    if (metrics.isTruncated()) {
+        printLn("Metrics didn't fit in %u bytes", sizeof(metricsText));
+    }
+
+    return metrics.getLength();
+}
+
+size_t RemoteDevelopmentService::buildConfig() {
+    size_t length = preferencesManager->settings.motion.format(configText, sizeof(configText));
+
+    if (motionChannel->status.read().configVersion != motionChannel->config.getVersion()) {
+        const int written = snprintf(configText + length, sizeof(configText) - length,
+                                     "# Saved, applies once the plotter is idle\n");
+        if (written > 0 && static_cast<size_t>(written) < sizeof(configText) - length) {
+            length += written;
+        } else {
+            configText[length] = '\0';
+        }
+    }
+
+    return length;
+}
+
+bool RemoteDevelopmentService::updateMotionConfig(const MotionConfig &config) {
+    if (!config.isValid()) {
+        return false;
+    }
+
+    preferencesManager->settings.motion = config;
+    parkForFlash();
+    preferencesManager->save();
+    releaseFlash();
+    motionChannel->config.write(config);
+    printLn("Motion config saved");
+    return true;
+}
+
+void RemoteDevelopmentService::handleTelnetSet(const char *arguments) {
+    char name[32] = {};
+    const char *value = strchr(arguments, ' ');
+
+    if (!value || static_cast<size_t>(value - arguments) >= sizeof(name)) {
+        telnetClient.println("Usage: set NAME VALUE, see config for the names");
+        return;
+    }
+    memcpy(name, arguments, value - arguments);
+
+    MotionConfig config = preferencesManager->settings.motion;
+    if (!config.set(name, value + 1)) {
+        telnetClient.printf("Unknown setting or bad value: %s\n", name);
+    } else if (!updateMotionConfig(config)) {
+        telnetClient.println("Settings would contradict each other, nothing saved");
+    } else {
+        telnetClient.write(configText, buildConfig());
+    }
+}
+
+void RemoteDevelopmentService::handleTelnetJobDelete(const char *argument) {
+    char *end = nullptr;
+    const unsigned long id = strtoul(argument, &end, 10);
+
+    bool removed = false;
+    if (end != argument && *end == '\0') {
+        parkForFlash();
+        removed = jobSpool->remove(id, millis());
+        releaseFlash();
+    }
+
+    if (!removed) {
+        telnetClient.println("Not queued, or being drawn");
+    } else {
+        telnetClient.write(jobsText, jobSpool->list(jobsText, sizeof(jobsText)));
+    }
+}
+
+void RemoteDevelopmentService::handleTelnetCommand(const char *command) {
+    for (const auto &control: JOB_CONTROLS) {
+        if (strcmp(command, control.name) == 0) {
+            telnetClient.println(motionChannel->send({control.type}) ? "Sent" : "Motion task busy, try again");
+            return;
+        }
+    }
+
+    if (strcmp(command, "metrics") == 0) {
+        telnetClient.write(metricsText, buildMetrics());
+    } else if (strcmp(command, "config") == 0) {
+        telnetClient.write(configText, buildConfig());
+    } else if (strcmp(command, "config defaults") == 0) {
+        updateMotionConfig(MotionConfig());
+        telnetClient.write(configText, buildConfig());
+    } else if (strncmp(command, "set ", 4) == 0) {
+        handleTelnetSet(command + 4);
+    } else if (strcmp(command, "jobs") == 0) {
+        telnetClient.write(jobsText, jobSpool->list(jobsText, sizeof(jobsText)));
+    } else if (strncmp(command, "jobs delete ", 12) == 0) {
+        handleTelnetJobDelete(command + 12);
+    } else if (strcmp(command, "help") == 0) {
+        telnetClient.println("metrics - motion, loop, pen, heap and stack telemetry");
+        telnetClient.println("config - motion settings, saved in flash");
+        telnetClient.println("set NAME VALUE - changes one, applied once the plotter is idle");
+        telnetClient.println("config defaults - back to the firmware's settings");
+        telnetClient.println("jobs - the spooled jobs, POST .spj files to /jobs to add one");
+        telnetClient.println("jobs delete ID - drops a queued job");
+        telnetClient.println("hold / resume / abort - feed hold of the job being drawn, as the encoder button");
+    } else if (command[0] != '\0') {
+        telnetClient.printf("Unknown command '%s', try help\n", command);
+    }
+}
+
 void RemoteDevelopmentService::handleTelnet() {
     if (!isWifiActive) {
         return;
@@ -205,12 +483,88 @@ void RemoteDevelopmentService::handleTelnet() {
     if (telnetServer->hasClient()) {
         if (!telnetClient || !telnetClient.connected()) {
             telnetClient = telnetServer->available();
+            telnetLineLength = 0;
             telnetFlushLogBuffer();
         } else {
             WiFiClient newClient = telnetServer->available();
             newClient.stop();
         }
     }
+
+    // Option negotiation and other control bytes are skipped, a line is run once complete
+    while (telnetClient && telnetClient.available() > 0) {
+        const int c = telnetClient.read();
+
+        if (c == '\n') {
+            while (telnetLineLength > 0 && telnetLine[telnetLineLength - 1] == ' ') {
+                telnetLineLength--;
+            }
+            telnetLine[telnetLineLength] = '\0';
+            telnetLineLength = 0;
+            handleTelnetCommand(telnetLine);
+        } else if (c >= ' ' && c < 0x7F && telnetLineLength < sizeof(telnetLine) - 1) {
+            telnetLine[telnetLineLength++] = static_cast<char>(c);
+        }
+    }
+}
+
+void RemoteDevelopmentService::handleJobStream() {
+    if (!isJobStreamActive) {
+        return;
+    }
+
+    if (jobServer->hasClient()) {
+        WiFiClient newClient = jobServer->available();
+
+        if ((jobClient && jobClient.connected()) || !pathStream->begin()) {
+            newClient.write('B');
+            newClient.stop();
+        } else if (!motionChannel->send({MotionCommand::startStreamedJob})) {
+            // The motion task is too far behind to take the job, turn it away like a busy plotter would
+            pathStream->end();
+            newClient.write('B');
+            newClient.stop();
+        } else {
+            // Drawing starts on the motion task once it is idle
+            jobClient = newClient;
+            printLn("Job stream connected");
+        }
+    }
+
+    if (!jobClient) {
+        return;
+    }
+
+    // Never read more than was granted, the rest waits in the TCP window and throttles the sender
+    uint8_t buf[256];
+    size_t acceptable;
+    while ((acceptable = pathStream->acceptableBytes()) > 0 && jobClient.available() > 0) {
+        const int length = jobClient.read(buf, acceptable < sizeof(buf) ? acceptable : sizeof(buf));
+        if (length <= 0) {
+            break;
+        }
+
+        if (!pathStream->receive(buf, length)) {
+            printLn("Job stream protocol error");
+            jobClient.stop();
+            return;
+        }
+    }
+
+    const uint16_t credits = pathStream->takeCredits();
+    if (credits > 0) {
+        const uint8_t grant[3] = {'C', static_cast<uint8_t>(credits & 0xFF), static_cast<uint8_t>(credits >> 8)};
+        jobClient.write(grant, sizeof(grant));
+    }
+
+    if (pathStream->getState() != PathStreamBuffer::receiving) {
+        printLn("Job stream received");
+        jobClient.stop();
+    } else if (!jobClient.connected() && jobClient.available() == 0) {
+        printLn("Job stream disconnected");
+        pathStream->end();
+        jobClient.stop();
+    }
 }
 
 void RemoteDevelopmentService::loop() {
@@ -220,4 +574,5 @@ void RemoteDevelopmentService::loop() {
 
     this->OTAServer->handleClient();
     handleTelnet();
+    handleJobStream();
 }
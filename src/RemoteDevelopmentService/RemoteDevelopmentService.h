@@ -1,28 +1,61 @@
 #ifndef REMOTE_DEVELOPMENT_SERVICE_H
 #define REMOTE_DEVELOPMENT_SERVICE_H
 
-#include <deque>
 #include <WebServer.h>
 
 #include "LiquidCrystal.h"
 #include "../PreferencesManager.h"
 #include "Display/LcdDisplay.h"
+#include "DeferredLog.h"
+#include "Job/PathStreamBuffer.h"
+
+#define JOB_STREAM_PORT 2323
+
+struct MotionChannel;
+class JobSpool;
 
 class RemoteDevelopmentService {
     WebServer *OTAServer = nullptr;
     WiFiServer *telnetServer = nullptr;
     WiFiClient telnetClient;
+    WiFiServer *jobServer = nullptr;
+    WiFiClient jobClient;
     PreferencesManager *preferencesManager = nullptr;
     LcdDisplay *lcdDisplay = nullptr;
+    PathStreamBuffer *pathStream = nullptr;
+    MotionChannel *motionChannel = nullptr;
+    JobSpool *jobSpool = nullptr;
 
     bool isAPActive = false;
     bool isWifiActive = false;
     bool isTelnetActive = false;
     bool isOTAActive = false;
     bool isNTPActive = false;
+    bool isJobStreamActive = false;
+
+    // Lines logged while no telnet client was connected, replayed when one connects
+    constexpr static uint8_t MAX_LOGS = 20;
+    char logHistory[MAX_LOGS][DeferredLog::LINE_LENGTH] = {};
+    uint8_t logHistoryStart = 0;
+    uint8_t logHistoryCount = 0;
+
+    // Commands typed over telnet, one per line
+    char telnetLine[64] = {};
+    uint8_t telnetLineLength = 0;
+
+    constexpr static size_t METRICS_TEXT_SIZE = 4096;
+    char metricsText[METRICS_TEXT_SIZE] = {};
+
+    constexpr static size_t CONFIG_TEXT_SIZE = 1024;
+    char configText[CONFIG_TEXT_SIZE] = {};
+
+    constexpr static size_t JOBS_TEXT_SIZE = 1024;
+    char jobsText[JOBS_TEXT_SIZE] = {};
+
+    /** Waits for the arms to stand still and stay so until releaseFlash(), see FlashWriteGate */
+    void parkForFlash();
 
-    std::deque<String> logBuffer;
-    const size_t MAX_LOGS = 20;
+    void releaseFlash();
 
     void setupOTA();
 
@@ -30,16 +63,39 @@ class RemoteDevelopmentService {
 
     void handleTelnet();
 
+    void handleTelnetCommand(const char *command);
+
+    /** Fills metricsText, see writeMetrics() */
+    size_t buildMetrics();
+
+    /** Fills configText with the motion settings as `name=value` lines */
+    size_t buildConfig();
+
+    /** Saves the motion settings and hands them to the motion task, which applies them between jobs */
+    bool updateMotionConfig(const MotionConfig &config);
+
+    /** Telnet `set NAME VALUE` */
+    void handleTelnetSet(const char *arguments);
+
+    /** Telnet `jobs delete ID` */
+    void handleTelnetJobDelete(const char *argument);
+
+    void setupJobStream();
+
+    void handleJobStream();
+
 public:
     void enableAP();
 
     void disableAP();
 
-    void init(PreferencesManager &_preferencesManager, LcdDisplay &_lcdDisplay);
+    void init(PreferencesManager &_preferencesManager, LcdDisplay &_lcdDisplay, PathStreamBuffer &_pathStream,
+              MotionChannel &_motionChannel, JobSpool &_jobSpool);
 
     void loop();
 
-    void remotePrintLn(const char *format, ...);
+    /** Writes a formatted line to telnet, or keeps it for the next client. Called by drainLog() only. */
+    void remotePrintLn(const char *line);
 
     void telnetFlushLogBuffer();
 
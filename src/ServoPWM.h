@@ -19,44 +19,141 @@ inline uint32_t pulseToDuty(const int us) {
     return static_cast<uint32_t>(us) * maxDuty / SERVO_PERIOD_US;
 }
 
+// Pen timing, measured from the command; see ServoPWM::Timing
+static constexpr uint16_t SERVO_DROP_MS = 120;
+static constexpr uint16_t SERVO_LIFT_MS = 150;
+static constexpr uint16_t SERVO_CLEAR_MS = 40;
+
+/**
+ * Pen servo, with a model of where the pen is rather than just where it was told to go: the servo takes a while
+ * to get there, and the coordinator uses the model to start pen moves while the arms are still slowing down and
+ * to start travel as soon as the tip has left the paper.
+ */
 class ServoPWM {
+public:
+    struct Timing {
+        uint16_t dropMs = SERVO_DROP_MS; // down() until the tip is on the paper and drawing may start
+        uint16_t liftMs = SERVO_LIFT_MS; // up() until the servo has settled at the top
+        uint16_t clearMs = SERVO_CLEAR_MS; // up() until the tip is off the paper and travel may start
+        uint16_t rampMs = 0; // Moves the pulse over this long instead of at once, 0 to jump; counts towards the above
+    };
+
+    constexpr static uint8_t DOWN_DEGREES = 80;
+    constexpr static uint8_t UP_DEGREES = 120;
+
+private:
     uint8_t gpio = 0;
-    uint8_t position = 0;
+    uint8_t downDegrees = DOWN_DEGREES;
+    uint8_t upDegrees = UP_DEGREES;
+    bool lifted = true;
+    uint8_t position = 0; // Commanded
+    uint8_t fromPosition = 0; // Before the last command, for ramping
+    uint8_t writtenPosition = 0;
+    unsigned long movedAtMs = 0;
 
-public:
-    explicit ServoPWM(const uint8_t gpio): gpio(gpio) {
+    Timing timing;
+
+    unsigned long sinceMove() const {
+        return millis() - movedAtMs;
     }
 
-    void down() {
-        if (position == 80) {
+    void moveTo(const uint8_t degrees) {
+        if (position == degrees) {
             return;
         }
 
-        position = 80;
-        writeAngle(position);
+        fromPosition = writtenPosition;
+        position = degrees;
+        movedAtMs = millis();
+
+        if (timing.rampMs == 0) {
+            writeAngle(position);
+        }
     }
 
-    void up() {
-        if (position == 120) {
-            return;
+public:
+    explicit ServoPWM(const uint8_t gpio): gpio(gpio) {
+    }
+
+    void setTiming(const Timing &_timing) {
+        timing = _timing;
+    }
+
+    const Timing &getTiming() const {
+        return timing;
+    }
+
+    /** Moves a lifted pen to the new up angle straight away, a lowered one keeps its angle until the next down() */
+    void setAngles(const uint8_t _downDegrees, const uint8_t _upDegrees) {
+        downDegrees = _downDegrees;
+        upDegrees = _upDegrees;
+
+        if (lifted) {
+            moveTo(upDegrees);
         }
+    }
 
-        position = 120;
-        writeAngle(position);
+    void down() {
+        lifted = false;
+        moveTo(downDegrees);
+    }
+
+    void up() {
+        lifted = true;
+        moveTo(upDegrees);
     }
 
+    /** Commanded up, the pen may still be on its way */
     bool isUp() const {
-        return position >= 100;
+        return lifted;
+    }
+
+    /** Down and on the paper */
+    bool isDown() const {
+        return !isUp() && sinceMove() >= timing.dropMs;
+    }
+
+    /** Up, or on its way with the tip already off the paper */
+    bool isClear() const {
+        return isUp() && sinceMove() >= timing.clearMs;
+    }
+
+    /** The pen has reached where it was told to go */
+    bool isSettled() const {
+        return sinceMove() >= (isUp() ? timing.liftMs : timing.dropMs);
     }
 
     void begin() {
         ledcSetup(SERVO_LEDC_CH, SERVO_FREQUENCY, SERVO_RESOLUTION);
         ledcAttachPin(gpio, SERVO_LEDC_CH);
-        writeAngle(120);
+        lifted = true;
+        position = fromPosition = upDegrees;
+        movedAtMs = millis() - timing.liftMs;
+        writeAngle(position);
+    }
+
+    /** Steps the pulse along a ramp, call every loop */
+    void run() {
+        if (writtenPosition == position) {
+            return;
+        }
+
+        const unsigned long elapsed = sinceMove();
+        if (elapsed >= timing.rampMs) {
+            writeAngle(position);
+            return;
+        }
+
+        const int angle = fromPosition + (static_cast<int>(position) - fromPosition) * static_cast<long>(elapsed)
+                                         / timing.rampMs;
+        if (angle != writtenPosition) {
+            writeAngle(angle);
+        }
     }
 
     void writeAngle(int degrees) {
         degrees = constrain(degrees, 0, 180);
+        writtenPosition = degrees;
         const int pulse = SERVO_CENTER_US + ((degrees - 90) * SERVO_DELTA_US) / 90;
         ledcWrite(SERVO_LEDC_CH, pulseToDuty(pulse));
     }
@@ -0,0 +1,516 @@
+#include "ConcurrencyVerification.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "SimulationLogger.h"
+
+#include "Job/GcodeInterpreter.h"
+#include "Job/PathStreamBuffer.h"
+#include "RemoteDevelopmentService/DeferredLog.h"
+#include "StepperMotor/MotionChannel.h"
+
+struct ThroughputResult {
+    uint64_t items = 0;
+    uint64_t errors = 0;
+    uint64_t fullSpins = 0; // Times the producer found no room
+    uint64_t emptySpins = 0; // Times the consumer found nothing
+    double seconds = 0;
+};
+
+static double secondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** Network side pushes numbered jogs as fast as it can, motion side checks they arrive whole and in order */
+static ThroughputResult runQueue(const uint32_t count) {
+    static MotionChannel channel;
+    ThroughputResult result;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count; i++) {
+            const MotionCommand command = {
+                i % 3 == 0 ? MotionCommand::startStreamedJob : MotionCommand::jog,
+                static_cast<uint8_t>(i & 1),
+                static_cast<long>(i)
+            };
+
+            while (!channel.commands.push(command)) {
+                result.fullSpins++;
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::thread consumer([&] {
+        MotionCommand command = {};
+        for (uint32_t expected = 0; expected < count;) {
+            if (!channel.commands.pop(command)) {
+                result.emptySpins++;
+                std::this_thread::yield();
+                continue;
+            }
+
+            const MotionCommand::Type type = expected % 3 == 0 ? MotionCommand::startStreamedJob : MotionCommand::jog;
+            if (command.steps != static_cast<long>(expected) || command.axis != (expected & 1) || command.type != type) {
+                result.errors++;
+            }
+
+            expected++;
+            result.items++;
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    result.seconds = secondsSince(start);
+
+    if (!channel.commands.isEmpty()) {
+        result.errors++;
+    }
+
+    return result;
+}
+
+/**
+ * Serial G-code as the two tasks share it: the network side writes lines into the byte ring, keeping two
+ * unanswered like a sender waiting for "ok", the motion side parses them as the interpreter has room and counts
+ * the lines it took. Every line is a G0 to a new point, so each must come out as one move to its joints.
+ */
+static ThroughputResult runSerialGcode(const uint32_t count) {
+    static MotionChannel channel;
+    ThroughputResult result;
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto pointOf = [](const uint32_t line, int &x, int &y) {
+        x = -40 + static_cast<int>(line % 80);
+        y = 150 + static_cast<int>(line / 80 % 50);
+    };
+
+    std::thread network([&] {
+        char text[32];
+        for (uint32_t i = 0; i < count; i++) {
+            while (i - channel.gcodeLines.load(std::memory_order_acquire) >= 2) {
+                result.fullSpins++;
+                std::this_thread::yield();
+            }
+
+            int x = 0;
+            int y = 0;
+            pointOf(i, x, y);
+            const int length = snprintf(text, sizeof(text), "G0 X%d Y%d\n", x, y);
+            for (int j = 0; j < length; j++) {
+                while (!channel.gcodeBytes.push(text[j])) {
+                    result.fullSpins++;
+                    std::this_thread::yield();
+                }
+            }
+        }
+    });
+
+    std::thread motion([&] {
+        GcodeInterpreter interpreter;
+        PathCommand command = {};
+        for (uint32_t expected = 0; expected < count;) {
+            char c = 0;
+            while (interpreter.canAccept() && channel.gcodeBytes.pop(c)) {
+                interpreter.feed(&c, 1);
+            }
+
+            const uint16_t lines = interpreter.takeAcknowledgements();
+            if (lines > 0) {
+                channel.gcodeLines.fetch_add(lines, std::memory_order_release);
+            }
+
+            if (!interpreter.peek(command)) {
+                result.emptySpins++;
+                std::this_thread::yield();
+                continue;
+            }
+            interpreter.pop();
+
+            int x = 0;
+            int y = 0;
+            long a = 0;
+            long b = 0;
+            pointOf(expected, x, y);
+            PlotterKinematics::inverseMillimetres(static_cast<float>(x), static_cast<float>(y), a, b);
+            if (command.type != PathCommand::move || command.a != a || command.b != b) {
+                result.errors++;
+            }
+
+            expected++;
+            result.items++;
+        }
+    });
+
+    network.join();
+    motion.join();
+    result.seconds = secondsSince(start);
+
+    if (channel.gcodeLines.load() != count || !channel.gcodeBytes.isEmpty()) {
+        result.errors++;
+    }
+
+    return result;
+}
+
+/** A streamed job received on one thread and drawn on another, the way the network and motion tasks share it */
+static ThroughputResult runPathStream(const uint32_t count) {
+    static PathStreamBuffer stream;
+    ThroughputResult result;
+    uint64_t receiveErrors = 0;
+
+    // Points within reach, which the stream would otherwise lift the pen over, and never the markers
+    const auto pointAt = [](const uint32_t i) {
+        const int16_t a = static_cast<int16_t>(-PlotterKinematics::ARM_LIMIT_STEPS + static_cast<long>(i % 1000));
+        const long opening = PlotterKinematics::OPENING_MIN_STEPS + static_cast<long>(i % 1400);
+        return PathPoint{static_cast<int16_t>(a + opening), a};
+    };
+
+    if (!stream.begin()) {
+        result.errors++;
+        return result;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread receiver([&] {
+        uint8_t buffer[256];
+        size_t length = 0;
+        uint32_t next = 0;
+        bool ended = false;
+
+        for (const uint8_t byte : PathStreamBuffer::MAGIC) {
+            buffer[length++] = byte;
+        }
+
+        while (!ended || length > 0) {
+            stream.takeCredits();
+
+            // Refill the outgoing buffer with whole records
+            while (!ended && length + 4 <= sizeof(buffer)) {
+                const PathPoint point = next < count
+                                            ? pointAt(next)
+                                            : PathPoint{PathStreamBuffer::END_OF_JOB, PathStreamBuffer::END_OF_JOB};
+                buffer[length++] = point.b & 0xFF;
+                buffer[length++] = point.b >> 8 & 0xFF;
+                buffer[length++] = point.a & 0xFF;
+                buffer[length++] = point.a >> 8 & 0xFF;
+                ended = next++ == count;
+            }
+
+            const size_t acceptable = std::min(length, stream.acceptableBytes());
+            if (acceptable == 0) {
+                result.fullSpins++;
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (!stream.receive(buffer, acceptable)) {
+                receiveErrors++;
+                return;
+            }
+
+            memmove(buffer, buffer + acceptable, length - acceptable);
+            length -= acceptable;
+        }
+    });
+
+    std::thread drawer([&] {
+        PathCommand command = {};
+        uint32_t expected = 0;
+
+        while (!stream.isFinished()) {
+            if (!stream.peek(command)) {
+                result.emptySpins++;
+                std::this_thread::yield();
+                continue;
+            }
+            stream.pop();
+
+            if (command.type != PathCommand::move) {
+                continue;
+            }
+
+            const PathPoint point = pointAt(expected++);
+            if (command.a != point.a || command.b != point.b) {
+                result.errors++;
+            }
+            result.items++;
+        }
+    });
+
+    receiver.join();
+    drawer.join();
+    result.seconds = secondsSince(start);
+    result.errors += receiveErrors;
+
+    if (result.items != count || stream.getState() != PathStreamBuffer::idle) {
+        result.errors++;
+    }
+
+    return result;
+}
+
+/** One writer publishing consistent statuses, two readers checking they never see half of one */
+static ThroughputResult runSnapshot(const uint32_t count) {
+    static SeqlockSnapshot<MotionStatus> snapshot;
+    std::atomic<bool> writing{true};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> errors{0};
+    ThroughputResult result;
+
+    const auto publish = [&](const uint32_t i) {
+        const long position = static_cast<long>(i);
+        snapshot.write({position, -position, static_cast<HomingSequence>(position % 6), i % 2 == 1, i % 2 == 0, ~i,
+                        static_cast<FeedHold>(i % 4), i * 3});
+    };
+    publish(0);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto reader = [&] {
+        long previous = 0;
+        while (writing.load(std::memory_order_acquire)) {
+            const MotionStatus status = snapshot.read();
+
+            const bool consistent = status.positionB == -status.positionA
+                                    && status.homingSequence == static_cast<HomingSequence>(status.positionA % 6)
+                                    && status.moving == (status.positionA % 2 == 1)
+                                    && status.penUp != status.moving
+                                    && status.configVersion == ~static_cast<uint32_t>(status.positionA)
+                                    && status.feedHold == static_cast<FeedHold>(status.positionA % 4)
+                                    && status.unreachableMoves == static_cast<uint32_t>(status.positionA) * 3;
+            if (!consistent || status.positionA < previous) {
+                errors.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            previous = status.positionA;
+            reads.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    };
+
+    std::thread firstReader(reader);
+    std::thread secondReader(reader);
+
+    for (uint32_t i = 1; i <= count; i++) {
+        publish(i);
+
+        // Lets the readers in even on a single core
+        if (i % 16 == 0) {
+            std::this_thread::yield();
+        }
+    }
+    writing.store(false, std::memory_order_release);
+
+    firstReader.join();
+    secondReader.join();
+    result.seconds = secondsSince(start);
+
+    result.items = reads.load();
+    result.errors = errors.load();
+    if (snapshot.getVersion() != count + 1 || snapshot.read().positionA != static_cast<long>(count)) {
+        result.errors++;
+    }
+
+    return result;
+}
+
+/**
+ * Network side "writes flash" `count` times, each once the arms are parked; the motion side starts and stops moves
+ * whenever it isn't holding them. A move that starts during a write is an error.
+ */
+static ThroughputResult runFlashGate(const uint32_t count) {
+    static FlashWriteGate gate;
+    std::atomic<bool> moving{false};
+    std::atomic<bool> writing{true};
+    ThroughputResult result;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread motion([&] {
+        uint32_t loops = 0;
+        while (writing.load(std::memory_order_acquire)) {
+            if (!gate.hold(!moving.load(std::memory_order_relaxed)) && ++loops % 7 == 0) {
+                moving.store(!moving.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    for (uint32_t i = 0; i < count; i++) {
+        while (!gate.park()) {
+            result.fullSpins++;
+            std::this_thread::yield();
+        }
+
+        // The write, during which the arms must stay put
+        for (uint8_t spin = 0; spin < 8; spin++) {
+            result.errors += moving.load(std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+
+        gate.release();
+        result.items++;
+    }
+    writing.store(false, std::memory_order_release);
+
+    motion.join();
+    result.seconds = secondsSince(start);
+    return result;
+}
+
+/** Lines logged from two threads at once, formatted by a third; each must come out as snprintf() would print it */
+static ThroughputResult runLog(const uint32_t count) {
+    static DeferredLog log;
+    static const char *const NAMES[] = {"homing", "drawing a rather long name that gets cut short here", ""};
+    constexpr uint8_t WORKERS = 2;
+    constexpr const char *FORMAT = "worker %d line %lu at %.2f mm, %s, %c";
+    std::atomic<uint8_t> working{WORKERS};
+    ThroughputResult result;
+
+    const auto expectedLine = [](char *line, const int worker, const unsigned long index) {
+        char name[LogRecord::STRING_CAPACITY];
+        snprintf(name, sizeof(name), "%s", NAMES[index % 3]);
+        snprintf(line, DeferredLog::LINE_LENGTH, FORMAT, worker, index, index * 0.25, name, 'a' + worker);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto worker = [&](const int id) {
+        for (uint32_t i = 0; i < count; i++) {
+            log.log(FORMAT, id, static_cast<unsigned long>(i), i * 0.25, NAMES[i % 3], static_cast<char>('a' + id));
+
+            if (i % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        working.fetch_sub(1, std::memory_order_release);
+    };
+
+    std::thread drainer([&] {
+        char line[DeferredLog::LINE_LENGTH];
+        char expected[DeferredLog::LINE_LENGTH];
+        long nextIndex[WORKERS] = {};
+        LogRecord record = {};
+
+        for (;;) {
+            const bool done = working.load(std::memory_order_acquire) == 0;
+            if (!log.take(record)) {
+                if (done) {
+                    break;
+                }
+                result.emptySpins++;
+                std::this_thread::yield();
+                continue;
+            }
+
+            DeferredLog::format(record, line);
+            int id = -1;
+            unsigned long index = 0;
+            if (sscanf(line, "worker %d line %lu", &id, &index) != 2 || id < 0 || id >= WORKERS
+                || static_cast<long>(index) < nextIndex[id]) {
+                result.errors++;
+                continue;
+            }
+
+            expectedLine(expected, id, index);
+            if (strcmp(line, expected) != 0) {
+                result.errors++;
+            }
+
+            nextIndex[id] = static_cast<long>(index) + 1;
+            result.items++;
+        }
+    });
+
+    std::thread first(worker, 0);
+    std::thread second(worker, 1);
+    first.join();
+    second.join();
+    drainer.join();
+    result.seconds = secondsSince(start);
+
+    const DeferredLog::Stats stats = log.getStats();
+    result.fullSpins = stats.dropped;
+    if (stats.logged + stats.dropped != WORKERS * count || stats.logged != result.items) {
+        result.errors++;
+    }
+
+    // Conversions the firmware uses, against the C library
+    static const struct {
+        const char *format;
+        long integer;
+        double number;
+    } CASES[] = {
+        {"Hit A limit on %d", -1450, 0},
+        {"Position X:%.2f Y:%.2f A:%ld B:%ld", 1234, -12.345},
+        {"[%5d|%-5d|%05d] %x %X %u%%", 42, 0},
+        {"%e %10.4g %ld, %+ld", 7, 123456.789},
+    };
+
+    for (const auto &check : CASES) {
+        char line[DeferredLog::LINE_LENGTH];
+        char expected[DeferredLog::LINE_LENGTH];
+        LogRecord record = {};
+
+        log.log(check.format, check.integer, check.integer, check.integer, check.integer, check.integer,
+                check.integer);
+        if (check.number != 0) {
+            log.take(record);
+            log.log(check.format, check.number, check.number, check.integer, -check.integer);
+            snprintf(expected, sizeof(expected), check.format, check.number, check.number, check.integer,
+                     -check.integer);
+        } else {
+            snprintf(expected, sizeof(expected), check.format, check.integer, check.integer, check.integer,
+                     check.integer, check.integer, check.integer);
+        }
+
+        if (!log.take(record) || DeferredLog::format(record, line) != strlen(expected) || strcmp(line, expected) != 0) {
+            printf("  log format \"%s\": \"%s\"\n", check.format, line);
+            result.errors++;
+        }
+    }
+
+    return result;
+}
+
+static void printResult(const char *name, const char *unit, const ThroughputResult &result) {
+    printf("  %-16s %10llu %s, %.1f M/s, %llu errors\n", name, static_cast<unsigned long long>(result.items), unit,
+           result.items / result.seconds / 1e6, static_cast<unsigned long long>(result.errors));
+    printf("  %-16s %10llu full / %llu empty spins\n", "", static_cast<unsigned long long>(result.fullSpins),
+           static_cast<unsigned long long>(result.emptySpins));
+}
+
+int runConcurrencyVerification() {
+    printf("\nConcurrency verification (%u hardware threads)\n", std::thread::hardware_concurrency());
+
+    const ThroughputResult queue = runQueue(2000000);
+    const ThroughputResult path = runPathStream(2000000);
+    const ThroughputResult status = runSnapshot(2000000);
+    const ThroughputResult log = runLog(500000);
+    const ThroughputResult gcode = runSerialGcode(20000);
+    const ThroughputResult flash = runFlashGate(20000);
+
+    printResult("command queue:", "commands", queue);
+    printResult("job stream:", "points", path);
+    printf("  %-16s %10llu reads of 2000000 writes, %llu torn\n", "status snapshot:",
+           static_cast<unsigned long long>(status.items), static_cast<unsigned long long>(status.errors));
+
+    printf("  %-16s %10llu lines of 1000000 formatted, %.1f M/s, %llu dropped, %llu errors\n", "log arena:",
+           static_cast<unsigned long long>(log.items), log.items / log.seconds / 1e6,
+           static_cast<unsigned long long>(log.fullSpins), static_cast<unsigned long long>(log.errors));
+    printResult("serial G-code:", "lines", gcode);
+    printf("  %-16s %10llu writes with the arms parked, %llu moves started during one\n", "flash gate:",
+           static_cast<unsigned long long>(flash.items), static_cast<unsigned long long>(flash.errors));
+
+    const bool passed = queue.errors == 0 && queue.items == 2000000 && path.errors == 0 && status.errors == 0
+                        && log.errors == 0 && gcode.errors == 0 && gcode.items == 20000
+                        && flash.errors == 0 && flash.items == 20000;
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#ifndef CONCURRENCY_VERIFICATION_H
+#define CONCURRENCY_VERIFICATION_H
+
+/**
+ * Runs the structures that cross between the motion and network cores on real host threads: the command queue,
+ * the job stream ring, the status snapshot and the log arena. Checks nothing is lost, reordered or torn, and
+ * reports throughput.
+ * @return 0 if everything arrived intact
+ */
+int runConcurrencyVerification();
+
+#endif //CONCURRENCY_VERIFICATION_H
@@ -0,0 +1,211 @@
+#include "ConfigVerification.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "PreferencesManager.h"
+#include "VerificationCheck.h"
+
+/** Field by field, the padding may differ */
+static bool sameConfig(const MotionConfig &left, const MotionConfig &right) {
+    char leftText[1024];
+    char rightText[1024];
+    left.format(leftText, sizeof(leftText));
+    right.format(rightText, sizeof(rightText));
+    return strcmp(leftText, rightText) == 0;
+}
+
+static void store(const char *key, const void *data, const size_t length, const bool withVersion,
+                  const uint16_t version) {
+    Preferences::storage().clear();
+
+    Preferences preferences;
+    preferences.begin(PREFERENCES_NAMESPACE, false);
+    preferences.putBytes(key, data, length);
+    if (withVersion) {
+        preferences.putUShort(PREFERENCES_KEY_VERSION, version);
+    }
+    preferences.end();
+}
+
+static std::vector<uint8_t> stored(const char *key) {
+    Preferences preferences;
+    preferences.begin(PREFERENCES_NAMESPACE, true);
+    std::vector<uint8_t> bytes(preferences.getBytesLength(key));
+    preferences.getBytes(key, bytes.data(), bytes.size());
+    preferences.end();
+    return bytes;
+}
+
+/** Adds `key` to what is stored, as a save cut short by a power cut would have left it */
+static void storeAlso(const char *key, const void *data, const size_t length) {
+    Preferences preferences;
+    preferences.begin(PREFERENCES_NAMESPACE, false);
+    preferences.putBytes(key, data, length);
+    preferences.end();
+}
+
+/** Applies every `name=value` line of `text` to `config` */
+static bool parse(const char *text, MotionConfig &config) {
+    char line[64];
+
+    while (*text) {
+        const char *end = strchr(text, '\n');
+        const size_t length = end ? end - text : strlen(text);
+        if (length >= sizeof(line)) {
+            return false;
+        }
+
+        memcpy(line, text, length);
+        line[length] = '\0';
+        text += length + (end ? 1 : 0);
+
+        char *separator = strchr(line, '=');
+        if (line[0] == '#' || !separator) {
+            continue;
+        }
+
+        *separator = '\0';
+        if (!config.set(line, separator + 1)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool verifyStorage() {
+    bool passed = true;
+    PreferencesManager manager;
+    const MotionConfig defaults;
+
+    // First boot
+    Preferences::storage().clear();
+    manager.read();
+    passed &= check(manager.getLoadResult() == PreferencesManager::empty && manager.settings.enableWifi
+                    && sameConfig(manager.settings.motion, defaults), "empty NVS gives defaults");
+
+    // What the first firmware stored: no version key, 130 bytes
+    PrefsDataV1 old = {};
+    old.enableAp = false;
+    old.enableWifi = true;
+    strcpy(old.wifiSSID, "workshop");
+    strcpy(old.wifiPassword, "hunter22");
+    store(PREFERENCES_KEY_SETTINGS_V1, &old, sizeof(old), false, 0);
+
+    manager.read();
+    passed &= check(manager.getLoadResult() == PreferencesManager::migrated && manager.getStoredVersion() == 1,
+                    "v1 is migrated");
+    passed &= check(!manager.settings.enableAp && manager.settings.enableWifi
+                    && strcmp(manager.settings.wifiSSID, "workshop") == 0
+                    && strcmp(manager.settings.wifiPassword, "hunter22") == 0, "v1 network settings kept");
+    passed &= check(sameConfig(manager.settings.motion, defaults), "v1 gets default motion");
+
+    PreferencesManager reboot;
+    reboot.read();
+    passed &= check(reboot.getLoadResult() == PreferencesManager::loaded
+                    && reboot.getStoredVersion() == PrefsData::PREFS_VERSION
+                    && strcmp(reboot.settings.wifiSSID, "workshop") == 0, "migration saved as current version");
+    passed &= check(stored(PREFERENCES_KEY_SETTINGS_V1).empty(), "v1 deleted once migrated");
+
+    // Power cut in the migration's save: after the new layout is written, but before the version and the delete
+    PrefsData migratedData;
+    strcpy(migratedData.wifiSSID, "workshop");
+    store(PREFERENCES_KEY_SETTINGS_V1, &old, sizeof(old), false, 0);
+    storeAlso(PREFERENCES_KEY_SETTINGS, &migratedData, sizeof(migratedData));
+    manager.read();
+    passed &= check(manager.getLoadResult() == PreferencesManager::loaded
+                    && strcmp(manager.settings.wifiSSID, "workshop") == 0, "migration cut short keeps network");
+
+    // Edited, saved, read back
+    reboot.settings.motion.set("acceleration_a", "1200");
+    reboot.settings.motion.set("pen_up_degrees", "115");
+    reboot.save();
+    manager.read();
+    passed &= check(manager.getLoadResult() == PreferencesManager::loaded
+                    && sameConfig(manager.settings.motion, reboot.settings.motion)
+                    && manager.settings.motion.acceleration[0] == 1200.0f
+                    && manager.settings.motion.penUpDegrees == 115, "round trip");
+
+    // A newer firmware's data: defaults, and the data stays for when that firmware is back
+    PrefsData newer;
+    strcpy(newer.wifiSSID, "newer");
+    store("set3", &newer, sizeof(newer), true, PrefsData::PREFS_VERSION + 1);
+    const std::vector<uint8_t> before = stored("set3");
+    manager.read();
+    passed &= check(manager.getLoadResult() == PreferencesManager::unreadable
+                    && manager.settings.wifiSSID[0] == '\0' && stored("set3") == before, "unknown version left alone");
+
+    // Motion values no firmware would have written: the device must stay reachable to fix them
+    PrefsData invalid;
+    invalid.enableAp = false;
+    strcpy(invalid.wifiSSID, "workshop");
+    strcpy(invalid.wifiPassword, "hunter22");
+    invalid.motion.maxSpeed[1] = 0.0f;
+    store(PREFERENCES_KEY_SETTINGS, &invalid, sizeof(invalid), true, PrefsData::PREFS_VERSION);
+    manager.read();
+    passed &= check(manager.getLoadResult() == PreferencesManager::motionReset
+                    && sameConfig(manager.settings.motion, defaults), "invalid motion config reset");
+    passed &= check(!manager.settings.enableAp && strcmp(manager.settings.wifiSSID, "workshop") == 0
+                    && strcmp(manager.settings.wifiPassword, "hunter22") == 0, "invalid motion config keeps network");
+
+    store(PREFERENCES_KEY_SETTINGS_V1, &old, sizeof(old) - 1, false, 0);
+    manager.read();
+    passed &= check(manager.getLoadResult() == PreferencesManager::unreadable, "wrong size rejected");
+
+    return passed;
+}
+
+static bool verifyEditing() {
+    bool passed = true;
+    const MotionConfig defaults;
+    MotionConfig config;
+
+    passed &= check(defaults.isValid(), "defaults are valid");
+
+    passed &= check(config.set("max_speed_b", "520.5") && config.maxSpeed[1] == 520.5f
+                    && config.set("homing_backoff", "64") && config.homingBackoff == 64
+                    && config.set("pen_ramp_ms", "30") && config.penRampMs == 30
+                    && config.set("jerk_a", "0") && config.jerk[0] == 0.0f, "fields set");
+
+    const MotionConfig edited = config;
+    passed &= check(!config.set("max_speed_c", "100") && !config.set("max_speed_a", "fast")
+                    && !config.set("max_speed_a", "100x") && !config.set("max_speed_a", "")
+                    && !config.set("max_speed_a", "-5") && !config.set("pen_up_degrees", "181")
+                    && !config.set("acceleration_b", "nan") && sameConfig(config, edited),
+                    "bad names and values rejected");
+
+    MotionConfig crossed;
+    crossed.set("pen_down_degrees", "120");
+    const bool samePenAngles = crossed.isValid();
+    crossed = MotionConfig();
+    crossed.set("homing_probe_speed", "500");
+    passed &= check(!samePenAngles && !crossed.isValid(), "inconsistent fields invalid");
+
+    char text[1024];
+    const size_t length = config.format(text, sizeof(text));
+    MotionConfig parsed;
+    passed &= check(length > 0 && length == strlen(text) && parse(text, parsed) && sameConfig(parsed, config),
+                    "format() parses back");
+
+    char small[64];
+    const size_t cut = config.format(small, sizeof(small));
+    passed &= check(cut < sizeof(small) && cut == strlen(small) && (cut == 0 || small[cut - 1] == '\n'),
+                    "format() cuts at a line");
+
+    printf("\n%s", text);
+    return passed;
+}
+
+int runConfigVerification() {
+    printf("\nConfig verification (PrefsData v%u, %zu bytes, motion %zu bytes)\n", PrefsData::PREFS_VERSION,
+           sizeof(PrefsData), sizeof(MotionConfig));
+
+    bool passed = verifyStorage();
+    passed &= verifyEditing();
+    Preferences::storage().clear();
+
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
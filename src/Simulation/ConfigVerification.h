@@ -0,0 +1,12 @@
+#ifndef CONFIG_VERIFICATION_H
+#define CONFIG_VERIFICATION_H
+
+/**
+ * Runs PreferencesManager against the in-memory NVS shim: first boot, migrating what the first firmware stored,
+ * round trips, and data it can't read (newer versions, invalid values), which must be left alone. Then checks
+ * MotionConfig's text editing: what format() writes parses back to the same config, and bad input is rejected.
+ * @return 0 if every check passed
+ */
+int runConfigVerification();
+
+#endif //CONFIG_VERIFICATION_H
@@ -0,0 +1,142 @@
+#include "EncoderVerification.h"
+
+#include <cstdio>
+
+#include "SimulatedHardware.h"
+#include "VerificationCheck.h"
+
+#include "Input/EncoderJog.h"
+#include "Input/PulseCounter.h"
+
+constexpr static uint8_t GPIO_CLK = 4; // Mirrors main.cpp
+constexpr static uint8_t GPIO_DT = 16;
+constexpr static uint32_t SETTLE_MS = 300; // Loops run on after the last detent
+
+/** The knob turned at a steady rate while the UI loop runs every `loopMs`, and now and then takes `stallMs` */
+struct EncoderScenario {
+    const char *name;
+    long detents; // Negative turns back
+    float detentsPerS;
+    uint32_t loopMs;
+    uint32_t stallEveryMs; // 0 for none
+    uint32_t stallMs;
+};
+
+struct EncoderResult {
+    long counted; // Detents, as the PCNT saw them
+    long polled; // Detents the old loop polling CLK would have seen
+    long steps;
+    uint32_t jogs;
+    uint32_t loops;
+};
+
+constexpr static EncoderScenario SCENARIOS[] = {
+    {"slow clicks", 12, 3.0f, 5, 0, 0},
+    {"slow clicks back", -12, 3.0f, 5, 0, 0},
+    {"steady turn, LCD stalls", 60, 20.0f, 10, 300, 80},
+    {"fast spin, Wi-Fi stalls", 200, 80.0f, 5, 500, 120},
+    {"very fast spin, slow loop", -300, 250.0f, 40, 1000, 250},
+    {"spin past the 16-bit count", 9000, 250.0f, 5, 1000, 250}, // The counter starts over twice
+};
+
+/** Forward the control pin (DT) leads, so the pulse pin (CLK) falls with it low and rises with it high */
+static void turnQuarter(SimulatedHardware &hardware, const long direction, const uint8_t quarter) {
+    constexpr static uint8_t FORWARD[4][2] = {{GPIO_DT, LOW}, {GPIO_CLK, LOW}, {GPIO_DT, HIGH}, {GPIO_CLK, HIGH}};
+    constexpr static uint8_t BACK[4][2] = {{GPIO_CLK, LOW}, {GPIO_DT, LOW}, {GPIO_CLK, HIGH}, {GPIO_DT, HIGH}};
+    const uint8_t (&edge)[2] = direction > 0 ? FORWARD[quarter] : BACK[quarter];
+    hardware.setInputLevel(edge[0], edge[1]);
+}
+
+static EncoderResult runScenario(const EncoderScenario &scenario, PulseCounter &counter) {
+    SimulatedHardware &hardware = SimulatedHardware::instance();
+    EncoderResult result = {};
+
+    EncoderJog jog;
+    const long startCount = counter.read();
+    jog.reset(startCount, millis());
+
+    const long direction = scenario.detents > 0 ? 1 : -1;
+    const uint64_t edges = 4 * static_cast<uint64_t>(std::abs(scenario.detents));
+    const double edgeUs = 1000000.0 / (scenario.detentsPerS * 4);
+    const uint64_t startUs = hardware.nowUs;
+
+    uint64_t edge = 0;
+    uint64_t nextLoopUs = startUs;
+    uint64_t nextStallUs = startUs + scenario.stallEveryMs * 1000ULL;
+    uint64_t endUs = UINT64_MAX;
+    int lastClk = hardware.readPin(GPIO_CLK);
+
+    while (hardware.nowUs < endUs) {
+        const uint64_t edgeDueUs = edge < edges ? startUs + static_cast<uint64_t>(edge * edgeUs) : UINT64_MAX;
+        const uint64_t nextUs = std::min(edgeDueUs, nextLoopUs);
+        hardware.advance(nextUs - hardware.nowUs);
+
+        if (nextUs == edgeDueUs) {
+            turnQuarter(hardware, direction, edge % 4);
+            if (++edge == edges) {
+                endUs = hardware.nowUs + SETTLE_MS * 1000ULL;
+            }
+            continue;
+        }
+
+        // What loop() used to do: one falling CLK edge seen per loop is one detent
+        const int clk = hardware.readPin(GPIO_CLK);
+        if (clk != lastClk && clk == LOW) {
+            result.polled += hardware.readPin(GPIO_DT) != clk ? -1 : 1;
+        }
+        lastClk = clk;
+
+        const long steps = jog.take(counter.read(), millis());
+        if (steps != 0) {
+            result.steps += steps;
+            result.jogs++;
+        }
+        result.loops++;
+
+        if (scenario.stallEveryMs > 0 && hardware.nowUs >= nextStallUs) {
+            nextLoopUs = hardware.nowUs + scenario.stallMs * 1000ULL;
+            nextStallUs += scenario.stallEveryMs * 1000ULL;
+        } else {
+            nextLoopUs = hardware.nowUs + scenario.loopMs * 1000ULL;
+        }
+    }
+
+    result.counted = (counter.read() - startCount) / EncoderJog::COUNTS_PER_DETENT;
+    return result;
+}
+
+int runEncoderVerification() {
+    printf("\nEncoder verification\n");
+    printf("  %-26s %7s %7s %7s %6s %6s %10s\n", "", "turned", "counted", "polled", "jogs", "loops", "steps/det");
+
+    PulseCounter counter;
+    counter.begin(GPIO_CLK, GPIO_DT);
+
+    constexpr size_t count = sizeof(SCENARIOS) / sizeof(SCENARIOS[0]);
+    EncoderResult results[count] = {};
+    bool allCounted = true;
+    bool coalesced = true;
+
+    for (size_t i = 0; i < count; i++) {
+        const EncoderScenario &scenario = SCENARIOS[i];
+        EncoderResult &result = results[i];
+        result = runScenario(scenario, counter);
+
+        allCounted &= result.counted == scenario.detents;
+        coalesced &= result.jogs <= result.loops;
+        printf("  %-26s %7ld %7ld %7ld %6u %6u %10.1f\n", scenario.name, scenario.detents, result.counted,
+               result.polled, result.jogs, result.loops, static_cast<double>(result.steps) / scenario.detents);
+    }
+
+    bool passed = true;
+    passed &= check(allCounted, "every detent counted, whatever the loop does");
+    passed &= check(coalesced && results[4].jogs < -SCENARIOS[4].detents / 4, "at most one jog per loop");
+    passed &= check(results[0].steps == SCENARIOS[0].detents * static_cast<long>(EncoderJog::FINE_STEPS)
+                    && results[1].steps == -results[0].steps, "slow clicks jog fine steps, both ways");
+    passed &= check(results[3].steps > SCENARIOS[3].detents * EncoderJog::COARSE_STEPS * 0.8f
+                    && results[4].steps < SCENARIOS[4].detents * EncoderJog::COARSE_STEPS * 0.8f,
+                    "fast spins jog coarse steps, both ways");
+
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
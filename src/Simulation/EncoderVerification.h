@@ -0,0 +1,12 @@
+#ifndef ENCODER_VERIFICATION_H
+#define ENCODER_VERIFICATION_H
+
+/**
+ * Turns a simulated quadrature encoder at rates from slow clicks to fast spins while the UI loop reading it runs
+ * late and stalls, and checks PulseCounter counts every detent, EncoderJog scales the steps per detent with the
+ * speed, and each loop sends at most one jog. Reports how many detents polling CLK once per loop would have lost.
+ * @return 0 if every check passed
+ */
+int runEncoderVerification();
+
+#endif //ENCODER_VERIFICATION_H
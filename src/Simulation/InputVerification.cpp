@@ -0,0 +1,181 @@
+#include "InputVerification.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "SimulatedHardware.h"
+#include "VerificationCheck.h"
+
+#include "Input/InputManager.h"
+
+constexpr static uint8_t GPIO_LIMIT_A = 34; // Mirrors main.cpp
+constexpr static uint8_t GPIO_LIMIT_B = 35;
+constexpr static uint8_t GPIO_BUTTON = 17;
+constexpr static uint32_t LOOP_US = 1000;
+
+static InputManager inputs(GPIO_LIMIT_A, GPIO_LIMIT_B, GPIO_BUTTON);
+static void onLimitA() { inputs.limitSwitchEvents.onInterrupt(GPIO_LIMIT_A); }
+static void onLimitB() { inputs.limitSwitchEvents.onInterrupt(GPIO_LIMIT_B); }
+static void onButton() { inputs.encoderButtonEvents.onInterrupt(GPIO_BUTTON); }
+
+struct Edge {
+    uint32_t atUs; // From the start of the run
+    uint8_t gpio;
+    uint8_t level;
+};
+
+struct Presses {
+    uint32_t limitA;
+    uint32_t limitB;
+    uint32_t button;
+};
+
+/** Edges in time order against both tasks' loops every `loopUs` (none while `stalledUntilUs`), up to `untilUs` */
+static Presses run(const std::vector<Edge> &edges, const uint32_t untilUs, const uint32_t stalledUntilUs = 0) {
+    SimulatedHardware &hardware = SimulatedHardware::instance();
+    const uint64_t startUs = hardware.nowUs;
+    Presses presses = {};
+    size_t next = 0;
+
+    for (uint32_t loopUs = LOOP_US; loopUs <= untilUs; loopUs += LOOP_US) {
+        for (; next < edges.size() && edges[next].atUs <= loopUs; next++) {
+            hardware.advance(startUs + edges[next].atUs - hardware.nowUs);
+            hardware.setInputLevel(edges[next].gpio, edges[next].level);
+        }
+        hardware.advance(startUs + loopUs - hardware.nowUs);
+
+        if (loopUs < stalledUntilUs) {
+            continue;
+        }
+
+        inputs.handleLimitSwitches();
+        inputs.handleEncoderButton();
+        presses.limitA += inputs.limitSwitchA.takePress();
+        presses.limitB += inputs.limitSwitchB.takePress();
+        presses.button += inputs.encoderButton.takePress();
+    }
+
+    return presses;
+}
+
+/** Contact bounce: `count` edges `gapUs` apart from `atUs`, alternating, ending on `level` */
+static void addBounce(std::vector<Edge> &edges, const uint8_t gpio, const uint32_t atUs, const uint8_t level,
+                      const uint32_t count, const uint32_t gapUs) {
+    for (uint32_t i = 0; i < count; i++) {
+        const bool last = (count - 1 - i) % 2 == 0;
+        edges.push_back({atUs + i * gapUs, gpio, static_cast<uint8_t>(last ? level : !level)});
+    }
+}
+
+static void sortByTime(std::vector<Edge> &edges) {
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge &left, const Edge &right) {
+        return left.atUs < right.atUs;
+    });
+}
+
+static bool allReleased() {
+    return !inputs.limitSwitchA.isPressed() && !inputs.limitSwitchB.isPressed() && !inputs.encoderButton.isPressed();
+}
+
+int runInputVerification() {
+    printf("\nInput verification\n");
+
+    SimulatedHardware &hardware = SimulatedHardware::instance();
+    hardware.attachInterrupt(GPIO_LIMIT_A, onLimitA, CHANGE);
+    hardware.attachInterrupt(GPIO_LIMIT_B, onLimitB, CHANGE);
+    hardware.attachInterrupt(GPIO_BUTTON, onButton, CHANGE);
+    inputs.begin();
+
+    bool passed = true;
+
+    // Latency: presses at random moments against a 1 ms loop, first, so nothing stalled has set the worst yet
+    std::mt19937 random(3);
+    std::uniform_int_distribution<uint32_t> jitter(0, LOOP_US - 1);
+    std::vector<Edge> clicks;
+    for (uint32_t i = 0; i < 100; i++) {
+        const uint32_t atUs = i * 100000 + 1000 + jitter(random);
+        clicks.push_back({atUs, GPIO_BUTTON, HIGH});
+        clicks.push_back({atUs + 40000, GPIO_BUTTON, LOW});
+    }
+    Presses presses = run(clicks, 10000000);
+    const InputEventQueue::Stats latency = inputs.encoderButtonEvents.getStats();
+    passed &= check(presses.button == 100 && latency.maxLatencyUs <= LOOP_US,
+                    "100 clicks handled within a loop of their edge");
+
+    // All three within a microsecond: a single "last GPIO" variable kept only the button
+    std::vector<Edge> together = {
+        {500, GPIO_LIMIT_A, HIGH}, {500, GPIO_LIMIT_B, HIGH}, {501, GPIO_BUTTON, HIGH},
+        {30000, GPIO_LIMIT_A, LOW}, {30000, GPIO_LIMIT_B, LOW}, {30001, GPIO_BUTTON, LOW}
+    };
+    presses = run(together, 60000);
+    passed &= check(presses.limitA == 1 && presses.limitB == 1 && presses.button == 1 && allReleased(),
+                    "switches going off together all arrive");
+
+    // Bounce on press and release, and a glitch shorter than the debounce window
+    std::vector<Edge> bouncy;
+    addBounce(bouncy, GPIO_LIMIT_A, 1000, HIGH, 7, 300);
+    addBounce(bouncy, GPIO_LIMIT_A, 40000, LOW, 6, 400);
+    addBounce(bouncy, GPIO_BUTTON, 1000, HIGH, 9, 1500);
+    addBounce(bouncy, GPIO_BUTTON, 80000, LOW, 8, 1500);
+    bouncy.push_back({150000, GPIO_LIMIT_B, HIGH});
+    bouncy.push_back({150050, GPIO_LIMIT_B, LOW});
+    sortByTime(bouncy);
+
+    const InputEventQueue::Stats limitBefore = inputs.limitSwitchEvents.getStats();
+    presses = run(bouncy, 200000);
+    const uint32_t bounces = inputs.limitSwitchEvents.getStats().bounces - limitBefore.bounces;
+    passed &= check(presses.limitA == 1 && presses.button == 1, "bouncing press and release count once");
+    passed &= check(presses.limitB == 1 && allReleased(), "a glitch counts once and settles released");
+
+    // Every input bouncing while both loops stall for 10 ms: 30 edges, all queued
+    std::vector<Edge> burst;
+    addBounce(burst, GPIO_LIMIT_A, 1000, HIGH, 11, 150);
+    addBounce(burst, GPIO_LIMIT_B, 1100, HIGH, 11, 170);
+    addBounce(burst, GPIO_BUTTON, 1200, HIGH, 11, 190);
+    sortByTime(burst);
+    const uint32_t droppedBefore = inputs.limitSwitchEvents.getStats().dropped
+                                   + inputs.encoderButtonEvents.getStats().dropped;
+    presses = run(burst, 40000, 12000);
+    const uint32_t dropped = inputs.limitSwitchEvents.getStats().dropped
+                             + inputs.encoderButtonEvents.getStats().dropped - droppedBefore;
+    passed &= check(dropped == 0 && presses.limitA == 1 && presses.limitB == 1 && presses.button == 1
+                    && inputs.limitSwitchA.isPressed() && inputs.limitSwitchB.isPressed()
+                    && inputs.encoderButton.isPressed(), "burst during a stalled loop, nothing dropped");
+
+    std::vector<Edge> release = {{1000, GPIO_LIMIT_A, LOW}, {1000, GPIO_LIMIT_B, LOW}, {1000, GPIO_BUTTON, LOW}};
+    run(release, 30000);
+
+    // Far more edges than the queue holds: dropped, and the levels are read back instead
+    std::vector<Edge> flood;
+    addBounce(flood, GPIO_LIMIT_A, 1000, HIGH, 201, 20);
+    presses = run(flood, 30000, 10000);
+    passed &= check(inputs.limitSwitchEvents.getStats().dropped > 0 && presses.limitA == 1
+                    && inputs.limitSwitchA.isPressed(), "overflow is counted and the level recovered");
+    run(release, 30000);
+
+    // An edge that fires on the other core after the loop read the clock: stamped later than the loop's "now"
+    const uint64_t loopReadUs = hardware.nowUs;
+    hardware.advance(200);
+    hardware.setInputLevel(GPIO_LIMIT_B, HIGH);
+    hardware.nowUs = loopReadUs;
+    const uint32_t maxLatencyBefore = inputs.limitSwitchEvents.getStats().maxLatencyUs;
+    inputs.handleLimitSwitches();
+    std::vector<Edge> lateBounce;
+    addBounce(lateBounce, GPIO_LIMIT_B, 1200, HIGH, 3, 300);
+    presses = run(lateBounce, 30000);
+    presses.limitB += inputs.limitSwitchB.takePress();
+    passed &= check(presses.limitB == 1 && inputs.limitSwitchB.isPressed()
+                    && inputs.limitSwitchEvents.getStats().maxLatencyUs == maxLatencyBefore,
+                    "an edge stamped after the loop's clock is debounced");
+    run(release, 30000);
+
+    printf("  bounce:           %6u limit switch edges discarded in the bounce run\n", bounces);
+    printf("  latency:          %6.0f us on average, %u us at worst, with a %u us loop\n",
+           static_cast<double>(latency.latencyUsTotal) / latency.handled,
+           latency.maxLatencyUs, LOOP_US);
+
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
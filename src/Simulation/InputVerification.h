@@ -0,0 +1,13 @@
+#ifndef INPUT_VERIFICATION_H
+#define INPUT_VERIFICATION_H
+
+/**
+ * Drives the limit switch and encoder button GPIOs of a separate InputManager with edges at set microseconds:
+ * switches going off together, contact bounce on press and release, a glitch, every input bouncing at once during
+ * a stalled loop and a flood that overflows the queue. Checks each press arrives exactly once, the levels settle
+ * right, and reports the latency from interrupt to handling.
+ * @return 0 if every check passed
+ */
+int runInputVerification();
+
+#endif //INPUT_VERIFICATION_H
@@ -0,0 +1,130 @@
+#include "JobFormatVerification.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "Job/CompactPathReader.h"
+#include "Job/compiledJob.h"
+#include "StepperMotor/gcode.h"
+
+/** gcode.h read the way the firmware used to */
+class PointArrayPath : public PointPathSource {
+    int index = 0;
+
+protected:
+    bool peekPoint(PathPoint &point) override {
+        if (index >= pathLength) {
+            return false;
+        }
+
+        point = {pathSteps[index][0], pathSteps[index][1]};
+        return true;
+    }
+
+    void popPoint() override {
+        index++;
+    }
+
+    bool hasNoMorePoints() const override {
+        return index >= pathLength;
+    }
+};
+
+static bool sameCommand(const PathCommand &left, const PathCommand &right) {
+    return left.type == right.type && left.a == right.a && left.b == right.b && left.value == right.value;
+}
+
+static CompactPathDecoder::Error decodeAll(const uint8_t *data, const size_t length, uint32_t &commands) {
+    CompactPathReader reader(data, length);
+    PathCommand command = {};
+    commands = 0;
+
+    while (reader.peek(command)) {
+        reader.pop();
+        commands++;
+    }
+
+    return reader.getDecoder().getError();
+}
+
+int runJobFormatVerification() {
+    printf("\nJob format verification\n");
+    bool passed = true;
+
+    // Same commands from both representations
+    PointArrayPath legacy;
+    CompactPathReader compact(compiledJob, sizeof(compiledJob));
+    PathCommand expected = {};
+    PathCommand actual = {};
+    uint32_t commands = 0;
+
+    while (legacy.peek(expected)) {
+        if (!compact.peek(actual) || !sameCommand(expected, actual)) {
+            printf("  command %u differs from gcode.h\n", commands);
+            passed = false;
+            break;
+        }
+
+        legacy.pop();
+        compact.pop();
+        commands++;
+    }
+
+    if (passed && (compact.peek(actual) || compact.getDecoder().getState() != CompactPathDecoder::finished)) {
+        printf("  compiledJob.h doesn't end with gcode.h (error %d)\n", compact.getDecoder().getError());
+        passed = false;
+    }
+
+    // The C++ encoder writes what the slicer wrote
+    static uint8_t encoded[sizeof(compiledJob) + 64];
+    CompactPathEncoder encoder(encoded, sizeof(encoded), PlotterKinematics::GEOMETRY_HASH);
+    PointArrayPath source;
+    PathCommand command = {};
+    while (source.peek(command)) {
+        encoder.add(command);
+        source.pop();
+    }
+
+    const size_t encodedLength = encoder.finish();
+    const bool sameBytes = encodedLength == sizeof(compiledJob) && memcmp(encoded, compiledJob, encodedLength) == 0;
+    passed &= sameBytes;
+
+    // Damage is caught
+    uint32_t decoded = 0;
+    memcpy(encoded, compiledJob, sizeof(compiledJob));
+    encoded[sizeof(compiledJob) / 2] ^= 0x04;
+    const CompactPathDecoder::Error flipped = decodeAll(encoded, sizeof(compiledJob), decoded);
+
+    memcpy(encoded, compiledJob, sizeof(compiledJob));
+    encoded[8] ^= 0x01;
+    const CompactPathDecoder::Error geometry = decodeAll(encoded, sizeof(compiledJob), decoded);
+
+    const CompactPathDecoder::Error cut = decodeAll(compiledJob, sizeof(compiledJob) - 10, decoded);
+
+    passed &= flipped != CompactPathDecoder::none && geometry == CompactPathDecoder::wrongGeometry
+            && cut == CompactPathDecoder::truncated;
+
+    // Decode speed
+    constexpr int ROUNDS = 20000;
+    uint64_t total = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        decodeAll(compiledJob, sizeof(compiledJob), decoded);
+        total += decoded;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const size_t legacyBytes = pathLength * sizeof(pathSteps[0]);
+    printf("  commands:        %10u matching gcode.h\n", commands);
+    printf("  size:            %10zu bytes, pathSteps %zu bytes, %.2fx smaller\n", sizeof(compiledJob), legacyBytes,
+           static_cast<double>(legacyBytes) / sizeof(compiledJob));
+    printf("  C++ encoder:     %10s\n", sameBytes ? "same bytes" : "DIFFERENT BYTES");
+    printf("  flipped bit:     %10d (error code)\n", flipped);
+    printf("  other geometry:  %10d\n", geometry);
+    printf("  truncated:       %10d\n", cut);
+    printf("  decode:          %10.1f M commands/s\n", total / seconds / 1e6);
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+
+    return passed ? 0 : 1;
+}
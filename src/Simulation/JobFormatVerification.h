@@ -0,0 +1,11 @@
+#ifndef JOB_FORMAT_VERIFICATION_H
+#define JOB_FORMAT_VERIFICATION_H
+
+/**
+ * Checks that compiledJob.h (exported by the web slicer) decodes to the same commands as gcode.h, that the C++
+ * encoder produces the same bytes, that corruption is detected, and reports size and decode speed.
+ * @return 0 if everything matched
+ */
+int runJobFormatVerification();
+
+#endif //JOB_FORMAT_VERIFICATION_H
@@ -0,0 +1,181 @@
+#include "KinematicsVerification.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Kinematics/RhombusKinematics.h"
+#include "StepperMotor/gcode.h"
+
+constexpr static double ARM_LENGTH = 150;
+constexpr static double MIN_DISTANCE = 50;
+constexpr static double MAX_DISTANCE = 290;
+constexpr static double STEPS_PER_DEGREE = 2900.0 / 200.0;
+constexpr static double DEGREES_PER_RADIAN = 180.0 / M_PI;
+
+/** computeRhombusKinematics from web-slicer/src/P5Canvas.jsx, returning firmware A/B */
+static bool referenceInverse(const double x, const double y, long &a, long &b) {
+    const double d = std::hypot(x, y);
+    if (d < MIN_DISTANCE || d > MAX_DISTANCE || d > 2 * ARM_LENGTH) {
+        return false;
+    }
+
+    const double halfD = d / 2;
+    const double h = std::sqrt(ARM_LENGTH * ARM_LENGTH - halfD * halfD);
+    const double ux = d > 0 ? -y / d : 0;
+    const double uy = d > 0 ? x / d : 0;
+    const double alphaDeg = std::atan2(x / 2 + ux * h, y / 2 + uy * h) * DEGREES_PER_RADIAN;
+    const double betaDeg = std::atan2(x / 2 - ux * h, y / 2 - uy * h) * DEGREES_PER_RADIAN;
+
+    if (std::abs(alphaDeg) > 100 || std::abs(betaDeg) > 100) {
+        return false;
+    }
+
+    // Math.round, and the slicer's "a" is the firmware's B
+    b = static_cast<long>(std::floor(-alphaDeg * STEPS_PER_DEGREE + 0.5));
+    a = static_cast<long>(std::floor(-betaDeg * STEPS_PER_DEGREE + 0.5));
+    return true;
+}
+
+static void referenceForward(const long a, const long b, double &x, double &y) {
+    const double angleA = -a / STEPS_PER_DEGREE / DEGREES_PER_RADIAN;
+    const double angleB = -b / STEPS_PER_DEGREE / DEGREES_PER_RADIAN;
+    const double direction = (angleA + angleB) / 2;
+    const double distance = 2 * ARM_LENGTH * std::cos((angleA - angleB) / 2);
+
+    x = distance * std::sin(direction);
+    y = distance * std::cos(direction);
+}
+
+static int32_t toFixed(const double millimetres) {
+    return static_cast<int32_t>(std::lround(millimetres * PlotterKinematics::ONE));
+}
+
+struct Comparison {
+    uint32_t points = 0;
+    uint32_t exact = 0;
+    uint32_t reachabilityMismatches = 0;
+    long maxStepError = 0;
+
+    void add(const bool referenceOk, const long referenceA, const long referenceB, const bool ok, const long a,
+             const long b) {
+        points++;
+
+        if (referenceOk != ok) {
+            reachabilityMismatches++;
+            return;
+        }
+
+        if (!ok) {
+            exact++;
+            return;
+        }
+
+        const long error = std::max(std::labs(a - referenceA), std::labs(b - referenceB));
+        maxStepError = std::max(maxStepError, error);
+        exact += error == 0;
+    }
+
+    void print(const char *name) const {
+        printf("  %-16s %9u points, %.4f%% exact, max error %ld step(s), %u reachability mismatches\n", name,
+               points, 100.0 * exact / points, maxStepError, reachabilityMismatches);
+    }
+};
+
+int runKinematicsVerification() {
+    printf("\nKinematics verification\n");
+
+    // The bundled job: every point is an exact joint position, so the solver must land on it
+    Comparison job;
+    double maxForwardError = 0;
+
+    for (int i = 0; i < pathLength; i++) {
+        const long a = pathSteps[i][1];
+        const long b = pathSteps[i][0];
+        if (a >= 4096 && b >= 4096) {
+            continue;
+        }
+
+        double x = 0;
+        double y = 0;
+        referenceForward(a, b, x, y);
+
+        long referenceA = 0;
+        long referenceB = 0;
+        const bool referenceOk = referenceInverse(x, y, referenceA, referenceB);
+        if (!referenceOk || referenceA != a || referenceB != b) {
+            printf("  reference disagrees with gcode.h at point %d\n", i);
+            return 1;
+        }
+
+        long solvedA = 0;
+        long solvedB = 0;
+        const bool ok = PlotterKinematics::inverse(toFixed(x), toFixed(y), solvedA, solvedB);
+        job.add(true, a, b, ok, solvedA, solvedB);
+
+        int32_t forwardX = 0;
+        int32_t forwardY = 0;
+        PlotterKinematics::forward(a, b, forwardX, forwardY);
+        maxForwardError = std::max(maxForwardError, std::hypot(forwardX / 256.0 - x, forwardY / 256.0 - y));
+    }
+
+    // Everything around the workspace, including its edges
+    Comparison grid;
+    for (double y = -60; y <= 300; y += 0.37) {
+        for (double x = -300; x <= 300; x += 0.37) {
+            const int32_t fixedX = toFixed(x);
+            const int32_t fixedY = toFixed(y);
+
+            long referenceA = 0;
+            long referenceB = 0;
+            const bool referenceOk = referenceInverse(fixedX / 256.0, fixedY / 256.0, referenceA, referenceB);
+
+            long a = 0;
+            long b = 0;
+            const bool ok = PlotterKinematics::inverse(fixedX, fixedY, a, b);
+            grid.add(referenceOk, referenceA, referenceB, ok, a, b);
+        }
+    }
+
+    job.print("PP.svg job:");
+    grid.print("workspace grid:");
+    printf("  forward error:   %9.4f mm max on the job\n", maxForwardError);
+
+    // Solve time over points spread like the job, mostly inside the workspace
+    constexpr int ROUNDS = 2000;
+    long sink = 0;
+
+    const auto fixedStart = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < pathLength; i++) {
+            long a = 0;
+            long b = 0;
+            PlotterKinematics::inverse(toFixed(150 + round % 7), toFixed(pathSteps[i][0] / 10.0 + 150), a, b);
+            sink += a + b;
+        }
+    }
+    const auto fixedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - fixedStart);
+
+    const auto referenceStart = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < pathLength; i++) {
+            long a = 0;
+            long b = 0;
+            referenceInverse(150 + round % 7, pathSteps[i][0] / 10.0 + 150, a, b);
+            sink += a + b;
+        }
+    }
+    const auto referenceUs =
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - referenceStart);
+
+    const double solves = static_cast<double>(ROUNDS) * pathLength;
+    printf("  inverse, fixed:  %9.1f ns/solve\n", fixedUs.count() * 1000.0 / solves);
+    printf("  inverse, double: %9.1f ns/solve (checksum %ld)\n", referenceUs.count() * 1000.0 / solves, sink);
+
+    const bool passed = job.exact == job.points && grid.maxStepError <= 1 && grid.exact >= grid.points * 0.999
+                        && maxForwardError < 0.05;
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+#ifndef KINEMATICS_VERIFICATION_H
+#define KINEMATICS_VERIFICATION_H
+
+/**
+ * Checks PlotterKinematics against a double precision port of the web slicer's computeRhombusKinematics,
+ * on the bundled job (gcode.h) and on a grid over the workspace, and times both solvers.
+ * @return 0 if everything matched within tolerance
+ */
+int runKinematicsVerification();
+
+#endif //KINEMATICS_VERIFICATION_H
@@ -0,0 +1,348 @@
+#include "ProfileVerification.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Float rounding on segments of a step or two at speed; past this the speeds handed over weren't feasible
+constexpr float STRETCH_TOLERANCE = 1.001f;
+
+static float randomIn(const float low, const float high) {
+    return low + (high - low) * static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+}
+
+/** Ratio of `value` to `limit`, 0 where the limit is unlimited (0) */
+static float ratio(const float value, const float limit) {
+    return limit > 0.0f ? fabsf(value) / limit : 0.0f;
+}
+
+struct SweepResult {
+    uint32_t profiles = 0;
+    uint32_t stretched = 0; // More than float rounding past the limits
+    float stretch = 1; // Most any profile was stretched
+    float speed = 0; // Highest ratio to the limit
+    float acceleration = 0;
+    float jerk = 0;
+    float joinSpeed = 0; // Largest step between consecutive phases, steps/s
+    float joinAcceleration = 0; // Same in steps/s², jerk-limited profiles only
+    float endPosition = 0; // Steps off the distance at the end
+    float endSpeed = 0; // Off the exit speed at the end
+    float stepPosition = 0; // Steps between where a step was timed and where the profile is then
+    double timing = 0; // µs between the stepped and the planned duration, per second of profile
+    float reachOver = 0; // Relative distance changeDistance(reachableSpeed()) needs beyond the length
+    float reachShort = 0; // Steps it leaves unused
+};
+
+static void checkProfile(const SCurveProfile &profile, const float length, const float entry, const float exit,
+                         const SCurveProfile::Limits &limits, SweepResult &result) {
+    result.profiles++;
+    result.stretch = std::max(result.stretch, profile.getStretch());
+    if (profile.getStretch() > STRETCH_TOLERANCE) {
+        result.stretched++;
+        return;
+    }
+
+    bool first = true;
+    SCurveProfile::State previous = {};
+    for (uint8_t phase = 0; phase < SCurveProfile::PHASE_COUNT; phase++) {
+        if (profile.getPhaseDuration(phase) <= 0.0f) {
+            continue;
+        }
+
+        const SCurveProfile::State start = profile.getPhaseStart(phase);
+        const SCurveProfile::State end = profile.getPhaseEnd(phase);
+
+        result.speed = std::max(result.speed, std::max(ratio(start.speed, limits.speed), ratio(end.speed, limits.speed)));
+        result.acceleration = std::max(result.acceleration, std::max(ratio(start.acceleration, limits.acceleration),
+                                                                     ratio(end.acceleration, limits.acceleration)));
+        result.jerk = std::max(result.jerk, ratio(profile.getPhaseJerk(phase), limits.jerk));
+
+        if (start.speed < -1e-3f || end.speed < -1e-3f) {
+            result.speed = INFINITY; // Runs backwards
+        }
+
+        if (first) {
+            previous = {0.0f, entry, 0.0f};
+            first = false;
+        }
+        result.joinSpeed = std::max(result.joinSpeed, fabsf(start.speed - previous.speed));
+        if (limits.jerk > 0.0f) {
+            result.joinAcceleration = std::max(result.joinAcceleration,
+                                               fabsf(start.acceleration - previous.acceleration));
+        }
+        previous = end;
+    }
+
+    const SCurveProfile::State end = profile.at(profile.getDuration());
+    result.endPosition = std::max(result.endPosition, fabsf(end.position - length));
+    result.endSpeed = std::max(result.endSpeed, fabsf(previous.speed - exit));
+    if (limits.jerk > 0.0f) {
+        result.joinAcceleration = std::max(result.joinAcceleration, fabsf(previous.acceleration));
+    }
+
+    // Stepping as LinearMove does
+    SCurveProfile::Cursor cursor = {};
+    double seconds = 0.0;
+    const uint32_t steps = static_cast<uint32_t>(length);
+    for (uint32_t step = 1; step <= steps; step++) {
+        seconds += profile.advance(step, cursor);
+        const float position = profile.at(static_cast<float>(seconds)).position;
+        result.stepPosition = std::max(result.stepPosition, fabsf(position - step));
+    }
+    if (profile.getDuration() > 0.0f) {
+        result.timing = std::max(result.timing, fabs(seconds - profile.getDuration()) * 1e6 / profile.getDuration());
+    }
+}
+
+int runProfileVerification() {
+    constexpr uint32_t profiles = 100000;
+    srand(1);
+
+    printf("\nProfile verification\n");
+
+    SweepResult result;
+    for (uint32_t i = 0; i < profiles; i++) {
+        // Integer distances like LinearMove's, mostly short like drawing segments; 1 in 8 unlimited jerk
+        SCurveProfile::Limits limits = {randomIn(20, 800), randomIn(50, 3000), randomIn(500, 50000)};
+        if (rand() % 8 == 0) {
+            limits.jerk = 0.0f;
+        }
+        const float length = floorf(rand() % 4 == 0 ? randomIn(1, 10) : randomIn(1, 3000));
+
+        // Speeds a planner could hand over: the exit reachable from the entry and the entry able to slow to it
+        float entry = randomIn(0, limits.speed);
+        const float exit = randomIn(0, std::min(limits.speed, SCurveProfile::reachableSpeed(entry, length, limits)));
+        entry = std::min(entry, SCurveProfile::reachableSpeed(exit, length, limits));
+
+        SCurveProfile profile;
+        profile.plan(length, entry, exit, limits);
+        checkProfile(profile, length, entry, exit, limits, result);
+
+        const float from = randomIn(0, limits.speed);
+        const float reached = SCurveProfile::reachableSpeed(from, length, limits);
+        const float needed = SCurveProfile::changeDistance(from, reached, limits);
+        result.reachOver = std::max(result.reachOver, (needed - length) / length);
+        result.reachShort = std::max(result.reachShort, length - needed);
+    }
+
+    printf("  profiles:        %10u, %u stretched past the limits, at most %.5f times\n", result.profiles,
+           result.stretched, result.stretch);
+    printf("  peak / limit:    %10.5f speed, %.5f acceleration, %.5f jerk\n", result.speed, result.acceleration,
+           result.jerk);
+    printf("  phase joins:     %10.5f steps/s, %.5f steps/s² apart at most\n", result.joinSpeed,
+           result.joinAcceleration);
+    printf("  end:             %10.5f steps, %.5f steps/s off\n", result.endPosition, result.endSpeed);
+    printf("  stepping:        %10.5f steps off the profile, %.3f µs/s off its duration\n", result.stepPosition,
+           result.timing);
+    printf("  reachable speed: %10.6f relative distance over, %.5f steps short\n", result.reachOver,
+           result.reachShort);
+
+    // What planning and stepping cost on this host, a typical drawing segment
+    constexpr uint32_t plans = 200000;
+    const SCurveProfile::Limits limits = {400, 800, 16000};
+    SCurveProfile profile;
+    float sink = 0.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < plans; i++) {
+        profile.plan(20.0f + i % 16, 100.0f, 60.0f + i % 32, limits);
+        sink += profile.getDuration();
+    }
+    const double planNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                          / plans;
+
+    uint32_t stepped = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < plans / 100; i++) {
+        profile.plan(2000.0f, 0.0f, 0.0f, limits);
+        SCurveProfile::Cursor cursor = {};
+        for (uint32_t step = 1; step <= 2000; step++) {
+            sink += profile.advance(step, cursor);
+            stepped++;
+        }
+    }
+    const double stepNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                          / stepped;
+
+    printf("  plan:            %10.1f ns, step %.1f ns on this host (checksum %.0f)\n", planNs, stepNs,
+           static_cast<double>(sink));
+
+    const float jerkTolerance = STRETCH_TOLERANCE * STRETCH_TOLERANCE;
+    const bool passed = result.stretched == 0 && result.speed <= 1.0001f && result.acceleration <= STRETCH_TOLERANCE
+                        && result.jerk <= jerkTolerance && result.joinSpeed < 0.05f && result.joinAcceleration < 0.5f
+                        && result.endPosition < 0.01f && result.endSpeed < 0.05f && result.stepPosition < 0.01f
+                        && result.timing < 5.0 && result.reachOver < 1e-4f
+                        && result.reachShort < 0.1f;
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+
+    return passed ? 0 : 1;
+}
+
+float ProfileRecorder::axisFactor(const Move &move, const uint8_t axis) {
+    const long major = labs(move.steps[move.majorAxis]);
+    return major > 0 ? static_cast<float>(move.steps[axis]) / major : 0.0f;
+}
+
+void ProfileRecorder::record(const LinearMove &move, const uint32_t startUs) {
+    const SCurveProfile &profile = move.getProfile();
+    moves.push_back({
+        startUs, profile, {move.getSteps(0), move.getSteps(1)}, move.getMajorAxis(),
+        move.toPathSpeed(profile.getPhaseStart(0).speed),
+        move.toPathSpeed(profile.at(profile.getDuration()).speed)
+    });
+}
+
+int ProfileRecorder::check(const Limits &limits) const {
+    float peaks[LinearMove::AXIS_COUNT][3] = {};
+    uint32_t stretched = 0;
+    float stretch = 1.0f;
+    uint32_t violations = 0;
+    uint32_t joins = 0;
+    float worstJoin = 0.0f;
+    uint32_t reversals = 0; // Back the way the move before came
+    uint32_t movingReversals = 0;
+
+    for (size_t i = 0; i < moves.size(); i++) {
+        const Move &move = moves[i];
+        stretched += move.profile.getStretch() > STRETCH_TOLERANCE;
+        stretch = std::max(stretch, move.profile.getStretch());
+
+        bool violated = false;
+        for (uint8_t axis = 0; axis < LinearMove::AXIS_COUNT; axis++) {
+            const float factor = fabsf(axisFactor(move, axis));
+            float *peak = peaks[axis];
+
+            for (uint8_t phase = 0; phase < SCurveProfile::PHASE_COUNT; phase++) {
+                if (move.profile.getPhaseDuration(phase) <= 0.0f) {
+                    continue;
+                }
+
+                const SCurveProfile::State start = move.profile.getPhaseStart(phase);
+                const SCurveProfile::State end = move.profile.getPhaseEnd(phase);
+                peak[0] = std::max(peak[0], factor * std::max(fabsf(start.speed), fabsf(end.speed)) / limits.speed);
+                peak[1] = std::max(peak[1], factor * std::max(fabsf(start.acceleration), fabsf(end.acceleration))
+                                            / limits.acceleration);
+                if (limits.jerk > 0.0f) {
+                    peak[2] = std::max(peak[2], factor * fabsf(move.profile.getPhaseJerk(phase)) / limits.jerk);
+                }
+            }
+
+            violated |= peak[0] > 1.0001f || peak[1] > STRETCH_TOLERANCE
+                        || peak[2] > STRETCH_TOLERANCE * STRETCH_TOLERANCE;
+        }
+        violations += violated;
+
+        // Moves stepped back to back should hand over the path speed the planner committed to
+        if (i > 0) {
+            const Move &previous = moves[i - 1];
+            const uint32_t previousEndUs = previous.startUs
+                                           + static_cast<uint32_t>(previous.profile.getDuration() * 1e6f);
+            if (previous.exitPathSpeed > 0.0f && move.startUs - previousEndUs < 1000) {
+                joins++;
+                worstJoin = std::max(worstJoin, fabsf(move.entryPathSpeed - previous.exitPathSpeed));
+            }
+
+            const long cross = previous.steps[0] * move.steps[1] - previous.steps[1] * move.steps[0];
+            const long dot = previous.steps[0] * move.steps[0] + previous.steps[1] * move.steps[1];
+            if (cross == 0 && dot < 0) {
+                reversals++;
+                movingReversals += previous.exitPathSpeed > 0.0f || move.entryPathSpeed > 0.0f;
+            }
+        }
+    }
+
+    printf("\nProfile check\n");
+    printf("  moves:           %10zu, %u stretched past the limits, at most %.5f times\n", moves.size(), stretched,
+           stretch);
+    for (uint8_t axis = 0; axis < LinearMove::AXIS_COUNT; axis++) {
+        printf("  peak / limit %c:  %10.4f speed, %.4f acceleration, %.4f jerk\n", 'A' + axis, peaks[axis][0],
+               peaks[axis][1], peaks[axis][2]);
+    }
+    printf("  moving joins:    %10u, path speed %.3f steps/s apart at most\n", joins, worstJoin);
+    printf("  reversals:       %10u, %u taken without stopping\n", reversals, movingReversals);
+    const bool passed = violations == 0 && movingReversals == 0;
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+
+    return passed ? 0 : 1;
+}
+
+bool ProfileRecorder::writePlot(const char *path, const float seconds, const Limits &limits) const {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    constexpr float WIDTH = 1200.0f;
+    constexpr float PANEL = 240.0f; // Height of each chart
+    constexpr float TOP = 30.0f;
+    constexpr float GAP = 40.0f;
+    constexpr float SAMPLE_S = 0.002f;
+    const char *colours[LinearMove::AXIS_COUNT] = {"#1f77b4", "#ff7f0e"};
+
+    const uint32_t originUs = moves.empty() ? 0 : moves.front().startUs;
+    const float xScale = WIDTH / seconds;
+    const float panelTop[2] = {TOP, TOP + PANEL + GAP};
+    const float panelScale[2] = {PANEL / 2.0f / limits.speed, PANEL / 2.0f / limits.acceleration};
+
+    fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\" "
+                  "font-family=\"sans-serif\" font-size=\"12\">\n", WIDTH, TOP + 2 * PANEL + GAP + 10);
+
+    // One band per move, alternating shades
+    for (size_t i = 0; i < moves.size(); i++) {
+        const float start = (moves[i].startUs - originUs) / 1e6f;
+        if (start > seconds) {
+            break;
+        }
+
+        for (const float top: panelTop) {
+            fprintf(file, "<rect x=\"%.2f\" y=\"%.0f\" width=\"%.2f\" height=\"%.0f\" fill=\"%s\"/>\n",
+                    start * xScale, top, moves[i].profile.getDuration() * xScale, PANEL,
+                    i % 2 ? "#f0f0f0" : "#e0e0e8");
+        }
+    }
+
+    const char *titles[2] = {"speed, steps/s (±%.0f)", "acceleration, steps/s² (±%.0f)"};
+    const float ranges[2] = {limits.speed, limits.acceleration};
+    for (uint8_t panel = 0; panel < 2; panel++) {
+        const float middle = panelTop[panel] + PANEL / 2.0f;
+        fprintf(file, "<line x1=\"0\" y1=\"%.0f\" x2=\"%.0f\" y2=\"%.0f\" stroke=\"#888\"/>\n", middle, WIDTH, middle);
+        fprintf(file, "<text x=\"4\" y=\"%.0f\">", panelTop[panel] - 6);
+        fprintf(file, titles[panel], ranges[panel]);
+        fprintf(file, " over %.1f s, A blue, B orange</text>\n", seconds);
+    }
+
+    // Sampled from the profiles, standing still between moves
+    for (uint8_t panel = 0; panel < 2; panel++) {
+        for (uint8_t axis = 0; axis < LinearMove::AXIS_COUNT; axis++) {
+            fprintf(file, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"1\" points=\"", colours[axis]);
+
+            size_t index = 0;
+            for (float time = 0.0f; time <= seconds; time += SAMPLE_S) {
+                while (index + 1 < moves.size() && (moves[index + 1].startUs - originUs) / 1e6f <= time) {
+                    index++;
+                }
+
+                float value = 0.0f;
+                if (index < moves.size()) {
+                    const Move &move = moves[index];
+                    const float into = time - (move.startUs - originUs) / 1e6f;
+                    if (into >= 0.0f && into <= move.profile.getDuration()) {
+                        const SCurveProfile::State state = move.profile.at(into);
+                        value = axisFactor(move, axis) * (panel == 0 ? state.speed : state.acceleration);
+                    }
+                }
+
+                fprintf(file, "%.1f,%.1f ", time * xScale,
+                        panelTop[panel] + PANEL / 2.0f - value * panelScale[panel]);
+            }
+
+            fprintf(file, "\"/>\n");
+        }
+    }
+
+    fprintf(file, "</svg>\n");
+    fclose(file);
+
+    return true;
+}
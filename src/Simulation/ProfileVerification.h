@@ -0,0 +1,59 @@
+#ifndef PROFILE_VERIFICATION_H
+#define PROFILE_VERIFICATION_H
+
+#include <vector>
+
+#include "StepperMotor/LinearMove.h"
+
+/**
+ * Checks SCurveProfile on randomized entry/exit speeds, distances and limits: speed, acceleration and jerk stay
+ * within the limits, the phases join up, the profile ends where and as fast as asked, stepping through it times
+ * every step where the profile reaches it, and reachableSpeed() agrees with the distance a change takes.
+ * @return 0 if every profile passed
+ */
+int runProfileVerification();
+
+/**
+ * Records the linear moves StepEngine starts during a simulated job (see StepEngine::setMoveObserver), then
+ * checks them against the per-axis limits and plots them.
+ */
+class ProfileRecorder {
+public:
+    struct Limits {
+        float speed;
+        float acceleration;
+        float jerk;
+    };
+
+private:
+    struct Move {
+        uint32_t startUs;
+        SCurveProfile profile;
+        long steps[LinearMove::AXIS_COUNT];
+        uint8_t majorAxis;
+        float entryPathSpeed;
+        float exitPathSpeed;
+    };
+
+    std::vector<Move> moves;
+
+    /** Axis share of the major axis' speed, acceleration and jerk, signed */
+    static float axisFactor(const Move &move, uint8_t axis);
+
+public:
+    void record(const LinearMove &move, uint32_t startUs);
+
+    /**
+     * Prints what the recorded moves reached against `limits` per axis, and how well consecutive moves join.
+     * @return 0 if no move exceeded the limits
+     */
+    int check(const Limits &limits) const;
+
+    /**
+     * SVG of both axes' speed and acceleration over the first `seconds` of recorded moves, one band per move,
+     * scaled to `limits`.
+     */
+    bool writePlot(const char *path, float seconds, const Limits &limits) const;
+};
+
+#endif //PROFILE_VERIFICATION_H
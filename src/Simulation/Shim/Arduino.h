@@ -0,0 +1,61 @@
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+// Minimal Arduino-ESP32 surface needed by the motion code, backed by SimulatedHardware.
+// Only used by the native (host) build.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define IRAM_ATTR
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+typedef unsigned long ulong;
+
+using std::abs;
+
+template<typename T, typename L, typename H>
+T constrain(const T value, const L low, const H high) {
+    return value < low ? low : value > high ? high : value;
+}
+
+unsigned long millis();
+
+unsigned long micros();
+
+void delay(unsigned long ms);
+
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+
+void digitalWrite(uint8_t pin, uint8_t value);
+
+int digitalRead(uint8_t pin);
+
+inline uint8_t digitalPinToInterrupt(const uint8_t pin) {
+    return pin;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+
+double ledcSetup(uint8_t channel, double frequency, uint8_t resolutionBits);
+
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+
+void ledcWrite(uint8_t channel, uint32_t duty);
+
+#endif //ARDUINO_SHIM_H
@@ -0,0 +1,157 @@
+#ifndef FS_SHIM_H
+#define FS_SHIM_H
+
+// Arduino-ESP32 fs::FS (LittleFS) for the native build, rooted in a directory of the host. Only the calls the
+// job spool makes.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+    class File {
+        std::shared_ptr<FILE> file;
+        std::shared_ptr<DIR> directory;
+        std::string hostPath;
+        std::string filePath; // As the firmware sees it
+        std::string fileName;
+
+    public:
+        File() = default;
+
+        File(const std::string &hostPath, const std::string &path, const char *mode)
+            : hostPath(hostPath), filePath(path) {
+            fileName = path.substr(path.find_last_of('/') + 1);
+
+            struct stat info = {};
+            if (stat(hostPath.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+                directory.reset(opendir(hostPath.c_str()), closedir);
+                return;
+            }
+
+            // Binary, the firmware's files are raw bytes
+            const std::string hostMode = std::string(mode) + "b";
+            FILE *opened = fopen(hostPath.c_str(), hostMode.c_str());
+            if (opened) {
+                file.reset(opened, fclose);
+            }
+        }
+
+        explicit operator bool() const {
+            return file || directory;
+        }
+
+        size_t read(uint8_t *buffer, const size_t length) {
+            return file ? fread(buffer, 1, length, file.get()) : 0;
+        }
+
+        size_t write(const uint8_t *buffer, const size_t length) {
+            return file ? fwrite(buffer, 1, length, file.get()) : 0;
+        }
+
+        bool seek(const uint32_t position) {
+            return file && fseek(file.get(), position, SEEK_SET) == 0;
+        }
+
+        size_t position() const {
+            return file ? ftell(file.get()) : 0;
+        }
+
+        size_t size() const {
+            struct stat info = {};
+            if (file) {
+                fflush(file.get());
+            }
+            return stat(hostPath.c_str(), &info) == 0 ? info.st_size : 0;
+        }
+
+        int available() const {
+            return file ? static_cast<int>(size() - position()) : 0;
+        }
+
+        void flush() {
+            if (file) {
+                fflush(file.get());
+            }
+        }
+
+        void close() {
+            file.reset();
+            directory.reset();
+        }
+
+        bool isDirectory() const {
+            return static_cast<bool>(directory);
+        }
+
+        const char *name() const {
+            return fileName.c_str();
+        }
+
+        const char *path() const {
+            return filePath.c_str();
+        }
+
+        File openNextFile(const char *mode = FILE_READ) {
+            if (!directory) {
+                return File();
+            }
+
+            while (const dirent *entry = readdir(directory.get())) {
+                if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                    return File(hostPath + "/" + entry->d_name, filePath + "/" + entry->d_name, mode);
+                }
+            }
+
+            return File();
+        }
+    };
+
+    class FS {
+        std::string root;
+
+        std::string host(const char *path) const {
+            return root + path;
+        }
+
+    public:
+        explicit FS(std::string root = "") : root(std::move(root)) {
+        }
+
+        File open(const char *path, const char *mode = FILE_READ, const bool create = false) {
+            (void) create;
+            return File(host(path), path, mode);
+        }
+
+        bool exists(const char *path) const {
+            struct stat info = {};
+            return stat(host(path).c_str(), &info) == 0;
+        }
+
+        bool remove(const char *path) {
+            return ::remove(host(path).c_str()) == 0;
+        }
+
+        bool rename(const char *from, const char *to) {
+            return ::rename(host(from).c_str(), host(to).c_str()) == 0;
+        }
+
+        bool mkdir(const char *path) {
+            return ::mkdir(host(path).c_str(), 0755) == 0 || exists(path);
+        }
+    };
+}
+
+using fs::File;
+
+#endif //FS_SHIM_H
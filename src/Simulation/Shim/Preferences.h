@@ -0,0 +1,103 @@
+#ifndef PREFERENCES_SHIM_H
+#define PREFERENCES_SHIM_H
+
+// Arduino-ESP32 Preferences (NVS) for the native build: namespaces of keyed blobs, kept in memory for the
+// lifetime of the process. Only the calls PreferencesManager makes.
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+    using Namespace = std::map<std::string, std::vector<uint8_t>>;
+
+    Namespace *opened = nullptr;
+    bool readOnly = true;
+
+    const std::vector<uint8_t> *find(const char *key) const {
+        if (!opened) {
+            return nullptr;
+        }
+
+        const auto entry = opened->find(key);
+        return entry == opened->end() ? nullptr : &entry->second;
+    }
+
+    size_t put(const char *key, const void *value, const size_t length) {
+        if (!opened || readOnly) {
+            return 0;
+        }
+
+        const uint8_t *bytes = static_cast<const uint8_t *>(value);
+        (*opened)[key].assign(bytes, bytes + length);
+        return length;
+    }
+
+public:
+    /** Every namespace, shared by all instances like the flash partition is */
+    static std::map<std::string, Namespace> &storage() {
+        static std::map<std::string, Namespace> namespaces;
+        return namespaces;
+    }
+
+    bool begin(const char *name, const bool _readOnly = false) {
+        opened = &storage()[name];
+        readOnly = _readOnly;
+        return true;
+    }
+
+    void end() {
+        opened = nullptr;
+    }
+
+    bool clear() {
+        if (!opened || readOnly) {
+            return false;
+        }
+
+        opened->clear();
+        return true;
+    }
+
+    bool remove(const char *key) {
+        return opened && !readOnly && opened->erase(key) > 0;
+    }
+
+    size_t getBytesLength(const char *key) const {
+        const std::vector<uint8_t> *value = find(key);
+        return value ? value->size() : 0;
+    }
+
+    size_t getBytes(const char *key, void *buffer, const size_t length) const {
+        const std::vector<uint8_t> *value = find(key);
+        if (!value || value->size() > length) {
+            return 0;
+        }
+
+        memcpy(buffer, value->data(), value->size());
+        return value->size();
+    }
+
+    size_t putBytes(const char *key, const void *value, const size_t length) {
+        return put(key, value, length);
+    }
+
+    uint16_t getUShort(const char *key, const uint16_t defaultValue = 0) const {
+        const std::vector<uint8_t> *value = find(key);
+        if (!value || value->size() != sizeof(uint16_t)) {
+            return defaultValue;
+        }
+
+        uint16_t result = 0;
+        memcpy(&result, value->data(), sizeof(result));
+        return result;
+    }
+
+    size_t putUShort(const char *key, const uint16_t value) {
+        return put(key, &value, sizeof(value));
+    }
+};
+
+#endif //PREFERENCES_SHIM_H
@@ -0,0 +1,217 @@
+#include "SimulatedHardware.h"
+
+#include <Arduino.h>
+
+SimulatedHardware &SimulatedHardware::instance() {
+    static SimulatedHardware hardware;
+    return hardware;
+}
+
+uint8_t SimulatedHardware::addAxis(const uint8_t stepPin, const uint8_t dirPin, const long startPosition) {
+    axes.push_back({stepPin, dirPin, startPosition, 0});
+    return axes.size() - 1;
+}
+
+void SimulatedHardware::addLimitSwitch(const uint8_t gpio, const uint8_t axis, const long position,
+                                       const bool activeBelow, const long jitter) {
+    const long axisPosition = axes[axis].position;
+    const bool pressed = activeBelow ? axisPosition <= position : axisPosition >= position;
+
+    limitSwitches.push_back({gpio, axis, position, activeBelow, pressed, jitter, 0});
+    pinLevels[gpio] = pressed ? HIGH : LOW;
+}
+
+uint8_t SimulatedHardware::addPulseCounter(const uint8_t pulsePin, const uint8_t controlPin, const long limit) {
+    pulseCounters.push_back({pulsePin, controlPin, limit, 0});
+    pinLevels[pulsePin] = HIGH;
+    pinLevels[controlPin] = HIGH;
+    return pulseCounters.size() - 1;
+}
+
+void SimulatedHardware::advance(const uint64_t us) {
+    const uint64_t targetUs = nowUs + us;
+
+    while (true) {
+        Timer *next = nullptr;
+
+        for (Timer &timer: timers) {
+            if (timer.armed && timer.dueUs <= targetUs && (!next || timer.dueUs < next->dueUs)) {
+                next = &timer;
+            }
+        }
+
+        if (!next) {
+            break;
+        }
+
+        nowUs = next->dueUs > nowUs ? next->dueUs : nowUs;
+        next->lastFireUs = nowUs;
+        next->dueUs = nowUs + next->intervalUs;
+        next->isr();
+    }
+
+    nowUs = targetUs;
+}
+
+uint8_t SimulatedHardware::addTimer(void (*isr)()) {
+    timers.push_back({isr, false, 1, 0, 0});
+    return timers.size() - 1;
+}
+
+void SimulatedHardware::startTimer(const uint8_t timer, const uint32_t intervalUs) {
+    timers[timer].intervalUs = intervalUs > 0 ? intervalUs : 1;
+    timers[timer].lastFireUs = nowUs;
+    timers[timer].dueUs = nowUs + timers[timer].intervalUs;
+    timers[timer].armed = true;
+}
+
+void SimulatedHardware::setTimerInterval(const uint8_t timer, const uint32_t intervalUs) {
+    timers[timer].intervalUs = intervalUs > 0 ? intervalUs : 1;
+    timers[timer].dueUs = timers[timer].lastFireUs + timers[timer].intervalUs;
+}
+
+void SimulatedHardware::stopTimer(const uint8_t timer) {
+    timers[timer].armed = false;
+}
+
+void SimulatedHardware::writePin(const uint8_t pin, const uint8_t level) {
+    if (pin >= PIN_COUNT) {
+        return;
+    }
+
+    const bool risingEdge = pinLevels[pin] == LOW && level != LOW;
+    pinLevels[pin] = level;
+
+    if (!risingEdge) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < axes.size(); i++) {
+        if (axes[i].stepPin == pin) {
+            onStep(i);
+        }
+    }
+}
+
+void SimulatedHardware::attachInterrupt(const uint8_t pin, void (*handler)(), const int mode) {
+    if (pin >= PIN_COUNT) {
+        return;
+    }
+
+    interruptHandlers[pin] = handler;
+    interruptModes[pin] = mode;
+}
+
+void SimulatedHardware::onStep(const uint8_t axisIndex) {
+    Axis &axis = axes[axisIndex];
+    const int direction = pinLevels[axis.dirPin] == HIGH ? 1 : -1;
+
+    axis.position += direction;
+    axis.steps++;
+
+    if (timeline) {
+        fprintf(timeline, "%llu,%u,%d,%ld\n", static_cast<unsigned long long>(nowUs), axisIndex, direction,
+                axis.position);
+    }
+
+    for (LimitSwitch &limitSwitch: limitSwitches) {
+        if (limitSwitch.axis != axisIndex) {
+            continue;
+        }
+
+        const long engagesAt = limitSwitch.position + limitSwitch.offset;
+        const bool pressed = limitSwitch.activeBelow
+                                 ? axis.position <= engagesAt
+                                 : axis.position >= engagesAt;
+
+        if (pressed != limitSwitch.pressed) {
+            limitSwitch.pressed = pressed;
+
+            // Where the next press engages, fixed seed so runs repeat
+            if (!pressed && limitSwitch.jitter > 0) {
+                limitSwitch.offset = rand() % (2 * limitSwitch.jitter + 1) - limitSwitch.jitter;
+            }
+
+            setInputLevel(limitSwitch.gpio, pressed ? HIGH : LOW);
+        }
+    }
+}
+
+void SimulatedHardware::setInputLevel(const uint8_t pin, const uint8_t level) {
+    const uint8_t previous = pinLevels[pin];
+    pinLevels[pin] = level;
+
+    if (previous == level) {
+        return;
+    }
+
+    // Rising counts up and falling down with the control pin high, the other way round with it low
+    for (PulseCounterUnit &counter: pulseCounters) {
+        if (counter.pulsePin == pin) {
+            const long direction = level == HIGH ? 1 : -1;
+            counter.count += pinLevels[counter.controlPin] == HIGH ? direction : -direction;
+            if (counter.count == counter.limit || counter.count == -counter.limit) {
+                counter.count = 0;
+            }
+        }
+    }
+
+    if (!interruptHandlers[pin]) {
+        return;
+    }
+
+    const int mode = interruptModes[pin];
+    const bool fire = mode == CHANGE
+                      || (mode == RISING && level == HIGH)
+                      || (mode == FALLING && level == LOW);
+
+    if (fire) {
+        interruptHandlers[pin]();
+    }
+}
+
+// Arduino shim
+
+unsigned long millis() {
+    return static_cast<unsigned long>(SimulatedHardware::instance().nowUs / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(SimulatedHardware::instance().nowUs);
+}
+
+void delay(const unsigned long ms) {
+    SimulatedHardware::instance().advance(static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(const unsigned int us) {
+    SimulatedHardware::instance().advance(us);
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(const uint8_t pin, const uint8_t value) {
+    SimulatedHardware::instance().writePin(pin, value);
+}
+
+int digitalRead(const uint8_t pin) {
+    return SimulatedHardware::instance().readPin(pin);
+}
+
+void attachInterrupt(const uint8_t pin, void (*handler)(), const int mode) {
+    SimulatedHardware::instance().attachInterrupt(pin, handler, mode);
+}
+
+double ledcSetup(uint8_t, const double frequency, uint8_t) {
+    return frequency;
+}
+
+void ledcAttachPin(uint8_t, uint8_t) {
+}
+
+void ledcWrite(const uint8_t channel, const uint32_t duty) {
+    if (channel < SimulatedHardware::LEDC_CHANNEL_COUNT) {
+        SimulatedHardware::instance().ledcDuty[channel] = duty;
+    }
+}
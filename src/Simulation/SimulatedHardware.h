@@ -0,0 +1,101 @@
+#ifndef SIMULATED_HARDWARE_H
+#define SIMULATED_HARDWARE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Virtual clock and GPIO model behind the Arduino shim.
+ * Time only moves when the simulator advances it, so a job runs as fast as the host can execute the motion code.
+ */
+class SimulatedHardware {
+public:
+    constexpr static uint8_t PIN_COUNT = 40;
+    constexpr static uint8_t LEDC_CHANNEL_COUNT = 16;
+
+    struct Axis {
+        uint8_t stepPin;
+        uint8_t dirPin;
+        long position; // Physical position in steps, relative to power-on
+        uint64_t steps;
+    };
+
+    struct LimitSwitch {
+        uint8_t gpio;
+        uint8_t axis;
+        long position;
+        bool activeBelow; // Pressed when axis position <= position, otherwise when >= position
+        bool pressed;
+        long jitter; // Each press engages up to this many steps early or late
+        long offset; // This press's
+    };
+
+    /** PCNT unit decoding a quadrature pair, see PulseCounter; `count` starts over from 0 at ±limit */
+    struct PulseCounterUnit {
+        uint8_t pulsePin;
+        uint8_t controlPin;
+        long limit;
+        long count;
+    };
+
+    struct Timer {
+        void (*isr)();
+        bool armed;
+        uint32_t intervalUs;
+        uint64_t lastFireUs;
+        uint64_t dueUs;
+    };
+
+    uint64_t nowUs = 0;
+
+    uint8_t pinLevels[PIN_COUNT] = {};
+    void (*interruptHandlers[PIN_COUNT])() = {};
+    int interruptModes[PIN_COUNT] = {};
+    uint32_t ledcDuty[LEDC_CHANNEL_COUNT] = {};
+
+    std::vector<Axis> axes;
+    std::vector<LimitSwitch> limitSwitches;
+    std::vector<PulseCounterUnit> pulseCounters;
+    std::vector<Timer> timers;
+
+    FILE *timeline = nullptr;
+
+    static SimulatedHardware &instance();
+
+    uint8_t addAxis(uint8_t stepPin, uint8_t dirPin, long startPosition);
+
+    /** Starts out pressed if the axis already is past `position` */
+    void addLimitSwitch(uint8_t gpio, uint8_t axis, long position, bool activeBelow, long jitter = 0);
+
+    /** Both pins idle high, as with the encoder's pull-ups */
+    uint8_t addPulseCounter(uint8_t pulsePin, uint8_t controlPin, long limit);
+
+    /** Moves the clock forward, firing every timer interrupt that falls due on the way */
+    void advance(uint64_t us);
+
+    uint8_t addTimer(void (*isr)());
+
+    void startTimer(uint8_t timer, uint32_t intervalUs);
+
+    /** Auto-reload semantics: the next alarm is counted from the last one */
+    void setTimerInterval(uint8_t timer, uint32_t intervalUs);
+
+    void stopTimer(uint8_t timer);
+
+    void writePin(uint8_t pin, uint8_t level);
+
+    uint8_t readPin(const uint8_t pin) const {
+        return pin < PIN_COUNT ? pinLevels[pin] : 0;
+    }
+
+    void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+
+    /** An input driven from outside, firing its interrupt and counting its edge as the hardware would */
+    void setInputLevel(uint8_t pin, uint8_t level);
+
+private:
+    void onStep(uint8_t axisIndex);
+};
+
+#endif //SIMULATED_HARDWARE_H
@@ -0,0 +1,23 @@
+#ifndef SIMULATED_PULSE_COUNTER_H
+#define SIMULATED_PULSE_COUNTER_H
+
+#include <Arduino.h>
+
+#include "SimulatedHardware.h"
+
+/** Host backend of PulseCounter: SimulatedHardware counts the edges as the PCNT would, 16 bit and starting over */
+class PulseCounter {
+    uint8_t counter = 0;
+    WrappedPulseCount total;
+
+public:
+    void begin(const uint8_t pulsePin, const uint8_t controlPin) {
+        counter = SimulatedHardware::instance().addPulseCounter(pulsePin, controlPin, WrappedPulseCount::LIMIT);
+    }
+
+    long read() {
+        return total.update(static_cast<int16_t>(SimulatedHardware::instance().pulseCounters[counter].count));
+    }
+};
+
+#endif //SIMULATED_PULSE_COUNTER_H
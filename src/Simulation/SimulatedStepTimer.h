@@ -0,0 +1,62 @@
+#ifndef SIMULATED_STEP_TIMER_H
+#define SIMULATED_STEP_TIMER_H
+
+#include <Arduino.h>
+
+#include "SimulatedHardware.h"
+
+/** Host backend of StepTimer: a virtual hardware timer dispatched by SimulatedHardware::advance() */
+class StepTimer {
+    uint8_t timer = 0;
+
+public:
+    void begin(void (*isr)()) {
+        timer = SimulatedHardware::instance().addTimer(isr);
+    }
+
+    void start(const uint32_t firstIntervalUs) const {
+        SimulatedHardware::instance().startTimer(timer, firstIntervalUs);
+    }
+
+    void setNextInterval(const uint32_t intervalUs) const {
+        SimulatedHardware::instance().setTimerInterval(timer, intervalUs);
+    }
+
+    void stop() const {
+        SimulatedHardware::instance().stopTimer(timer);
+    }
+
+    // The simulation is single threaded, the ISR only runs from inside advance()
+    void lock() {
+    }
+
+    void unlock() {
+    }
+
+    void lockFromIsr() {
+    }
+
+    void unlockFromIsr() {
+    }
+
+    static void setPinsHigh(const uint32_t mask) {
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & 1UL << pin) {
+                digitalWrite(pin, HIGH);
+            }
+        }
+    }
+
+    static void setPinsLow(const uint32_t mask) {
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & 1UL << pin) {
+                digitalWrite(pin, LOW);
+            }
+        }
+    }
+
+    static void pulseDelay() {
+    }
+};
+
+#endif //SIMULATED_STEP_TIMER_H
@@ -0,0 +1,27 @@
+#ifndef SIMULATION_LOGGER_H
+#define SIMULATION_LOGGER_H
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "SimulatedHardware.h"
+
+// Host replacement for RemoteDevelopmentService/LoggerHelper.h, prefixes virtual time.
+
+inline bool gSimulationVerbose = true;
+
+inline void printLn(const char *format, ...) {
+    if (!gSimulationVerbose) {
+        return;
+    }
+
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    printf("[%10.3f ms] %s\n", SimulatedHardware::instance().nowUs / 1000.0, buf);
+}
+
+#endif //SIMULATION_LOGGER_H
@@ -0,0 +1,907 @@
+// Host simulation of the plotter motion stack ([env:native]).
+// Runs homing + the compiled-in path (or a G-code file) on a virtual clock and reports where the time went.
+
+#include <Arduino.h>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "ConcurrencyVerification.h"
+#include "ConfigVerification.h"
+#include "EncoderVerification.h"
+#include "InputVerification.h"
+#include "JobFormatVerification.h"
+#include "KinematicsVerification.h"
+#include "ProfileVerification.h"
+#include "SimulatedHardware.h"
+#include "SimulationLogger.h"
+#include "SpoolVerification.h"
+#include "VerificationCheck.h"
+#include "WorkspaceVerification.h"
+
+#include "ServoPWM.h"
+#include "Input/InputManager.h"
+#include "Job/CompiledPath.h"
+#include "Job/GcodeInterpreter.h"
+#include "Job/PathStreamBuffer.h"
+#include "StepperMotor/StepperMotor.h"
+#include "StepperMotor/StepperMotorCoordinator.h"
+#include "StepperMotor/gcode.h"
+#include "Telemetry/MotionTelemetry.h"
+
+// Pin map, mirrors main.cpp
+constexpr int GPIO_ENCODER_SW = 17;
+constexpr int GPIO_MOTOR_A_DIR = 18;
+constexpr int GPIO_MOTOR_A_STEP = 19;
+constexpr int GPIO_MOTOR_B_DIR = 21;
+constexpr int GPIO_MOTOR_B_STEP = 22;
+constexpr int GPIO_SERVO = 23;
+constexpr int GPIO_LIMIT_SWITCH_A = 34;
+constexpr int GPIO_LIMIT_SWITCH_B = 35;
+
+InputManager inputManager(GPIO_LIMIT_SWITCH_A, GPIO_LIMIT_SWITCH_B, GPIO_ENCODER_SW);
+void IRAM_ATTR onRemoteReceiverInterrupt_limitSwitchA() {
+    inputManager.limitSwitchEvents.onInterrupt(GPIO_LIMIT_SWITCH_A);
+}
+void IRAM_ATTR onRemoteReceiverInterrupt_limitSwitchB() {
+    inputManager.limitSwitchEvents.onInterrupt(GPIO_LIMIT_SWITCH_B);
+}
+
+StepEngine stepEngine(GPIO_MOTOR_A_STEP, GPIO_MOTOR_A_DIR, GPIO_MOTOR_B_STEP, GPIO_MOTOR_B_DIR);
+StepperMotor stepperA(stepEngine, 0);
+StepperMotor stepperB(stepEngine, 1);
+ServoPWM penServo(GPIO_SERVO);
+
+StepperMotorCoordinator stepperCoordinator(stepEngine, stepperA, stepperB, penServo, inputManager);
+
+PathStreamBuffer pathStream;
+GcodeInterpreter gcode;
+
+MotionTelemetry motionTelemetry(stepEngine, stepperCoordinator, penServo);
+
+ProfileRecorder profileRecorder;
+static void onMoveStarted(const LinearMove &move, const uint32_t startUs) {
+    profileRecorder.record(move, startUs);
+}
+
+/** Mirrors main.cpp, minus what only exists on the device */
+void writeMetrics(MetricsText &metrics) {
+    motionTelemetry.write(metrics);
+}
+
+struct SimulationOptions {
+    uint32_t loopUs = 20; // Modeled cost of one firmware loop() iteration, step timing is independent of it
+    long startA = 0;
+    long startB = 0;
+    long switchA = -600; // Physical position of limit switch A, pressed at or below
+    long switchB = 1200; // Physical position of limit switch B, pressed at or above
+    long switchJitter = 0; // Steps each switch press may engage early or late
+    uint32_t homingRuns = 0; // Only homes this many times in a row, reporting duration and repeatability
+    double timeoutS = 3600;
+    const char *timelinePath = nullptr;
+    uint32_t streamBytesPerMs = 0; // Streams the path through PathStreamBuffer at this rate instead of drawing it directly
+    const char *gcodePath = nullptr; // Draws this G-code file instead of the compiled path
+    uint32_t gcodeBenchLines = 0; // Only benchmarks the G-code interpreter on this many generated lines
+    bool verifyKinematics = false; // Only checks the kinematics against the web slicer's
+    bool verifyJobFormat = false; // Only checks compiledJob.h against gcode.h
+    bool verifyConcurrency = false; // Only checks the cross-core queues on host threads
+    bool verifyConfig = false; // Only checks the settings store and config editing
+    bool verifySpool = false; // Only checks the job spool's checkpoints across power cuts
+    bool verifyEncoder = false; // Only checks encoder counting and jog scaling against a late, stalling loop
+    bool verifyInputs = false; // Only checks the input event queue and debouncing against bursts and bounce
+    bool verifyWorkspace = false; // Only checks the joint limits jobs are validated against
+    MotionConfig config; // As applied on the device, edited with --set and the --pen-* options
+    bool penOverlap = true; // Pen moves overlap the arms' deceleration and the start of travel
+    bool printMetrics = false; // Prints what /metrics would serve at the end of the run
+    bool verifyProfiles = false; // Checks SCurveProfile, then every move of the run against the axis limits
+    const char *profilePlotPath = nullptr; // SVG of the first PROFILE_PLOT_S of drawing moves
+    std::vector<double> holdAtS; // Feed holds this far into the job, as if the encoder button was pressed
+    double holdForS = 1.0; // How long each hold lasts before it is resumed
+    double abortAtS = -1; // Aborts the job this far into it
+    bool verifyHold = false; // Holds at VERIFY_HOLD_AT_S unless --hold-at is given, checks the arms stay on the path
+};
+
+constexpr float PROFILE_PLOT_S = 10.0f;
+constexpr double VERIFY_HOLD_AT_S[] = {3.0, 7.5, 12.25, 20.0}; // Into the bundled job: drawing, travel, a corner
+constexpr double PATH_TOLERANCE_STEPS = 1.5; // Bresenham rounding plus the steps of the other axis still to come
+constexpr size_t PATH_SEARCH_SEGMENTS = 32;
+
+/** Client side of the job stream protocol, sending the compiled path as the granted credit allows */
+class SimulatedStreamClient {
+    PathStreamBuffer &stream;
+    uint32_t bytesPerMs;
+
+    uint8_t pending[4 + (pathLength + 1) * 4] = {};
+    size_t pendingLength = 0;
+    size_t sent = 0;
+    size_t granted = 4; // The magic needs no credit
+    double budget = 0;
+
+public:
+    uint32_t grants = 0;
+    uint32_t maxBuffered = 0;
+
+    SimulatedStreamClient(PathStreamBuffer &stream, const uint32_t bytesPerMs) : stream(stream), bytesPerMs(bytesPerMs) {
+        memcpy(pending, PathStreamBuffer::MAGIC, 4);
+        pendingLength = 4;
+
+        auto append = [this](const int16_t b, const int16_t a) {
+            pending[pendingLength++] = b & 0xFF;
+            pending[pendingLength++] = b >> 8 & 0xFF;
+            pending[pendingLength++] = a & 0xFF;
+            pending[pendingLength++] = a >> 8 & 0xFF;
+        };
+
+        for (int i = 0; i < pathLength; i++) {
+            append(pathSteps[i][0], pathSteps[i][1]);
+        }
+        append(PathStreamBuffer::END_OF_JOB, PathStreamBuffer::END_OF_JOB);
+    }
+
+    void loop(const uint32_t elapsedUs) {
+        budget += bytesPerMs * elapsedUs / 1000.0;
+
+        const uint16_t credits = stream.takeCredits();
+        if (credits > 0) {
+            granted += credits * 4;
+            grants++;
+        }
+
+        size_t length = std::min(std::min(granted, pendingLength) - sent, static_cast<size_t>(budget));
+        length = std::min(length, stream.acceptableBytes());
+
+        if (length > 0) {
+            stream.receive(pending + sent, length);
+            sent += length;
+            budget -= length;
+        }
+    }
+};
+
+/** Feeds a G-code file to the interpreter whenever it has room, like a sender waiting for "ok" */
+class SimulatedGcodeSender {
+    FILE *file;
+    GcodeInterpreter &interpreter;
+
+    char chunk[64] = {};
+    size_t length = 0;
+    size_t offset = 0;
+    bool done = false;
+
+public:
+    SimulatedGcodeSender(FILE *file, GcodeInterpreter &interpreter) : file(file), interpreter(interpreter) {
+    }
+
+    void loop() {
+        while (!done && interpreter.canAccept()) {
+            if (offset == length) {
+                length = fread(chunk, 1, sizeof(chunk), file);
+                offset = 0;
+
+                if (length == 0) {
+                    interpreter.end();
+                    done = true;
+                    return;
+                }
+            }
+
+            offset += interpreter.feed(chunk + offset, length - offset);
+        }
+    }
+};
+
+/**
+ * Presses hold and resume (or abort) at set points of the job, like the encoder button, and checks what the
+ * coordinator does in between: the arms come to rest, the pen lifts and nothing moves until the resume.
+ */
+class SimulatedOperator {
+    StepperMotorCoordinator &coordinator;
+    StepEngine &engine;
+    ServoPWM &pen;
+    const SimulationOptions &options;
+
+    size_t nextHold = 0;
+    uint64_t holdRequestedUs = 0;
+    uint64_t heldSinceUs = 0;
+    long requestedAt[2] = {};
+    long heldAt[2] = {};
+    bool aborted = false;
+
+public:
+    uint32_t holds = 0;
+    uint64_t worstStopUs = 0; // From hold() to standing still with the pen up
+    long worstStopSteps = 0; // Travelled along the path after hold(), on the arm that moved most
+    uint32_t heldViolations = 0; // Loops a held plotter had the pen down or an arm off where it stopped
+
+    SimulatedOperator(StepperMotorCoordinator &coordinator, StepEngine &engine, ServoPWM &pen,
+                      const SimulationOptions &options)
+        : coordinator(coordinator), engine(engine), pen(pen), options(options) {
+    }
+
+    bool hasAborted() const {
+        return aborted;
+    }
+
+    void loop(const uint64_t jobUs, const uint64_t nowUs) {
+        const FeedHold feedHold = coordinator.getFeedHold();
+
+        if (options.abortAtS >= 0 && !aborted && jobUs >= static_cast<uint64_t>(options.abortAtS * 1000000.0)) {
+            aborted = coordinator.abort();
+            return;
+        }
+
+        if (nextHold < options.holdAtS.size() && feedHold == feedRunning
+            && jobUs >= static_cast<uint64_t>(options.holdAtS[nextHold] * 1000000.0) && coordinator.hold()) {
+            nextHold++;
+            holdRequestedUs = nowUs;
+            requestedAt[0] = engine.getPosition(0);
+            requestedAt[1] = engine.getPosition(1);
+            return;
+        }
+
+        if (feedHold != feedHeld) {
+            return;
+        }
+
+        if (heldSinceUs == 0) {
+            heldSinceUs = nowUs;
+            heldAt[0] = engine.getPosition(0);
+            heldAt[1] = engine.getPosition(1);
+            holds++;
+            worstStopUs = std::max(worstStopUs, nowUs - holdRequestedUs);
+            worstStopSteps = std::max(worstStopSteps, std::max(std::abs(heldAt[0] - requestedAt[0]),
+                                                               std::abs(heldAt[1] - requestedAt[1])));
+        }
+
+        if (!pen.isUp() || engine.getPosition(0) != heldAt[0] || engine.getPosition(1) != heldAt[1]) {
+            heldViolations++;
+        }
+
+        if (nowUs - heldSinceUs >= static_cast<uint64_t>(options.holdForS * 1000000.0) && coordinator.resume()) {
+            heldSinceUs = 0;
+        }
+    }
+};
+
+/** The bundled job as the polyline of its move targets, which the arms must follow through holds (--verify-hold) */
+class PathFollowCheck {
+    struct Point {
+        double a;
+        double b;
+    };
+
+    std::vector<Point> points;
+    size_t segment = 0;
+
+    static double distanceToSegment(const Point &point, const Point &from, const Point &to) {
+        const double da = to.a - from.a;
+        const double db = to.b - from.b;
+        const double lengthSquared = da * da + db * db;
+        double t = 0;
+        if (lengthSquared > 0) {
+            t = std::max(0.0, std::min(1.0, ((point.a - from.a) * da + (point.b - from.b) * db) / lengthSquared));
+        }
+        return std::hypot(point.a - from.a - t * da, point.b - from.b - t * db);
+    }
+
+public:
+    double worstSteps = 0;
+    uint32_t strays = 0; // Samples further than PATH_TOLERANCE_STEPS from the path ahead
+
+    /** From where the arms are when drawing starts */
+    void begin(const long a, const long b) {
+        points.push_back({static_cast<double>(a), static_cast<double>(b)});
+
+        CompiledPath path;
+        PathCommand command = {};
+        while (path.peek(command)) {
+            if (command.type == PathCommand::move) {
+                points.push_back({static_cast<double>(command.a), static_cast<double>(command.b)});
+            }
+            path.pop();
+        }
+    }
+
+    bool hasBegun() const {
+        return !points.empty();
+    }
+
+    void sample(const long a, const long b) {
+        // The arms only go forward along the path, so the search starts where they were last seen
+        const Point point = {static_cast<double>(a), static_cast<double>(b)};
+        double best = INFINITY;
+        size_t bestSegment = segment;
+
+        for (size_t i = segment; i + 1 < points.size() && i < segment + PATH_SEARCH_SEGMENTS; i++) {
+            const double distance = distanceToSegment(point, points[i], points[i + 1]);
+            if (distance < best) {
+                best = distance;
+                bestSegment = i;
+            }
+            if (distance <= PATH_TOLERANCE_STEPS) {
+                break;
+            }
+        }
+
+        worstSteps = std::max(worstSteps, best);
+        if (best > PATH_TOLERANCE_STEPS) {
+            strays++;
+        } else {
+            segment = bestSegment;
+        }
+    }
+};
+
+/** Interpreter throughput on a generated drawing program: mostly short G1 moves, a pen lift every 50 lines */
+static int runGcodeBenchmark(const uint32_t lines) {
+    std::string program;
+    program.reserve(lines * 32);
+
+    char line[64];
+    for (uint32_t i = 0; i < lines; i++) {
+        const float x = 100.0f * sinf(i * 0.01f);
+        const float y = 150.0f + 50.0f * cosf(i * 0.013f);
+
+        switch (i % 50) {
+            case 0:
+                snprintf(line, sizeof(line), "G0 X%.3f Y%.3f\n", x, y);
+                break;
+            case 1:
+                snprintf(line, sizeof(line), "M3\n");
+                break;
+            case 49:
+                snprintf(line, sizeof(line), "M5 ; lift\n");
+                break;
+            default:
+                snprintf(line, sizeof(line), "G1 X%.3f Y%.3f F3000\n", x, y);
+        }
+        program += line;
+    }
+
+    GcodeInterpreter interpreter;
+    PathCommand command = {};
+    uint64_t commands = 0;
+    size_t offset = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    while (offset < program.size()) {
+        offset += interpreter.feed(program.data() + offset, program.size() - offset);
+
+        while (interpreter.peek(command)) {
+            commands++;
+            interpreter.pop();
+        }
+    }
+    interpreter.end();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\nG-code benchmark\n");
+    printf("  lines:           %10u\n", interpreter.getLineCount());
+    printf("  bytes:           %10zu\n", program.size());
+    printf("  commands:        %10llu\n", static_cast<unsigned long long>(commands));
+    printf("  errors:          %10u\n", interpreter.getErrorCount());
+    printf("  host time:       %10.3f ms\n", seconds * 1000.0);
+    printf("  lines/s:         %10.0f\n", interpreter.getLineCount() / seconds);
+    printf("  MB/s:            %10.1f\n", program.size() / seconds / 1e6);
+
+    return interpreter.getLineCount() == lines && interpreter.getErrorCount() == 0 ? 0 : 1;
+}
+
+struct SimulationReport {
+    uint64_t homingUs = 0;
+    uint64_t jobUs = 0;
+    uint64_t penDownUs = 0;
+    uint64_t travelUs = 0;
+    uint64_t returnUs = 0;
+    uint64_t penWaitUs = 0; // Arms standing still during a job while the pen moves
+    uint32_t penLifts = 0;
+    uint64_t loopIterations = 0;
+};
+
+static void printUsage(const char *program) {
+    printf("Usage: %s [--loop-us N] [--start-a N] [--start-b N] [--switch-a N] [--switch-b N]\n"
+           "          [--switch-jitter N] [--homing-runs N] [--timeout-s N] [--timeline FILE]\n"
+           "          [--stream BYTES_PER_MS] [--gcode FILE]\n"
+           "          [--gcode-bench LINES] [--verify-kinematics] [--verify-job-format]\n"
+           "          [--verify-concurrency] [--pen-drop-ms N] [--pen-lift-ms N] [--pen-clear-ms N]\n"
+           "          [--pen-ramp-ms N] [--no-pen-overlap] [--metrics] [--verify-profiles]\n"
+           "          [--profile-plot FILE] [--verify-config] [--set KEY=VALUE]... [--verify-spool]\n"
+           "          [--hold-at S]... [--hold-for S] [--abort-at S] [--verify-hold]\n"
+           "          [--verify-encoder] [--verify-inputs] [--verify-workspace] [--quiet]\n", program);
+}
+
+static bool parseOptions(const int argc, char **argv, SimulationOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--quiet") == 0) {
+            gSimulationVerbose = false;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-kinematics") == 0) {
+            options.verifyKinematics = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-job-format") == 0) {
+            options.verifyJobFormat = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-concurrency") == 0) {
+            options.verifyConcurrency = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--no-pen-overlap") == 0) {
+            options.penOverlap = false;
+            continue;
+        }
+
+        if (strcmp(arg, "--metrics") == 0) {
+            options.printMetrics = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-profiles") == 0) {
+            options.verifyProfiles = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-config") == 0) {
+            options.verifyConfig = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-spool") == 0) {
+            options.verifySpool = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-encoder") == 0) {
+            options.verifyEncoder = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-inputs") == 0) {
+            options.verifyInputs = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-workspace") == 0) {
+            options.verifyWorkspace = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--verify-hold") == 0) {
+            options.verifyHold = true;
+            continue;
+        }
+
+        if (!value) {
+            return false;
+        }
+
+        bool accepted = true;
+
+        if (strcmp(arg, "--loop-us") == 0) {
+            options.loopUs = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--start-a") == 0) {
+            options.startA = strtol(value, nullptr, 10);
+        } else if (strcmp(arg, "--start-b") == 0) {
+            options.startB = strtol(value, nullptr, 10);
+        } else if (strcmp(arg, "--switch-a") == 0) {
+            options.switchA = strtol(value, nullptr, 10);
+        } else if (strcmp(arg, "--switch-b") == 0) {
+            options.switchB = strtol(value, nullptr, 10);
+        } else if (strcmp(arg, "--switch-jitter") == 0) {
+            options.switchJitter = strtol(value, nullptr, 10);
+        } else if (strcmp(arg, "--homing-runs") == 0) {
+            options.homingRuns = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--timeout-s") == 0) {
+            options.timeoutS = strtod(value, nullptr);
+        } else if (strcmp(arg, "--timeline") == 0) {
+            options.timelinePath = value;
+        } else if (strcmp(arg, "--stream") == 0) {
+            options.streamBytesPerMs = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--gcode") == 0) {
+            options.gcodePath = value;
+        } else if (strcmp(arg, "--gcode-bench") == 0) {
+            options.gcodeBenchLines = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--pen-drop-ms") == 0) {
+            accepted = options.config.set("pen_drop_ms", value);
+        } else if (strcmp(arg, "--pen-lift-ms") == 0) {
+            accepted = options.config.set("pen_lift_ms", value);
+        } else if (strcmp(arg, "--pen-clear-ms") == 0) {
+            accepted = options.config.set("pen_clear_ms", value);
+        } else if (strcmp(arg, "--pen-ramp-ms") == 0) {
+            accepted = options.config.set("pen_ramp_ms", value);
+        } else if (strcmp(arg, "--set") == 0) {
+            // Same names and checks as the telnet "set" command
+            char name[32] = {};
+            const char *separator = strchr(value, '=');
+            if (!separator || static_cast<size_t>(separator - value) >= sizeof(name)) {
+                return false;
+            }
+            memcpy(name, value, separator - value);
+            accepted = options.config.set(name, separator + 1);
+        } else if (strcmp(arg, "--profile-plot") == 0) {
+            options.profilePlotPath = value;
+        } else if (strcmp(arg, "--hold-at") == 0) {
+            options.holdAtS.push_back(strtod(value, nullptr));
+        } else if (strcmp(arg, "--hold-for") == 0) {
+            options.holdForS = strtod(value, nullptr);
+        } else if (strcmp(arg, "--abort-at") == 0) {
+            options.abortAtS = strtod(value, nullptr);
+        } else {
+            return false;
+        }
+
+        if (!accepted) {
+            fprintf(stderr, "Bad value for %s: %s\n", arg, value);
+            return false;
+        }
+
+        i++;
+    }
+
+    if (options.verifyHold && options.holdAtS.empty()) {
+        options.holdAtS.assign(std::begin(VERIFY_HOLD_AT_S), std::end(VERIFY_HOLD_AT_S));
+    }
+
+    if (options.verifyHold && (options.gcodePath || options.streamBytesPerMs > 0)) {
+        fprintf(stderr, "--verify-hold checks the path of the compiled job\n");
+        return false;
+    }
+
+    if (!options.config.isValid()) {
+        fprintf(stderr, "Settings contradict each other, see MotionConfig::isValid()\n");
+        return false;
+    }
+
+    return options.loopUs > 0;
+}
+
+/**
+ * What /metrics would serve after the run, then what the instrumentation costs per loop on this host, timed on a
+ * separate instance fed a 1 ms loop period so it publishes as often as on the device.
+ */
+static void printMetrics() {
+    motionTelemetry.onLoopStart(micros());
+
+    static char text[4096];
+    MetricsText metrics(text, sizeof(text));
+    writeMetrics(metrics);
+    printf("\nMetrics (%zu bytes%s)\n%s", metrics.getLength(), metrics.isTruncated() ? ", TRUNCATED" : "", text);
+
+    constexpr uint32_t loops = 1000000;
+    MotionTelemetry telemetry(stepEngine, stepperCoordinator, penServo);
+    uint32_t nowUs = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < loops; i++) {
+        telemetry.onLoopStart(nowUs);
+        nowUs += 1000;
+        telemetry.onLoopEnd(nowUs);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\nTelemetry overhead: %.1f ns per loop on this host, %zu bytes of state\n", seconds * 1e9 / loops,
+           sizeof(MotionTelemetry));
+}
+
+/**
+ * Homes again and again, each time from where the last one returned the arms to (zero), and reports how long
+ * it took, where the probe found the switches compared to the homing before and how far the arms opened.
+ */
+static int runHomingRuns(const SimulationOptions &options) {
+    SimulatedHardware &hardware = SimulatedHardware::instance();
+    const uint64_t timeoutUs = static_cast<uint64_t>(options.timeoutS * 1000000.0);
+
+    GcodeInterpreter emptyJob;
+    emptyJob.end();
+
+    uint64_t totalMs = 0;
+    long worst[2] = {};
+    // B ahead of A in joint steps, from where the switches are: each sits at the end of its arm's range
+    const long openingOffset = PlotterKinematics::ARM_RANGE_STEPS - (options.switchB - options.switchA);
+    long widestOpening = 0;
+
+    printf("\nHoming runs\n");
+
+    for (uint32_t run = 0; run < options.homingRuns; run++) {
+        stepperCoordinator.home(&emptyJob);
+
+        while (hardware.nowUs < timeoutUs) {
+            if (stepperCoordinator.getHomingSequence() == finished && !stepperA.isRunning()
+                && !stepperB.isRunning()) {
+                break;
+            }
+
+            inputManager.handleLimitSwitches();
+            stepperCoordinator.run();
+            hardware.advance(options.loopUs);
+            widestOpening = std::max(widestOpening,
+                                     hardware.axes[1].position - hardware.axes[0].position + openingOffset);
+        }
+
+        const HomingReport &report = stepperCoordinator.getHomingReport();
+        if (hardware.nowUs >= timeoutUs || report.homings != run + 1) {
+            printf("  run %u: TIMED OUT\n", run + 1);
+            return 1;
+        }
+
+        totalMs += report.durationMs;
+        for (uint8_t axis = 0; axis < 2; axis++) {
+            worst[axis] = std::max(worst[axis], std::abs(report.repeatabilitySteps[axis]));
+        }
+
+        printf("  run %3u: %6u ms, overshoot A/B %ld / %ld, repeatability A/B %+ld / %+ld steps\n", run + 1,
+               report.durationMs, report.overshootSteps[0], report.overshootSteps[1],
+               report.repeatabilitySteps[0], report.repeatabilitySteps[1]);
+    }
+
+    printf("  mean duration:   %10.0f ms\n", static_cast<double>(totalMs) / options.homingRuns);
+    printf("  worst A / B:     %10ld / %ld steps off the previous homing\n", worst[0], worst[1]);
+    printf("  widest opening:  %10ld steps, %ld at most while drawing\n", widestOpening,
+           PlotterKinematics::OPENING_MAX_STEPS);
+
+    return 0;
+}
+
+static double toSeconds(const uint64_t us) {
+    return us / 1000000.0;
+}
+
+int main(const int argc, char **argv) {
+    SimulationOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    if (options.verifyKinematics) {
+        return runKinematicsVerification();
+    }
+
+    if (options.verifyJobFormat) {
+        return runJobFormatVerification();
+    }
+
+    if (options.verifyConcurrency) {
+        return runConcurrencyVerification();
+    }
+
+    if (options.verifyConfig) {
+        return runConfigVerification();
+    }
+
+    if (options.verifySpool) {
+        return runSpoolVerification();
+    }
+
+    if (options.verifyEncoder) {
+        return runEncoderVerification();
+    }
+
+    if (options.verifyInputs) {
+        return runInputVerification();
+    }
+
+    if (options.verifyWorkspace) {
+        return runWorkspaceVerification();
+    }
+
+    if (options.gcodeBenchLines > 0) {
+        return runGcodeBenchmark(options.gcodeBenchLines);
+    }
+
+    if (options.verifyProfiles && runProfileVerification() != 0) {
+        return 1;
+    }
+
+    FILE *gcodeFile = nullptr;
+    if (options.gcodePath) {
+        gcodeFile = fopen(options.gcodePath, "r");
+        if (!gcodeFile) {
+            fprintf(stderr, "Cannot open %s\n", options.gcodePath);
+            return 1;
+        }
+    }
+
+    SimulatedHardware &hardware = SimulatedHardware::instance();
+
+    if (options.timelinePath) {
+        hardware.timeline = fopen(options.timelinePath, "w");
+        if (!hardware.timeline) {
+            fprintf(stderr, "Cannot open %s\n", options.timelinePath);
+            return 1;
+        }
+        fprintf(hardware.timeline, "time_us,axis,dir,position\n");
+    }
+
+    const uint8_t axisA = hardware.addAxis(GPIO_MOTOR_A_STEP, GPIO_MOTOR_A_DIR, options.startA);
+    const uint8_t axisB = hardware.addAxis(GPIO_MOTOR_B_STEP, GPIO_MOTOR_B_DIR, options.startB);
+    hardware.addLimitSwitch(GPIO_LIMIT_SWITCH_A, axisA, options.switchA, true, options.switchJitter);
+    hardware.addLimitSwitch(GPIO_LIMIT_SWITCH_B, axisB, options.switchB, false, options.switchJitter);
+
+    attachInterrupt(digitalPinToInterrupt(GPIO_LIMIT_SWITCH_A), onRemoteReceiverInterrupt_limitSwitchA, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(GPIO_LIMIT_SWITCH_B), onRemoteReceiverInterrupt_limitSwitchB, CHANGE);
+    inputManager.begin();
+
+    stepEngine.begin();
+    penServo.begin();
+    stepperCoordinator.applyConfig(options.config);
+    stepperCoordinator.setPenOverlap(options.penOverlap);
+
+    if (options.homingRuns > 0) {
+        return runHomingRuns(options);
+    }
+
+    if (options.verifyProfiles || options.profilePlotPath) {
+        stepEngine.setMoveObserver(onMoveStarted);
+    }
+
+    SimulatedStreamClient streamClient(pathStream, options.streamBytesPerMs);
+    SimulatedGcodeSender gcodeSender(gcodeFile, gcode);
+    if (gcodeFile) {
+        stepperCoordinator.home(&gcode);
+    } else if (options.streamBytesPerMs > 0) {
+        pathStream.begin();
+        stepperCoordinator.home(&pathStream);
+    } else {
+        stepperCoordinator.home();
+    }
+
+    SimulatedOperator simulatedOperator(stepperCoordinator, stepEngine, penServo, options);
+    PathFollowCheck pathCheck;
+
+    SimulationReport report;
+    const uint64_t timeoutUs = static_cast<uint64_t>(options.timeoutS * 1000000.0);
+    const auto hostStart = std::chrono::steady_clock::now();
+
+    bool wasUp = penServo.isUp();
+
+    while (hardware.nowUs < timeoutUs) {
+        const HomingSequence state = stepperCoordinator.getHomingSequence();
+        const bool moving = stepperA.isRunning() || stepperB.isRunning();
+
+        if (penServo.isUp() && !wasUp) {
+            report.penLifts++;
+        }
+        wasUp = penServo.isUp();
+
+        if (state == finished && !moving) {
+            break;
+        }
+
+        if (options.streamBytesPerMs > 0) {
+            streamClient.loop(options.loopUs);
+        }
+        if (gcodeFile) {
+            gcodeSender.loop();
+        }
+
+        motionTelemetry.onLoopStart(micros());
+        inputManager.handleLimitSwitches();
+        stepperCoordinator.run();
+        hardware.advance(options.loopUs);
+        motionTelemetry.onLoopEnd(micros());
+        report.loopIterations++;
+
+        if (state == drawingPath) {
+            report.jobUs += options.loopUs;
+            simulatedOperator.loop(report.jobUs, hardware.nowUs);
+
+            if (options.verifyHold) {
+                if (!pathCheck.hasBegun()) {
+                    pathCheck.begin(stepEngine.getPosition(0), stepEngine.getPosition(1));
+                }
+                pathCheck.sample(stepEngine.getPosition(0), stepEngine.getPosition(1));
+            }
+
+            if (!penServo.isUp()) {
+                report.penDownUs += options.loopUs;
+            } else if (moving) {
+                report.travelUs += options.loopUs;
+            }
+
+            if (!moving && !penServo.isSettled()) {
+                report.penWaitUs += options.loopUs;
+            }
+        } else if (state == finished) {
+            report.returnUs += options.loopUs;
+        } else {
+            report.homingUs += options.loopUs;
+        }
+    }
+
+    const auto hostUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - hostStart).count();
+
+    if (hardware.timeline) {
+        fclose(hardware.timeline);
+    }
+    if (gcodeFile) {
+        fclose(gcodeFile);
+    }
+
+    const bool timedOut = hardware.nowUs >= timeoutUs;
+
+    printf("\nSimulation report%s\n", timedOut ? " (TIMED OUT)" : "");
+    printf("  homing:          %10.3f s\n", toSeconds(report.homingUs));
+    printf("  job:             %10.3f s\n", toSeconds(report.jobUs));
+    printf("    pen down:      %10.3f s\n", toSeconds(report.penDownUs));
+    printf("    travel:        %10.3f s\n", toSeconds(report.travelUs));
+    printf("    other:         %10.3f s\n", toSeconds(report.jobUs - report.penDownUs - report.travelUs));
+    printf("  pen lifts:       %10u, arms waiting on the pen %.3f s\n", report.penLifts,
+           toSeconds(report.penWaitUs));
+    printf("  return to zero:  %10.3f s\n", toSeconds(report.returnUs));
+    printf("  total:           %10.3f s\n", toSeconds(hardware.nowUs));
+    if (gcodeFile) {
+        printf("  G-code lines:    %10u (%u malformed, %u unsupported)\n", gcode.getLineCount(), gcode.getErrorCount(),
+               gcode.getUnsupportedCount());
+    } else {
+        printf("  points:          %10d\n", pathLength);
+    }
+    printf("  steps A / B:     %10llu / %llu\n", static_cast<unsigned long long>(hardware.axes[axisA].steps),
+           static_cast<unsigned long long>(hardware.axes[axisB].steps));
+    if (options.streamBytesPerMs > 0) {
+        printf("  stream grants:   %10u\n", streamClient.grants);
+    }
+    if (!options.holdAtS.empty()) {
+        printf("  feed holds:      %10u, stopped within %.3f s and %ld steps, %u held loops disturbed\n",
+               simulatedOperator.holds, toSeconds(simulatedOperator.worstStopUs), simulatedOperator.worstStopSteps,
+               simulatedOperator.heldViolations);
+    }
+    if (simulatedOperator.hasAborted()) {
+        printf("  aborted at:      %10.3f s into the job\n", options.abortAtS);
+    }
+    printf("  loop iterations: %10llu\n", static_cast<unsigned long long>(report.loopIterations));
+    printf("  host time:       %10.3f ms\n", hostUs / 1000.0);
+
+    if (options.printMetrics) {
+        printMetrics();
+    }
+
+    // Checked against the looser arm's limits
+    const MotionConfig &config = options.config;
+    const ProfileRecorder::Limits limits = {
+        std::max(config.maxSpeed[0], config.maxSpeed[1]),
+        std::max(config.acceleration[0], config.acceleration[1]),
+        config.jerk[0] > 0.0f && config.jerk[1] > 0.0f ? std::max(config.jerk[0], config.jerk[1]) : 0.0f
+    };
+    int profileResult = 0;
+    if (options.verifyProfiles) {
+        profileResult = profileRecorder.check(limits);
+    }
+    if (options.profilePlotPath) {
+        if (profileRecorder.writePlot(options.profilePlotPath, PROFILE_PLOT_S, limits)) {
+            printf("\nProfile plot written to %s\n", options.profilePlotPath);
+        } else {
+            fprintf(stderr, "Cannot open %s\n", options.profilePlotPath);
+            profileResult = 1;
+        }
+    }
+
+    int holdResult = 0;
+    if (options.verifyHold) {
+        const bool followed = pathCheck.strays == 0;
+        const bool held = simulatedOperator.holds == options.holdAtS.size() && simulatedOperator.heldViolations == 0;
+        const bool completed = !timedOut && stepperCoordinator.getHomingSequence() == finished;
+
+        printf("\nFeed hold verification (worst %.2f steps off the path)\n", pathCheck.worstSteps);
+        check(followed, "arms stay on the path through every hold");
+        check(held, "every hold stops still with the pen up");
+        check(completed, "job completes after resuming");
+        holdResult = followed && held && completed ? 0 : 1;
+        printf("  %s\n", holdResult == 0 ? "PASSED" : "FAILED");
+    }
+
+    return timedOut ? 1 : profileResult | holdResult;
+}
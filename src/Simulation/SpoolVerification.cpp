@@ -0,0 +1,295 @@
+#include "SpoolVerification.h"
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "SimulationLogger.h"
+#include "VerificationCheck.h"
+
+#include "Job/CompactPathReader.h"
+#include "Job/JobSpool.h"
+
+constexpr static uint32_t COMMAND_MS = 2; // Drawing pace of the stand-in motion task
+constexpr static uint32_t POWER_CUTS = 12;
+
+/** What survives a power cut is the filesystem and NVS, everything in here starts over */
+struct SpoolPlotter {
+    SpooledJob job;
+    FlashWriteGate flashGate;
+    JobSpool spool;
+    bool armsStill = true; // The stand-in motion task's arms, which stop for pen moves and with nothing to draw
+    bool parked = false;
+    uint32_t unparkedWrites = 0; // Checkpoints written while the arms could move
+
+    explicit SpoolPlotter(fs::FS &fs) : spool(fs, job, flashGate) {
+        spool.begin();
+    }
+};
+
+struct SpoolRun {
+    uint32_t startCommand; // Where the run picked the job up
+    std::vector<PathCommand> drawn;
+};
+
+/** Strokes of short moves with travel between them, as a long plot would have */
+static std::vector<uint8_t> makeJob(const uint32_t strokes, const uint32_t movesPerStroke, const uint32_t seed) {
+    std::vector<uint8_t> buffer(CompactPathFormat::HEADER_SIZE + strokes * (movesPerStroke * 5 + 16) + 16);
+    CompactPathEncoder encoder(buffer.data(), buffer.size(), PlotterKinematics::GEOMETRY_HASH);
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> start(-1000, 1000);
+    std::uniform_int_distribution<int> opening(600, 2000);
+    std::uniform_int_distribution<int> step(-6, 6);
+
+    for (uint32_t stroke = 0; stroke < strokes; stroke++) {
+        long a = 0;
+        long b = 0;
+        do {
+            a = start(random);
+            b = a + opening(random);
+        } while (!PlotterKinematics::isReachable(a, b));
+        encoder.add({PathCommand::move, a, b});
+        encoder.add({PathCommand::penDown});
+
+        // Within reach, or JobSpool refuses the job
+        for (uint32_t move = 0; move < movesPerStroke; move++) {
+            long nextA = 0;
+            long nextB = 0;
+            do {
+                nextA = a + step(random);
+                nextB = b + step(random);
+            } while (!PlotterKinematics::isReachable(nextA, nextB));
+            a = nextA;
+            b = nextB;
+            encoder.add({PathCommand::move, a, b});
+        }
+        encoder.add({PathCommand::penUp});
+    }
+
+    buffer.resize(encoder.finish());
+    return buffer;
+}
+
+static std::vector<uint8_t> encodeJob(const std::vector<PathCommand> &commands) {
+    std::vector<uint8_t> buffer(CompactPathFormat::HEADER_SIZE + commands.size() * 12 + 16);
+    CompactPathEncoder encoder(buffer.data(), buffer.size(), PlotterKinematics::GEOMETRY_HASH);
+    for (const PathCommand &command : commands) {
+        encoder.add(command);
+    }
+
+    buffer.resize(encoder.finish());
+    return buffer;
+}
+
+static std::vector<PathCommand> decodeJob(const std::vector<uint8_t> &data) {
+    CompactPathReader reader(data.data(), data.size());
+    std::vector<PathCommand> commands;
+    PathCommand command = {};
+
+    while (reader.peek(command)) {
+        commands.push_back(command);
+        reader.pop();
+    }
+
+    return commands;
+}
+
+static bool sameCommand(const PathCommand &left, const PathCommand &right) {
+    return left.type == right.type && left.a == right.a && left.b == right.b && left.value == right.value;
+}
+
+static JobSpool::UploadResult upload(JobSpool &spool, const std::vector<uint8_t> &data) {
+    spool.beginUpload();
+    // In pieces, as HTTP hands them over
+    for (size_t offset = 0; offset < data.size(); offset += 1436) {
+        spool.writeUpload(data.data() + offset, std::min<size_t>(1436, data.size() - offset));
+    }
+    return spool.finishUpload();
+}
+
+/**
+ * Both tasks in one loop, the network side topping up and checkpointing, the motion side taking a command every
+ * COMMAND_MS unless parked for a flash write, until `untilMs` or until the spool has nothing left to draw.
+ * @return true if it ran out of work rather than time
+ */
+static bool runPlotter(SpoolPlotter &plotter, SpoolRun &run, unsigned long &nowMs, const unsigned long untilMs) {
+    for (; nowMs < untilMs; nowMs++) {
+        const bool idle = plotter.job.getState() == SpooledJob::idle || plotter.job.isFinished();
+        const uint32_t writes = plotter.spool.getCheckpointWrites();
+        plotter.spool.loop(idle, nowMs);
+        plotter.unparkedWrites += plotter.spool.getCheckpointWrites() != writes && !plotter.parked;
+
+        if (plotter.spool.getActiveId() == 0 && !plotter.spool.startNext()) {
+            return true;
+        }
+
+        plotter.parked = plotter.flashGate.hold(plotter.armsStill);
+        if (plotter.parked || nowMs % COMMAND_MS != 0) {
+            continue;
+        }
+
+        PathCommand command = {};
+        const bool available = plotter.job.peek(command);
+        plotter.armsStill = !available || command.type != PathCommand::move;
+        if (available) {
+            run.drawn.push_back(command);
+            plotter.job.pop();
+        }
+    }
+
+    return false;
+}
+
+int runSpoolVerification() {
+    printf("\nSpool verification\n");
+    gSimulationVerbose = false;
+
+    char root[] = "/tmp/spool-XXXXXX";
+    if (!mkdtemp(root)) {
+        printf("  cannot create a directory for the filesystem\n");
+        return 1;
+    }
+    fs::FS fs(root);
+    Preferences::storage().clear();
+
+    bool passed = true;
+    const std::vector<uint8_t> data = makeJob(2000, 50, 1);
+    const std::vector<PathCommand> reference = decodeJob(data);
+
+    auto plotter = std::make_unique<SpoolPlotter>(fs);
+
+    // Only jobs that decode end to end join the queue
+    std::vector<uint8_t> corrupt = data;
+    corrupt[corrupt.size() / 2] ^= 0x10;
+    const JobSpool::UploadResult corruptResult = upload(plotter->spool, corrupt);
+
+    // Nor those that would drive the arms out of reach, here onto each other
+    std::vector<PathCommand> stray = reference;
+    size_t strayIndex = stray.size() / 3;
+    while (stray[strayIndex].type != PathCommand::move) {
+        strayIndex++;
+    }
+    stray[strayIndex].b = stray[strayIndex].a;
+    const JobSpool::UploadResult strayResult = upload(plotter->spool, encodeJob(stray));
+    const WorkspaceCheck &workspace = plotter->spool.getUploadWorkspace();
+    passed &= check(strayResult == JobSpool::unreachableJob && workspace.getViolations() == 1
+                    && workspace.getFirst().command == strayIndex, "upload out of reach refused at its move");
+
+    const JobSpool::UploadResult firstResult = upload(plotter->spool, data);
+    const JobSpool::UploadResult secondResult = upload(plotter->spool, makeJob(20, 10, 2));
+    passed &= check(corruptResult == JobSpool::invalidJob && firstResult == JobSpool::queued
+                    && secondResult == JobSpool::queued && plotter->spool.getQueuedJobs() == 2,
+                    "corrupt upload rejected, two queued");
+
+    // Draw the first job, cutting the power at random moments
+    const unsigned long jobMs = reference.size() * COMMAND_MS;
+    std::mt19937 random(7);
+    std::uniform_int_distribution<unsigned long> cutAfter(1, jobMs / 4);
+
+    std::vector<SpoolRun> runs;
+    unsigned long nowMs = 0;
+    uint32_t writes = 0;
+    uint32_t worstLost = 0;
+    uint64_t totalLost = 0;
+    bool boundaries = true;
+    uint32_t unparkedWrites = 0;
+
+    plotter->spool.startNext();
+    for (uint32_t cut = 0; cut <= POWER_CUTS; cut++) {
+        const uint32_t startCommand = plotter->job.getProgress().commands;
+        runs.push_back({startCommand, {}});
+        SpoolRun &run = runs.back();
+
+        const bool lastRun = cut == POWER_CUTS;
+        // Stops with the first job, the second one is checked below
+        const unsigned long untilMs = lastRun ? nowMs + 2 * jobMs : nowMs + cutAfter(random);
+        while (nowMs < untilMs && plotter->spool.getActiveId() == 1) {
+            runPlotter(*plotter, run, nowMs, nowMs + 1);
+        }
+
+        if (lastRun || plotter->spool.getActiveId() != 1) {
+            break;
+        }
+
+        // Power cut and reboot: the new instance finds the checkpoint and resumes
+        const uint32_t reached = startCommand + run.drawn.size();
+        writes += plotter->spool.getCheckpointWrites();
+        unparkedWrites += plotter->unparkedWrites;
+        plotter = std::make_unique<SpoolPlotter>(fs);
+        plotter->spool.startNext();
+
+        const uint32_t resumed = plotter->job.getProgress().commands;
+        const uint32_t lost = reached - resumed;
+        worstLost = std::max(worstLost, lost);
+        totalLost += lost;
+        boundaries &= resumed <= reached && (resumed == 0 || reference[resumed - 1].type == PathCommand::penUp);
+    }
+    writes += plotter->spool.getCheckpointWrites();
+    unparkedWrites += plotter->unparkedWrites;
+
+    bool matching = true;
+    for (const SpoolRun &run: runs) {
+        for (size_t i = 0; i < run.drawn.size(); i++) {
+            const size_t index = run.startCommand + i;
+            matching &= index < reference.size() && sameCommand(run.drawn[i], reference[index]);
+        }
+    }
+
+    const SpoolRun &last = runs.back();
+    const bool finished = last.startCommand + last.drawn.size() == reference.size();
+    passed &= check(boundaries, "every resume starts at a stroke boundary");
+    passed &= check(matching, "every run draws exactly the job from there");
+    passed &= check(writes > 0 && unparkedWrites == 0, "checkpoints only written with the arms parked");
+    passed &= check(finished && plotter->spool.getActiveId() == 2, "job finished, next one started");
+    passed &= check(!fs.exists("/jobs/00000001.spj") && plotter->spool.getSavedCheckpoint().jobId == 0,
+                    "drawn job deleted, checkpoint cleared");
+
+    // The second job runs to the end and leaves an empty spool
+    SpoolRun second = {0, {}};
+    runPlotter(*plotter, second, nowMs, nowMs + 1000000);
+    passed &= check(plotter->spool.getQueuedJobs() == 0 && plotter->spool.getActiveId() == 0
+                    && second.drawn.size() == 20 * 13, "second job drawn, spool empty");
+
+    // A checkpoint the job doesn't lead to fails the job instead of drawing it somewhere else
+    upload(plotter->spool, data);
+    const uint32_t tamperedId = plotter->spool.getLastId();
+    plotter->spool.startNext();
+    SpoolRun tampered = {0, {}};
+    runPlotter(*plotter, tampered, nowMs, nowMs + 10000);
+
+    JobSpool::Checkpoint checkpoint = plotter->spool.getSavedCheckpoint();
+    checkpoint.progress.a += 1;
+    {
+        Preferences preferences;
+        preferences.begin(SPOOL_NAMESPACE, false);
+        preferences.putBytes(SPOOL_KEY_CHECKPOINT, &checkpoint, sizeof(checkpoint));
+        preferences.end();
+    }
+    plotter = std::make_unique<SpoolPlotter>(fs);
+    plotter->spool.startNext();
+    SpoolRun afterTamper = {checkpoint.progress.commands, {}};
+    runPlotter(*plotter, afterTamper, nowMs, nowMs + 10000);
+
+    char badPath[32];
+    snprintf(badPath, sizeof(badPath), "/jobs/%08lu.bad", static_cast<unsigned long>(tamperedId));
+    passed &= check(checkpoint.jobId == tamperedId && afterTamper.drawn.empty() && fs.exists(badPath),
+                    "mismatched checkpoint fails the job");
+
+    printf("  job:             %10zu commands, %zu bytes, %.1f min at %u ms per command\n", reference.size(),
+           data.size(), jobMs / 60000.0, COMMAND_MS);
+    printf("  power cuts:      %10zu, drawing lost per cut %.0f commands on average, %u at worst\n",
+           runs.size() - 1, runs.size() > 1 ? static_cast<double>(totalLost) / (runs.size() - 1) : 0.0,
+           worstLost);
+    printf("  NVS writes:      %10u, %.0f per hour of drawing (interval %u s)\n", writes,
+           writes / (nowMs / 3600000.0), JobSpool::CHECKPOINT_INTERVAL_MS / 1000);
+
+    Preferences::storage().clear();
+    std::string command = std::string("rm -rf ") + root;
+    if (system(command.c_str()) != 0) {
+        printf("  could not remove %s\n", root);
+    }
+
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#ifndef SPOOL_VERIFICATION_H
+#define SPOOL_VERIFICATION_H
+
+/**
+ * Runs JobSpool and SpooledJob on a host directory and the in-memory NVS, the motion task replaced by a consumer
+ * popping commands at a steady rate: uploads (and rejects corrupt ones), draws a long generated job, cuts the power
+ * at random moments and reboots, and checks every resumed run carries on exactly at its checkpoint, which must be a
+ * stroke boundary. Reports how much drawing each cut lost and how often NVS was written.
+ * @return 0 if every check passed
+ */
+int runSpoolVerification();
+
+#endif //SPOOL_VERIFICATION_H
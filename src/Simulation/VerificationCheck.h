@@ -0,0 +1,12 @@
+#ifndef VERIFICATION_CHECK_H
+#define VERIFICATION_CHECK_H
+
+#include <cstdio>
+
+/** Prints one line of a --verify-* report, the checks of every report lined up in one column */
+inline bool check(const bool condition, const char *what) {
+    printf("  %-52s %s\n", what, condition ? "ok" : "FAILED");
+    return condition;
+}
+
+#endif //VERIFICATION_CHECK_H
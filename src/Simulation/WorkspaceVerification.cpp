@@ -0,0 +1,368 @@
+#include "WorkspaceVerification.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "VerificationCheck.h"
+
+#include "Job/CompactPathReader.h"
+#include "Job/CompiledPath.h"
+#include "Job/GcodeInterpreter.h"
+#include "Job/PathStreamBuffer.h"
+#include "Job/WorkspaceCheck.h"
+#include "StepperMotor/gcode.h"
+
+constexpr static double ARM_LENGTH = 150;
+constexpr static double MIN_DISTANCE = 50;
+constexpr static double MAX_DISTANCE = 290;
+constexpr static double ARM_DEGREES = 100; // Either way of the y axis, as the web slicer limits the arms
+constexpr static double STEPS_PER_DEGREE = 2900.0 / 200.0;
+constexpr static double DEGREES_PER_RADIAN = 180.0 / M_PI;
+
+constexpr static long GRID_LIMIT = 1600; // Joint positions checked, either way of 0
+constexpr static uint32_t SEGMENTS = 20000;
+constexpr static uint32_t BENCH_MOVES = 4000000;
+
+/** The workspace as the web slicer sees it, worked out in double precision from the joint angles */
+static bool referenceReachable(const long a, const long b) {
+    const double degreesA = -a / STEPS_PER_DEGREE;
+    const double degreesB = -b / STEPS_PER_DEGREE;
+    if (std::abs(degreesA) > ARM_DEGREES || std::abs(degreesB) > ARM_DEGREES || degreesA < degreesB) {
+        return false;
+    }
+
+    const double distance = 2 * ARM_LENGTH * std::cos((degreesA - degreesB) / 2 / DEGREES_PER_RADIAN);
+    return distance >= MIN_DISTANCE && distance <= MAX_DISTANCE;
+}
+
+/** Steps (a, b) is outside the joint limits by, 0 if within */
+static long excursion(const long a, const long b) {
+    const long opening = b - a;
+    return std::max({
+        0L, std::labs(a) - PlotterKinematics::ARM_LIMIT_STEPS, std::labs(b) - PlotterKinematics::ARM_LIMIT_STEPS,
+        PlotterKinematics::OPENING_MIN_STEPS - opening, opening - PlotterKinematics::OPENING_MAX_STEPS
+    });
+}
+
+/** Worst excursion along a move, stepped as LinearMove does: the major axis steps, then the minor one if due */
+static long segmentExcursion(const long fromA, const long fromB, const long toA, const long toB) {
+    const long steps[2] = {std::labs(toA - fromA), std::labs(toB - fromB)};
+    const long direction[2] = {toA < fromA ? -1L : 1L, toB < fromB ? -1L : 1L};
+    const uint8_t major = steps[1] > steps[0] ? 1 : 0;
+    const uint8_t minor = 1 - major;
+
+    long position[2] = {fromA, fromB};
+    long error = steps[major] / 2;
+    long worst = 0;
+
+    for (long i = 0; i < steps[major]; i++) {
+        position[major] += direction[major];
+        worst = std::max(worst, excursion(position[0], position[1]));
+
+        error -= steps[minor];
+        if (error < 0) {
+            error += steps[major];
+            position[minor] += direction[minor];
+            worst = std::max(worst, excursion(position[0], position[1]));
+        }
+    }
+
+    return worst;
+}
+
+static std::vector<uint8_t> encode(const std::vector<PathCommand> &commands) {
+    std::vector<uint8_t> buffer(CompactPathFormat::HEADER_SIZE + commands.size() * 12 + 16);
+    CompactPathEncoder encoder(buffer.data(), buffer.size(), PlotterKinematics::GEOMETRY_HASH);
+    for (const PathCommand &command : commands) {
+        encoder.add(command);
+    }
+
+    buffer.resize(encoder.finish());
+    return buffer;
+}
+
+/** Decodes a job as JobSpool does at upload, checking every move */
+static WorkspaceCheck checkJob(const uint8_t *data, const size_t length) {
+    CompactPathReader reader(data, length);
+    WorkspaceCheck workspace;
+    PathCommand command = {};
+
+    while (reader.peek(command)) {
+        workspace.check(command);
+        reader.pop();
+    }
+
+    return workspace;
+}
+
+/** Strokes of short moves wandering about the workspace, `moves` in all */
+static std::vector<PathCommand> makeMoves(const uint32_t moves, const uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<long> joint(-PlotterKinematics::ARM_LIMIT_STEPS,
+                                              PlotterKinematics::ARM_LIMIT_STEPS);
+    std::uniform_int_distribution<int> step(-6, 6);
+    std::vector<PathCommand> commands;
+    commands.reserve(moves + moves / 50 * 2 + 2);
+
+    long a = 0;
+    long b = 0;
+    for (uint32_t move = 0; move < moves; move++) {
+        if (move % 50 == 0) {
+            if (move > 0) {
+                commands.push_back({PathCommand::penUp});
+            }
+            do {
+                a = joint(random);
+                b = joint(random);
+            } while (!PlotterKinematics::isReachable(a, b));
+            commands.push_back({PathCommand::move, a, b});
+            commands.push_back({PathCommand::penDown});
+            continue;
+        }
+
+        long nextA = 0;
+        long nextB = 0;
+        do {
+            nextA = a + step(random);
+            nextB = b + step(random);
+        } while (!PlotterKinematics::isReachable(nextA, nextB));
+        a = nextA;
+        b = nextB;
+        commands.push_back({PathCommand::move, a, b});
+    }
+    commands.push_back({PathCommand::penUp});
+
+    return commands;
+}
+
+/** What feeding a G-code program through GcodeInterpreter drew */
+struct GcodeDrawing {
+    uint32_t unreachable = 0;
+    uint32_t drops = 0;
+    bool penDown = false;
+    bool lifted = false; // Pen lifted part way, then
+    bool droppedAgain = false;
+    long longestDrawn = 0; // Steps of the longer arm, of one move with the pen down
+};
+
+static GcodeDrawing drawGcode(const char *program) {
+    GcodeInterpreter interpreter;
+    GcodeDrawing drawing;
+    const size_t length = strlen(program);
+    size_t fed = 0;
+
+    long atA = 0;
+    long atB = 0;
+    PathCommand command = {};
+    while (fed < length || interpreter.hasCommands()) {
+        fed += interpreter.feed(program + fed, length - fed);
+        if (!interpreter.peek(command)) {
+            continue;
+        }
+
+        if (command.type == PathCommand::move) {
+            if (drawing.penDown) {
+                drawing.longestDrawn = std::max(drawing.longestDrawn,
+                                                std::max(labs(command.a - atA), labs(command.b - atB)));
+            }
+            atA = command.a;
+            atB = command.b;
+        } else if (command.type == PathCommand::penDown || command.type == PathCommand::penUp) {
+            const bool down = command.type == PathCommand::penDown;
+            drawing.lifted |= drawing.penDown && !down && !drawing.droppedAgain;
+            drawing.droppedAgain |= drawing.lifted && down;
+            drawing.drops += down && !drawing.penDown ? 1 : 0;
+            drawing.penDown = down;
+        }
+        interpreter.pop();
+    }
+
+    drawing.unreachable = interpreter.getUnreachableCount();
+    return drawing;
+}
+
+int runWorkspaceVerification() {
+    printf("\nWorkspace verification\n");
+    printf("  arms within %ld steps, %ld to %ld steps apart\n", PlotterKinematics::ARM_LIMIT_STEPS,
+           PlotterKinematics::OPENING_MIN_STEPS, PlotterKinematics::OPENING_MAX_STEPS);
+    bool passed = true;
+
+    // Every joint position around the workspace
+    uint64_t gridPoints = 0;
+    uint64_t gridReachable = 0;
+    uint64_t gridMismatches = 0;
+    for (long a = -GRID_LIMIT; a <= GRID_LIMIT; a++) {
+        for (long b = -GRID_LIMIT; b <= GRID_LIMIT; b++) {
+            const bool reachable = PlotterKinematics::isReachable(a, b);
+            gridPoints++;
+            gridReachable += reachable;
+            gridMismatches += reachable != referenceReachable(a, b);
+        }
+    }
+    printf("  joint grid:      %10llu positions, %llu reachable, %llu mismatches\n",
+           static_cast<unsigned long long>(gridPoints), static_cast<unsigned long long>(gridReachable),
+           static_cast<unsigned long long>(gridMismatches));
+    passed &= check(gridMismatches == 0, "joint limits match the workspace");
+
+    // inverse() rounds each arm on its own, which right at the edge can land a step outside; it refuses those
+    uint32_t solved = 0;
+    uint32_t solvedOutside = 0;
+    uint32_t refusedAtEdge = 0;
+    for (double y = -60; y <= 300; y += 0.25) {
+        for (double x = -300; x <= 300; x += 0.25) {
+            long a = 0;
+            long b = 0;
+            if (PlotterKinematics::inverseMillimetres(static_cast<float>(x), static_cast<float>(y), a, b)) {
+                solved++;
+                solvedOutside += !PlotterKinematics::isReachable(a, b);
+                continue;
+            }
+
+            const double distance = std::hypot(x, y);
+            const double direction = std::atan2(x, y) * DEGREES_PER_RADIAN;
+            const double halfOpening = std::acos(std::min(1.0, distance / (2 * ARM_LENGTH))) * DEGREES_PER_RADIAN;
+            refusedAtEdge += distance >= MIN_DISTANCE && distance <= MAX_DISTANCE
+                    && std::abs(direction) + halfOpening <= ARM_DEGREES;
+        }
+    }
+    printf("  paper grid:      %10u points solved, %u outside the joint limits, %u refused at the edge\n", solved,
+           solvedOutside, refusedAtEdge);
+    passed &= check(solvedOutside == 0 && refusedAtEdge < solved / 1000, "inverse() solves within the joint limits");
+
+    // Moves between reachable positions, across the whole workspace
+    std::mt19937 random(3);
+    std::uniform_int_distribution<long> joint(-PlotterKinematics::ARM_LIMIT_STEPS,
+                                              PlotterKinematics::ARM_LIMIT_STEPS);
+    uint32_t segmentsOutside = 0;
+    long worstExcursion = 0;
+    uint64_t segmentSteps = 0;
+    for (uint32_t segment = 0; segment < SEGMENTS; segment++) {
+        long ends[4] = {};
+        for (uint8_t end = 0; end < 2; end++) {
+            do {
+                ends[2 * end] = joint(random);
+                ends[2 * end + 1] = joint(random);
+            } while (!PlotterKinematics::isReachable(ends[2 * end], ends[2 * end + 1]));
+        }
+
+        const long worst = segmentExcursion(ends[0], ends[1], ends[2], ends[3]);
+        segmentsOutside += worst > 0;
+        worstExcursion = std::max(worstExcursion, worst);
+        segmentSteps += std::max(std::labs(ends[2] - ends[0]), std::labs(ends[3] - ends[1]));
+    }
+    printf("  segments:        %10u, %llu steps, %u touch the edge by %ld step(s)\n", SEGMENTS,
+           static_cast<unsigned long long>(segmentSteps), segmentsOutside, worstExcursion);
+    // Convex in joint space: only the rounding of the minor axis may cross the edge
+    passed &= check(worstExcursion <= 1, "moves stay within a step of the workspace");
+
+    // The bundled jobs
+    uint32_t pathStepsMoves = 0;
+    uint32_t pathStepsOutside = 0;
+    for (int i = 0; i < pathLength; i++) {
+        const PathPoint point = {pathSteps[i][0], pathSteps[i][1]};
+        if (!point.isPenUp()) {
+            pathStepsMoves++;
+            pathStepsOutside += !PlotterKinematics::isReachable(point.a, point.b);
+        }
+    }
+    const WorkspaceCheck compiled = checkJob(compiledJob, sizeof(compiledJob));
+    printf("  bundled jobs:    %10u moves in compiledJob.h, %u in gcode.h\n", compiled.getMoves(), pathStepsMoves);
+    passed &= check(compiled.isValid() && compiled.getMoves() > 0 && pathStepsOutside == 0,
+                    "bundled jobs within reach");
+
+    // A job with a few moves out of reach, each a different way
+    std::vector<PathCommand> stray = makeMoves(1000, 5);
+    const uint32_t strayAt[] = {100, 400, 900};
+    for (const uint32_t index : strayAt) {
+        PathCommand &command = stray[index];
+        command.type = PathCommand::move;
+        if (index == 100) {
+            command.b = command.a + PlotterKinematics::OPENING_MIN_STEPS - 1; // Pen past MAX_DISTANCE
+        } else if (index == 400) {
+            command.b = command.a + PlotterKinematics::OPENING_MAX_STEPS + 1; // Pen inside MIN_DISTANCE
+        } else {
+            command.a = -PlotterKinematics::ARM_LIMIT_STEPS - 1; // Arm past its range
+        }
+    }
+    const std::vector<uint8_t> strayJob = encode(stray);
+    const WorkspaceCheck strayCheck = checkJob(strayJob.data(), strayJob.size());
+    printf("  stray job:       %10u of %u moves out of reach, first at command %u\n", strayCheck.getViolations(),
+           strayCheck.getMoves(), strayCheck.getFirst().command);
+    passed &= check(strayCheck.getViolations() == 3 && strayCheck.getFirst().command == strayAt[0]
+                    && strayCheck.getFirst().a == stray[strayAt[0]].a
+                    && strayCheck.getFirst().b == stray[strayAt[0]].b, "moves out of reach reported");
+
+    // Streamed: the point out of reach becomes a pen lift, the pen drops again at the next one
+    PathStreamBuffer stream;
+    stream.begin();
+    stream.receive(PathStreamBuffer::MAGIC, sizeof(PathStreamBuffer::MAGIC));
+    stream.takeCredits();
+    const PathPoint streamed[] = {{500, -500}, {0, 0}, {520, -480}, {-32768, -32768}};
+    for (const PathPoint &point : streamed) {
+        const uint8_t record[4] = {
+            static_cast<uint8_t>(point.b), static_cast<uint8_t>(point.b >> 8),
+            static_cast<uint8_t>(point.a), static_cast<uint8_t>(point.a >> 8)
+        };
+        stream.receive(record, sizeof(record));
+    }
+
+    const PathCommand::Type expected[] = {
+        PathCommand::move, PathCommand::penDown, PathCommand::penUp, PathCommand::move, PathCommand::penDown
+    };
+    bool sequence = true;
+    size_t commands = 0;
+    PathCommand command = {};
+    while (stream.peek(command)) {
+        sequence &= commands < sizeof(expected) / sizeof(expected[0]) && command.type == expected[commands];
+        commands++;
+        stream.pop();
+    }
+    passed &= check(sequence && commands == sizeof(expected) / sizeof(expected[0])
+                    && stream.getUnreachablePoints() == 1, "streamed point out of reach skipped pen up");
+
+    // G-code: a line through the unreachable middle is drawn up to it, crossed pen up and drawn on after it
+    const GcodeDrawing crossing = drawGcode("G0 X-16 Y50\nM3\nG1 X16 Y50 F3000\nM5\n");
+    printf("  G-code:          %10u segments out of reach, longest drawn move %ld steps\n", crossing.unreachable,
+           crossing.longestDrawn);
+    passed &= check(crossing.unreachable > 0 && crossing.lifted && crossing.droppedAgain && !crossing.penDown
+                    && crossing.longestDrawn < 100, "G-code out of reach crossed pen up");
+
+    // Pen lowered after a travel out of reach: it drops where the next line comes into reach, not where the arms
+    // were left
+    const GcodeDrawing travel = drawGcode("G0 X-16 Y50\nG0 X0 Y30\nM3\nG1 X16 Y50 F3000\nM5\n");
+    printf("  G-code travel:   %10u segments out of reach, longest drawn move %ld steps\n", travel.unreachable,
+           travel.longestDrawn);
+    passed &= check(travel.unreachable > 0 && travel.drops == 1 && !travel.penDown && travel.longestDrawn > 0
+                    && travel.longestDrawn < 100, "G-code pen down out of reach waits");
+
+    // Millions of moves: decoded and checked as an upload, and checked alone
+    const std::vector<PathCommand> bench = makeMoves(BENCH_MOVES, 9);
+    const std::vector<uint8_t> benchJob = encode(bench);
+
+    const auto decodeStart = std::chrono::steady_clock::now();
+    const WorkspaceCheck benchCheck = checkJob(benchJob.data(), benchJob.size());
+    const double decodeSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+
+    WorkspaceCheck alone;
+    const auto checkStart = std::chrono::steady_clock::now();
+    for (const PathCommand &benchCommand : bench) {
+        alone.check(benchCommand);
+    }
+    const double checkSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - checkStart).count();
+
+    printf("  %u moves, %zu bytes: decoded and checked in %.1f ms, checked alone in %.1f ms (%.0f M moves/s)\n",
+           benchCheck.getMoves(), benchJob.size(), decodeSeconds * 1000.0, checkSeconds * 1000.0,
+           alone.getMoves() / checkSeconds / 1e6);
+    passed &= check(benchCheck.isValid() && alone.isValid() && benchCheck.getMoves() == BENCH_MOVES
+                    && decodeSeconds < 1.0, "millions of moves checked in under a second");
+
+    printf("  %s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+#ifndef WORKSPACE_VERIFICATION_H
+#define WORKSPACE_VERIFICATION_H
+
+/**
+ * Checks PlotterKinematics::isReachable() against the workspace worked out in double precision for every joint
+ * position, that inverse() never solves to a position it rejects, that moves between reachable positions stay
+ * reachable step by step, and that jobs out of reach are caught where they come in: an upload by WorkspaceCheck,
+ * a streamed point by PathStreamBuffer, G-code by GcodeInterpreter lifting the pen over it. Then times
+ * WorkspaceCheck over a job of millions of moves.
+ * @return 0 if every check passed
+ */
+int runWorkspaceVerification();
+
+#endif //WORKSPACE_VERIFICATION_H
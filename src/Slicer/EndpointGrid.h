@@ -0,0 +1,194 @@
+#ifndef ENDPOINT_GRID_H
+#define ENDPOINT_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "SlicedJob.h"
+
+/**
+ * Uniform grid over joint-space points for nearest-neighbour queries by JointPoint::distanceTo. Cells are
+ * scanned in square rings around the query, which is exactly the shape of that distance, and the scan stops
+ * as soon as the next ring can't hold anything closer. Points can be removed, e.g. once their stroke is placed.
+ */
+class EndpointGrid {
+    std::vector<JointPoint> points;
+    std::vector<bool> alive;
+    size_t aliveCount = 0;
+
+    long originA = 0;
+    long originB = 0;
+    long cellSize = 1;
+    long columns = 1;
+    long rows = 1;
+
+    // Point ids sorted by cell, cell i holding entries[cellStart[i]] up to entries[cellStart[i + 1]]
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> entries;
+    std::vector<uint32_t> aliveInCell;
+
+    long column(const long a) const {
+        return static_cast<long>(floor(static_cast<double>(a - originA) / cellSize));
+    }
+
+    long row(const long b) const {
+        return static_cast<long>(floor(static_cast<double>(b - originB) / cellSize));
+    }
+
+    size_t cellOf(const JointPoint &point) const {
+        return row(point.b) * columns + column(point.a);
+    }
+
+    /** Keeps found sorted by (distance, id) and at most count long */
+    static void offer(std::vector<std::pair<long, uint32_t> > &found, const size_t count, const long distance,
+                      const uint32_t id) {
+        const std::pair<long, uint32_t> candidate = {distance, id};
+        if (found.size() == count && !(candidate < found.back())) {
+            return;
+        }
+
+        found.insert(std::upper_bound(found.begin(), found.end(), candidate), candidate);
+        if (found.size() > count) {
+            found.pop_back();
+        }
+    }
+
+    void scanCell(const long x, const long y, const JointPoint &query, const size_t count, const long excluded,
+                  std::vector<std::pair<long, uint32_t> > &found) const {
+        const size_t cell = y * columns + x;
+        if (aliveInCell[cell] == 0) {
+            return;
+        }
+
+        for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+            const uint32_t id = entries[i];
+            if (alive[id] && static_cast<long>(id) != excluded) {
+                offer(found, count, query.distanceTo(points[id]), id);
+            }
+        }
+    }
+
+    /** Spreads the points still alive over a grid sized for them */
+    void build() {
+        std::vector<uint32_t> ids;
+        for (uint32_t id = 0; id < points.size(); id++) {
+            if (alive[id]) {
+                ids.push_back(id);
+            }
+        }
+
+        aliveCount = ids.size();
+        if (ids.empty()) {
+            columns = rows = 1;
+            cellStart.assign(2, 0);
+            aliveInCell.assign(1, 0);
+            entries.clear();
+            return;
+        }
+
+        long maxA = points[ids[0]].a;
+        long maxB = points[ids[0]].b;
+        originA = maxA;
+        originB = maxB;
+        for (const uint32_t id : ids) {
+            originA = std::min(originA, points[id].a);
+            originB = std::min(originB, points[id].b);
+            maxA = std::max(maxA, points[id].a);
+            maxB = std::max(maxB, points[id].b);
+        }
+
+        // About two points per cell
+        const double area = static_cast<double>(maxA - originA + 1) * (maxB - originB + 1);
+        cellSize = std::max(1L, static_cast<long>(ceil(sqrt(2.0 * area / ids.size()))));
+        columns = (maxA - originA) / cellSize + 1;
+        rows = (maxB - originB) / cellSize + 1;
+
+        const size_t cells = columns * rows;
+        cellStart.assign(cells + 1, 0);
+        aliveInCell.assign(cells, 0);
+        for (const uint32_t id : ids) {
+            aliveInCell[cellOf(points[id])]++;
+        }
+
+        for (size_t cell = 0; cell < cells; cell++) {
+            cellStart[cell + 1] = cellStart[cell] + aliveInCell[cell];
+        }
+
+        std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+        entries.resize(ids.size());
+        for (const uint32_t id : ids) {
+            entries[fill[cellOf(points[id])]++] = id;
+        }
+    }
+
+public:
+    explicit EndpointGrid(const std::vector<JointPoint> &gridPoints)
+        : points(gridPoints), alive(points.size(), true) {
+        build();
+    }
+
+    void remove(const uint32_t id) {
+        if (!alive[id]) {
+            return;
+        }
+
+        alive[id] = false;
+        aliveCount--;
+        aliveInCell[cellOf(points[id])]--;
+
+        // Mostly empty cells make queries scan far, a denser grid keeps them local
+        if (entries.size() > 64 && aliveCount * 4 < entries.size()) {
+            build();
+        }
+    }
+
+    /**
+     * Up to count points closest to query that are still in the grid, nearest first.
+     * @param excluded id to leave out, e.g. the query point itself, -1 for none
+     */
+    void nearest(const JointPoint &query, const size_t count, std::vector<uint32_t> &result,
+                 const long excluded = -1) const {
+        std::vector<std::pair<long, uint32_t> > found;
+        found.reserve(count + 1);
+
+        const long x = column(query.a);
+        const long y = row(query.b);
+        const long lastRing = std::max(std::max(labs(x), labs(x - columns + 1)),
+                                       std::max(labs(y), labs(y - rows + 1)));
+
+        for (long ring = 0; ring <= lastRing; ring++) {
+            // Nothing in this ring is closer than this
+            if (found.size() == count && found.back().first < (ring - 1) * cellSize + 1) {
+                break;
+            }
+
+            const long firstColumn = std::max(0L, x - ring);
+            const long endColumn = std::min(columns - 1, x + ring);
+
+            for (long cellY = std::max(0L, y - ring); cellY <= std::min(rows - 1, y + ring); cellY++) {
+                if (labs(cellY - y) == ring) {
+                    for (long cellX = firstColumn; cellX <= endColumn; cellX++) {
+                        scanCell(cellX, cellY, query, count, excluded, found);
+                    }
+                    continue;
+                }
+
+                if (x - ring >= 0 && x - ring < columns) {
+                    scanCell(x - ring, cellY, query, count, excluded, found);
+                }
+                if (ring > 0 && x + ring >= 0 && x + ring < columns) {
+                    scanCell(x + ring, cellY, query, count, excluded, found);
+                }
+            }
+        }
+
+        result.clear();
+        for (const std::pair<long, uint32_t> &entry : found) {
+            result.push_back(entry.second);
+        }
+    }
+};
+
+#endif //ENDPOINT_GRID_H
@@ -0,0 +1,132 @@
+#ifndef ORDERED_BATCHES_H
+#define ORDERED_BATCHES_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Runs `work` on batches across worker threads and hands the results back in the order the batches came in, so
+ * what comes out doesn't depend on the thread count. At most two batches per thread are in flight: submit() waits
+ * for the oldest one past that, which keeps a fast reader from queueing up the whole input. With one thread the
+ * work runs on the caller's.
+ */
+template<typename Batch, typename Result>
+class OrderedBatches {
+public:
+    using Work = std::function<void(Batch &, Result &)>;
+    using Take = std::function<void(Result &)>;
+
+private:
+    struct Slot {
+        Batch batch;
+        Result result;
+        bool done = false;
+    };
+
+    Work work;
+    Take take;
+    size_t maxInFlight;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::unique_ptr<Slot> > inFlight; // Submission order
+    std::deque<Slot *> waiting; // Not picked up by a worker yet
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void runWorker() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return stopping || !waiting.empty(); });
+            if (waiting.empty()) {
+                return;
+            }
+
+            Slot *slot = waiting.front();
+            waiting.pop_front();
+
+            lock.unlock();
+            work(slot->batch, slot->result);
+            lock.lock();
+
+            slot->done = true;
+            changed.notify_all();
+        }
+    }
+
+    /** Hands over finished results from the front, waiting until no more than `limit` are in flight */
+    void takeFinished(const size_t limit) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!inFlight.empty()) {
+            if (!inFlight.front()->done) {
+                if (inFlight.size() <= limit) {
+                    return;
+                }
+                changed.wait(lock, [this] { return inFlight.front()->done; });
+            }
+
+            std::unique_ptr<Slot> slot = std::move(inFlight.front());
+            inFlight.pop_front();
+
+            // The front is only ever taken here, so the result can go out without the lock
+            lock.unlock();
+            take(slot->result);
+            lock.lock();
+        }
+    }
+
+public:
+    OrderedBatches(const unsigned threads, Work work, Take take)
+        : work(std::move(work)), take(std::move(take)), maxInFlight(2 * static_cast<size_t>(threads)) {
+        for (unsigned i = 0; threads > 1 && i < threads; i++) {
+            workers.emplace_back(&OrderedBatches::runWorker, this);
+        }
+    }
+
+    ~OrderedBatches() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    OrderedBatches(const OrderedBatches &) = delete;
+    OrderedBatches &operator=(const OrderedBatches &) = delete;
+
+    void submit(Batch &&batch) {
+        if (workers.empty()) {
+            Result result;
+            work(batch, result);
+            take(result);
+            return;
+        }
+
+        std::unique_ptr<Slot> slot(new Slot{std::move(batch), Result(), false});
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            waiting.push_back(slot.get());
+            inFlight.push_back(std::move(slot));
+        }
+        changed.notify_all();
+
+        takeFinished(maxInFlight - 1);
+    }
+
+    /** Waits for every batch submitted and hands over the rest of the results */
+    void finish() {
+        takeFinished(0);
+    }
+};
+
+#endif //ORDERED_BATCHES_H
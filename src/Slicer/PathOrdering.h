@@ -0,0 +1,225 @@
+#ifndef PATH_ORDERING_H
+#define PATH_ORDERING_H
+
+#include <algorithm>
+#include <vector>
+
+#include "EndpointGrid.h"
+#include "TravelModel.h"
+
+/**
+ * Reorders and reverses strokes to cut pen-up travel: a greedy nearest-neighbour tour from the start position,
+ * then 2-opt moves limited to each endpoint's nearest neighbours, so both stay close to linear in the stroke
+ * count. Costs are TravelModel times, i.e. joint-space, because equal Cartesian gaps take very different
+ * times depending on where the arms are. Strokes that end up (nearly) touching are merged into one.
+ */
+class PathOrdering {
+public:
+    struct Report {
+        size_t strokesBefore = 0;
+        size_t strokesAfter = 0;
+        float travelSecondsBefore = 0.0;
+        float travelSecondsAfter = 0.0;
+        uint32_t improvements = 0; // 2-opt moves applied
+    };
+
+private:
+    constexpr static size_t NEIGHBOURS = 8;
+    constexpr static uint8_t MAX_PASSES = 20;
+
+    /** A stroke's place in the tour; reversed strokes are drawn from their last point */
+    struct Visit {
+        uint32_t stroke;
+        bool reversed;
+    };
+
+    const TravelModel &model;
+    JointPoint startPosition;
+
+    // Stroke i starts at endpoints[2i] and ends at endpoints[2i + 1]
+    std::vector<JointPoint> endpoints;
+    std::vector<Visit> tour;
+    std::vector<uint32_t> slotOf;
+
+    uint32_t entryOf(const size_t slot) const {
+        return 2 * tour[slot].stroke + tour[slot].reversed;
+    }
+
+    uint32_t exitOf(const size_t slot) const {
+        return 2 * tour[slot].stroke + !tour[slot].reversed;
+    }
+
+    /** Where the pen is before slot is drawn */
+    const JointPoint &before(const size_t slot) const {
+        return slot == 0 ? startPosition : endpoints[exitOf(slot - 1)];
+    }
+
+    float cost(const JointPoint &from, const JointPoint &to) const {
+        return model.seconds(from, to);
+    }
+
+    void buildGreedyTour() {
+        EndpointGrid grid(endpoints);
+        std::vector<uint32_t> nearest;
+        JointPoint position = startPosition;
+
+        while (tour.size() < endpoints.size() / 2) {
+            grid.nearest(position, 1, nearest);
+            const uint32_t endpoint = nearest[0];
+            const uint32_t stroke = endpoint / 2;
+
+            grid.remove(2 * stroke);
+            grid.remove(2 * stroke + 1);
+            tour.push_back({stroke, (endpoint & 1) != 0});
+            position = endpoints[exitOf(tour.size() - 1)];
+        }
+    }
+
+    /** Draws slots first to last in the opposite order and direction */
+    void reverse(size_t first, size_t last) {
+        while (first < last) {
+            std::swap(tour[first], tour[last]);
+            flip(first++);
+            flip(last--);
+        }
+
+        if (first == last) {
+            flip(first);
+        }
+    }
+
+    void flip(const size_t slot) {
+        tour[slot].reversed = !tour[slot].reversed;
+        slotOf[tour[slot].stroke] = slot;
+    }
+
+    /**
+     * Gain of reversing slots first to last, which replaces the travel into first and out of last with travel
+     * from before first to last's exit and from first's entry to after last. Travel costs are symmetric, so
+     * the travel inside the reversed run doesn't change.
+     */
+    float reversalGain(const size_t first, const size_t last) const {
+        const JointPoint &from = before(first);
+        float gain = cost(from, endpoints[entryOf(first)]) - cost(from, endpoints[exitOf(last)]);
+
+        if (last + 1 < tour.size()) {
+            const JointPoint &to = endpoints[entryOf(last + 1)];
+            gain += cost(endpoints[exitOf(last)], to) - cost(endpoints[entryOf(first)], to);
+        }
+
+        return gain;
+    }
+
+    /** 2-opt, trying only reversals that create travel to one of an endpoint's nearest neighbours */
+    uint32_t improveTour() {
+        EndpointGrid grid(endpoints);
+        std::vector<std::vector<uint32_t> > neighbours(endpoints.size());
+        for (uint32_t endpoint = 0; endpoint < endpoints.size(); endpoint++) {
+            grid.nearest(endpoints[endpoint], NEIGHBOURS, neighbours[endpoint], endpoint);
+        }
+
+        std::vector<uint32_t> startNeighbours;
+        grid.nearest(startPosition, NEIGHBOURS, startNeighbours);
+
+        uint32_t improvements = 0;
+        for (uint8_t pass = 0; pass < MAX_PASSES; pass++) {
+            uint32_t passImprovements = 0;
+
+            for (size_t slot = 0; slot < tour.size(); slot++) {
+                // New travel from before slot to the exit of a later one
+                const std::vector<uint32_t> &candidates = slot == 0 ? startNeighbours : neighbours[exitOf(slot - 1)];
+                for (const uint32_t endpoint : candidates) {
+                    const size_t last = slotOf[endpoint / 2];
+                    if (last >= slot && exitOf(last) == endpoint && reversalGain(slot, last) > 1e-4f) {
+                        reverse(slot, last);
+                        passImprovements++;
+                        break;
+                    }
+                }
+
+                // New travel from the entry of an earlier slot to after this one
+                if (slot + 1 < tour.size()) {
+                    for (const uint32_t endpoint : neighbours[entryOf(slot + 1)]) {
+                        const size_t first = slotOf[endpoint / 2];
+                        if (first <= slot && entryOf(first) == endpoint && reversalGain(first, slot) > 1e-4f) {
+                            reverse(first, slot);
+                            passImprovements++;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            improvements += passImprovements;
+            if (passImprovements == 0) {
+                break;
+            }
+        }
+
+        return improvements;
+    }
+
+    /** Travel and pen lifts, one per stroke, to draw strokes in the given order */
+    float travelSeconds(const std::vector<Stroke> &strokes) const {
+        float seconds = 0.0;
+        JointPoint position = startPosition;
+        for (const Stroke &stroke : strokes) {
+            seconds += model.moveSeconds(position.distanceTo(stroke.start())) + model.penLiftSeconds;
+            position = stroke.end();
+        }
+        return seconds;
+    }
+
+public:
+    explicit PathOrdering(const TravelModel &model, const JointPoint startPosition = {0, 0})
+        : model(model), startPosition(startPosition) {
+    }
+
+    Report run(SlicedJob &job) {
+        Report report;
+        std::vector<Stroke> &strokes = job.strokes;
+        report.strokesBefore = strokes.size();
+        report.travelSecondsBefore = travelSeconds(strokes);
+
+        endpoints.clear();
+        for (const Stroke &stroke : strokes) {
+            endpoints.push_back(stroke.start());
+            endpoints.push_back(stroke.end());
+        }
+
+        tour.clear();
+        buildGreedyTour();
+        slotOf.assign(strokes.size(), 0);
+        for (size_t slot = 0; slot < tour.size(); slot++) {
+            slotOf[tour[slot].stroke] = slot;
+        }
+        report.improvements = improveTour();
+
+        // Lay the strokes out in tour order, drawing through the joins
+        std::vector<Stroke> ordered;
+        ordered.reserve(strokes.size());
+        for (const Visit &visit : tour) {
+            Stroke &stroke = strokes[visit.stroke];
+            if (visit.reversed) {
+                std::reverse(stroke.points.begin(), stroke.points.end());
+            }
+
+            if (!ordered.empty() && ordered.back().speedLimit == stroke.speedLimit
+                && model.joins(ordered.back().end().distanceTo(stroke.start()))) {
+                std::vector<JointPoint> &points = ordered.back().points;
+                const bool sameStart = points.back() == stroke.start();
+                points.insert(points.end(), stroke.points.begin() + sameStart, stroke.points.end());
+                continue;
+            }
+
+            ordered.push_back(std::move(stroke));
+        }
+
+        strokes = std::move(ordered);
+        report.strokesAfter = strokes.size();
+        report.travelSecondsAfter = travelSeconds(strokes);
+        return report;
+    }
+};
+
+#endif //PATH_ORDERING_H
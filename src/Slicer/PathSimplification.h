@@ -0,0 +1,224 @@
+#ifndef PATH_SIMPLIFICATION_H
+#define PATH_SIMPLIFICATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "SlicedJob.h"
+
+/**
+ * Drops stroke points the pen wouldn't miss, Ramer-Douglas-Peucker style. The arms interpolate linearly in
+ * joint space, so the pen follows a curve, not a chord, between two kept points; a point may go only if the
+ * pen still passes within the tolerance of it, measured on paper after forward kinematics. Segment midpoints
+ * of the original stroke are checked too, so the stroke's curves between its points are held to it as well.
+ *
+ * Every point and midpoint is put on paper once per stroke. The pen's path between two kept points is sampled
+ * once per range checked, as finely as its bow needs, and the points are measured against the chords of it.
+ */
+class PathSimplification {
+public:
+    struct Report {
+        size_t pointsBefore = 0;
+        size_t pointsAfter = 0;
+        double maxErrorMillimetres = 0.0; // Largest deviation of a dropped point
+    };
+
+private:
+    constexpr static double SEARCH_WINDOW_STEPS = 8.0; // Either side of where a point projects onto the chord
+    constexpr static double SAMPLING_SHARE = 0.05; // Of the tolerance, what sampling the pen's path may cut off
+    constexpr static uint16_t MAX_SAMPLES = 256;
+
+    double tolerance;
+
+    struct Position {
+        double x;
+        double y;
+    };
+
+    /** Paper positions of a stroke's points and of the midpoints between them, each worked out once */
+    struct StrokeGeometry {
+        std::vector<Position> points;
+        std::vector<Position> midpoints;
+    };
+
+    /** The pen's path between two points as chords between spots on it, and how far it may stray from them */
+    struct SampledPath {
+        JointPoint from;
+        JointPoint to;
+        std::vector<Position> samples; // Evenly spaced in joint space, ends included
+        double slack;
+    };
+
+    static Position toPaper(const double a, const double b) {
+        Position position = {};
+        PlotterKinematics::forwardExact(a, b, position.x, position.y);
+        return position;
+    }
+
+    static double segmentDistance(const Position &point, const Position &start, const Position &end) {
+        const double dx = end.x - start.x;
+        const double dy = end.y - start.y;
+        const double lengthSquared = dx * dx + dy * dy;
+        double t = lengthSquared > 0 ? ((point.x - start.x) * dx + (point.y - start.y) * dy) / lengthSquared : 0.0;
+        t = std::min(1.0, std::max(0.0, t));
+        return std::hypot(start.x + t * dx - point.x, start.y + t * dy - point.y);
+    }
+
+    /**
+     * Samples the pen's path from `from` to `to` finely enough for the tolerance. A path that bows b off its
+     * chord at the middle strays about b / n^2 from n even chords of it; twice that is taken as the slack. A
+     * chord shorter than the tolerance is taken as it is, the path can't bow off it by any measurable amount.
+     */
+    void samplePath(const JointPoint &from, const Position &fromPosition, const JointPoint &to,
+                    const Position &toPosition, SampledPath &path) const {
+        path.from = from;
+        path.to = to;
+        path.samples.assign({fromPosition});
+        path.slack = 0.0;
+
+        if (std::hypot(toPosition.x - fromPosition.x, toPosition.y - fromPosition.y) >= tolerance) {
+            const Position middle = toPaper((from.a + to.a) / 2.0, (from.b + to.b) / 2.0);
+            const double bow = segmentDistance(middle, fromPosition, toPosition);
+            const uint16_t pieces = static_cast<uint16_t>(std::min<double>(
+                MAX_SAMPLES, std::max(1.0, ceil(std::sqrt(2.0 * bow / (SAMPLING_SHARE * tolerance))))));
+
+            for (uint16_t i = 1; i < pieces; i++) {
+                const double t = static_cast<double>(i) / pieces;
+                path.samples.push_back(pieces == 2 * i ? middle
+                                                       : toPaper(from.a + t * (to.a - from.a),
+                                                                 from.b + t * (to.b - from.b)));
+            }
+            path.slack = 2.0 * bow / (static_cast<double>(pieces) * pieces);
+        }
+
+        path.samples.push_back(toPosition);
+    }
+
+    /**
+     * Distance on paper from `position`, at joint position (a, b), to the pen's path: to the sampled chords near
+     * where the point projects onto the joint-space chord, plus the slack. Never less than the true distance.
+     */
+    static double deviation(const SampledPath &path, const double a, const double b, const Position &position) {
+        const double chordA = path.to.a - path.from.a;
+        const double chordB = path.to.b - path.from.b;
+        const double chordSquared = chordA * chordA + chordB * chordB;
+        const size_t pieces = path.samples.size() - 1;
+
+        if (chordSquared == 0) {
+            return std::hypot(position.x - path.samples.front().x, position.y - path.samples.front().y);
+        }
+
+        const double projected = ((a - path.from.a) * chordA + (b - path.from.b) * chordB) / chordSquared;
+        const double window = SEARCH_WINDOW_STEPS / std::sqrt(chordSquared);
+        const double low = std::min(1.0, std::max(0.0, projected - window));
+        const double high = std::min(1.0, std::max(0.0, projected + window));
+        const size_t first = std::min(pieces - 1, static_cast<size_t>(low * pieces));
+        const size_t last = std::min(pieces - 1, static_cast<size_t>(high * pieces));
+
+        double distance = std::numeric_limits<double>::max();
+        for (size_t i = first; i <= last; i++) {
+            distance = std::min(distance, segmentDistance(position, path.samples[i], path.samples[i + 1]));
+        }
+
+        return distance + path.slack;
+    }
+
+    /**
+     * Worst deviation of points first + 1 .. last - 1, and of the midpoints of the segments between them.
+     * @param worst index of the point to split at if it's too much
+     */
+    double maxDeviation(const std::vector<JointPoint> &points, const StrokeGeometry &geometry, const size_t first,
+                        const size_t last, SampledPath &path, size_t &worst) const {
+        samplePath(points[first], geometry.points[first], points[last], geometry.points[last], path);
+        double maxError = -1.0;
+        worst = first + 1;
+
+        for (size_t i = first; i < last; i++) {
+            const double midpointError = deviation(path, (points[i].a + points[i + 1].a) / 2.0,
+                                                   (points[i].b + points[i + 1].b) / 2.0, geometry.midpoints[i]);
+            if (midpointError > maxError) {
+                maxError = midpointError;
+                worst = i == first ? i + 1 : i;
+            }
+
+            if (i > first) {
+                const double pointError = deviation(path, points[i].a, points[i].b, geometry.points[i]);
+                if (pointError > maxError) {
+                    maxError = pointError;
+                    worst = i;
+                }
+            }
+        }
+
+        return maxError;
+    }
+
+    void simplify(std::vector<JointPoint> &points, Report &report) const {
+        if (points.size() < 3) {
+            return;
+        }
+
+        StrokeGeometry geometry;
+        geometry.points.reserve(points.size());
+        geometry.midpoints.reserve(points.size() - 1);
+        for (size_t i = 0; i < points.size(); i++) {
+            geometry.points.push_back(toPaper(points[i].a, points[i].b));
+            if (i + 1 < points.size()) {
+                geometry.midpoints.push_back(toPaper((points[i].a + points[i + 1].a) / 2.0,
+                                                     (points[i].b + points[i + 1].b) / 2.0));
+            }
+        }
+
+        std::vector<bool> keep(points.size(), false);
+        keep.front() = keep.back() = true;
+        SampledPath path;
+
+        // Ranges still to check, with a stack so long strokes can't run out of call depth
+        std::vector<std::pair<size_t, size_t> > pending = {{0, points.size() - 1}};
+        while (!pending.empty()) {
+            const std::pair<size_t, size_t> range = pending.back();
+            pending.pop_back();
+            if (range.second - range.first < 2) {
+                continue;
+            }
+
+            size_t worst = 0;
+            const double error = maxDeviation(points, geometry, range.first, range.second, path, worst);
+            if (error > tolerance) {
+                keep[worst] = true;
+                pending.push_back({range.first, worst});
+                pending.push_back({worst, range.second});
+            } else {
+                report.maxErrorMillimetres = std::max(report.maxErrorMillimetres, error);
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < points.size(); i++) {
+            if (keep[i]) {
+                points[kept++] = points[i];
+            }
+        }
+        points.resize(kept);
+    }
+
+public:
+    explicit PathSimplification(const double toleranceMillimetres) : tolerance(toleranceMillimetres) {
+    }
+
+    Report run(SlicedJob &job) const {
+        Report report;
+        report.pointsBefore = job.pointCount();
+
+        for (Stroke &stroke : job.strokes) {
+            simplify(stroke.points, report);
+        }
+
+        report.pointsAfter = job.pointCount();
+        return report;
+    }
+};
+
+#endif //PATH_SIMPLIFICATION_H
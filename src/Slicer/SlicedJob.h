@@ -0,0 +1,136 @@
+#ifndef SLICED_JOB_H
+#define SLICED_JOB_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "Job/CompactPathDecoder.h"
+#include "Kinematics/RhombusKinematics.h"
+
+/** Joint-space position in motor steps, firmware order */
+struct JointPoint {
+    long a;
+    long b;
+
+    bool operator==(const JointPoint &other) const {
+        return a == other.a && b == other.b;
+    }
+
+    /** Steps the busier motor has to make, which is what a coordinated move's duration depends on */
+    long distanceTo(const JointPoint &other) const {
+        return std::max(labs(a - other.a), labs(b - other.b));
+    }
+};
+
+/** One pen-down polyline: the pen drops at the first point and lifts after the last */
+struct Stroke {
+    std::vector<JointPoint> points;
+    float speedLimit = 0.0; // Path speed limit of its moves, 0 if none
+
+    const JointPoint &start() const {
+        return points.front();
+    }
+
+    const JointPoint &end() const {
+        return points.back();
+    }
+};
+
+/** A job as the slicer stages work on it: strokes in drawing order, travel between them implied */
+struct SlicedJob {
+    std::vector<Stroke> strokes;
+    uint32_t droppedCommands = 0; // Dwell and home records, which the slicer doesn't carry
+
+    size_t pointCount() const {
+        size_t count = 0;
+        for (const Stroke &stroke : strokes) {
+            count += stroke.points.size();
+        }
+        return count;
+    }
+
+    /**
+     * Splits a CompactPathFormat job into strokes.
+     * @return CompactPathDecoder::none, or why the job was refused
+     */
+    CompactPathDecoder::Error read(const uint8_t *data, const size_t length) {
+        CompactPathDecoder decoder(PlotterKinematics::GEOMETRY_HASH);
+        JointPoint position = {0, 0};
+        bool penDown = false;
+        size_t offset = 0;
+
+        strokes.clear();
+        droppedCommands = 0;
+
+        while (true) {
+            offset += decoder.feed(data + offset, length - offset);
+            if (!decoder.hasCommand()) {
+                if (offset == length) {
+                    decoder.end();
+                }
+                if (decoder.getState() == CompactPathDecoder::finished) {
+                    return CompactPathDecoder::none;
+                }
+                if (decoder.getState() == CompactPathDecoder::failed) {
+                    return decoder.getError();
+                }
+                continue;
+            }
+
+            const PathCommand command = decoder.getCommand();
+            decoder.takeCommand();
+
+            switch (command.type) {
+                case PathCommand::move:
+                    position = {command.a, command.b};
+                    if (penDown) {
+                        strokes.back().points.push_back(position);
+                    }
+                    break;
+                case PathCommand::penDown:
+                    if (!penDown) {
+                        strokes.push_back({{position}, 0.0});
+                    }
+                    penDown = true;
+                    break;
+                case PathCommand::penUp:
+                    penDown = false;
+                    break;
+                default:
+                    droppedCommands++;
+            }
+
+            // The speed a stroke is drawn at is the one of its first drawing move
+            if (penDown && command.type == PathCommand::move && strokes.back().points.size() == 2) {
+                strokes.back().speedLimit = command.value;
+            }
+        }
+    }
+
+    /**
+     * Writes the strokes as a CompactPathFormat job, in the shape the web slicer writes: pen up, travel to the
+     * first point, pen down, draw.
+     */
+    std::vector<uint8_t> write() const {
+        // Worst case per record: opcode and two five-byte varints
+        std::vector<uint8_t> buffer(CompactPathFormat::HEADER_SIZE + 11 * (pointCount() + 3 * strokes.size()) + 1);
+        CompactPathEncoder encoder(buffer.data(), buffer.size(), PlotterKinematics::GEOMETRY_HASH);
+
+        for (const Stroke &stroke : strokes) {
+            encoder.add({PathCommand::penUp});
+            encoder.add({PathCommand::move, stroke.start().a, stroke.start().b, 0.0});
+            encoder.add({PathCommand::penDown});
+
+            for (size_t i = 1; i < stroke.points.size(); i++) {
+                encoder.add({PathCommand::move, stroke.points[i].a, stroke.points[i].b, stroke.speedLimit});
+            }
+        }
+
+        encoder.add({PathCommand::penUp});
+        buffer.resize(encoder.finish());
+        return buffer;
+    }
+};
+
+#endif //SLICED_JOB_H
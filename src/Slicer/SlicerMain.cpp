@@ -0,0 +1,585 @@
+// Host slicer stages ([env:slicer]), working on jobs in CompactPathFormat.
+// Reads an SVG or a job exported by the web slicer, drops points out of reach and points the pen wouldn't miss,
+// reorders its strokes to cut pen-up travel and writes it back, as a .spj or as a compiledJob.h to build into the
+// firmware. SVGs are read as a stream and their paths sliced in batches across threads.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+
+#include "OrderedBatches.h"
+#include "PathOrdering.h"
+#include "PathSimplification.h"
+#include "SlicedJob.h"
+#include "StrokeBuilder.h"
+#include "SvgPathFlattener.h"
+#include "SvgStreamReader.h"
+#include "WorkspaceFilter.h"
+
+struct SlicerOptions {
+    const char *inputPath = nullptr;
+    const char *outputPath = nullptr;
+    bool order = true;
+    double tolerance = 0.05; // mm, 0 keeps every point
+    uint32_t benchStrokes = 0;
+    uint32_t benchSvgMegabytes = 0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool svgTransforms = false; // Off like the web slicer, whose getPointAtLength() ignores them
+    Placement placement;
+    SvgPathFlattener::Settings flattening;
+    TravelModel travel;
+};
+
+static void printUsage(const char *program) {
+    printf("Usage: %s [--flatten-tolerance MM] [--max-segment MM] [--tolerance MM] [--no-order]\n"
+           "          [--merge-steps N] [--pen-lift-ms N] [--max-speed N] [--acceleration N]\n"
+           "          [--jerk N] [--threads N] [--svg-transforms] [--scale-x N] [--scale-y N]\n"
+           "          [--offset-x MM] [--offset-y MM] INPUT.svg|INPUT.spj [OUTPUT.spj|OUTPUT.h]\n"
+           "       %s --bench STROKES\n"
+           "       %s [--threads N] [--tolerance MM] --bench-svg MEGABYTES\n", program, program, program);
+}
+
+static bool parseOptions(const int argc, char **argv, SlicerOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--no-order") == 0) {
+            options.order = false;
+            continue;
+        }
+
+        if (strcmp(arg, "--svg-transforms") == 0) {
+            options.svgTransforms = true;
+            continue;
+        }
+
+        if (strncmp(arg, "--", 2) != 0) {
+            if (!options.inputPath) {
+                options.inputPath = arg;
+            } else if (!options.outputPath) {
+                options.outputPath = arg;
+            } else {
+                return false;
+            }
+            continue;
+        }
+
+        if (!value) {
+            return false;
+        }
+
+        if (strcmp(arg, "--flatten-tolerance") == 0) {
+            options.flattening.tolerance = strtod(value, nullptr);
+        } else if (strcmp(arg, "--max-segment") == 0) {
+            options.flattening.maxSegmentLength = strtod(value, nullptr);
+        } else if (strcmp(arg, "--tolerance") == 0) {
+            options.tolerance = strtod(value, nullptr);
+        } else if (strcmp(arg, "--merge-steps") == 0) {
+            options.travel.mergeDistance = strtol(value, nullptr, 10);
+        } else if (strcmp(arg, "--pen-lift-ms") == 0) {
+            options.travel.penLiftSeconds = strtof(value, nullptr) / 1000.0f;
+        } else if (strcmp(arg, "--max-speed") == 0) {
+            options.travel.maxSpeed = strtof(value, nullptr);
+        } else if (strcmp(arg, "--acceleration") == 0) {
+            options.travel.acceleration = strtof(value, nullptr);
+        } else if (strcmp(arg, "--jerk") == 0) {
+            options.travel.jerk = strtof(value, nullptr);
+        } else if (strcmp(arg, "--bench") == 0) {
+            options.benchStrokes = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--bench-svg") == 0) {
+            options.benchSvgMegabytes = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threads = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--scale-x") == 0) {
+            options.placement.scaleX = strtod(value, nullptr);
+        } else if (strcmp(arg, "--scale-y") == 0) {
+            options.placement.scaleY = strtod(value, nullptr);
+        } else if (strcmp(arg, "--offset-x") == 0) {
+            options.placement.offsetX = strtod(value, nullptr);
+        } else if (strcmp(arg, "--offset-y") == 0) {
+            options.placement.offsetY = strtod(value, nullptr);
+        } else {
+            return false;
+        }
+
+        i++;
+    }
+
+    return (options.inputPath || options.benchStrokes > 0 || options.benchSvgMegabytes > 0)
+           && options.travel.maxSpeed > 0 && options.travel.acceleration > 0 && options.travel.jerk >= 0
+           && options.flattening.tolerance > 0 && options.flattening.maxSegmentLength > 0 && options.threads > 0
+           && options.placement.scaleX != 0 && options.placement.scaleY != 0;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &data) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint8_t chunk[4096];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + length);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool endsWith(const char *text, const char *suffix) {
+    const size_t textLength = strlen(text);
+    const size_t suffixLength = strlen(suffix);
+    return textLength >= suffixLength && strcmp(text + textLength - suffixLength, suffix) == 0;
+}
+
+/** Raw .spj, or a compiledJob.h in the layout the web slicer exports */
+static bool writeFile(const char *path, const std::vector<uint8_t> &data) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool written = true;
+    if (endsWith(path, ".h")) {
+        fprintf(file, "#ifndef COMPILED_JOB_H\n#define COMPILED_JOB_H\n\n#include <Arduino.h>\n\n");
+        fprintf(file, "// Auto-generated by the slicer, CompactPathFormat (%zu bytes)\n", data.size());
+        fprintf(file, "const uint8_t compiledJob[] = {\n");
+        for (size_t i = 0; i < data.size(); i++) {
+            fprintf(file, "%s0x%02X,%s", i % 16 == 0 ? "  " : "", data[i],
+                    i % 16 == 15 || i + 1 == data.size() ? "\n" : " ");
+        }
+        written = fprintf(file, "};\n\n#endif //COMPILED_JOB_H\n") > 0;
+    } else {
+        written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    }
+
+    return fclose(file) == 0 && written;
+}
+
+/** Paths read from an SVG, sliced together by one worker */
+struct PathBatch {
+    constexpr static size_t MAX_PATHS = 256;
+    constexpr static size_t MAX_BYTES = 64 * 1024; // Of path data
+
+    std::vector<SvgPathElement> paths;
+    size_t bytes = 0;
+};
+
+/** Strokes sliced from a batch of paths, or simplified from a batch of strokes, and what it took */
+struct SlicedBatch {
+    SlicedJob job;
+    uint32_t paths = 0;
+    uint32_t malformed = 0;
+    size_t points = 0;
+    double sourceLength = 0.0; // User units
+    size_t jointPoints = 0;
+    uint32_t addedPoints = 0;
+    uint32_t unreachablePoints = 0;
+    PathSimplification::Report simplification;
+    double simplificationSeconds = 0.0; // Thread time
+};
+
+static double secondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** Largest resident set so far, in MB */
+static double peakMemoryMegabytes() {
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+/** @param seconds wall time on `threads` threads, or summed over them when `threads` is 0 */
+static void printSimplificationReport(const double tolerance, const PathSimplification::Report &report,
+                                      const double seconds, const unsigned threads) {
+    printf("\nSimplification, %.3f mm\n", tolerance);
+    printf("  points:          %10zu -> %zu (%.1f%% fewer)\n", report.pointsBefore, report.pointsAfter,
+           report.pointsBefore > 0 ? 100.0 * (report.pointsBefore - report.pointsAfter) / report.pointsBefore : 0);
+    printf("  max error:       %10.4f mm\n", report.maxErrorMillimetres);
+    if (threads > 0) {
+        printf("  host time:       %10.3f ms on %u thread(s) (%.0f points/s)\n", seconds * 1000.0, threads,
+               seconds > 0 ? report.pointsBefore / seconds : 0.0);
+    } else {
+        printf("  thread time:     %10.3f ms, part of slicing (%.0f points/s per thread)\n", seconds * 1000.0,
+               seconds > 0 ? report.pointsBefore / seconds : 0.0);
+    }
+}
+
+static void addSimplification(PathSimplification::Report &total, const PathSimplification::Report &report) {
+    total.pointsBefore += report.pointsBefore;
+    total.pointsAfter += report.pointsAfter;
+    total.maxErrorMillimetres = std::max(total.maxErrorMillimetres, report.maxErrorMillimetres);
+}
+
+/**
+ * Flattens a batch of paths, solves each point's joints and simplifies the strokes, which then take no more
+ * memory than their points need: a large SVG's job is all there is held of it.
+ */
+static void sliceBatch(const SlicerOptions &options, PathBatch &batch, SlicedBatch &sliced) {
+    SvgPathFlattener flattener(options.flattening, options.placement.toTransform());
+    std::vector<std::vector<PaperPoint> > polylines;
+
+    for (const SvgPathElement &path : batch.paths) {
+        if (!path.data.empty()) {
+            sliced.paths++;
+            flattener.setTransform(path.transform);
+            sliced.malformed += !flattener.flatten(path.data.c_str(), polylines);
+        }
+    }
+
+    StrokeBuilder builder(sliced.job, options.flattening.tolerance);
+    for (const std::vector<PaperPoint> &polyline : polylines) {
+        sliced.points += polyline.size();
+        for (size_t i = 1; i < polyline.size(); i++) {
+            sliced.sourceLength += std::hypot((polyline[i].x - polyline[i - 1].x) / options.placement.scaleX,
+                                              (polyline[i].y - polyline[i - 1].y) / options.placement.scaleY);
+        }
+
+        builder.add(polyline);
+    }
+    builder.finish();
+
+    sliced.jointPoints = sliced.job.pointCount();
+    sliced.addedPoints = builder.getAddedPoints();
+    sliced.unreachablePoints = builder.getUnreachablePoints();
+
+    if (options.tolerance > 0) {
+        const auto start = std::chrono::steady_clock::now();
+        sliced.simplification = PathSimplification(options.tolerance).run(sliced.job);
+        sliced.simplificationSeconds = secondsSince(start);
+    }
+
+    for (Stroke &stroke : sliced.job.strokes) {
+        stroke.points.shrink_to_fit();
+    }
+}
+
+/**
+ * Flattens every path element of an SVG with the placement and solves each point's joints, reading the file as
+ * it goes and slicing its paths in batches across threads. The strokes come out in the order of the paths,
+ * simplified already if there's a tolerance.
+ */
+static bool sliceSvg(FILE *file, const SlicerOptions &options, SlicedJob &job, uint64_t &bytesRead) {
+    SvgStreamReader reader(file, options.placement.toTransform(), options.svgTransforms);
+    SlicedBatch total;
+
+    OrderedBatches<PathBatch, SlicedBatch> batches(options.threads, [&options](PathBatch &batch, SlicedBatch &sliced) {
+        sliceBatch(options, batch, sliced);
+    }, [&job, &total](SlicedBatch &sliced) {
+        std::move(sliced.job.strokes.begin(), sliced.job.strokes.end(), std::back_inserter(job.strokes));
+        total.paths += sliced.paths;
+        total.malformed += sliced.malformed;
+        total.points += sliced.points;
+        total.sourceLength += sliced.sourceLength;
+        total.jointPoints += sliced.jointPoints;
+        total.addedPoints += sliced.addedPoints;
+        total.unreachablePoints += sliced.unreachablePoints;
+        addSimplification(total.simplification, sliced.simplification);
+        total.simplificationSeconds += sliced.simplificationSeconds;
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    PathBatch batch;
+    SvgPathElement path;
+    while (reader.next(path)) {
+        batch.bytes += path.data.size();
+        batch.paths.push_back(std::move(path));
+
+        if (batch.paths.size() >= PathBatch::MAX_PATHS || batch.bytes >= PathBatch::MAX_BYTES) {
+            batches.submit(std::move(batch));
+            batch = PathBatch();
+        }
+    }
+    if (!batch.paths.empty()) {
+        batches.submit(std::move(batch));
+    }
+    batches.finish();
+    const double seconds = secondsSince(start);
+
+    const SvgStreamReader::Stats &stats = reader.getStats();
+    bytesRead = stats.bytes;
+
+    printf("\nFlattening, %.3f mm chord error, %.1f mm segments, SVG transforms %s\n", options.flattening.tolerance,
+           options.flattening.maxSegmentLength, options.svgTransforms ? "applied" : "ignored");
+    printf("  paths:           %10u (%u malformed, %u too long)\n", total.paths, total.malformed, stats.oversized);
+    if (stats.badTransforms > 0) {
+        printf("  bad transforms:  %10u (ignored)\n", stats.badTransforms);
+    }
+    printf("  points:          %10zu (%.0f at fixed 2-unit steps)\n", total.points, total.sourceLength / 2.0);
+    printf("  joint points:    %10zu (%u added against bowing)\n", total.jointPoints, total.addedPoints);
+    printf("  out of reach:    %10u\n", total.unreachablePoints);
+    printf("  read:            %10.1f MB (longest tag %zu bytes), %.1f MB peak memory\n", stats.bytes / 1e6,
+           stats.longestTag, peakMemoryMegabytes());
+    printf("  host time:       %10.3f ms on %u thread(s) (%.0f points/s)\n", seconds * 1000.0, options.threads,
+           seconds > 0 ? total.points / seconds : 0.0);
+
+    if (options.tolerance > 0) {
+        printSimplificationReport(options.tolerance, total.simplification, total.simplificationSeconds, 0);
+    }
+
+    return total.paths > 0;
+}
+
+/**
+ * Simplifies a job read from a file, its strokes in batches across threads; each stroke on its own, so the split
+ * doesn't matter.
+ */
+static void simplifyJob(const SlicerOptions &options, SlicedJob &job) {
+    constexpr size_t BATCH_POINTS = 4096;
+    const PathSimplification simplification(options.tolerance);
+    PathSimplification::Report report;
+    std::vector<Stroke> strokes;
+    strokes.reserve(job.strokes.size());
+
+    OrderedBatches<SlicedJob, SlicedBatch> batches(options.threads, [&simplification](SlicedJob &batch,
+                                                                                        SlicedBatch &simplified) {
+        simplified.simplification = simplification.run(batch);
+        simplified.job.strokes = std::move(batch.strokes);
+    }, [&strokes, &report](SlicedBatch &simplified) {
+        std::move(simplified.job.strokes.begin(), simplified.job.strokes.end(), std::back_inserter(strokes));
+        addSimplification(report, simplified.simplification);
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    SlicedJob batch;
+    size_t batchPoints = 0;
+    for (Stroke &stroke : job.strokes) {
+        batchPoints += stroke.points.size();
+        batch.strokes.push_back(std::move(stroke));
+
+        if (batchPoints >= BATCH_POINTS) {
+            batches.submit(std::move(batch));
+            batch = SlicedJob();
+            batchPoints = 0;
+        }
+    }
+    if (!batch.strokes.empty()) {
+        batches.submit(std::move(batch));
+    }
+    batches.finish();
+    const double seconds = secondsSince(start);
+    job.strokes = std::move(strokes);
+
+    printSimplificationReport(options.tolerance, report, seconds, options.threads);
+}
+
+static void printOrderingReport(const PathOrdering::Report &report, const double seconds) {
+    const float saved = report.travelSecondsBefore - report.travelSecondsAfter;
+
+    printf("\nPath ordering\n");
+    printf("  strokes:         %10zu -> %zu\n", report.strokesBefore, report.strokesAfter);
+    printf("  travel estimate: %10.1f s -> %.1f s (%.1f%% less)\n", report.travelSecondsBefore,
+           report.travelSecondsAfter, report.travelSecondsBefore > 0 ? 100.0f * saved / report.travelSecondsBefore : 0);
+    printf("  2-opt moves:     %10u\n", report.improvements);
+    printf("  host time:       %10.3f ms\n", seconds * 1000.0);
+}
+
+static void printWorkspaceReport(const WorkspaceFilter::Report &report, const double seconds) {
+    printf("\nWorkspace, arms within %ld steps, %ld to %ld steps apart\n", PlotterKinematics::ARM_LIMIT_STEPS,
+           PlotterKinematics::OPENING_MIN_STEPS, PlotterKinematics::OPENING_MAX_STEPS);
+    printf("  points checked:  %10zu\n", report.pointsChecked);
+    printf("  out of reach:    %10zu (strokes %zu -> %zu)\n", report.unreachablePoints, report.strokesBefore,
+           report.strokesAfter);
+    for (const WorkspaceFilter::Violation &violation : report.first) {
+        printf("    stroke %zu point %zu: A:%ld B:%ld\n", violation.stroke, violation.point, violation.joints.a,
+               violation.joints.b);
+    }
+    printf("  host time:       %10.3f ms (%.0f points/s)\n", seconds * 1000.0,
+           seconds > 0 ? report.pointsChecked / seconds : 0.0);
+}
+
+/** Ordering on generated artwork: short random scribbles spread over the workspace, in random order */
+static int runOrderingBenchmark(const SlicerOptions &options) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    SlicedJob job;
+
+    while (job.strokes.size() < options.benchStrokes) {
+        // Uniform over the workspace annulus, then a few 2 mm segments in a drifting direction
+        const float radius = sqrtf(50.0f * 50.0f + unit(random) * (290.0f * 290.0f - 50.0f * 50.0f));
+        const float bearing = (unit(random) - 0.5f) * 3.0f;
+        float x = radius * sinf(bearing);
+        float y = radius * cosf(bearing);
+        float heading = unit(random) * 6.2832f;
+
+        Stroke stroke;
+        for (int i = 0; i < 8; i++) {
+            long a = 0;
+            long b = 0;
+            if (!PlotterKinematics::inverseMillimetres(x, y, a, b)) {
+                break;
+            }
+
+            stroke.points.push_back({a, b});
+            heading += (unit(random) - 0.5f);
+            x += 2.0f * cosf(heading);
+            y += 2.0f * sinf(heading);
+        }
+
+        if (stroke.points.size() >= 2) {
+            job.strokes.push_back(std::move(stroke));
+        }
+    }
+
+    const size_t points = job.pointCount();
+    PathOrdering ordering(options.travel);
+
+    const auto start = std::chrono::steady_clock::now();
+    const PathOrdering::Report report = ordering.run(job);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printOrderingReport(report, seconds);
+    printf("  strokes/s:       %10.0f\n", report.strokesBefore / seconds);
+
+    return job.pointCount() <= points && report.travelSecondsAfter <= report.travelSecondsBefore ? 0 : 1;
+}
+
+/**
+ * Writes generated artwork of about `megabytes` MB: groups of paths mixing lines, cubic and quadratic Béziers and
+ * arcs, in user units that land within reach with or without the groups' small translations.
+ */
+static void writeBenchmarkSvg(FILE *file, const uint32_t megabytes) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> x(10.0, 170.0);
+    std::uniform_real_distribution<double> y(40.0, 180.0);
+    std::uniform_real_distribution<double> offset(-5.0, 5.0);
+    std::uniform_real_distribution<double> size(2.0, 8.0);
+
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!-- generated by the slicer's --bench-svg -->\n"
+                  "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 200 220\">\n"
+                  "<style><![CDATA[ path > * { stroke: black } ]]></style>\n");
+
+    const long target = static_cast<long>(megabytes) * 1000 * 1000;
+    for (uint32_t group = 0; ftell(file) < target; group++) {
+        fprintf(file, "<g id=\"g%u\" transform=\"translate(%.3f, %.3f)\">\n", group, offset(random), offset(random));
+        for (int i = 0; i < 32; i++) {
+            const double startX = x(random);
+            const double startY = y(random);
+            const double r = size(random);
+            fprintf(file, "  <path fill=\"none\" d=\"M%.3f %.3f c%.3f %.3f %.3f %.3f %.3f %.3f q%.3f %.3f %.3f %.3f "
+                          "a%.3f %.3f 0 0 1 %.3f %.3f l%.3f %.3f z\"/>\n", startX, startY, r, -r, 2 * r, r, 3 * r, 0.0,
+                    r, r, 0.0, 2 * r, r, r / 2, -2 * r, 0.0, -r, -r);
+        }
+        fprintf(file, "</g>\n");
+    }
+    fprintf(file, "</svg>\n");
+}
+
+/** Slicing on generated artwork, from a temporary file read as a stream like any other */
+static int runSvgBenchmark(const SlicerOptions &options) {
+    FILE *file = tmpfile();
+    if (!file) {
+        fprintf(stderr, "Cannot create a temporary file\n");
+        return 1;
+    }
+
+    writeBenchmarkSvg(file, options.benchSvgMegabytes);
+    rewind(file);
+
+    SlicedJob job;
+    uint64_t bytesRead = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const bool sliced = sliceSvg(file, options, job, bytesRead);
+    fclose(file);
+    const double seconds = secondsSince(start);
+
+    printf("\nGenerated %.1f MB SVG: %zu strokes, %zu points in %.3f s, %.1f MB peak memory\n", bytesRead / 1e6,
+           job.strokes.size(), job.pointCount(), seconds, peakMemoryMegabytes());
+
+    return sliced && !job.strokes.empty() ? 0 : 1;
+}
+
+int main(const int argc, char **argv) {
+    SlicerOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    if (options.benchStrokes > 0) {
+        return runOrderingBenchmark(options);
+    }
+
+    if (options.benchSvgMegabytes > 0) {
+        return runSvgBenchmark(options);
+    }
+
+    SlicedJob job;
+    uint64_t inputBytes = 0;
+    const bool isSvg = endsWith(options.inputPath, ".svg");
+    if (isSvg) {
+        FILE *file = fopen(options.inputPath, "rb");
+        if (!file) {
+            fprintf(stderr, "Cannot open %s\n", options.inputPath);
+            return 1;
+        }
+
+        const bool sliced = sliceSvg(file, options, job, inputBytes);
+        fclose(file);
+        if (!sliced) {
+            fprintf(stderr, "%s has no paths\n", options.inputPath);
+            return 1;
+        }
+    } else {
+        std::vector<uint8_t> input;
+        if (!readFile(options.inputPath, input)) {
+            fprintf(stderr, "Cannot open %s\n", options.inputPath);
+            return 1;
+        }
+
+        inputBytes = input.size();
+        const CompactPathDecoder::Error error = job.read(input.data(), input.size());
+        if (error != CompactPathDecoder::none) {
+            fprintf(stderr, "%s is not a job for this plotter (error %d)\n", options.inputPath, error);
+            return 1;
+        }
+    }
+
+    printf("Job %s: %llu bytes, %zu strokes, %zu points\n", options.inputPath,
+           static_cast<unsigned long long>(inputBytes), job.strokes.size(), job.pointCount());
+    if (job.droppedCommands > 0) {
+        printf("  dropped %u dwell/home command(s)\n", job.droppedCommands);
+    }
+
+    {
+        const WorkspaceFilter filter;
+        const auto start = std::chrono::steady_clock::now();
+        const WorkspaceFilter::Report report = filter.run(job);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printWorkspaceReport(report, seconds);
+    }
+
+    // An SVG's strokes were simplified as they were sliced
+    if (options.tolerance > 0 && !isSvg) {
+        simplifyJob(options, job);
+    }
+
+    if (options.order) {
+        PathOrdering ordering(options.travel);
+        const auto start = std::chrono::steady_clock::now();
+        const PathOrdering::Report report = ordering.run(job);
+        printOrderingReport(report, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    if (options.outputPath) {
+        const std::vector<uint8_t> output = job.write();
+        if (output.empty() || !writeFile(options.outputPath, output)) {
+            fprintf(stderr, "Cannot write %s\n", options.outputPath);
+            return 1;
+        }
+
+        printf("\nWrote %s: %zu bytes, %zu strokes, %zu points\n", options.outputPath, output.size(),
+               job.strokes.size(), job.pointCount());
+    }
+
+    return 0;
+}
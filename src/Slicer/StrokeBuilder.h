@@ -0,0 +1,130 @@
+#ifndef STROKE_BUILDER_H
+#define STROKE_BUILDER_H
+
+#include <cmath>
+#include <vector>
+
+#include "SlicedJob.h"
+#include "SvgPathFlattener.h"
+
+/**
+ * Turns polylines on paper into strokes of joint positions. The arms move linearly in joint space, so a straight
+ * chord on paper is drawn as a slight curve; chords are split until that curve stays within the tolerance of
+ * them, which only happens where it matters: long chords, and near the edges of the workspace. Points out of
+ * reach end the stroke, drawing resumes at the next reachable one.
+ */
+class StrokeBuilder {
+    constexpr static uint8_t MAX_DEPTH = 12;
+
+    SlicedJob &job;
+    double tolerance;
+
+    uint32_t unreachablePoints = 0;
+    uint32_t addedPoints = 0;
+
+    static bool solve(const PaperPoint &point, JointPoint &joints) {
+        return PlotterKinematics::inverseMillimetres(static_cast<float>(point.x), static_cast<float>(point.y),
+                                                     joints.a, joints.b);
+    }
+
+    static PaperPoint toPaper(const double a, const double b) {
+        PaperPoint point = {};
+        PlotterKinematics::forwardExact(a, b, point.x, point.y);
+        return point;
+    }
+
+    /**
+     * Largest distance on paper between the chord and the joint-space line the arms take instead. The chord
+     * runs between where the end steps actually put the pen, so step resolution alone never splits it.
+     */
+    static double bow(const JointPoint &fromJoints, const JointPoint &toJoints) {
+        const PaperPoint from = toPaper(fromJoints.a, fromJoints.b);
+        const PaperPoint to = toPaper(toJoints.a, toJoints.b);
+        const double chordX = to.x - from.x;
+        const double chordY = to.y - from.y;
+        const double length = std::hypot(chordX, chordY);
+        double maxDistance = 0.0;
+
+        for (const double t : {0.25, 0.5, 0.75}) {
+            const PaperPoint drawn = toPaper(fromJoints.a + t * (toJoints.a - fromJoints.a),
+                                             fromJoints.b + t * (toJoints.b - fromJoints.b));
+            const double distance = length > 0
+                                        ? fabs((drawn.x - from.x) * chordY - (drawn.y - from.y) * chordX) / length
+                                        : std::hypot(drawn.x - from.x, drawn.y - from.y);
+            maxDistance = std::max(maxDistance, distance);
+        }
+
+        return maxDistance;
+    }
+
+    /** Adds the chord's end, after its midpoint if the arms would stray too far from it */
+    void addChord(const PaperPoint &from, const JointPoint &fromJoints, const PaperPoint &to,
+                  const JointPoint &toJoints, const uint8_t depth) {
+        if (depth < MAX_DEPTH && fromJoints.distanceTo(toJoints) > 1
+            && bow(fromJoints, toJoints) > tolerance) {
+            const PaperPoint middle = {(from.x + to.x) / 2, (from.y + to.y) / 2};
+            JointPoint middleJoints = {};
+
+            if (!solve(middle, middleJoints)) {
+                // The chord crosses the unreachable middle of the workspace
+                unreachablePoints++;
+                job.strokes.push_back({{toJoints}, 0.0});
+                return;
+            }
+
+            addChord(from, fromJoints, middle, middleJoints, depth + 1);
+            addedPoints++;
+            addChord(middle, middleJoints, to, toJoints, depth + 1);
+            return;
+        }
+
+        job.strokes.back().points.push_back(toJoints);
+    }
+
+public:
+    StrokeBuilder(SlicedJob &job, const double toleranceMillimetres) : job(job), tolerance(toleranceMillimetres) {
+    }
+
+    void add(const std::vector<PaperPoint> &polyline) {
+        bool drawing = false;
+        PaperPoint previous = {};
+        JointPoint previousJoints = {};
+
+        for (const PaperPoint &point : polyline) {
+            JointPoint joints = {};
+            if (!solve(point, joints)) {
+                unreachablePoints++;
+                drawing = false;
+                continue;
+            }
+
+            if (drawing) {
+                addChord(previous, previousJoints, point, joints, 0);
+            } else {
+                job.strokes.push_back({{joints}, 0.0});
+                drawing = true;
+            }
+
+            previous = point;
+            previousJoints = joints;
+        }
+    }
+
+    /** Drops the single points left where reach came and went */
+    void finish() {
+        std::vector<Stroke> &strokes = job.strokes;
+        strokes.erase(std::remove_if(strokes.begin(), strokes.end(), [](const Stroke &stroke) {
+            return stroke.points.size() < 2;
+        }), strokes.end());
+    }
+
+    uint32_t getUnreachablePoints() const {
+        return unreachablePoints;
+    }
+
+    uint32_t getAddedPoints() const {
+        return addedPoints;
+    }
+};
+
+#endif //STROKE_BUILDER_H
@@ -0,0 +1,442 @@
+#ifndef SVG_PATH_FLATTENER_H
+#define SVG_PATH_FLATTENER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "SvgTransform.h"
+
+/** Point on paper, mm in the plotter's frame (origin between the arm pivots, y away from the base) */
+struct PaperPoint {
+    double x;
+    double y;
+};
+
+/** Where SVG user units land on paper: scale, flip and offset, by default as hard-coded in the web slicer's p.setup */
+struct Placement {
+    double scaleX = 0.85;
+    double scaleY = -1.0;
+    double offsetX = -75.0;
+    double offsetY = 300.0;
+
+    AffineTransform toTransform() const {
+        return {scaleX, 0.0, 0.0, scaleY, offsetX, offsetY};
+    }
+};
+
+/**
+ * Turns SVG path data (the d attribute) into polylines on paper, one per subpath. Curves are split where they
+ * bend, not at fixed steps: a piece is kept once its chord is within the tolerance of the curve and no longer
+ * than the maximum segment length. How the arms bow off a chord is up to StrokeBuilder.
+ */
+class SvgPathFlattener {
+public:
+    struct Settings {
+        double tolerance = 0.02; // mm on paper, largest gap between curve and chord
+        double maxSegmentLength = 10.0; // mm on paper
+    };
+
+private:
+    constexpr static uint8_t BISECTION_STEPS = 20;
+    constexpr static double PI = 3.14159265358979323846;
+
+    Settings settings;
+    AffineTransform transform; // User units of the path to paper
+
+    std::vector<std::vector<PaperPoint> > *output = nullptr;
+
+    const char *cursor = nullptr;
+
+    // Current point and subpath start, in SVG user units
+    double x = 0.0;
+    double y = 0.0;
+    double startX = 0.0;
+    double startY = 0.0;
+    // Control point to reflect for S and T, valid after C/S and Q/T respectively
+    double lastControlX = 0.0;
+    double lastControlY = 0.0;
+    char lastCommand = 0;
+
+    void skipSeparators() {
+        while (isspace(static_cast<unsigned char>(*cursor)) || *cursor == ',') {
+            cursor++;
+        }
+    }
+
+    bool readNumber(double &value) {
+        skipSeparators();
+        char *end = nullptr;
+        value = strtod(cursor, &end);
+        if (end == cursor) {
+            return false;
+        }
+        cursor = end;
+        return true;
+    }
+
+    /** Arc flags are a single 0 or 1, and may run into the next number ("a5 5 0 015 5") */
+    bool readFlag(bool &flag) {
+        skipSeparators();
+        if (*cursor != '0' && *cursor != '1') {
+            return false;
+        }
+        flag = *cursor++ == '1';
+        return true;
+    }
+
+    bool nextIsNumber() {
+        skipSeparators();
+        return *cursor == '-' || *cursor == '+' || *cursor == '.' || isdigit(static_cast<unsigned char>(*cursor));
+    }
+
+    PaperPoint place(const double pointX, const double pointY) const {
+        PaperPoint point = {};
+        transform.apply(pointX, pointY, point.x, point.y);
+        return point;
+    }
+
+    void emit(const PaperPoint &point) {
+        output->back().push_back(point);
+    }
+
+    void moveTo(const double toX, const double toY) {
+        if (!output->empty() && output->back().size() < 2) {
+            output->back().clear();
+        } else {
+            output->emplace_back();
+        }
+
+        x = startX = toX;
+        y = startY = toY;
+        emit(place(x, y));
+    }
+
+    void lineTo(const double toX, const double toY) {
+        const PaperPoint from = place(x, y);
+        const PaperPoint to = place(toX, toY);
+        const double length = std::hypot(to.x - from.x, to.y - from.y);
+        const int pieces = std::max(1, static_cast<int>(ceil(length / settings.maxSegmentLength)));
+
+        for (int i = 1; i <= pieces; i++) {
+            const double t = static_cast<double>(i) / pieces;
+            emit({from.x + t * (to.x - from.x), from.y + t * (to.y - from.y)});
+        }
+
+        x = toX;
+        y = toY;
+    }
+
+    static PaperPoint lerp(const PaperPoint &from, const PaperPoint &to, const double t) {
+        return {from.x + t * (to.x - from.x), from.y + t * (to.y - from.y)};
+    }
+
+    /** Control points of the part of cubic p between t0 and t1, by de Casteljau */
+    static void cubicPart(const PaperPoint p[4], const double t0, const double t1, PaperPoint part[4]) {
+        // Up to t1: the left half of a split there
+        const PaperPoint p01 = lerp(p[0], p[1], t1);
+        const PaperPoint p12 = lerp(p[1], p[2], t1);
+        const PaperPoint p012 = lerp(p01, p12, t1);
+        const PaperPoint left[4] = {p[0], p01, p012, lerp(p012, lerp(p12, lerp(p[2], p[3], t1), t1), t1)};
+
+        // From t0 on that: the right half of a split at t0 / t1
+        const double t = t1 > 0 ? t0 / t1 : 0;
+        const PaperPoint q12 = lerp(left[1], left[2], t);
+        const PaperPoint q23 = lerp(left[2], left[3], t);
+        const PaperPoint q123 = lerp(q12, q23, t);
+        part[0] = lerp(lerp(lerp(left[0], left[1], t), q12, t), q123, t);
+        part[1] = q123;
+        part[2] = q23;
+        part[3] = left[3];
+    }
+
+    /**
+     * Whether a cubic can be drawn as its chord: the control point offsets 3P1 - 2P0 - P3 and 3P2 - P0 - 2P3
+     * bound the curve's distance from the chord by a quarter of their length (tight for symmetric arches), and
+     * the control polygon, never shorter than the curve, bounds its length.
+     */
+    bool isFlat(const PaperPoint p[4]) const {
+        const double ux = 3.0 * p[1].x - 2.0 * p[0].x - p[3].x;
+        const double uy = 3.0 * p[1].y - 2.0 * p[0].y - p[3].y;
+        const double vx = 3.0 * p[2].x - p[0].x - 2.0 * p[3].x;
+        const double vy = 3.0 * p[2].y - p[0].y - 2.0 * p[3].y;
+        const double deviationSquared = std::max(ux * ux + uy * uy, vx * vx + vy * vy);
+        const double length = std::hypot(p[1].x - p[0].x, p[1].y - p[0].y)
+                              + std::hypot(p[2].x - p[1].x, p[2].y - p[1].y)
+                              + std::hypot(p[3].x - p[2].x, p[3].y - p[2].y);
+
+        return deviationSquared <= 16.0 * settings.tolerance * settings.tolerance
+               && length <= settings.maxSegmentLength;
+    }
+
+    /**
+     * Cubic Bézier on paper, in pieces as long as they can be: from each point, the furthest t whose piece is
+     * still flat is found by bisection. Straight stretches get long pieces and tight bends short ones.
+     */
+    void flattenCubic(const PaperPoint p[4]) {
+        PaperPoint part[4];
+        double t0 = 0.0;
+
+        while (t0 < 1.0) {
+            cubicPart(p, t0, 1.0, part);
+            double t1 = 1.0;
+
+            if (!isFlat(part)) {
+                double flat = t0;
+                double tooFar = 1.0;
+                for (uint8_t i = 0; i < BISECTION_STEPS; i++) {
+                    const double middle = (flat + tooFar) / 2;
+                    cubicPart(p, t0, middle, part);
+                    (isFlat(part) ? flat : tooFar) = middle;
+                }
+
+                // Always make progress, even on degenerate input
+                t1 = std::max(flat, t0 + 1.0 / (1 << BISECTION_STEPS));
+                cubicPart(p, t0, std::min(1.0, t1), part);
+            }
+
+            emit(part[3]);
+            t0 = t1;
+        }
+    }
+
+    void cubicTo(const double x1, const double y1, const double x2, const double y2, const double toX,
+                 const double toY) {
+        // Béziers stay Béziers under affine transforms, so flatten where the tolerance applies
+        const PaperPoint p[4] = {place(x, y), place(x1, y1), place(x2, y2), place(toX, toY)};
+        flattenCubic(p);
+        lastControlX = x2;
+        lastControlY = y2;
+        x = toX;
+        y = toY;
+    }
+
+    void quadraticTo(const double x1, const double y1, const double toX, const double toY) {
+        cubicTo(x + 2.0 / 3.0 * (x1 - x), y + 2.0 / 3.0 * (y1 - y), toX + 2.0 / 3.0 * (x1 - toX),
+                toY + 2.0 / 3.0 * (y1 - toY), toX, toY);
+        lastControlX = x1;
+        lastControlY = y1;
+    }
+
+    /** Elliptical arc from the current point, endpoint parameterisation converted as in SVG 1.1 appendix F.6.5 */
+    void arcTo(double rx, double ry, const double rotationDegrees, const bool largeArc, const bool sweep,
+               const double toX, const double toY) {
+        rx = fabs(rx);
+        ry = fabs(ry);
+        if (rx == 0 || ry == 0 || (toX == x && toY == y)) {
+            lineTo(toX, toY);
+            return;
+        }
+
+        const double phi = rotationDegrees * PI / 180.0;
+        const double cosPhi = cos(phi);
+        const double sinPhi = sin(phi);
+        const double dx = (x - toX) / 2;
+        const double dy = (y - toY) / 2;
+        const double x1 = cosPhi * dx + sinPhi * dy;
+        const double y1 = -sinPhi * dx + cosPhi * dy;
+
+        // Radii too small to reach the end point are scaled up until they just do
+        const double lambda = x1 * x1 / (rx * rx) + y1 * y1 / (ry * ry);
+        if (lambda > 1) {
+            rx *= sqrt(lambda);
+            ry *= sqrt(lambda);
+        }
+
+        const double numerator = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+        const double denominator = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+        double factor = sqrt(std::max(0.0, numerator / denominator));
+        if (largeArc == sweep) {
+            factor = -factor;
+        }
+
+        const double centreX1 = factor * rx * y1 / ry;
+        const double centreY1 = -factor * ry * x1 / rx;
+        const double centreX = cosPhi * centreX1 - sinPhi * centreY1 + (x + toX) / 2;
+        const double centreY = sinPhi * centreX1 + cosPhi * centreY1 + (y + toY) / 2;
+
+        const double startAngle = atan2((y1 - centreY1) / ry, (x1 - centreX1) / rx);
+        double sweepAngle = atan2((-y1 - centreY1) / ry, (-x1 - centreX1) / rx) - startAngle;
+        if (sweep && sweepAngle < 0) {
+            sweepAngle += 2 * PI;
+        } else if (!sweep && sweepAngle > 0) {
+            sweepAngle -= 2 * PI;
+        }
+
+        // Chord sagitta r (1 - cos(step / 2)) within the tolerance, on the larger radius as placed on paper
+        const double radius = std::max(rx, ry) * transform.maxScale();
+        double step = settings.maxSegmentLength / radius;
+        if (settings.tolerance < radius) {
+            step = std::min(step, 2.0 * acos(1.0 - settings.tolerance / radius));
+        }
+        const int pieces = std::max(1, static_cast<int>(ceil(fabs(sweepAngle) / step)));
+
+        for (int i = 1; i <= pieces; i++) {
+            const double angle = startAngle + sweepAngle * i / pieces;
+            const double ellipseX = rx * cos(angle);
+            const double ellipseY = ry * sin(angle);
+            emit(i == pieces ? place(toX, toY)
+                             : place(cosPhi * ellipseX - sinPhi * ellipseY + centreX,
+                                               sinPhi * ellipseX + cosPhi * ellipseY + centreY));
+        }
+
+        x = toX;
+        y = toY;
+    }
+
+    /** One command letter and all its argument groups */
+    bool parseCommand(const char command) {
+        const bool relative = islower(static_cast<unsigned char>(command));
+        const double baseX = relative ? x : 0.0;
+        const double baseY = relative ? y : 0.0;
+        double values[7] = {};
+
+        const auto read = [&](const uint8_t count) {
+            for (uint8_t i = 0; i < count; i++) {
+                if (!readNumber(values[i])) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        switch (toupper(command)) {
+            case 'M':
+                if (!read(2)) {
+                    return false;
+                }
+                moveTo(baseX + values[0], baseY + values[1]);
+                lastCommand = 'M';
+                // Further pairs are line-tos
+                while (nextIsNumber()) {
+                    if (!parseCommand(relative ? 'l' : 'L')) {
+                        return false;
+                    }
+                }
+                return true;
+            case 'Z':
+                lineTo(startX, startY);
+                break;
+            case 'L':
+                if (!read(2)) {
+                    return false;
+                }
+                lineTo(baseX + values[0], baseY + values[1]);
+                break;
+            case 'H':
+                if (!read(1)) {
+                    return false;
+                }
+                lineTo(baseX + values[0], y);
+                break;
+            case 'V':
+                if (!read(1)) {
+                    return false;
+                }
+                lineTo(x, baseY + values[0]);
+                break;
+            case 'C':
+                if (!read(6)) {
+                    return false;
+                }
+                cubicTo(baseX + values[0], baseY + values[1], baseX + values[2], baseY + values[3],
+                        baseX + values[4], baseY + values[5]);
+                break;
+            case 'S': {
+                if (!read(4)) {
+                    return false;
+                }
+                const bool reflect = lastCommand == 'C' || lastCommand == 'S';
+                cubicTo(reflect ? 2 * x - lastControlX : x, reflect ? 2 * y - lastControlY : y,
+                        baseX + values[0], baseY + values[1], baseX + values[2], baseY + values[3]);
+                break;
+            }
+            case 'Q':
+                if (!read(4)) {
+                    return false;
+                }
+                quadraticTo(baseX + values[0], baseY + values[1], baseX + values[2], baseY + values[3]);
+                break;
+            case 'T': {
+                if (!read(2)) {
+                    return false;
+                }
+                const bool reflect = lastCommand == 'Q' || lastCommand == 'T';
+                quadraticTo(reflect ? 2 * x - lastControlX : x, reflect ? 2 * y - lastControlY : y,
+                            baseX + values[0], baseY + values[1]);
+                break;
+            }
+            case 'A': {
+                bool largeArc = false;
+                bool sweep = false;
+                if (!read(3) || !readFlag(largeArc) || !readFlag(sweep) || !readNumber(values[3])
+                    || !readNumber(values[4])) {
+                    return false;
+                }
+                arcTo(values[0], values[1], values[2], largeArc, sweep, baseX + values[3], baseY + values[4]);
+                break;
+            }
+            default:
+                return false;
+        }
+
+        lastCommand = static_cast<char>(toupper(command));
+        return true;
+    }
+
+public:
+    SvgPathFlattener(const Settings &settings, const AffineTransform &transform)
+        : settings(settings), transform(transform) {
+    }
+
+    /** For the paths flattened from here on, e.g. the placement times their own and their groups' transforms */
+    void setTransform(const AffineTransform &pathTransform) {
+        transform = pathTransform;
+    }
+
+    /**
+     * Appends a polyline per subpath of pathData to polylines.
+     * @return false on malformed path data; what was read up to there is kept, as browsers render it
+     */
+    bool flatten(const char *pathData, std::vector<std::vector<PaperPoint> > &polylines) {
+        output = &polylines;
+        cursor = pathData;
+        x = y = startX = startY = 0.0;
+        lastCommand = 0;
+        const size_t firstPolyline = polylines.size();
+        bool valid = true;
+
+        skipSeparators();
+        // Path data must start with a move-to
+        if (*cursor != 'M' && *cursor != 'm' && *cursor != '\0') {
+            valid = false;
+        }
+
+        while (valid && *cursor != '\0') {
+            const char command = *cursor++;
+            if (!isalpha(static_cast<unsigned char>(command)) || (lastCommand == 0 && toupper(command) != 'M')) {
+                valid = false;
+                break;
+            }
+
+            // Argument groups may repeat without the letter
+            do {
+                valid = parseCommand(command);
+            } while (valid && toupper(command) != 'M' && toupper(command) != 'Z' && nextIsNumber());
+
+            skipSeparators();
+        }
+
+        // A move-to with nothing drawn after it draws nothing
+        if (polylines.size() > firstPolyline && polylines.back().size() < 2) {
+            polylines.pop_back();
+        }
+
+        return valid;
+    }
+};
+
+#endif //SVG_PATH_FLATTENER_H
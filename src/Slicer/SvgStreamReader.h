@@ -0,0 +1,248 @@
+#ifndef SVG_STREAM_READER_H
+#define SVG_STREAM_READER_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "SvgTransform.h"
+
+/** A path element as read: its d attribute, and what takes its user units to paper */
+struct SvgPathElement {
+    std::string data;
+    AffineTransform transform;
+};
+
+/**
+ * Reads the path elements out of an SVG file as it goes, a chunk at a time, without building a document: only the
+ * tag being read is held, so memory is set by the longest tag rather than the file. Comments and CDATA are skipped,
+ * quoted attribute values may contain '>'.
+ *
+ * Every path element counts, wherever it is, as querySelectorAll('path') in the web slicer has it. Transforms
+ * are ignored like getPointAtLength() does unless asked for; then each path is placed by the placement, the
+ * transforms of the groups it is in and its own. Group transforms are tracked on a stack as the groups open and
+ * close.
+ */
+class SvgStreamReader {
+public:
+    constexpr static size_t CHUNK_SIZE = 64 * 1024;
+    constexpr static size_t MAX_TAG_LENGTH = 64 * 1024 * 1024; // Longer tags are skipped, see Stats::oversized
+
+    struct Stats {
+        uint64_t bytes = 0;
+        uint32_t paths = 0;
+        uint32_t oversized = 0; // Path elements skipped for their length
+        uint32_t badTransforms = 0; // Transform attributes that didn't parse, taken as none
+        size_t longestTag = 0;
+    };
+
+private:
+    enum Mode : uint8_t {
+        text,
+        tag,
+        comment, // <!-- -->
+        characterData // <![CDATA[ ]]>
+    };
+
+    FILE *file;
+    AffineTransform placement;
+    bool applyTransforms;
+
+    std::vector<char> chunk;
+    size_t chunkLength = 0;
+    size_t chunkOffset = 0;
+
+    Mode mode = text;
+    std::string tagText; // Between < and >
+    size_t tagLength = 0; // Including what didn't fit
+    char quote = 0; // Of the attribute value being read, 0 outside one
+    char previous[2] = {}; // Last characters of a comment or CDATA section, to find its end
+
+    std::vector<AffineTransform> groups = {AffineTransform{}}; // Of the open <g> elements, outermost first
+    Stats stats;
+
+    bool fill() {
+        chunkLength = fread(chunk.data(), 1, chunk.size(), file);
+        chunkOffset = 0;
+        stats.bytes += chunkLength;
+        return chunkLength > 0;
+    }
+
+    /** Value of attribute `name` of the tag read, unquoted; false if it has none */
+    bool attribute(const char *name, std::string &value) const {
+        const size_t nameLength = strlen(name);
+        size_t at = 0;
+
+        // Past the element name
+        while (at < tagText.size() && !isspace(static_cast<unsigned char>(tagText[at])) && tagText[at] != '/') {
+            at++;
+        }
+
+        while (at < tagText.size()) {
+            while (at < tagText.size() && (isspace(static_cast<unsigned char>(tagText[at])) || tagText[at] == '/')) {
+                at++;
+            }
+
+            const size_t nameStart = at;
+            while (at < tagText.size() && tagText[at] != '=' && !isspace(static_cast<unsigned char>(tagText[at]))) {
+                at++;
+            }
+            const size_t foundLength = at - nameStart;
+
+            while (at < tagText.size() && isspace(static_cast<unsigned char>(tagText[at]))) {
+                at++;
+            }
+            if (at >= tagText.size() || tagText[at] != '=') {
+                continue; // An attribute without a value
+            }
+            at++;
+            while (at < tagText.size() && isspace(static_cast<unsigned char>(tagText[at]))) {
+                at++;
+            }
+            if (at >= tagText.size() || (tagText[at] != '"' && tagText[at] != '\'')) {
+                return false;
+            }
+
+            const size_t valueEnd = tagText.find(tagText[at], at + 1);
+            if (valueEnd == std::string::npos) {
+                return false;
+            }
+
+            if (foundLength == nameLength && tagText.compare(nameStart, nameLength, name) == 0) {
+                value.assign(tagText, at + 1, valueEnd - at - 1);
+                return true;
+            }
+            at = valueEnd + 1;
+        }
+
+        return false;
+    }
+
+    /** This element's transform after the ones of the groups it is in */
+    AffineTransform ownTransform() {
+        AffineTransform transform = groups.back();
+        std::string value;
+        if (applyTransforms && attribute("transform", value)) {
+            AffineTransform own;
+            if (AffineTransform::parse(value.c_str(), own)) {
+                transform = transform * own;
+            } else {
+                stats.badTransforms++;
+            }
+        }
+        return transform;
+    }
+
+    bool isElement(const char *name, const size_t offset = 0) const {
+        const size_t length = strlen(name);
+        if (tagText.compare(offset, length, name) != 0) {
+            return false;
+        }
+        const char next = tagText.size() > offset + length ? tagText[offset + length] : '\0';
+        return next == '\0' || next == '/' || isspace(static_cast<unsigned char>(next));
+    }
+
+    /** A whole tag was read: tracks groups, and fills `path` for a path element */
+    bool finishTag(SvgPathElement &path) {
+        stats.longestTag = std::max(stats.longestTag, tagLength);
+        const bool complete = tagLength == tagText.size();
+        const bool selfClosing = !tagText.empty() && tagText.back() == '/';
+
+        if (isElement("/g")) {
+            if (groups.size() > 1) {
+                groups.pop_back();
+            }
+        } else if (isElement("g") && !selfClosing) {
+            groups.push_back(complete ? ownTransform() : groups.back());
+        } else if (isElement("path")) {
+            if (!complete) {
+                stats.oversized++;
+                return false;
+            }
+
+            path.data.clear();
+            attribute("d", path.data);
+            path.transform = placement * ownTransform();
+            stats.paths++;
+            return true;
+        }
+
+        return false;
+    }
+
+public:
+    SvgStreamReader(FILE *file, const AffineTransform &placement, const bool applyTransforms)
+        : file(file), placement(placement), applyTransforms(applyTransforms), chunk(CHUNK_SIZE) {
+    }
+
+    /**
+     * Reads up to the next path element.
+     * @return false at the end of the file
+     */
+    bool next(SvgPathElement &path) {
+        while (chunkOffset < chunkLength || fill()) {
+            if (mode == text) {
+                const char *start = chunk.data() + chunkOffset;
+                const char *open = static_cast<const char *>(memchr(start, '<', chunkLength - chunkOffset));
+                if (!open) {
+                    chunkOffset = chunkLength;
+                    continue;
+                }
+
+                chunkOffset += open - start + 1;
+                mode = tag;
+                tagText.clear();
+                tagLength = 0;
+                quote = 0;
+                continue;
+            }
+
+            const char character = chunk[chunkOffset++];
+
+            if (mode == comment || mode == characterData) {
+                const char closing = mode == comment ? '-' : ']';
+                if (character == '>' && previous[0] == closing && previous[1] == closing) {
+                    mode = text;
+                }
+                previous[0] = previous[1];
+                previous[1] = character;
+                continue;
+            }
+
+            if (quote != 0) {
+                quote = character == quote ? 0 : quote;
+            } else if (character == '"' || character == '\'') {
+                quote = character;
+            } else if (character == '>') {
+                mode = text;
+                if (finishTag(path)) {
+                    return true;
+                }
+                continue;
+            }
+
+            tagLength++;
+            if (tagText.size() < MAX_TAG_LENGTH) {
+                tagText.push_back(character);
+            }
+
+            // Sections whose content isn't markup
+            if (tagLength == 3 && tagText == "!--") {
+                mode = comment;
+                previous[0] = previous[1] = 0;
+            } else if (tagLength == 8 && tagText == "![CDATA[") {
+                mode = characterData;
+                previous[0] = previous[1] = 0;
+            }
+        }
+
+        return false;
+    }
+
+    const Stats &getStats() const {
+        return stats;
+    }
+};
+
+#endif //SVG_STREAM_READER_H
@@ -0,0 +1,133 @@
+#ifndef SVG_TRANSFORM_H
+#define SVG_TRANSFORM_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * 2D affine transform as SVG writes it, matrix(a b c d e f): x' = a x + c y + e, y' = b x + d y + f.
+ * Composed outermost first, so a path inside a group is placed by placement * group * path.
+ */
+struct AffineTransform {
+    double a = 1.0;
+    double b = 0.0;
+    double c = 0.0;
+    double d = 1.0;
+    double e = 0.0;
+    double f = 0.0;
+
+    void apply(const double x, const double y, double &outX, double &outY) const {
+        outX = a * x + c * y + e;
+        outY = b * x + d * y + f;
+    }
+
+    /** This transform applied after `inner` */
+    AffineTransform operator*(const AffineTransform &inner) const {
+        return {
+            a * inner.a + c * inner.b, b * inner.a + d * inner.b,
+            a * inner.c + c * inner.d, b * inner.c + d * inner.d,
+            a * inner.e + c * inner.f + e, b * inner.e + d * inner.f + f
+        };
+    }
+
+    /** Largest factor any length is stretched by, the larger singular value */
+    double maxScale() const {
+        const double squares = a * a + b * b + c * c + d * d;
+        const double determinant = a * d - b * c;
+        return sqrt((squares + sqrt(std::max(0.0, squares * squares - 4.0 * determinant * determinant))) / 2.0);
+    }
+
+    /**
+     * Parses a transform attribute: a list of matrix, translate, scale, rotate, skewX and skewY, applied right
+     * to left as SVG does.
+     * @return false if it isn't one, `transform` is then left alone
+     */
+    static bool parse(const char *text, AffineTransform &transform) {
+        constexpr double RADIANS_PER_DEGREE = 3.14159265358979323846 / 180.0;
+        AffineTransform parsed;
+        const char *cursor = text;
+
+        const auto skipSeparators = [&cursor] {
+            while (isspace(static_cast<unsigned char>(*cursor)) || *cursor == ',') {
+                cursor++;
+            }
+        };
+
+        while (true) {
+            skipSeparators();
+            if (*cursor == '\0') {
+                break;
+            }
+
+            const char *name = cursor;
+            while (isalpha(static_cast<unsigned char>(*cursor))) {
+                cursor++;
+            }
+            const size_t nameLength = cursor - name;
+
+            while (isspace(static_cast<unsigned char>(*cursor))) {
+                cursor++;
+            }
+            if (*cursor++ != '(') {
+                return false;
+            }
+
+            double values[6] = {};
+            uint8_t count = 0;
+            while (true) {
+                skipSeparators();
+                if (*cursor == ')') {
+                    cursor++;
+                    break;
+                }
+
+                char *end = nullptr;
+                const double value = strtod(cursor, &end);
+                if (end == cursor || count == 6) {
+                    return false;
+                }
+                values[count++] = value;
+                cursor = end;
+            }
+
+            const auto is = [&](const char *function) {
+                return nameLength == strlen(function) && strncmp(name, function, nameLength) == 0;
+            };
+
+            AffineTransform step;
+            if (is("matrix") && count == 6) {
+                step = {values[0], values[1], values[2], values[3], values[4], values[5]};
+            } else if (is("translate") && (count == 1 || count == 2)) {
+                step.e = values[0];
+                step.f = values[1];
+            } else if (is("scale") && (count == 1 || count == 2)) {
+                step.a = values[0];
+                step.d = count == 2 ? values[1] : values[0];
+            } else if (is("rotate") && (count == 1 || count == 3)) {
+                const double angle = values[0] * RADIANS_PER_DEGREE;
+                const AffineTransform rotation = {cos(angle), sin(angle), -sin(angle), cos(angle), 0.0, 0.0};
+                // About (cx, cy): there and back around the rotation
+                const AffineTransform there = {1.0, 0.0, 0.0, 1.0, values[1], values[2]};
+                const AffineTransform back = {1.0, 0.0, 0.0, 1.0, -values[1], -values[2]};
+                step = there * rotation * back;
+            } else if (is("skewX") && count == 1) {
+                step.c = tan(values[0] * RADIANS_PER_DEGREE);
+            } else if (is("skewY") && count == 1) {
+                step.b = tan(values[0] * RADIANS_PER_DEGREE);
+            } else {
+                return false;
+            }
+
+            parsed = parsed * step;
+        }
+
+        transform = parsed;
+        return true;
+    }
+};
+
+#endif //SVG_TRANSFORM_H
@@ -0,0 +1,44 @@
+#ifndef TRAVEL_MODEL_H
+#define TRAVEL_MODEL_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "SlicedJob.h"
+#include "StepperMotor/SCurveProfile.h"
+
+/**
+ * Time the plotter spends between two strokes. Travel is a coordinated joint-space move from standstill to
+ * standstill (the planner stops at every pen lift), so its duration is the busier motor's S-curve; the pen
+ * lift and drop around it cost a fixed time, unless the gap is small enough to draw through instead.
+ */
+struct TravelModel {
+    float maxSpeed = 400.0; // Steps/s, as set up in StepperMotor
+    float acceleration = 800.0; // Steps/s²
+    float jerk = 16000.0; // Steps/s³, 0 for unlimited
+    float penLiftSeconds = 0.3; // Pen up and back down
+    long mergeDistance = 1; // Steps; strokes this close are joined without lifting the pen
+
+    float moveSeconds(const long steps) const {
+        if (steps <= 0) {
+            return 0.0f;
+        }
+
+        const SCurveProfile::Limits limits = {maxSpeed, acceleration, jerk};
+        const float peak = std::min(maxSpeed, SCurveProfile::reachableSpeed(0.0f, steps / 2.0f, limits));
+        const float cruise = std::max(0.0f, steps - 2.0f * SCurveProfile::changeDistance(0.0f, peak, limits));
+
+        return 2.0f * SCurveProfile::changeSeconds(0.0f, peak, limits) + cruise / peak;
+    }
+
+    bool joins(const long steps) const {
+        return steps <= mergeDistance;
+    }
+
+    float seconds(const JointPoint &from, const JointPoint &to) const {
+        const long steps = from.distanceTo(to);
+        return moveSeconds(steps) + (joins(steps) ? 0.0f : penLiftSeconds);
+    }
+};
+
+#endif //TRAVEL_MODEL_H
@@ -0,0 +1,76 @@
+#ifndef WORKSPACE_FILTER_H
+#define WORKSPACE_FILTER_H
+
+#include <vector>
+
+#include "SlicedJob.h"
+
+/**
+ * Takes the points the arms can't reach out of a job, ending the stroke at each: drawing resumes at the next
+ * reachable point, as the StrokeBuilder does for an SVG. Checking a point is a few comparisons against the joint
+ * limits (PlotterKinematics::isReachable()), and the segments in between need none, the workspace being convex in
+ * joint space. The plotter refuses a job with such points outright, see JobSpool, so a job from elsewhere goes
+ * through here before it is written back.
+ */
+class WorkspaceFilter {
+public:
+    constexpr static uint8_t REPORTED_POINTS = 8;
+
+    /** A point out of reach, where it was in the job */
+    struct Violation {
+        size_t stroke;
+        size_t point;
+        JointPoint joints;
+    };
+
+    struct Report {
+        size_t pointsChecked = 0;
+        size_t unreachablePoints = 0;
+        size_t strokesBefore = 0;
+        size_t strokesAfter = 0;
+        std::vector<Violation> first; // Up to REPORTED_POINTS
+    };
+
+    Report run(SlicedJob &job) const {
+        Report report;
+        report.strokesBefore = job.strokes.size();
+
+        std::vector<Stroke> strokes;
+        strokes.reserve(job.strokes.size());
+
+        for (size_t strokeIndex = 0; strokeIndex < job.strokes.size(); strokeIndex++) {
+            Stroke &stroke = job.strokes[strokeIndex];
+            report.pointsChecked += stroke.points.size();
+
+            size_t kept = 0;
+            for (size_t i = 0; i < stroke.points.size(); i++) {
+                const JointPoint &point = stroke.points[i];
+                if (PlotterKinematics::isReachable(point.a, point.b)) {
+                    continue;
+                }
+
+                if (report.first.size() < REPORTED_POINTS) {
+                    report.first.push_back({strokeIndex, i, point});
+                }
+                report.unreachablePoints++;
+
+                if (i - kept >= 2) {
+                    strokes.push_back({{stroke.points.begin() + kept, stroke.points.begin() + i}, stroke.speedLimit});
+                }
+                kept = i + 1;
+            }
+
+            if (kept == 0) {
+                strokes.push_back(std::move(stroke));
+            } else if (stroke.points.size() - kept >= 2) {
+                strokes.push_back({{stroke.points.begin() + kept, stroke.points.end()}, stroke.speedLimit});
+            }
+        }
+
+        job.strokes = std::move(strokes);
+        report.strokesAfter = job.strokes.size();
+        return report;
+    }
+};
+
+#endif //WORKSPACE_FILTER_H
@@ -0,0 +1,170 @@
+#ifndef LINEAR_MOVE_H
+#define LINEAR_MOVE_H
+
+#include <Arduino.h>
+#include <algorithm>
+
+#include "SCurveProfile.h"
+
+/**
+ * Straight line in joint space, stepped Bresenham-style: the axis with more steps (major) follows a
+ * jerk-limited speed profile (SCurveProfile) and the other axis steps whenever its error term crosses over,
+ * so both arms start and finish the move together.
+ *
+ * Speeds are given along the path, in joint-space steps/s (euclidean length of the (A, B) step delta).
+ */
+class LinearMove {
+public:
+    constexpr static uint8_t AXIS_COUNT = 2;
+
+    long target[AXIS_COUNT] = {};
+    float entrySpeed = 0.0;
+    float exitSpeed = 0.0;
+    float speedLimit = 0.0; // 0 for as fast as the axes allow
+
+private:
+    uint32_t steps[AXIS_COUNT] = {};
+    int8_t direction[AXIS_COUNT] = {};
+    uint8_t majorAxis = 0;
+    uint32_t majorSteps = 0;
+    uint32_t stepIndex = 0;
+    uint32_t minorStepIndex = 0;
+    int32_t error = 0;
+    long start[AXIS_COUNT] = {};
+
+    float majorPerPath = 0.0; // Major axis steps per path step
+    SCurveProfile profile; // Major axis steps, steps/s, steps/s², steps/s³
+    SCurveProfile::Cursor cursor = {};
+    float carryUs = 0.0; // Fraction of a µs the intervals so far were rounded down by
+
+public:
+    LinearMove() = default;
+
+    LinearMove(const long targetA, const long targetB, const float entrySpeed = 0.0, const float exitSpeed = 0.0,
+               const float speedLimit = 0.0)
+        : target{targetA, targetB}, entrySpeed(entrySpeed), exitSpeed(exitSpeed), speedLimit(speedLimit) {
+    }
+
+    /**
+     * Prepares stepping from the given position. Per-axis limits are converted to the major axis,
+     * so the axis travelling the most sets the pace and neither axis exceeds its own limits.
+     */
+    void begin(const long from[AXIS_COUNT], const float maxSpeed[AXIS_COUNT], const float acceleration[AXIS_COUNT],
+               const float jerk[AXIS_COUNT]) {
+        float lengthSquared = 0.0;
+
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            const long delta = target[axis] - from[axis];
+            start[axis] = from[axis];
+            steps[axis] = abs(delta);
+            direction[axis] = delta < 0 ? -1 : 1;
+            lengthSquared += static_cast<float>(delta) * delta;
+        }
+
+        majorAxis = steps[1] > steps[0] ? 1 : 0;
+        majorSteps = steps[majorAxis];
+        stepIndex = 0;
+        minorStepIndex = 0;
+        error = majorSteps / 2;
+        cursor = {};
+        carryUs = 0.0;
+
+        if (majorSteps == 0) {
+            return;
+        }
+
+        SCurveProfile::Limits limits = {maxSpeed[majorAxis], acceleration[majorAxis], 0.0f};
+
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if (steps[axis] == 0) {
+                continue;
+            }
+
+            const float ratio = static_cast<float>(majorSteps) / steps[axis];
+            limits.speed = std::min(limits.speed, maxSpeed[axis] * ratio);
+            limits.acceleration = std::min(limits.acceleration, acceleration[axis] * ratio);
+            if (jerk[axis] > 0.0f) {
+                limits.jerk = limits.jerk > 0.0f ? std::min(limits.jerk, jerk[axis] * ratio) : jerk[axis] * ratio;
+            }
+        }
+
+        majorPerPath = majorSteps / sqrtf(lengthSquared);
+        if (speedLimit > 0.0f) {
+            limits.speed = std::min(limits.speed, speedLimit * majorPerPath);
+        }
+        profile.plan(majorSteps, std::min(entrySpeed * majorPerPath, limits.speed),
+                     std::min(exitSpeed * majorPerPath, limits.speed), limits);
+    }
+
+    bool hasStep() const {
+        return stepIndex < majorSteps;
+    }
+
+    /** Time the steps not yet taken will need, as nextStep() will time them */
+    uint32_t remainingUs() const {
+        return static_cast<uint32_t>((profile.getDuration() - profile.elapsed(cursor)) * 1000000.0f);
+    }
+
+    /**
+     * Advances one major axis step. Each step is timed for when the profile reaches it, so the last one lands
+     * on the end of the move.
+     * @return µs since the previous step of this move (or since the end of the previous move)
+     */
+    uint32_t nextStep(uint8_t &stepMask, uint8_t &dirMask) {
+        const uint8_t minorAxis = majorAxis ^ 1;
+        const float exactUs = profile.advance(stepIndex + 1, cursor) * 1000000.0f + carryUs;
+        const uint32_t interval = static_cast<uint32_t>(exactUs);
+        carryUs = exactUs - interval;
+
+        stepMask = 1 << majorAxis;
+        dirMask = 0;
+
+        error -= steps[minorAxis];
+        if (error < 0) {
+            error += majorSteps;
+            stepMask |= 1 << minorAxis;
+            minorStepIndex++;
+        }
+
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if (direction[axis] > 0) {
+                dirMask |= 1 << axis;
+            }
+        }
+
+        stepIndex++;
+
+        return interval;
+    }
+
+    /** Where the steps handed out so far take the axis */
+    long getPlannedPosition(const uint8_t axis) const {
+        const uint32_t stepped = axis == majorAxis ? stepIndex : minorStepIndex;
+        return start[axis] + direction[axis] * static_cast<long>(stepped);
+    }
+
+    /** Path speed (see above) at the last step handed out */
+    float getPlannedSpeed() const {
+        return toPathSpeed(profile.at(profile.elapsed(cursor)).speed);
+    }
+
+    const SCurveProfile &getProfile() const {
+        return profile;
+    }
+
+    uint8_t getMajorAxis() const {
+        return majorAxis;
+    }
+
+    /** Steps the move makes on `axis`, signed */
+    long getSteps(const uint8_t axis) const {
+        return direction[axis] * static_cast<long>(steps[axis]);
+    }
+
+    /** Path speed (see above) for a major axis speed of the profile */
+    float toPathSpeed(const float majorSpeed) const {
+        return majorPerPath > 0.0f ? majorSpeed / majorPerPath : 0.0f;
+    }
+};
+
+#endif //LINEAR_MOVE_H
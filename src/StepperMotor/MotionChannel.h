@@ -0,0 +1,73 @@
+#ifndef MOTION_CHANNEL_H
+#define MOTION_CHANNEL_H
+
+#include "StepperMotorCoordinator.h"
+#include "Concurrency/FlashWriteGate.h"
+#include "Concurrency/SeqlockSnapshot.h"
+#include "Concurrency/SpscQueue.h"
+
+/** Request from the network/UI task to the motion task */
+struct MotionCommand {
+    enum Type : uint8_t {
+        jog, // Moves one arm by `steps`, only while homed and idle
+        startStreamedJob, // Draws the job stream once the current job is done
+        holdJob, // Feed hold, see StepperMotorCoordinator::hold()
+        resumeJob,
+        abortJob
+    };
+
+    Type type;
+    uint8_t axis;
+    long steps;
+};
+
+/** What the motion task last published about the arms */
+struct MotionStatus {
+    long positionA;
+    long positionB;
+    HomingSequence homingSequence;
+    bool moving;
+    bool penUp;
+    uint32_t configVersion; // Of MotionChannel::config, as last applied
+    FeedHold feedHold;
+    uint32_t unreachableMoves; // Skipped by the coordinator since boot
+};
+
+/**
+ * Everything that crosses between the two cores. The motion task is the only consumer of `commands` and
+ * `gcodeBytes` and the only writer of `status` and `gcodeLines`, the network/UI task the only producer of
+ * `commands` and `gcodeBytes` and writer of `config`. The motion task applies a new `config` once it is between
+ * jobs, see StepperMotorCoordinator::applyConfig().
+ *
+ * Serial G-code is read by the network task, so the UART and its lock stay off the motion core: bytes go through
+ * `gcodeBytes`, and each line the interpreter takes is counted in `gcodeLines` for the network task to answer
+ * with "ok".
+ *
+ * Flash writes on the network task (settings, checkpoints, uploads) first park the arms through `flashWrites`.
+ */
+struct MotionChannel {
+    constexpr static uint16_t COMMAND_CAPACITY = 16;
+    constexpr static uint16_t GCODE_CAPACITY = 256; // Bytes, a few lines ahead of the interpreter
+
+    SpscQueue<MotionCommand, COMMAND_CAPACITY> commands;
+    SeqlockSnapshot<MotionStatus> status;
+    SeqlockSnapshot<MotionConfig> config;
+    std::atomic<uint32_t> droppedCommands{0};
+
+    SpscQueue<char, GCODE_CAPACITY> gcodeBytes;
+    std::atomic<uint32_t> gcodeLines{0}; // Taken by the interpreter since boot
+
+    FlashWriteGate flashWrites;
+
+    /** Network/UI side, never blocks: a command that doesn't fit is counted and dropped */
+    bool send(const MotionCommand &command) {
+        if (commands.push(command)) {
+            return true;
+        }
+
+        droppedCommands.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+#endif //MOTION_CHANNEL_H
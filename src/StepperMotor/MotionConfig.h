@@ -0,0 +1,193 @@
+#ifndef MOTION_CONFIG_H
+#define MOTION_CONFIG_H
+
+#include <Arduino.h>
+#include <cstddef>
+
+#include "ServoPWM.h"
+#include "StepperMotor.h"
+#include "Kinematics/RhombusKinematics.h"
+
+/**
+ * Motion tuning that can change without a reflash: arm limits, homing and the pen. Stored in NVS as part of
+ * PrefsData, edited as `name=value` text over HTTP and telnet, and applied by the coordinator between jobs.
+ *
+ * Geometry (arm length, steps per revolution, workspace and arm range) is not in here: the fixed-point
+ * kinematics are compiled for it, and compact jobs carry its hash, so changing it means a new firmware anyway.
+ */
+struct MotionConfig {
+    // Per arm, A then B
+    float maxSpeed[2] = {StepperMotor::MAX_SPEED, StepperMotor::MAX_SPEED}; // Steps/s
+    float acceleration[2] = {StepperMotor::ACCELERATION, StepperMotor::ACCELERATION}; // Steps/s²
+    float jerk[2] = {StepperMotor::JERK, StepperMotor::JERK}; // Steps/s³, drawing moves only, 0 for unlimited
+
+    float homingSeekSpeed = StepperMotor::MAX_SPEED; // Steps/s
+    float homingProbeSpeed = 40.0f;
+    int32_t homingBackoff = 50; // Steps, clears the switch after the fast seek's overshoot
+    int32_t homingOffset = 200; // Steps off each switch once homed
+    int32_t armSeparation = 200; // Steps B stays above A after homing
+
+    uint8_t penDownDegrees = ServoPWM::DOWN_DEGREES;
+    uint8_t penUpDegrees = ServoPWM::UP_DEGREES;
+    uint16_t penDropMs = SERVO_DROP_MS;
+    uint16_t penLiftMs = SERVO_LIFT_MS;
+    uint16_t penClearMs = SERVO_CLEAR_MS;
+    uint16_t penRampMs = 0;
+
+    ServoPWM::Timing penTiming() const {
+        return {penDropMs, penLiftMs, penClearMs, penRampMs};
+    }
+
+private:
+    enum FieldType : uint8_t { f32, i32, u16, u8 };
+
+    struct Field {
+        const char *name;
+        FieldType type;
+        uint16_t offset;
+        float min;
+        float max;
+    };
+
+    constexpr static uint8_t FIELD_COUNT = 17;
+
+    static const Field *fields() {
+        static const Field table[FIELD_COUNT] = {
+            {"max_speed_a", f32, offsetof(MotionConfig, maxSpeed), 1, 5000},
+            {"max_speed_b", f32, offsetof(MotionConfig, maxSpeed) + sizeof(float), 1, 5000},
+            {"acceleration_a", f32, offsetof(MotionConfig, acceleration), 1, 50000},
+            {"acceleration_b", f32, offsetof(MotionConfig, acceleration) + sizeof(float), 1, 50000},
+            {"jerk_a", f32, offsetof(MotionConfig, jerk), 0, 5000000},
+            {"jerk_b", f32, offsetof(MotionConfig, jerk) + sizeof(float), 0, 5000000},
+            {"homing_seek_speed", f32, offsetof(MotionConfig, homingSeekSpeed), 1, 5000},
+            {"homing_probe_speed", f32, offsetof(MotionConfig, homingProbeSpeed), 1, 5000},
+            {"homing_backoff", i32, offsetof(MotionConfig, homingBackoff), 1, 1000},
+            {"homing_offset", i32, offsetof(MotionConfig, homingOffset), 0, 1450},
+            {"arm_separation", i32, offsetof(MotionConfig, armSeparation), 0, 2900},
+            {"pen_down_degrees", u8, offsetof(MotionConfig, penDownDegrees), 0, 180},
+            {"pen_up_degrees", u8, offsetof(MotionConfig, penUpDegrees), 0, 180},
+            {"pen_drop_ms", u16, offsetof(MotionConfig, penDropMs), 0, 5000},
+            {"pen_lift_ms", u16, offsetof(MotionConfig, penLiftMs), 0, 5000},
+            {"pen_clear_ms", u16, offsetof(MotionConfig, penClearMs), 0, 5000},
+            {"pen_ramp_ms", u16, offsetof(MotionConfig, penRampMs), 0, 5000},
+        };
+        return table;
+    }
+
+    float get(const Field &field) const {
+        const uint8_t *base = reinterpret_cast<const uint8_t *>(this) + field.offset;
+
+        switch (field.type) {
+            case f32: {
+                float value;
+                memcpy(&value, base, sizeof(value));
+                return value;
+            }
+            case i32: {
+                int32_t value;
+                memcpy(&value, base, sizeof(value));
+                return static_cast<float>(value);
+            }
+            case u16: {
+                uint16_t value;
+                memcpy(&value, base, sizeof(value));
+                return value;
+            }
+            default:
+                return *base;
+        }
+    }
+
+    void put(const Field &field, const float value) {
+        uint8_t *base = reinterpret_cast<uint8_t *>(this) + field.offset;
+
+        switch (field.type) {
+            case f32:
+                memcpy(base, &value, sizeof(value));
+                break;
+            case i32: {
+                const int32_t whole = static_cast<int32_t>(lroundf(value));
+                memcpy(base, &whole, sizeof(whole));
+                break;
+            }
+            case u16: {
+                const uint16_t whole = static_cast<uint16_t>(lroundf(value));
+                memcpy(base, &whole, sizeof(whole));
+                break;
+            }
+            default:
+                *base = static_cast<uint8_t>(lroundf(value));
+        }
+    }
+
+public:
+    /**
+     * Sets one field from text, e.g. set("acceleration_a", "1200").
+     * @return false for an unknown name, a value that doesn't parse, or one out of the field's range
+     */
+    bool set(const char *name, const char *value) {
+        for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+            const Field &field = fields()[i];
+            if (strcmp(field.name, name) != 0) {
+                continue;
+            }
+
+            char *end = nullptr;
+            const float parsed = strtof(value, &end);
+            if (end == value || *end != '\0' || !(parsed >= field.min && parsed <= field.max)) {
+                return false;
+            }
+
+            put(field, parsed);
+            return true;
+        }
+
+        return false;
+    }
+
+    /** Every field in range, and the ones that depend on each other consistent. For whatever came out of NVS. */
+    bool isValid() const {
+        for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+            const Field &field = fields()[i];
+            const float value = get(field);
+            if (!(value >= field.min && value <= field.max)) {
+                return false;
+            }
+        }
+
+        return penUpDegrees != penDownDegrees && homingProbeSpeed <= homingSeekSpeed
+               && penClearMs <= penLiftMs;
+    }
+
+    /**
+     * Writes every field as a `name=value` line, then the fixed geometry as comments.
+     * @return length written, the text is cut at a line boundary if it doesn't fit
+     */
+    size_t format(char *text, const size_t size) const {
+        size_t length = 0;
+        text[0] = '\0';
+
+        auto append = [&](const char *format, const char *name, const double value) {
+            const int written = snprintf(text + length, size - length, format, name, value);
+            if (written < 0 || static_cast<size_t>(written) >= size - length) {
+                text[length] = '\0';
+                return false;
+            }
+            length += written;
+            return true;
+        };
+
+        for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+            const Field &field = fields()[i];
+            if (!append(field.type == f32 ? "%s=%.7g\n" : "%s=%.0f\n", field.name, get(field))) {
+                return length;
+            }
+        }
+
+        append("# %s=%.0f (fixed)\n", "arm_range", PlotterKinematics::ARM_RANGE_STEPS);
+        append("# %s=%.0f (fixed)\n", "geometry_hash", PlotterKinematics::GEOMETRY_HASH);
+        return length;
+    }
+};
+
+#endif //MOTION_CONFIG_H
@@ -0,0 +1,335 @@
+#ifndef MOTION_PLANNER_H
+#define MOTION_PLANNER_H
+
+#include "StepEngine.h"
+
+/**
+ * Look-ahead stage between the path source and StepEngine.
+ *
+ * Buffered segments get entry speeds limited by the direction change at each junction (junction deviation,
+ * as in Grbl) and by what acceleration and jerk allow over the following segments, assuming the last buffered
+ * segment ends at standstill. Segments are handed to the engine only when it runs low, so each one is
+ * committed as late as possible, with the most look-ahead behind it. Since the buffer always plans down to
+ * zero, the arms come to a controlled stop whenever the source stops adding points, e.g. at a pen lift.
+ */
+class MotionPlanner {
+    constexpr static uint8_t BUFFER_SIZE = 16;
+    constexpr static uint8_t ENGINE_MOVES_AHEAD = 2;
+    // A feed hold puts the engine's moves back in front of a full buffer
+    constexpr static uint8_t CAPACITY = BUFFER_SIZE + ENGINE_MOVES_AHEAD;
+
+    // Joint-space steps; larger values carry more speed through corners
+    constexpr static float JUNCTION_DEVIATION = 2.0f;
+    // Path speed (steps/s) a junction may always be taken at, matching what the arms tolerated without look-ahead.
+    // Fades out towards a reversal, which needs a stop.
+    constexpr static float MINIMUM_JUNCTION_SPEED = 60.0f;
+
+    struct Segment {
+        long from[LinearMove::AXIS_COUNT];
+        long target[LinearMove::AXIS_COUNT];
+        float unit[LinearMove::AXIS_COUNT]; // Direction in joint space
+        float length; // Joint-space steps
+        float nominalSpeed; // Path steps/s
+        float speedLimit; // Requested cap on nominalSpeed, 0 if none
+        float acceleration; // Path steps/s²
+        float jerk; // Path steps/s³, 0 for unlimited
+        float maxEntrySpeed;
+        float entrySpeed;
+    };
+
+    StepEngine &engine;
+
+    Segment buffer[CAPACITY] = {};
+    uint8_t first = 0;
+    uint8_t count = 0;
+
+    long lastTarget[LinearMove::AXIS_COUNT] = {};
+    float committedExitSpeed = 0.0;
+
+    bool holding = false; // Segments go out slowing down to a stop, see hold()
+    bool stopCommitted = false; // The engine has every move up to the stop
+
+    Segment &at(const uint8_t index) {
+        return buffer[(first + index) % CAPACITY];
+    }
+
+    /** Path speed, acceleration and jerk at which neither axis exceeds its own limits */
+    void applyAxisLimits(Segment &segment, const long delta[LinearMove::AXIS_COUNT]) const {
+        segment.nominalSpeed = INFINITY;
+        segment.acceleration = INFINITY;
+        segment.jerk = 0.0f;
+
+        for (uint8_t axis = 0; axis < LinearMove::AXIS_COUNT; axis++) {
+            if (delta[axis] == 0) {
+                continue;
+            }
+
+            const float share = fabsf(segment.unit[axis]);
+            StepProfile &profile = engine.getProfile(axis);
+            segment.nominalSpeed = std::min(segment.nominalSpeed, profile.getMaxSpeed() / share);
+            segment.acceleration = std::min(segment.acceleration, profile.getAcceleration() / share);
+            if (profile.getJerk() > 0.0f) {
+                const float jerk = profile.getJerk() / share;
+                segment.jerk = segment.jerk > 0.0f ? std::min(segment.jerk, jerk) : jerk;
+            }
+        }
+    }
+
+    /** Direction, length and limits of the segment from `from` to its target */
+    void measure(Segment &segment, const long from[LinearMove::AXIS_COUNT]) const {
+        long delta[LinearMove::AXIS_COUNT];
+        for (uint8_t axis = 0; axis < LinearMove::AXIS_COUNT; axis++) {
+            segment.from[axis] = from[axis];
+            delta[axis] = segment.target[axis] - from[axis];
+        }
+
+        segment.length = sqrtf(static_cast<float>(delta[0]) * delta[0] + static_cast<float>(delta[1]) * delta[1]);
+        segment.unit[0] = delta[0] / segment.length;
+        segment.unit[1] = delta[1] / segment.length;
+        applyAxisLimits(segment, delta);
+        if (segment.speedLimit > 0.0f) {
+            segment.nominalSpeed = std::min(segment.nominalSpeed, segment.speedLimit);
+        }
+    }
+
+    static SCurveProfile::Limits limitsOf(const Segment &segment) {
+        return {segment.nominalSpeed, segment.acceleration, segment.jerk};
+    }
+
+    /** Highest speed a segment can start or end at to still change to `speed` over its length */
+    static float reachableSpeed(const Segment &segment, const float speed) {
+        return SCurveProfile::reachableSpeed(speed, segment.length, limitsOf(segment));
+    }
+
+    /** Lowest speed a segment entered at `entry` can be left at, slowing down as hard as its limits allow */
+    static float lowestExitSpeed(const Segment &segment, const float entry) {
+        const SCurveProfile::Limits limits = limitsOf(segment);
+        if (SCurveProfile::changeDistance(entry, 0.0f, limits) <= segment.length) {
+            return 0.0f;
+        }
+
+        float low = 0.0f;
+        float high = entry;
+        for (uint8_t i = 0; i < 24; i++) {
+            const float middle = (low + high) / 2.0f;
+            (SCurveProfile::changeDistance(middle, entry, limits) <= segment.length ? high : low) = middle;
+        }
+        return high;
+    }
+
+    float junctionSpeed(const Segment &previous, const Segment &next) const {
+        // Cosine of the angle between the reversed previous direction and the next one
+        const float cosTheta = -(previous.unit[0] * next.unit[0] + previous.unit[1] * next.unit[1]);
+        const float limit = std::min(previous.nominalSpeed, next.nominalSpeed);
+
+        if (cosTheta < -0.999999f) {
+            return limit; // Straight through
+        }
+
+        if (cosTheta > 0.999999f) {
+            return 0.0f; // Full reversal, the arms stop to turn back
+        }
+
+        const float sinHalfTheta = sqrtf(0.5f * (1.0f - cosTheta));
+        const float speed = sqrtf(next.acceleration * JUNCTION_DEVIATION * sinHalfTheta / (1.0f - sinHalfTheta));
+        // Whole going straight on, half at a right angle, none turning back
+        const float floor = MINIMUM_JUNCTION_SPEED * 0.5f * (1.0f - cosTheta);
+
+        return std::min(std::max(speed, floor), limit);
+    }
+
+    void recalculate() {
+        // Reverse pass: every segment must be able to slow down to the next entry, the last one to a stop
+        float nextEntry = 0.0;
+        for (int8_t i = count - 1; i >= 1; i--) {
+            Segment &segment = at(i);
+            segment.entrySpeed = std::min(segment.maxEntrySpeed, reachableSpeed(segment, nextEntry));
+            nextEntry = segment.entrySpeed;
+        }
+
+        // The first one continues from what the engine was already told
+        at(0).entrySpeed = committedExitSpeed;
+
+        // Forward pass: entries can't exceed what accelerating over the previous segment reaches
+        for (uint8_t i = 1; i < count; i++) {
+            const Segment &previous = at(i - 1);
+            Segment &segment = at(i);
+            segment.entrySpeed = std::min(segment.entrySpeed, reachableSpeed(previous, previous.entrySpeed));
+        }
+    }
+
+public:
+    explicit MotionPlanner(StepEngine &engine) : engine(engine) {
+    }
+
+    bool canAdd() const {
+        return count < BUFFER_SIZE;
+    }
+
+    /**
+     * Appends a drawing move to the given joint position. Check canAdd() first.
+     * @param speedLimit path speed cap in joint steps/s, 0 to run as fast as the axes allow
+     */
+    void add(const long targetA, const long targetB, const float speedLimit = 0.0f) {
+        if (!isBusy()) {
+            lastTarget[0] = engine.getProfile(0).getPosition();
+            lastTarget[1] = engine.getProfile(1).getPosition();
+            committedExitSpeed = 0.0;
+        }
+
+        if (targetA == lastTarget[0] && targetB == lastTarget[1]) {
+            return;
+        }
+
+        Segment &segment = at(count);
+        segment.target[0] = targetA;
+        segment.target[1] = targetB;
+        segment.speedLimit = speedLimit;
+        measure(segment, lastTarget);
+        segment.maxEntrySpeed = count > 0 ? junctionSpeed(at(count - 1), segment) : 0.0f;
+
+        count++;
+        lastTarget[0] = targetA;
+        lastTarget[1] = targetB;
+
+        recalculate();
+    }
+
+    /** Hands planned segments to the engine as it needs them, call every loop */
+    void run() {
+        if (holding) {
+            runHold();
+            return;
+        }
+
+        while (count > 0 && engine.getQueuedMoveCount() < ENGINE_MOVES_AHEAD && engine.canQueueMove()) {
+            const Segment &segment = at(0);
+            const float exitSpeed = count > 1 ? at(1).entrySpeed : 0.0f;
+
+            engine.queueMove(LinearMove(segment.target[0], segment.target[1], segment.entrySpeed, exitSpeed,
+                                        segment.speedLimit));
+            committedExitSpeed = exitSpeed;
+
+            first = (first + 1) % CAPACITY;
+            count--;
+        }
+    }
+
+    /**
+     * Feed hold: the arms stop along the path as soon as acceleration and jerk allow, carrying on from the speed
+     * the steps already planned end at (StepEngine::recallMoves()). The segment the stop falls in is split there,
+     * so the rest of the path stays buffered from exactly where the arms stand until resume().
+     */
+    void hold() {
+        if (holding) {
+            return;
+        }
+
+        LinearMove recalled[ENGINE_MOVES_AHEAD];
+        float speed = 0.0f;
+        const uint8_t recalledCount = engine.recallMoves(recalled, speed);
+
+        // Back in front of the buffer, the first one now from where the planned steps end
+        long from[LinearMove::AXIS_COUNT] = {engine.getProfile(0).getPosition(), engine.getProfile(1).getPosition()};
+        first = (first + CAPACITY - recalledCount) % CAPACITY;
+        count += recalledCount;
+        for (uint8_t i = 0; i < recalledCount; i++) {
+            Segment &segment = at(i);
+            segment.target[0] = recalled[i].target[0];
+            segment.target[1] = recalled[i].target[1];
+            segment.speedLimit = recalled[i].speedLimit;
+            measure(segment, from);
+            from[0] = segment.target[0];
+            from[1] = segment.target[1];
+        }
+
+        holding = true;
+        committedExitSpeed = speed;
+        stopCommitted = speed <= 0.0f;
+    }
+
+    /** While holding: hands out segments slowed down to the stop, splitting the one it falls in */
+    void runHold() {
+        while (!stopCommitted && count > 0 && engine.getQueuedMoveCount() < ENGINE_MOVES_AHEAD
+               && engine.canQueueMove()) {
+            Segment &segment = at(0);
+            const float entry = committedExitSpeed;
+            // A step longer than it takes, so rounding the stop to whole steps doesn't cut it short
+            const float stopLength = SCurveProfile::changeDistance(entry, 0.0f, limitsOf(segment)) + 1.0f;
+
+            if (stopLength < segment.length - 1.0f) {
+                const long stop[LinearMove::AXIS_COUNT] = {
+                    segment.from[0] + lroundf(segment.unit[0] * stopLength),
+                    segment.from[1] + lroundf(segment.unit[1] * stopLength)
+                };
+                engine.queueMove(LinearMove(stop[0], stop[1], entry, 0.0f, segment.speedLimit));
+                measure(segment, stop);
+                committedExitSpeed = 0.0f;
+                stopCommitted = true;
+                return;
+            }
+
+            // The buffer always ends at a standstill, the last segment has room to stop
+            const float exitSpeed = count > 1 ? lowestExitSpeed(segment, entry) : 0.0f;
+            engine.queueMove(LinearMove(segment.target[0], segment.target[1], entry, exitSpeed, segment.speedLimit));
+            committedExitSpeed = exitSpeed;
+            stopCommitted = exitSpeed <= 0.0f;
+
+            first = (first + 1) % CAPACITY;
+            count--;
+        }
+    }
+
+    /**
+     * Ends a feed hold once the arms stand still, planning the rest of the path from there.
+     * @return false while they are still stopping
+     */
+    bool resume() {
+        if (holding && !isHeld()) {
+            return false;
+        }
+
+        holding = false;
+        committedExitSpeed = 0.0f;
+        for (uint8_t i = 1; i < count; i++) {
+            at(i).maxEntrySpeed = junctionSpeed(at(i - 1), at(i));
+        }
+        if (count > 0) {
+            recalculate();
+        }
+        return true;
+    }
+
+    /** Drops what is left of the path, for an aborted job. Only once held, the arms stand still then. */
+    void clear() {
+        count = 0;
+        holding = false;
+        committedExitSpeed = 0.0f;
+    }
+
+    bool isHolding() const {
+        return holding;
+    }
+
+    /** Holding, with the arms stopped */
+    bool isHeld() const {
+        return holding && stopCommitted && !engine.isBusy();
+    }
+
+    /** Whether the arms stop within `us`, known once the last added segment is in the engine */
+    bool stopsWithinUs(const uint32_t us) const {
+        return count == 0 && engine.stopsWithinUs(us);
+    }
+
+    /** Segments added but not yet handed to the engine */
+    uint8_t getSegmentCount() const {
+        return count;
+    }
+
+    /** True until every added segment has been stepped out */
+    bool isBusy() const {
+        return count > 0 || engine.isBusy();
+    }
+};
+
+#endif //MOTION_PLANNER_H
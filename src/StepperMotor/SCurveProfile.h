@@ -0,0 +1,313 @@
+#ifndef S_CURVE_PROFILE_H
+#define S_CURVE_PROFILE_H
+
+#include <Arduino.h>
+#include <algorithm>
+
+/**
+ * Jerk-limited (S-curve) speed profile over a fixed distance, from an entry to an exit speed.
+ *
+ * Seven phases: jerk up, constant acceleration and jerk down to the peak speed, cruise, then the mirror image
+ * down to the exit speed. Each speed change starts and ends at zero acceleration, so profiles placed back to back
+ * join without a step in acceleration; the acceleration ramps at the jerk limit instead of switching on and off,
+ * which is what excites the arms. Speed changes too small to reach full acceleration skip the constant phase.
+ *
+ * Units are whatever the caller uses, LinearMove plans in major axis steps. A jerk of 0 means unlimited, which
+ * makes this a trapezoid.
+ */
+class SCurveProfile {
+public:
+    constexpr static uint8_t PHASE_COUNT = 7;
+
+    struct Limits {
+        float speed;
+        float acceleration;
+        float jerk; // 0 for unlimited
+    };
+
+    struct State {
+        float position;
+        float speed;
+        float acceleration;
+    };
+
+    /** Where stepping has got to, see advance() */
+    struct Cursor {
+        uint8_t phase;
+        float time; // Into the phase
+    };
+
+private:
+    struct Phase {
+        float duration;
+        float jerk;
+        float startTime;
+        State start;
+    };
+
+    Phase phases[PHASE_COUNT] = {};
+    float distance = 0.0f;
+    float duration = 0.0f;
+    float stretch = 1.0f;
+
+    /** Jerk phase and constant acceleration phase durations of a speed change by `change` */
+    static void changeTimes(const float change, const Limits &limits, float &rampTime, float &constantTime) {
+        if (limits.jerk <= 0.0f) {
+            rampTime = 0.0f;
+            constantTime = change / limits.acceleration;
+        } else if (change * limits.jerk >= limits.acceleration * limits.acceleration) {
+            rampTime = limits.acceleration / limits.jerk;
+            constantTime = change / limits.acceleration - rampTime;
+        } else {
+            rampTime = sqrtf(change / limits.jerk);
+            constantTime = 0.0f;
+        }
+    }
+
+    static State stateAt(const Phase &phase, const float time) {
+        const State &start = phase.start;
+        return {
+            start.position + time * (start.speed + time * (start.acceleration / 2.0f + time * phase.jerk / 6.0f)),
+            start.speed + time * (start.acceleration + time * phase.jerk / 2.0f),
+            start.acceleration + time * phase.jerk
+        };
+    }
+
+    /** Appends the three phases of a speed change, starting at `index` */
+    void addChange(uint8_t &index, const float from, const float to, const Limits &limits) {
+        float rampTime = 0.0f;
+        float constantTime = 0.0f;
+        changeTimes(fabsf(to - from), limits, rampTime, constantTime);
+
+        const float sign = to >= from ? 1.0f : -1.0f;
+        const float jerk = sign * limits.jerk;
+        const float peakAcceleration = sign * (limits.jerk > 0.0f ? limits.jerk * rampTime : limits.acceleration);
+
+        phases[index++] = {rampTime, jerk, 0.0f, {0.0f, 0.0f, 0.0f}};
+        phases[index++] = {constantTime, 0.0f, 0.0f, {0.0f, 0.0f, peakAcceleration}};
+        phases[index++] = {rampTime, -jerk, 0.0f, {0.0f, 0.0f, peakAcceleration}};
+    }
+
+    /** Time into `phase` at which it reaches `position`, searching from `from` on */
+    static float solve(const Phase &phase, const float position, const float from) {
+        const float tolerance = 1e-4f + position * 1e-6f;
+        float low = from;
+        float high = phase.duration;
+        float time = from;
+
+        // Newton on the position, falling back to bisection where the speed is ~0 or a step leaves the bracket
+        for (uint8_t i = 0; i < 32; i++) {
+            const State state = stateAt(phase, time);
+            const float error = state.position - position;
+            if (fabsf(error) < tolerance) {
+                break;
+            }
+
+            (error < 0.0f ? low : high) = time;
+            float next = state.speed > 1e-3f ? time - error / state.speed : low - 1.0f;
+            if (!(next > low && next < high)) {
+                next = (low + high) / 2.0f;
+            }
+            time = next;
+        }
+
+        return std::min(std::max(time, from), phase.duration);
+    }
+
+public:
+    /** Distance a speed change takes, the same both ways */
+    static float changeDistance(const float from, const float to, const Limits &limits) {
+        float rampTime = 0.0f;
+        float constantTime = 0.0f;
+        changeTimes(fabsf(to - from), limits, rampTime, constantTime);
+
+        return (from + to) / 2.0f * (2.0f * rampTime + constantTime);
+    }
+
+    /** Time a speed change takes, the same both ways */
+    static float changeSeconds(const float from, const float to, const Limits &limits) {
+        float rampTime = 0.0f;
+        float constantTime = 0.0f;
+        changeTimes(fabsf(to - from), limits, rampTime, constantTime);
+
+        return 2.0f * rampTime + constantTime;
+    }
+
+    /**
+     * Highest speed reachable from `from` within `length`, which is also the highest speed that can still slow
+     * down to `from` within it. What a look-ahead planner needs in place of sqrt(v² + 2as).
+     */
+    static float reachableSpeed(const float from, const float length, const Limits &limits) {
+        const float acceleration = limits.acceleration;
+        float change = 0.0f;
+
+        if (limits.jerk <= 0.0f) {
+            change = sqrtf(from * from + 2.0f * acceleration * length) - from;
+        } else if (length >= changeDistance(from, from + acceleration * acceleration / limits.jerk, limits)) {
+            // Long enough to reach full acceleration: the distance is quadratic in the speed change
+            const float fullChange = acceleration * acceleration / limits.jerk;
+            const float b = 2.0f * from + fullChange;
+            const float c = 2.0f * from * fullChange - 2.0f * acceleration * length;
+            change = (-b + sqrtf(b * b - 4.0f * c)) / 2.0f;
+        } else {
+            // Otherwise jerk x³ + 2 from x = length for x = sqrt(change / jerk). Newton from an upper bound
+            // converges from above on this convex, increasing cubic.
+            float x = cbrtf(length / limits.jerk);
+            if (from > 0.0f) {
+                x = std::min(x, length / (2.0f * from));
+            }
+            for (uint8_t i = 0; i < 8; i++) {
+                x -= (limits.jerk * x * x * x + 2.0f * from * x - length) / (3.0f * limits.jerk * x * x + 2.0f * from);
+            }
+            change = limits.jerk * x * x;
+        }
+
+        // At speed, a step's worth of change is only a few ulps: round towards `from` so plan() never falls short
+        const float speed = from + std::max(change, 0.0f);
+        return speed - from > change ? nextafterf(speed, from) : speed;
+    }
+
+    /**
+     * Plans `length` from `entry` to `exit` speed, cruising as fast as the limits and distance allow.
+     * @return false if the speeds can't be met within the limits; acceleration and jerk are then stretched just
+     *         enough to make it, see getStretch()
+     */
+    bool plan(const float length, const float entry, const float exit, Limits limits) {
+        distance = length;
+
+        // Peaking at the faster of entry and exit is the least distance any profile needs
+        const float floor = std::max(entry, exit);
+        const float needed = changeDistance(entry, floor, limits) + changeDistance(floor, exit, limits);
+        stretch = std::max(1.0f, needed / length);
+
+        float peak = floor;
+        if (stretch > 1.0f) {
+            // Acceleration k times and jerk k² times higher make every speed change k times shorter
+            limits.acceleration *= stretch;
+            limits.jerk *= stretch * stretch;
+        } else if (changeDistance(entry, limits.speed, limits) + changeDistance(limits.speed, exit, limits)
+                   <= length) {
+            peak = limits.speed;
+        } else {
+            float low = floor;
+            float high = limits.speed;
+            for (uint8_t i = 0; i < 24; i++) {
+                const float middle = (low + high) / 2.0f;
+                const float used = changeDistance(entry, middle, limits) + changeDistance(middle, exit, limits);
+                (used <= length ? low : high) = middle;
+            }
+            peak = low;
+        }
+
+        const float cruiseLength = std::max(0.0f, length - changeDistance(entry, peak, limits)
+                                                  - changeDistance(peak, exit, limits));
+
+        uint8_t index = 0;
+        addChange(index, entry, peak, limits);
+        phases[index++] = {peak > 0.0f ? cruiseLength / peak : 0.0f, 0.0f, 0.0f, {0.0f, 0.0f, 0.0f}};
+        addChange(index, peak, exit, limits);
+
+        // Positions and speeds carry over, accelerations are as set per phase
+        State state = {0.0f, entry, 0.0f};
+        float time = 0.0f;
+        for (Phase &phase: phases) {
+            phase.start.position = state.position;
+            phase.start.speed = state.speed;
+            phase.startTime = time;
+
+            if (phase.duration > 0.0f) {
+                state = stateAt(phase, phase.duration);
+                time += phase.duration;
+            }
+        }
+        duration = time;
+
+        return stretch == 1.0f;
+    }
+
+    float getDistance() const {
+        return distance;
+    }
+
+    /** Seconds */
+    float getDuration() const {
+        return duration;
+    }
+
+    /**
+     * How many times its acceleration limit the last plan() needed to meet its entry and exit speeds, 1 if it
+     * kept to the limits (jerk is this squared). Planners using reachableSpeed() stay within float rounding of 1.
+     */
+    float getStretch() const {
+        return stretch;
+    }
+
+    /** Per phase, for validation: speed and acceleration are extreme at a phase's ends, jerk is constant */
+    float getPhaseJerk(const uint8_t phase) const {
+        return phases[phase].jerk;
+    }
+
+    float getPhaseDuration(const uint8_t phase) const {
+        return phases[phase].duration;
+    }
+
+    State getPhaseStart(const uint8_t phase) const {
+        return phases[phase].start;
+    }
+
+    State getPhaseEnd(const uint8_t phase) const {
+        return stateAt(phases[phase], phases[phase].duration);
+    }
+
+    /** State `time` seconds in, for validation and plots */
+    State at(const float time) const {
+        for (int8_t phase = PHASE_COUNT - 1; phase >= 0; phase--) {
+            if (time >= phases[phase].startTime && phases[phase].duration > 0.0f) {
+                return stateAt(phases[phase], std::min(time - phases[phase].startTime, phases[phase].duration));
+            }
+        }
+
+        return phases[0].start;
+    }
+
+    /** Seconds from the start to the cursor */
+    float elapsed(const Cursor &cursor) const {
+        return cursor.phase < PHASE_COUNT ? phases[cursor.phase].startTime + cursor.time : duration;
+    }
+
+    /**
+     * Moves the cursor on to where the profile reaches `position`, never back.
+     * @return seconds from the old cursor to the new one
+     */
+    float advance(const float position, Cursor &cursor) const {
+        // The end is where the profile is, not where the solver gets within tolerance of it
+        if (position >= distance) {
+            const float seconds = duration - elapsed(cursor);
+            cursor = {PHASE_COUNT, 0.0f};
+            return seconds;
+        }
+
+        float seconds = 0.0f;
+
+        while (cursor.phase < PHASE_COUNT) {
+            const Phase &phase = phases[cursor.phase];
+            const bool last = cursor.phase == PHASE_COUNT - 1;
+            const float end = last ? distance : phases[cursor.phase + 1].start.position;
+
+            if (phase.duration > 0.0f && (position <= end || last)) {
+                const float time = solve(phase, position, cursor.time);
+                seconds += time - cursor.time;
+                cursor.time = time;
+                return seconds;
+            }
+
+            seconds += phase.duration - cursor.time;
+            cursor.phase++;
+            cursor.time = 0.0f;
+        }
+
+        return seconds;
+    }
+};
+
+#endif //S_CURVE_PROFILE_H
@@ -0,0 +1,436 @@
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+
+#include "LinearMove.h"
+#include "StepProfile.h"
+#include "StepTimer.h"
+
+/**
+ * Timer-interrupt step generation for both arms.
+ *
+ * The main loop plans steps ahead (fill()) into a queue of timed events; the timer ISR pops one event per alarm,
+ * pulses the STEP pins and re-arms itself with the interval to the next event. Step timing therefore no longer
+ * depends on how often loop() runs, only on the queue holding enough lead time to ride out a slow iteration.
+ *
+ * Steps come either from the per-axis profiles (homing, jogging) or from queued coordinated LinearMoves.
+ * Linear moves wait until both profiles are idle, and a finished linear move replaces the profiles' targets.
+ */
+class StepEngine {
+public:
+    constexpr static uint8_t AXIS_COUNT = 2;
+
+private:
+    constexpr static uint16_t QUEUE_SIZE = 256; // Power of two
+    constexpr static uint16_t QUEUE_MASK = QUEUE_SIZE - 1;
+    constexpr static uint32_t MAX_LEAD_US = 20000; // How far ahead of the ISR steps are planned
+    constexpr static uint32_t MIN_INTERVAL_US = 5;
+    constexpr static uint8_t MOVE_QUEUE_SIZE = 8;
+
+    struct StepEvent {
+        uint32_t intervalUs; // Since the previous event
+        uint8_t stepMask;
+        uint8_t dirMask;
+    };
+
+    static StepEngine *instance;
+
+    StepTimer timer;
+
+    uint8_t stepPins[AXIS_COUNT];
+    uint8_t dirPins[AXIS_COUNT];
+    uint32_t stepPinMask = 0;
+    uint32_t dirPinMasks[AXIS_COUNT] = {};
+
+    StepEvent queue[QUEUE_SIZE] = {};
+    std::atomic<uint16_t> head{0}; // Written by fill()
+    std::atomic<uint16_t> tail{0}; // Written by the ISR
+
+    volatile int32_t positions[AXIS_COUNT] = {}; // Where the arms physically are
+    volatile uint32_t stepCounts[AXIS_COUNT] = {}; // Steps pulsed, either direction
+    std::atomic<uint32_t> executedUs{0}; // Sum of intervals the ISR has played
+    volatile bool timerRunning = false;
+    uint8_t currentDirMask = 0;
+
+    StepProfile profiles[AXIS_COUNT];
+    uint32_t plannedUs = 0; // Sum of intervals queued so far
+    uint32_t lastStepUs[AXIS_COUNT] = {};
+    uint32_t plannedStepCounts[AXIS_COUNT] = {};
+
+    // Telemetry: the ISR running dry while steps were still waiting to be planned
+    bool planningAhead = false; // The last fill() stopped at the lead limit, not for lack of steps
+    uint32_t underruns = 0;
+    uint32_t lowestLeadUs = MAX_LEAD_US;
+
+    LinearMove moves[MOVE_QUEUE_SIZE];
+    uint8_t moveHead = 0;
+    uint8_t moveCount = 0;
+    LinearMove *activeMove = nullptr;
+    float lastExitSpeed = 0.0; // Path speed the last linear move to finish planning ended at
+    void (*moveObserver)(const LinearMove &move, uint32_t startUs) = nullptr;
+
+    static void IRAM_ATTR onTimer() {
+        instance->handleTimer();
+    }
+
+    void IRAM_ATTR handleTimer() {
+        timer.lockFromIsr();
+
+        const uint16_t currentTail = tail.load(std::memory_order_relaxed);
+
+        if (currentTail == head.load(std::memory_order_acquire)) {
+            timer.stop();
+            timerRunning = false;
+            timer.unlockFromIsr();
+            return;
+        }
+
+        const StepEvent &event = queue[currentTail];
+
+        if (event.stepMask) {
+            uint32_t stepMask = 0;
+
+            for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+                if (!(event.stepMask & 1 << axis)) {
+                    continue;
+                }
+
+                const bool up = event.dirMask & 1 << axis;
+                if (up != static_cast<bool>(currentDirMask & 1 << axis)) {
+                    if (up) {
+                        StepTimer::setPinsHigh(dirPinMasks[axis]);
+                    } else {
+                        StepTimer::setPinsLow(dirPinMasks[axis]);
+                    }
+                    currentDirMask ^= 1 << axis;
+                    StepTimer::pulseDelay();
+                }
+
+                stepMask |= 1UL << stepPins[axis];
+                positions[axis] = positions[axis] + (up ? 1 : -1);
+                stepCounts[axis] = stepCounts[axis] + 1;
+            }
+
+            StepTimer::setPinsHigh(stepMask);
+            StepTimer::pulseDelay();
+            StepTimer::setPinsLow(stepMask);
+        }
+
+        executedUs.store(executedUs.load(std::memory_order_relaxed) + event.intervalUs, std::memory_order_release);
+
+        const uint16_t nextTail = (currentTail + 1) & QUEUE_MASK;
+        tail.store(nextTail, std::memory_order_release);
+
+        if (nextTail == head.load(std::memory_order_acquire)) {
+            timer.stop();
+            timerRunning = false;
+        } else {
+            timer.setNextInterval(queue[nextTail].intervalUs);
+        }
+
+        timer.unlockFromIsr();
+    }
+
+    bool queueFull() const {
+        return ((head.load(std::memory_order_relaxed) + 1) & QUEUE_MASK) == tail.load(std::memory_order_acquire);
+    }
+
+    void push(const StepEvent &event) {
+        const uint16_t currentHead = head.load(std::memory_order_relaxed);
+        queue[currentHead] = event;
+
+        timer.lock();
+        head.store((currentHead + 1) & QUEUE_MASK, std::memory_order_release);
+
+        if (!timerRunning) {
+            timerRunning = true;
+            timer.start(queue[tail.load(std::memory_order_relaxed)].intervalUs);
+        }
+        timer.unlock();
+    }
+
+    bool planAxisEvent(StepEvent &event) {
+        int32_t due[AXIS_COUNT];
+        int32_t earliest = INT32_MAX;
+
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if (!profiles[axis].hasStep()) {
+                due[axis] = INT32_MAX;
+                continue;
+            }
+
+            // Like AccelStepper, counted from the axis' last step, so a move from standstill starts right away
+            const uint32_t elapsed = plannedUs - lastStepUs[axis];
+            const uint32_t interval = profiles[axis].getStepInterval();
+            due[axis] = elapsed >= interval ? 0 : static_cast<int32_t>(interval - elapsed);
+            earliest = std::min(earliest, due[axis]);
+        }
+
+        if (earliest == INT32_MAX) {
+            return false;
+        }
+
+        event = {std::max(static_cast<uint32_t>(earliest), MIN_INTERVAL_US), 0, 0};
+        plannedUs += event.intervalUs;
+
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if (due[axis] > earliest + static_cast<int32_t>(MIN_INTERVAL_US)) {
+                continue;
+            }
+
+            event.stepMask |= 1 << axis;
+            if (profiles[axis].getDirection() > 0) {
+                event.dirMask |= 1 << axis;
+            }
+
+            profiles[axis].onStep();
+            lastStepUs[axis] = plannedUs;
+            plannedStepCounts[axis]++;
+        }
+
+        return true;
+    }
+
+    bool startNextMove() {
+        while (moveCount > 0) {
+            LinearMove &move = moves[(moveHead + MOVE_QUEUE_SIZE - moveCount) % MOVE_QUEUE_SIZE];
+            moveCount--;
+
+            const long from[AXIS_COUNT] = {profiles[0].getPosition(), profiles[1].getPosition()};
+            const float maxSpeed[AXIS_COUNT] = {profiles[0].getMaxSpeed(), profiles[1].getMaxSpeed()};
+            const float acceleration[AXIS_COUNT] = {profiles[0].getAcceleration(), profiles[1].getAcceleration()};
+            const float jerk[AXIS_COUNT] = {profiles[0].getJerk(), profiles[1].getJerk()};
+            move.begin(from, maxSpeed, acceleration, jerk);
+
+            if (move.hasStep()) {
+                activeMove = &move;
+                if (moveObserver) {
+                    moveObserver(move, plannedUs);
+                }
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool planMoveEvent(StepEvent &event) {
+        if (!activeMove && !startNextMove()) {
+            return false;
+        }
+
+        event.intervalUs = std::max(activeMove->nextStep(event.stepMask, event.dirMask), MIN_INTERVAL_US);
+        plannedUs += event.intervalUs;
+
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if (event.stepMask & 1 << axis) {
+                lastStepUs[axis] = plannedUs;
+                plannedStepCounts[axis]++;
+            }
+        }
+
+        if (!activeMove->hasStep()) {
+            for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+                profiles[axis].setCurrentPosition(activeMove->target[axis]);
+            }
+            lastExitSpeed = activeMove->getPlannedSpeed();
+            activeMove = nullptr;
+        }
+
+        return true;
+    }
+
+public:
+    StepEngine(const uint8_t stepPinA, const uint8_t dirPinA, const uint8_t stepPinB, const uint8_t dirPinB)
+        : stepPins{stepPinA, stepPinB}, dirPins{dirPinA, dirPinB} {
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            stepPinMask |= 1UL << stepPins[axis];
+            dirPinMasks[axis] = 1UL << dirPins[axis];
+        }
+    }
+
+    /** Call once from setup(), after the pins are configured as outputs */
+    void begin() {
+        instance = this;
+        StepTimer::setPinsLow(stepPinMask | dirPinMasks[0] | dirPinMasks[1]);
+        timer.begin(onTimer);
+    }
+
+    /** Plans steps until the queue holds MAX_LEAD_US of motion, call as often as possible from the main loop */
+    void fill() {
+        if (planningAhead) {
+            const uint32_t leadUs = getLeadUs();
+            lowestLeadUs = std::min(lowestLeadUs, leadUs);
+            underruns += leadUs == 0;
+        }
+
+        planningAhead = true;
+
+        while (!queueFull() && plannedUs - executedUs.load(std::memory_order_acquire) < MAX_LEAD_US) {
+            StepEvent event = {};
+
+            const bool planned = activeMove
+                                     ? planMoveEvent(event)
+                                     : planAxisEvent(event) || planMoveEvent(event);
+            if (!planned) {
+                planningAhead = false;
+                return;
+            }
+
+            push(event);
+        }
+    }
+
+    /** Planned motion the ISR has yet to play */
+    uint32_t getLeadUs() const {
+        return plannedUs - executedUs.load(std::memory_order_acquire);
+    }
+
+    /** Sum of all intervals planned so far, the commanded timeline */
+    uint32_t getPlannedUs() const {
+        return plannedUs;
+    }
+
+    /** Steps pulsed by the ISR on the axis since boot */
+    uint32_t getStepCount(const uint8_t axis) const {
+        return stepCounts[axis];
+    }
+
+    /** Steps queued for the axis since boot */
+    uint32_t getPlannedStepCount(const uint8_t axis) const {
+        return plannedStepCounts[axis];
+    }
+
+    /**
+     * fill() calls that found the queue played out while more steps were waiting, so the next step left late.
+     * Also counts slow steps whose interval alone exceeds the lead, those are late by up to a loop iteration.
+     */
+    uint32_t getUnderrunCount() const {
+        return underruns;
+    }
+
+    /** Lowest lead fill() found while more steps were waiting, how close the loop came to an underrun */
+    uint32_t getLowestLeadUs() const {
+        return lowestLeadUs;
+    }
+
+    /** Linear moves queued or being stepped */
+    uint8_t getQueuedMoveCount() const {
+        return moveCount + (activeMove ? 1 : 0);
+    }
+
+    bool canQueueMove() const {
+        return moveCount < MOVE_QUEUE_SIZE - 1;
+    }
+
+    /**
+     * Called with each linear move as stepping it starts, already begun, and where it starts on the planned
+     * timeline (µs, as getPlannedUs()). For profile validation and plots, nullptr to stop.
+     */
+    void setMoveObserver(void (*observer)(const LinearMove &move, uint32_t startUs)) {
+        moveObserver = observer;
+    }
+
+    /** Queues a coordinated move of both axes, see LinearMove. Check canQueueMove() first. */
+    void queueMove(const LinearMove &move) {
+        moves[moveHead] = move;
+        moveHead = (moveHead + 1) % MOVE_QUEUE_SIZE;
+        moveCount++;
+    }
+
+    /**
+     * Takes back the linear moves not stepped yet, for a feed hold. The active move ends where planning has got to
+     * and its rest comes back as a move from there, queued moves come back as they were. Steps already planned still
+     * play out, at most MAX_LEAD_US of them, so the caller has to carry on from `speed`.
+     * @param recalled room for getQueuedMoveCount() moves
+     * @param speed set to the path speed at the end of the planned steps
+     * @return moves written to `recalled` in order, with entry and exit speeds to be planned again
+     */
+    uint8_t recallMoves(LinearMove *recalled, float &speed) {
+        uint8_t count = 0;
+        speed = moveCount > 0 || activeMove ? lastExitSpeed : 0.0f;
+
+        if (activeMove) {
+            speed = activeMove->getPlannedSpeed();
+            for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+                profiles[axis].setCurrentPosition(activeMove->getPlannedPosition(axis));
+            }
+            recalled[count++] = LinearMove(activeMove->target[0], activeMove->target[1], 0.0f, 0.0f,
+                                           activeMove->speedLimit);
+            activeMove = nullptr;
+        }
+
+        for (; moveCount > 0; moveCount--) {
+            const LinearMove &move = moves[(moveHead + MOVE_QUEUE_SIZE - moveCount) % MOVE_QUEUE_SIZE];
+            recalled[count++] = LinearMove(move.target[0], move.target[1], 0.0f, 0.0f, move.speedLimit);
+        }
+
+        return count;
+    }
+
+    /**
+     * Whether the arms will stand still within `us`. Only known once the last linear move is being stepped:
+     * false while more moves are queued or the per-axis profiles are moving.
+     */
+    bool stopsWithinUs(const uint32_t us) const {
+        if (moveCount > 0 || (!activeMove && (profiles[0].isRunning() || profiles[1].isRunning()))) {
+            return false;
+        }
+
+        // Steps already planned wait in the queue for the ISR, the active move's rest isn't planned yet
+        const uint32_t queuedUs = plannedUs - executedUs.load(std::memory_order_acquire);
+        if (queuedUs > us) {
+            return false;
+        }
+
+        return !activeMove || activeMove->remainingUs() <= us - queuedUs;
+    }
+
+    /** True while anything is queued or moving, on either axis */
+    bool isBusy() const {
+        return activeMove || moveCount > 0 || isRunning(0) || isRunning(1);
+    }
+
+    StepProfile &getProfile(const uint8_t axis) {
+        return profiles[axis];
+    }
+
+    /** Physical position, i.e. steps actually pulsed by the ISR */
+    long getPosition(const uint8_t axis) const {
+        return positions[axis];
+    }
+
+    /** True while the axis is planned to move or still has queued steps */
+    bool isRunning(const uint8_t axis) const {
+        return activeMove || moveCount > 0 || profiles[axis].isRunning()
+               || profiles[axis].getPosition() != positions[axis];
+    }
+
+    /**
+     * Stops the axis immediately and redefines its position.
+     * Its queued steps are dropped, the other axis keeps moving undisturbed. Queued linear moves are discarded.
+     */
+    void setCurrentPosition(const uint8_t axis, const long position) {
+        activeMove = nullptr;
+        moveCount = 0;
+
+        timer.lock();
+
+        for (uint16_t i = tail.load(std::memory_order_relaxed); i != head.load(std::memory_order_relaxed);
+             i = (i + 1) & QUEUE_MASK) {
+            queue[i].stepMask &= ~(1 << axis);
+        }
+
+        positions[axis] = position;
+        profiles[axis].setCurrentPosition(position);
+
+        timer.unlock();
+    }
+};
+
+inline StepEngine *StepEngine::instance = nullptr;
+
+#endif //STEP_ENGINE_H
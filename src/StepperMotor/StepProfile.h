@@ -0,0 +1,194 @@
+#ifndef STEP_PROFILE_H
+#define STEP_PROFILE_H
+
+#include <Arduino.h>
+
+/**
+ * Trapezoidal speed ramp for one axis, producing the interval to the next step.
+ * Same ramp as AccelStepper (David Austin's cn recurrence), but it only plans steps:
+ * StepEngine calls onStep() when it queues a step, and the timer ISR does the actual pulse.
+ *
+ * Also holds the axis' limits for coordinated moves, which the planner and LinearMove read. Those are
+ * jerk-limited; this ramp, used for homing and jogging, is not.
+ */
+class StepProfile {
+    long position = 0; // Planned position, i.e. including steps still waiting in the queue
+    long targetPosition = 0;
+    float speed = 0.0; // Steps/sec, negative when moving down
+    float maxSpeed = 1.0;
+    float acceleration = 1.0;
+    float jerk = 0.0; // Steps/sec³ for planned moves, 0 for unlimited
+    uint32_t stepInterval = 0; // µs to the next step, 0 if stopped
+
+    long n = 0;
+    float c0 = 0.0;
+    float cn = 0.0;
+    float cmin = 1000000.0;
+    int8_t direction = 1;
+
+    void computeNewSpeed() {
+        const long distanceTo = distanceToGo();
+        const long stepsToStop = static_cast<long>(speed * speed / (2.0f * acceleration));
+
+        if (distanceTo == 0 && stepsToStop <= 1) {
+            stepInterval = 0;
+            speed = 0.0;
+            n = 0;
+            return;
+        }
+
+        if (distanceTo > 0) {
+            if (n > 0) {
+                if (stepsToStop >= distanceTo || direction < 0) {
+                    n = -stepsToStop;
+                }
+            } else if (n < 0) {
+                if (stepsToStop < distanceTo && direction > 0) {
+                    n = -n;
+                }
+            }
+        } else if (distanceTo < 0) {
+            if (n > 0) {
+                if (stepsToStop >= -distanceTo || direction > 0) {
+                    n = -stepsToStop;
+                }
+            } else if (n < 0) {
+                if (stepsToStop < -distanceTo && direction < 0) {
+                    n = -n;
+                }
+            }
+        }
+
+        if (n == 0) {
+            cn = c0;
+            direction = distanceTo > 0 ? 1 : -1;
+        } else {
+            cn = cn - 2.0f * cn / (4.0f * n + 1);
+            cn = cn > cmin ? cn : cmin;
+        }
+
+        n++;
+        stepInterval = static_cast<uint32_t>(cn);
+        speed = direction * 1000000.0f / cn;
+    }
+
+public:
+    StepProfile() {
+        c0 = 0.676f * sqrtf(2.0f / acceleration) * 1000000.0f;
+    }
+
+    void setMaxSpeed(float newSpeed) {
+        newSpeed = fabsf(newSpeed);
+
+        if (newSpeed == 0.0f || maxSpeed == newSpeed) {
+            return;
+        }
+
+        maxSpeed = newSpeed;
+        cmin = 1000000.0f / newSpeed;
+
+        if (n > 0) {
+            n = static_cast<long>(speed * speed / (2.0f * acceleration));
+            computeNewSpeed();
+        }
+    }
+
+    void setAcceleration(float newAcceleration) {
+        newAcceleration = fabsf(newAcceleration);
+
+        if (newAcceleration == 0.0f || acceleration == newAcceleration) {
+            return;
+        }
+
+        n = static_cast<long>(n * (acceleration / newAcceleration));
+        c0 = 0.676f * sqrtf(2.0f / newAcceleration) * 1000000.0f;
+        acceleration = newAcceleration;
+        computeNewSpeed();
+    }
+
+    /** Jerk limit of coordinated moves, see SCurveProfile. 0 for unlimited. */
+    void setJerk(const float newJerk) {
+        jerk = fabsf(newJerk);
+    }
+
+    void moveTo(const long absolute) {
+        if (targetPosition != absolute) {
+            targetPosition = absolute;
+            computeNewSpeed();
+        }
+    }
+
+    void move(const long relative) {
+        moveTo(position + relative);
+    }
+
+    /** Decelerate to a stop as fast as the acceleration allows */
+    void stop() {
+        if (speed == 0.0f) {
+            return;
+        }
+
+        const long stepsToStop = static_cast<long>(speed * speed / (2.0f * acceleration)) + 1;
+        move(speed > 0 ? stepsToStop : -stepsToStop);
+    }
+
+    /** Stops immediately, without deceleration */
+    void setCurrentPosition(const long newPosition) {
+        targetPosition = position = newPosition;
+        n = 0;
+        stepInterval = 0;
+        speed = 0.0;
+    }
+
+    /** Accounts for the step StepEngine just queued and plans the next one */
+    void onStep() {
+        position += direction;
+        computeNewSpeed();
+    }
+
+    bool hasStep() const {
+        return stepInterval != 0;
+    }
+
+    uint32_t getStepInterval() const {
+        return stepInterval;
+    }
+
+    int8_t getDirection() const {
+        return direction;
+    }
+
+    long distanceToGo() const {
+        return targetPosition - position;
+    }
+
+    long getPosition() const {
+        return position;
+    }
+
+    long getTargetPosition() const {
+        return targetPosition;
+    }
+
+    float getSpeed() const {
+        return speed;
+    }
+
+    float getMaxSpeed() const {
+        return maxSpeed;
+    }
+
+    float getAcceleration() const {
+        return acceleration;
+    }
+
+    float getJerk() const {
+        return jerk;
+    }
+
+    bool isRunning() const {
+        return !(speed == 0.0f && targetPosition == position);
+    }
+};
+
+#endif //STEP_PROFILE_H
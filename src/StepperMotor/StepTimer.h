@@ -0,0 +1,77 @@
+#ifndef STEP_TIMER_H
+#define STEP_TIMER_H
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <soc/gpio_struct.h>
+
+constexpr uint8_t STEP_TIMER_ID = 0;
+constexpr uint16_t STEP_TIMER_DIVIDER = 80; // 80 MHz APB / 80 = 1 tick per µs
+
+/**
+ * One-shot-per-event hardware timer driving StepEngine::onTimer().
+ * The alarm auto-reloads, so the ISR only has to write the interval to the next event.
+ */
+class StepTimer {
+    hw_timer_t *timer = nullptr;
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+public:
+    void begin(void (*isr)()) {
+        timer = timerBegin(STEP_TIMER_ID, STEP_TIMER_DIVIDER, true);
+        timerAttachInterrupt(timer, isr, true);
+    }
+
+    void IRAM_ATTR start(const uint32_t firstIntervalUs) {
+        timerWrite(timer, 0);
+        timerAlarmWrite(timer, firstIntervalUs, true);
+        timerAlarmEnable(timer);
+    }
+
+    void IRAM_ATTR setNextInterval(const uint32_t intervalUs) {
+        timerAlarmWrite(timer, intervalUs, true);
+    }
+
+    void IRAM_ATTR stop() {
+        timerAlarmDisable(timer);
+    }
+
+    void lock() {
+        portENTER_CRITICAL(&mux);
+    }
+
+    void unlock() {
+        portEXIT_CRITICAL(&mux);
+    }
+
+    void IRAM_ATTR lockFromIsr() {
+        portENTER_CRITICAL_ISR(&mux);
+    }
+
+    void IRAM_ATTR unlockFromIsr() {
+        portEXIT_CRITICAL_ISR(&mux);
+    }
+
+    /** All stepper pins are below GPIO32, so a single register write sets them together */
+    static void IRAM_ATTR setPinsHigh(const uint32_t mask) {
+        GPIO.out_w1ts = mask;
+    }
+
+    static void IRAM_ATTR setPinsLow(const uint32_t mask) {
+        GPIO.out_w1tc = mask;
+    }
+
+    /** TMC2209 needs >100 ns STEP high and 20 ns DIR setup */
+    static void IRAM_ATTR pulseDelay() {
+        delayMicroseconds(1);
+    }
+};
+
+#else
+
+#include "Simulation/SimulatedStepTimer.h"
+
+#endif
+
+#endif //STEP_TIMER_H
@@ -1,18 +1,27 @@
 #ifndef STEPPERMOTOR_H
 #define STEPPERMOTOR_H
-#include "AccelStepper.h"
+#include "StepEngine.h"
 
 
 class StepperMotor {
-    AccelStepper &stepper;
+public:
+    // Defaults, MotionConfig overrides them at runtime
+    constexpr static float MAX_SPEED = 400; // Steps/sec
+    constexpr static float ACCELERATION = 800; // Steps/sec^2
+    constexpr static float JERK = 16000; // Steps/sec^3, drawing moves only
+
+private:
+    StepEngine &engine;
+    StepProfile &profile;
+    uint8_t axis;
 
     long minPosition = -10;
     long maxPosition = 10;
 
 public:
-    explicit StepperMotor(AccelStepper &stepper) : stepper(stepper) {
-        stepper.setMaxSpeed(400); // Steps/sec
-        stepper.setAcceleration(200); // Steps/sec^2
+    StepperMotor(StepEngine &engine, const uint8_t axis)
+        : engine(engine), profile(engine.getProfile(axis)), axis(axis) {
+        configure(MAX_SPEED, ACCELERATION, JERK);
     }
 
     static long clamp(const long min, const long value, const long max) {
@@ -20,23 +29,23 @@ public:
     }
 
     void triggerMinPositionLimitSwitch() {
-        minPosition = stepper.currentPosition();
+        minPosition = engine.getPosition(axis);
 
-        if (stepper.targetPosition() < minPosition) {
-            stepper.moveTo(minPosition);
+        if (profile.getTargetPosition() < minPosition) {
+            profile.moveTo(minPosition);
         }
 
-        stepper.stop();
+        profile.stop();
     }
 
     void triggerMaxPositionLimitSwitch() {
-        maxPosition = stepper.currentPosition();
+        maxPosition = engine.getPosition(axis);
 
-        if (stepper.targetPosition() > maxPosition) {
-            stepper.moveTo(maxPosition);
+        if (profile.getTargetPosition() > maxPosition) {
+            profile.moveTo(maxPosition);
         }
 
-        stepper.stop();
+        profile.stop();
     }
 
     void setMinPosition(const long _minPosition) {
@@ -48,7 +57,7 @@ public:
     }
 
     void setZeroPosition(long position = 0) const {
-        stepper.setCurrentPosition(position);
+        engine.setCurrentPosition(axis, position);
     }
 
     long getMinPosition() const {
@@ -60,41 +69,53 @@ public:
     }
 
     bool isRunning() const {
-        return stepper.isRunning();
+        return engine.isRunning(axis);
     }
 
+    /** Unclamped, homing seeks past the range. Job moves are kept within the joint limits by the kinematics. */
     void moveToPosition(const long position) const {
-        // const long clampedPosition = clamp(minPosition, position, maxPosition);
-
-        // if (clampedPosition != position) {
-            // printLn("Tried to move beyond limit - target %d, clamped %d", position, clampedPosition);
-        // }
-
-        stepper.moveTo(position);
+        profile.moveTo(position);
     }
 
     /** Dangerous, use only for homing */
     void moveOffset(const long offset) const {
-        stepper.move(offset);
+        profile.move(offset);
+    }
+
+    /** Stops dead where the arm is, dropping its queued steps. For homing, where a switch is the target. */
+    void stop() const {
+        engine.setCurrentPosition(axis, engine.getPosition(axis));
+    }
+
+    void setMaxSpeed(const float speed) const {
+        profile.setMaxSpeed(speed);
+    }
+
+    /** Limits for jogging and drawing; homing sets its own speeds and goes back to `maxSpeed` when done */
+    void configure(const float maxSpeed, const float acceleration, const float jerk) const {
+        profile.setMaxSpeed(maxSpeed);
+        profile.setAcceleration(acceleration);
+        profile.setJerk(jerk);
     }
 
     long getPosition() const {
-        return stepper.currentPosition();
+        return engine.getPosition(axis);
     }
 
     long getTargetPosition() const {
-        return stepper.targetPosition();
+        return profile.getTargetPosition();
     }
 
     long getDirection() const {
-        const long targetPosition = stepper.targetPosition();
-        const long currentPosition = stepper.currentPosition();
+        const long targetPosition = profile.getTargetPosition();
+        const long currentPosition = engine.getPosition(axis);
 
         return clamp(-1, targetPosition - currentPosition, 1);
     }
 
+    /** Steps are pulsed by the timer ISR, this only keeps its queue topped up */
     void run() const {
-        stepper.run();
+        engine.fill();
     }
 };
 
@@ -1,148 +1,472 @@
 #ifndef STEPPERMOTORCOORDINATOR_H
 #define STEPPERMOTORCOORDINATOR_H
-#include "gcode.h"
+#include "MotionConfig.h"
+#include "MotionPlanner.h"
+#include "ServoPWM.h"
 #include "StepperMotor.h"
 #include "Input/InputManager.h"
+#include "Job/CompiledPath.h"
+#include "Kinematics/RhombusKinematics.h"
 
+/**
+ * Where homing is, for the arm behind, then what the coordinator does once homed. Ordered: an arm's phase only
+ * moves forward.
+ */
 enum HomingSequence {
-    homingA,
-    offsettingA,
-    homingB,
-    offsettingB,
+    seekingSwitches, // Fast towards the arm's own switch; B follows A until A is zeroed and clear of its switch
+    backingOff, // Off the switch again, by MotionConfig::homingBackoff
+    probingSwitches, // Slowly back onto the switch, where the arm is zeroed
+    offsetting, // Clear of the switches, once both are known
     finished,
     drawingPath
 };
 
+/** Feed hold of the job being drawn, see StepperMotorCoordinator::hold() */
+enum FeedHold : uint8_t {
+    feedRunning,
+    feedStopping, // Arms slowing down along the path, then the pen lifts
+    feedHeld, // Stopped with the pen up, the rest of the job waits
+    feedResuming // The pen going back down where it was, before the arms carry on
+};
+
+/** How the last homing went */
+struct HomingReport {
+    uint32_t homings; // Completed since boot
+    uint32_t durationMs;
+    // Where the probe found each switch in the coordinates of the homing before, 0 for the first one. The switch
+    // positions don't move, so this is the steps lost (or switch scatter) between two homings.
+    long repeatabilitySteps[2];
+    long overshootSteps[2]; // How far past the switch the fast seek stopped, against the slow probe
+};
+
 class StepperMotorCoordinator {
+    constexpr static long HOMING_PROBE_TRAVEL_BACKOFFS = 4; // How far the probe looks for the switch
+    // Where A waits off its switch while B seeks, as the sequential homing had it: the opening stays within
+    // ARM_RANGE_STEPS less this, plus B's overshoot
+    constexpr static long HOMING_CLEARANCE_STEPS = 200;
+
+    /** One arm's progress through homing */
+    struct ArmHoming {
+        HomingSequence phase;
+        long fastHit; // Where the fast seek stopped on the switch
+        bool failed; // Reported, the arm waits for the next homing
+    };
+
+    MotionPlanner planner;
     StepperMotor &stepperMotorA;
     StepperMotor &stepperMotorB;
     ServoPWM &penServo;
     InputManager &inputManager;
 
-    const long stepperRange = 1000;
-    const long minimumStepperDistanceFromEachOther = 200;
-
-    const long homingStepLength = 32;
-    const long homingSequenceOffset = 200;
-    const long armRange = 2900;
+    const long armRange = PlotterKinematics::ARM_RANGE_STEPS;
+    MotionConfig config;
 
-    size_t drawIndex = 0;
-    bool penReadyToMove = false;
+    CompiledPath compiledPath;
+    PathSource *pathSource = &compiledPath;
+    unsigned long dwellUntil = 0; // millis(), 0 when not dwelling
     bool inMotion = false;
+    bool overlapPenMoves = true;
+    bool awaitingPen = false; // Moves wait for the arms to stop and the pen to get where it was sent
+    uint32_t unreachableMoves = 0; // Skipped since boot, see skipUnreachable()
+    uint32_t unreachableMovesAtStart = 0; // As the current job started
+
+    FeedHold feedHold = feedRunning;
+    bool resumeWithPenDown = false;
+    bool abortRequested = false;
 
     HomingSequence homingSequence = finished;
+    ArmHoming armHoming[2] = {};
+    bool followingA = false; // B copies A's travel, so the opening doesn't change while neither is zeroed
+    long followedPositionA = 0; // A's position as B last copied it
+    HomingReport homingReport = {};
+    unsigned long homingStartedMs = 0;
 
-    void runHoming() {
-        if (homingSequence == homingA) {
-            if (inputManager.limitSwitchA.takeActionIfPossible()) {
-                stepperMotorA.triggerMinPositionLimitSwitch();
-                stepperMotorA.setZeroPosition();
-                stepperMotorA.setMinPosition(armRange / -2);
-                stepperMotorA.setMaxPosition(armRange / 2);
+    StepperMotor &arm(const uint8_t index) const {
+        return index == 0 ? stepperMotorA : stepperMotorB;
+    }
+
+    Input &limitSwitch(const uint8_t index) const {
+        return index == 0 ? inputManager.limitSwitchA : inputManager.limitSwitchB;
+    }
+
+    /** A's switch sits at the bottom of its range, B's at the top */
+    static long towardsSwitch(const uint8_t index) {
+        return index == 0 ? -1 : 1;
+    }
+
+    long switchPosition(const uint8_t index) const {
+        return towardsSwitch(index) * armRange / 2;
+    }
+
+    void startSeek(const uint8_t index) {
+        StepperMotor &motor = arm(index);
+
+        // An edge from before the seek means nothing now, an arm already on its switch is caught by the level
+        limitSwitch(index).takePress();
+        motor.moveToPosition(motor.getPosition() + towardsSwitch(index) * 2 * armRange);
+    }
+
+    /**
+     * A seeks first, with B following it so the opening stays what it was while neither position is known. Once A
+     * is zeroed and waits HOMING_CLEARANCE_STEPS off its switch, B seeks. Seeking both at once would open the
+     * linkage to the whole ARM_RANGE_STEPS, past anything the arms reach when drawing.
+     */
+    void startHoming() {
+        homingStartedMs = millis();
+        awaitingPen = false;
+
+        for (uint8_t index = 0; index < 2; index++) {
+            armHoming[index].phase = seekingSwitches;
+            armHoming[index].failed = false;
+            arm(index).setMaxSpeed(config.homingSeekSpeed);
+        }
+
+        followingA = true;
+        followedPositionA = stepperMotorA.getPosition();
+        stepperMotorB.moveToPosition(stepperMotorB.getPosition());
+        startSeek(0);
+        homingSequence = seekingSwitches;
+    }
+
+    /** Moves B by as much as A moved since the last loop */
+    void followArmA() {
+        const long positionA = stepperMotorA.getPosition();
+        stepperMotorB.moveToPosition(stepperMotorB.getTargetPosition() + positionA - followedPositionA);
+        followedPositionA = positionA;
+    }
+
+    /** While B follows: parks zeroed A off its switch, then lets B seek */
+    void runFollowing() {
+        followArmA();
+        runArmHoming(0);
+
+        if (armHoming[0].phase != offsetting || stepperMotorA.isRunning()) {
+            return;
+        }
+
+        const long clearance = switchPosition(0) + HOMING_CLEARANCE_STEPS;
+        if (stepperMotorA.getPosition() != clearance) {
+            stepperMotorA.moveToPosition(clearance);
+            return;
+        }
+
+        if (stepperMotorB.isRunning()) {
+            return;
+        }
+
+        followingA = false;
+        startSeek(1);
+    }
+
+    void failArmHoming(const uint8_t index, ArmHoming &homing) {
+        if (!homing.failed) {
+            homing.failed = true;
+            printLn("Homing: %c switch not found", index == 0 ? 'A' : 'B');
+        }
+    }
+
+    /** One arm's seek, back-off and probe, run every loop once the arm seeks */
+    void runArmHoming(const uint8_t index) {
+        StepperMotor &motor = arm(index);
+        ArmHoming &homing = armHoming[index];
+        const long direction = towardsSwitch(index);
 
-                homingSequence = offsettingA;
+        // The edge from the interrupt, or the level for a switch that was already down when the phase began
+        const bool hit = limitSwitch(index).takePress()
+                         || digitalRead(limitSwitch(index).getGPIO()) == HIGH;
 
-                // Reset limit switch state if it was clicked at the very start
-                inputManager.limitSwitchB.takeActionIfPossible();
+        if (homing.phase == seekingSwitches) {
+            if (hit) {
+                motor.stop();
+                homing.fastHit = motor.getPosition();
+                motor.moveToPosition(homing.fastHit - direction * config.homingBackoff);
+                homing.phase = backingOff;
+            } else if (!motor.isRunning()) {
+                failArmHoming(index, homing);
+            }
+        } else if (homing.phase == backingOff) {
+            if (motor.isRunning()) {
+                return;
+            }
 
-                printLn("Hit A limit on %d", stepperMotorA.getPosition());
+            if (hit) {
+                // Still pressed, the switch releases further out than it engages
+                motor.moveToPosition(motor.getPosition() - direction * config.homingBackoff);
+                return;
             }
 
-            stepperMotorA.moveOffset(homingStepLength * -1);
-            stepperMotorB.moveOffset(homingStepLength * -1);
-        } else if (homingSequence == offsettingA) {
-            if (stepperMotorA.getPosition() > homingSequenceOffset) {
-                homingSequence = homingB;
-                printLn("Offset A done");
+            motor.setMaxSpeed(config.homingProbeSpeed);
+            motor.moveToPosition(motor.getPosition() + direction * HOMING_PROBE_TRAVEL_BACKOFFS * config.homingBackoff);
+            homing.phase = probingSwitches;
+        } else if (homing.phase == probingSwitches) {
+            if (hit) {
+                motor.stop();
+
+                const long probeHit = motor.getPosition();
+                homingReport.overshootSteps[index] = (homing.fastHit - probeHit) * direction;
+                homingReport.repeatabilitySteps[index] = homingReport.homings > 0
+                                                             ? probeHit - switchPosition(index)
+                                                             : 0;
+
+                motor.setZeroPosition(switchPosition(index));
+                if (index == 0) {
+                    followedPositionA += switchPosition(index) - probeHit; // Same place, A's new coordinates
+                }
+                motor.setMinPosition(armRange / -2);
+                motor.setMaxPosition(armRange / 2);
+                motor.setMaxSpeed(config.maxSpeed[index]);
+                homing.phase = offsetting;
+            } else if (!motor.isRunning()) {
+                failArmHoming(index, homing);
             }
+        }
+    }
+
+    void runHoming() {
+        if (homingSequence == drawingPath) {
+            runDrawing();
+            return;
+        }
 
-            stepperMotorA.moveOffset(homingStepLength);
-            stepperMotorB.moveOffset(homingStepLength);
-        } else if (homingSequence == homingB) {
-            if (inputManager.limitSwitchB.takeActionIfPossible()) {
-                stepperMotorB.triggerMaxPositionLimitSwitch();
-                stepperMotorB.setZeroPosition();
-                stepperMotorA.setMinPosition(armRange / -2);
-                stepperMotorA.setMaxPosition(armRange / 2);
+        if (homingSequence < offsetting) {
+            if (followingA) {
+                runFollowing();
+            } else {
+                runArmHoming(0);
+                runArmHoming(1);
+            }
+            homingSequence = std::min(armHoming[0].phase, armHoming[1].phase);
 
-                homingSequence = offsettingB;
-                printLn("Hit B limit on %d", stepperMotorB.getPosition());
+            if (homingSequence == offsetting) {
+                // Both zeroed: off the switches, towards each other, keeping the arms apart
+                const long offsetA = switchPosition(0) + config.homingOffset;
+                const long offsetB = std::max(switchPosition(1) - config.homingOffset,
+                                              offsetA + config.armSeparation);
+                stepperMotorA.moveToPosition(offsetA);
+                stepperMotorB.moveToPosition(offsetB);
             }
+            return;
+        }
+
+        if (stepperMotorA.isRunning() || stepperMotorB.isRunning()) {
+            return;
+        }
 
-            stepperMotorB.moveOffset(homingStepLength);
-        } else if (homingSequence == offsettingB) {
-            if (stepperMotorB.getPosition() < homingSequenceOffset * -1) {
-                const long halfOfRange = armRange / 2;
+        armHoming[0].phase = armHoming[1].phase = finished;
+        homingReport.homings++;
+        homingReport.durationMs = millis() - homingStartedMs;
+        homingSequence = drawingPath;
 
-                // Set "0" in both to the robot middle.
-                // Stepper A position is positive, due to CCW rotation.
-                stepperMotorA.setZeroPosition(halfOfRange * -1 + stepperMotorA.getPosition());
-                // Stepper B position is negative due to CW rotation.
-                stepperMotorB.setZeroPosition(halfOfRange + stepperMotorB.getPosition());
+        printLn("Homed in %u ms, A/B overshoot %ld/%ld, repeatability %ld/%ld steps; starting path draw",
+                static_cast<unsigned>(homingReport.durationMs), homingReport.overshootSteps[0], homingReport.overshootSteps[1],
+                homingReport.repeatabilitySteps[0], homingReport.repeatabilitySteps[1]);
+    }
+
+    /**
+     * Whether a pen move may start now. With overlapping, it starts while the arms are still slowing down, as
+     * long as the pen then reaches the paper (or leaves it) no earlier than they stop.
+     */
+    bool penMoveDue(const uint16_t leadMs) const {
+        if (!planner.isBusy()) {
+            return true;
+        }
+
+        return overlapPenMoves && planner.stopsWithinUs(leadMs * 1000UL);
+    }
 
-                homingSequence = drawingPath;
-                drawIndex = 0;
-                printLn("Offset B done; starting path draw");
+    /** Whether the pen is far enough along for the arms to move: on the paper, or clear of it for travel */
+    bool penReady() const {
+        if (!overlapPenMoves) {
+            return penServo.isSettled();
+        }
+
+        return penServo.isUp() ? penServo.isClear() : penServo.isDown();
+    }
+
+    /** Ends an aborted job where it was held: the pen is up, the arms return to zero */
+    void finishAborted() {
+        planner.clear();
+        pathSource->cancel();
+        feedHold = feedRunning;
+        abortRequested = false;
+        dwellUntil = 0;
+        awaitingPen = false;
+
+        homingSequence = finished;
+        stepperMotorB.moveToPosition(0);
+        stepperMotorA.moveToPosition(0);
+        printLn("Job aborted at A:%ld B:%ld", stepperMotorA.getPosition(), stepperMotorB.getPosition());
+    }
+
+    /** Takes over from runDrawing() while a hold is in progress */
+    void runFeedHold() {
+        if (feedHold == feedStopping) {
+            if (!planner.isHeld()) {
+                return;
             }
 
-            stepperMotorB.moveOffset(homingStepLength * -1);
-        } else if (homingSequence == drawingPath) {
-            if (drawIndex < pathLength) {
-                const long rawA = pathSteps[drawIndex][1];
-                const long rawB = pathSteps[drawIndex][0];
+            penServo.up();
+            if (!penServo.isSettled()) {
+                return;
+            }
 
-                if (rawA >= 4096 && rawB >= 4096) {
-                    penServo.up();
-                    penReadyToMove = false;
-                    drawIndex++;
+            feedHold = feedHeld;
+            printLn("Held at A:%ld B:%ld", stepperMotorA.getPosition(), stepperMotorB.getPosition());
+        }
 
-                    if (drawIndex < pathLength) {
-                        stepperMotorA.moveToPosition(pathSteps[drawIndex][1]);
-                        stepperMotorB.moveToPosition(pathSteps[drawIndex][0]);
-                    }
+        if (abortRequested) {
+            finishAborted();
+            return;
+        }
+
+        if (feedHold == feedResuming) {
+            if (resumeWithPenDown) {
+                penServo.down();
+                if (!penServo.isDown()) {
                     return;
                 }
+            }
 
-                const long currentA = stepperMotorA.getPosition();
-                const long targetA = stepperMotorA.getTargetPosition();
-                const long currentB = stepperMotorB.getPosition();
-                const long targetB = stepperMotorB.getTargetPosition();
-                const bool atTarget = abs(currentA - targetA) < 5 && abs(currentB - targetB) < 5;
+            planner.resume();
+            feedHold = feedRunning;
+            printLn("Resumed");
+        }
+    }
 
-                if (atTarget && !penReadyToMove) {
-                    penServo.down();
-                    penReadyToMove = true;
+    /** Lifts the pen instead of driving the arms out of reach; it stays up until the job lowers it again */
+    void skipUnreachable(const PathCommand &command) {
+        if (!penServo.isUp()) {
+            if (!penMoveDue(penServo.getTiming().clearMs)) {
+                return;
+            }
+            penServo.up();
+            awaitingPen = true;
+        }
+
+        if (unreachableMoves++ == unreachableMovesAtStart) {
+            printLn("Skipping moves out of reach, first A:%ld B:%ld", command.a, command.b);
+        }
+        pathSource->pop();
+    }
+
+    void runDrawing() {
+        if (feedHold != feedRunning) {
+            runFeedHold();
+            return;
+        }
+
+        if (dwellUntil != 0) {
+            if (static_cast<long>(millis() - dwellUntil) < 0) {
+                return;
+            }
+            dwellUntil = 0;
+        }
+
+        PathCommand command = {};
+
+        if (!pathSource->peek(command)) {
+            // Either the job is done, or streamed commands haven't arrived yet
+            if (pathSource->isFinished() && !planner.isBusy()) {
+                penServo.up();
+                if (!penReady()) {
                     return;
                 }
 
-                if (atTarget) {
-                    stepperMotorA.moveToPosition(rawA);
-                    stepperMotorB.moveToPosition(rawB);
-                    ++drawIndex;
-                }
-            } else {
                 homingSequence = finished;
+                awaitingPen = false;
                 stepperMotorB.moveToPosition(0);
                 stepperMotorA.moveToPosition(0);
-                penServo.up();
             }
+            return;
+        }
+
+        // Jobs are checked when they come in, this only catches a source that wasn't
+        if (command.type == PathCommand::move && !PlotterKinematics::isReachable(command.a, command.b)) {
+            skipUnreachable(command);
+            return;
+        }
+
+        if (command.type == PathCommand::move) {
+            if (awaitingPen) {
+                if (planner.isBusy() || !penReady()) {
+                    return;
+                }
+                awaitingPen = false;
+            }
+
+            // Moves are planned ahead, so the arms carry speed through points instead of stopping at each
+            if (!planner.canAdd()) {
+                return;
+            }
+
+            planner.add(command.a, command.b, command.value);
+            pathSource->pop();
+            return;
+        }
+
+        if (command.type == PathCommand::penUp || command.type == PathCommand::penDown) {
+            const bool lifting = command.type == PathCommand::penUp;
+
+            // A pen already where it should be doesn't interrupt the look-ahead
+            if (lifting != penServo.isUp()) {
+                const ServoPWM::Timing &timing = penServo.getTiming();
+                if (!penMoveDue(lifting ? timing.clearMs : timing.dropMs)) {
+                    return;
+                }
+
+                if (lifting) {
+                    penServo.up();
+                } else {
+                    penServo.down();
+                }
+                awaitingPen = true;
+            }
+
+            pathSource->pop();
+            return;
+        }
+
+        // Everything else happens at standstill: the planner has already brought the arms to a halt
+        if (planner.isBusy()) {
+            return;
+        }
+
+        if (command.type == PathCommand::dwell) {
+            dwellUntil = millis() + static_cast<unsigned long>(command.value);
+            dwellUntil += dwellUntil == 0;
+        } else if (command.type == PathCommand::home) {
+            penServo.up();
+            if (!penReady()) {
+                return;
+            }
+
+            startHoming();
+            printLn("Homing requested by job");
+        } else if (command.type == PathCommand::reportPosition) {
+            float x = 0.0;
+            float y = 0.0;
+            PlotterKinematics::forwardMillimetres(stepperMotorA.getPosition(), stepperMotorB.getPosition(), x, y);
+            printLn("Position X:%.2f Y:%.2f A:%ld B:%ld", x, y, stepperMotorA.getPosition(),
+                    stepperMotorB.getPosition());
         }
+
+        pathSource->pop();
     }
 
     void runStandard() const {
-        if (inputManager.limitSwitchA.takeActionIfPossible()) {
+        if (inputManager.limitSwitchA.takePress()) {
             stepperMotorA.triggerMinPositionLimitSwitch();
         }
 
-        if (inputManager.limitSwitchB.takeActionIfPossible()) {
+        if (inputManager.limitSwitchB.takePress()) {
             stepperMotorB.triggerMaxPositionLimitSwitch();
         }
     }
 
 public:
-    StepperMotorCoordinator(StepperMotor &_stepperMotorA, StepperMotor &_stepperMotorB, ServoPWM &penServo,
-                            InputManager &_inputManager)
-        : stepperMotorA(_stepperMotorA), stepperMotorB(_stepperMotorB), penServo(penServo),
+    StepperMotorCoordinator(StepEngine &_stepEngine, StepperMotor &_stepperMotorA, StepperMotor &_stepperMotorB,
+                            ServoPWM &penServo, InputManager &_inputManager)
+        : planner(_stepEngine), stepperMotorA(_stepperMotorA), stepperMotorB(_stepperMotorB), penServo(penServo),
           inputManager(_inputManager) {
     }
 
@@ -150,8 +474,122 @@ public:
         return homingSequence == finished;
     }
 
-    void home() {
-        homingSequence = homingA;
+    /** Moves skipped as out of reach, since boot */
+    uint32_t getUnreachableMoves() const {
+        return unreachableMoves;
+    }
+
+    HomingSequence getHomingSequence() const {
+        return homingSequence;
+    }
+
+    const HomingReport &getHomingReport() const {
+        return homingReport;
+    }
+
+    const MotionPlanner &getPlanner() const {
+        return planner;
+    }
+
+    const MotionConfig &getConfig() const {
+        return config;
+    }
+
+    FeedHold getFeedHold() const {
+        return feedHold;
+    }
+
+    /**
+     * Takes over arm limits, homing and pen settings, only between jobs: homed or never homed, arms and pen at
+     * rest. Nothing in flight was planned with the old limits then, and homing always starts from the new ones.
+     * @return false if busy, the caller retries later
+     */
+    bool applyConfig(const MotionConfig &_config) {
+        if (homingSequence != finished || planner.isBusy() || stepperMotorA.isRunning()
+            || stepperMotorB.isRunning() || !penServo.isSettled()) {
+            return false;
+        }
+
+        config = _config;
+        stepperMotorA.configure(config.maxSpeed[0], config.acceleration[0], config.jerk[0]);
+        stepperMotorB.configure(config.maxSpeed[1], config.acceleration[1], config.jerk[1]);
+        penServo.setTiming(config.penTiming());
+        penServo.setAngles(config.penDownDegrees, config.penUpDegrees);
+        return true;
+    }
+
+    /** Off: pen moves start only once the arms stand still, and the arms wait until the pen has settled */
+    void setPenOverlap(const bool overlap) {
+        overlapPenMoves = overlap;
+    }
+
+    /** Homes, then draws the given job, the path compiled into the firmware by default */
+    void home(PathSource *job = nullptr) {
+        compiledPath.rewind();
+        pathSource = job ? job : &compiledPath;
+        startHoming();
+    }
+
+    /**
+     * Feed hold: the arms slow down along the path and stop, then the pen lifts. resume() lowers it again where
+     * it was and carries on from exactly there, without homing.
+     * @return false if no job is being drawn, or it is held already
+     */
+    bool hold() {
+        if (homingSequence != drawingPath || feedHold == feedStopping || feedHold == feedHeld) {
+            return false;
+        }
+
+        // Held again while resuming: the pen was down before the first hold, and goes back up now
+        if (feedHold == feedRunning) {
+            resumeWithPenDown = !penServo.isUp();
+        }
+        planner.hold();
+        feedHold = feedStopping;
+        printLn("Feed hold");
+        return true;
+    }
+
+    /** @return false unless held */
+    bool resume() {
+        if (feedHold != feedHeld || abortRequested) {
+            return false;
+        }
+
+        feedHold = feedResuming;
+        return true;
+    }
+
+    /**
+     * Ends the job being drawn: held first, as by hold(), then the rest is dropped and the arms return to zero
+     * with the pen up. The source is told through PathSource::cancel().
+     * @return false if no job is being drawn
+     */
+    bool abort() {
+        if (homingSequence != drawingPath) {
+            return false;
+        }
+
+        abortRequested = true;
+        if (feedHold == feedRunning || feedHold == feedResuming) {
+            planner.hold();
+            feedHold = feedStopping;
+        }
+        return true;
+    }
+
+    /** Draws from the given source, once homed and idle. The source must outlive the job. */
+    bool startJob(PathSource &source) {
+        if (homingSequence != finished) {
+            return false;
+        }
+
+        pathSource = &source;
+        dwellUntil = 0;
+        awaitingPen = false;
+        unreachableMovesAtStart = unreachableMoves;
+        homingSequence = drawingPath;
+        return true;
     }
 
     void run() {
@@ -161,8 +599,10 @@ public:
             runStandard();
         }
 
+        planner.run();
         stepperMotorA.run();
         stepperMotorB.run();
+        penServo.run();
     }
 };
 
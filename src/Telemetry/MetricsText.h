@@ -0,0 +1,75 @@
+#ifndef METRICS_TEXT_H
+#define METRICS_TEXT_H
+
+#include <Arduino.h>
+#include <cinttypes>
+#include <cstdarg>
+
+/**
+ * Builds the Prometheus-style text served at /metrics and printed by the telnet "metrics" command, one
+ * `name{labels} value` line per metric, into a caller-owned buffer. Lines that don't fit are dropped whole.
+ */
+class MetricsText {
+    char *text;
+    size_t size;
+    size_t length = 0;
+    bool truncated = false;
+
+    void append(const char *name, const char *labels, const char *format, ...) __attribute__((format(printf, 4, 5))) {
+        char value[24];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(value, sizeof(value), format, args);
+        va_end(args);
+
+        const int written = labels
+                                ? snprintf(text + length, size - length, "plotter_%s{%s} %s\n", name, labels, value)
+                                : snprintf(text + length, size - length, "plotter_%s %s\n", name, value);
+
+        if (written < 0 || static_cast<size_t>(written) >= size - length) {
+            text[length] = '\0';
+            truncated = true;
+            return;
+        }
+
+        length += written;
+    }
+
+public:
+    MetricsText(char *text, const size_t size) : text(text), size(size) {
+        text[0] = '\0';
+    }
+
+    void add(const char *name, const uint64_t value, const char *labels = nullptr) {
+        append(name, labels, "%" PRIu64, value);
+    }
+
+    void add(const char *name, const uint32_t value, const char *labels = nullptr) {
+        append(name, labels, "%" PRIu32, value);
+    }
+
+    void add(const char *name, const int32_t value, const char *labels = nullptr) {
+        append(name, labels, "%" PRId32, value);
+    }
+
+    void add(const char *name, const float value, const char *labels = nullptr) {
+        append(name, labels, "%.1f", static_cast<double>(value));
+    }
+
+    const char *getText() const {
+        return text;
+    }
+
+    size_t getLength() const {
+        return length;
+    }
+
+    bool isTruncated() const {
+        return truncated;
+    }
+};
+
+/** Defined by the firmware: everything /metrics and the telnet "metrics" command report */
+void writeMetrics(MetricsText &metrics);
+
+#endif //METRICS_TEXT_H
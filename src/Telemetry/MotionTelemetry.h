@@ -0,0 +1,290 @@
+#ifndef MOTION_TELEMETRY_H
+#define MOTION_TELEMETRY_H
+
+#include "MetricsText.h"
+#include "ServoPWM.h"
+#include "Concurrency/SeqlockSnapshot.h"
+#include "StepperMotor/StepperMotorCoordinator.h"
+
+/** Loop periods in log-linear buckets, four per power of two, so a percentile is off by at most a quarter */
+class LoopHistogram {
+public:
+    constexpr static uint8_t BUCKETS = 92; // Periods up to 2^24 us, longer ones share the last bucket
+
+private:
+    uint32_t counts[BUCKETS] = {};
+    uint32_t total = 0;
+
+    static uint8_t bucketOf(const uint32_t us) {
+        if (us < 4) {
+            return us;
+        }
+
+        const uint8_t octave = 31 - __builtin_clz(us);
+        if (octave >= 24) {
+            return BUCKETS - 1;
+        }
+
+        return (octave - 1) * 4 + (us >> (octave - 2) & 3);
+    }
+
+    /** Largest period that lands in the bucket */
+    static uint32_t upperBound(const uint8_t bucket) {
+        if (bucket < 4) {
+            return bucket;
+        }
+        if (bucket == BUCKETS - 1) {
+            return UINT32_MAX;
+        }
+
+        const uint8_t next = bucket + 1;
+        return ((4 + next % 4) << (next / 4 - 1)) - 1;
+    }
+
+public:
+    void add(const uint32_t us) {
+        counts[bucketOf(us)]++;
+        total++;
+    }
+
+    /** Upper bound of the bucket holding the `fraction` quantile, 0 before anything was added */
+    uint32_t percentile(const float fraction) const {
+        const uint32_t rank = std::max<uint32_t>(1, ceilf(fraction * total));
+        uint32_t seen = 0;
+
+        for (uint8_t bucket = 0; bucket < BUCKETS && total > 0; bucket++) {
+            seen += counts[bucket];
+            if (seen >= rank) {
+                return upperBound(bucket);
+            }
+        }
+
+        return 0;
+    }
+};
+
+/** What the motion task last published, see MotionTelemetry */
+struct MotionTelemetrySnapshot {
+    constexpr static uint8_t STATE_COUNT = drawingPath + 1;
+
+    uint32_t uptimeMs;
+    uint32_t loops;
+    uint32_t loopMinUs;
+    uint32_t loopP50Us;
+    uint32_t loopP90Us;
+    uint32_t loopP99Us;
+    uint32_t loopMaxUs;
+    uint32_t busyMaxUs; // Longest time from the start to the end of one iteration
+    uint64_t busyUs;
+    uint64_t overheadUs; // Spent in the telemetry itself
+
+    uint32_t steps[StepEngine::AXIS_COUNT]; // Pulsed
+    uint32_t plannedSteps[StepEngine::AXIS_COUNT];
+    float commandedRate[StepEngine::AXIS_COUNT]; // Steps/s in the last publish interval, over planned time
+    float achievedRate[StepEngine::AXIS_COUNT]; // Steps/s in the last publish interval, over time spent moving
+    float peakCommandedRate[StepEngine::AXIS_COUNT];
+    float peakAchievedRate[StepEngine::AXIS_COUNT];
+
+    uint32_t leadUs;
+    uint32_t lowestLeadUs;
+    uint32_t underruns;
+    uint8_t plannerSegments;
+    uint8_t engineMoves;
+
+    uint32_t penLifts;
+    uint32_t penDrops;
+    uint64_t penWaitUs; // Arms standing still during a job until the pen gets where it was sent
+    uint64_t stateUs[STATE_COUNT]; // Indexed by HomingSequence
+
+    HomingReport homing;
+};
+
+/**
+ * Motion loop instrumentation. The motion task calls onLoopStart() and onLoopEnd() around each iteration; the
+ * cost per call is a handful of counter updates and one histogram increment, plus a snapshot copy every
+ * PUBLISH_INTERVAL_US. Memory is fixed. Any task can read the last published snapshot or write it as metrics.
+ *
+ * Time in a state, pen waits and time spent moving are charged to what was sampled at the start of the period.
+ */
+class MotionTelemetry {
+public:
+    constexpr static uint32_t PUBLISH_INTERVAL_US = 250000;
+
+private:
+    constexpr static const char *STATE_LABELS[MotionTelemetrySnapshot::STATE_COUNT] = {
+        "state=\"seekingSwitches\"", "state=\"backingOff\"", "state=\"probingSwitches\"", "state=\"offsetting\"",
+        "state=\"finished\"", "state=\"drawingPath\""
+    };
+    constexpr static const char *AXIS_LABELS[StepEngine::AXIS_COUNT] = {"axis=\"a\"", "axis=\"b\""};
+    constexpr static const char *COMMANDED_LABELS[StepEngine::AXIS_COUNT] = {
+        "axis=\"a\",kind=\"commanded\"", "axis=\"b\",kind=\"commanded\""
+    };
+    constexpr static const char *ACHIEVED_LABELS[StepEngine::AXIS_COUNT] = {
+        "axis=\"a\",kind=\"achieved\"", "axis=\"b\",kind=\"achieved\""
+    };
+
+    const StepEngine &engine;
+    const StepperMotorCoordinator &coordinator;
+    const ServoPWM &penServo;
+
+    // Motion task only
+    MotionTelemetrySnapshot current = {};
+    LoopHistogram periods;
+    uint32_t loopStartUs = 0;
+    uint32_t lastPublishUs = 0;
+    HomingSequence lastState = finished;
+    bool wasMoving = false;
+    bool wasWaitingOnPen = false;
+    bool wasUp = true;
+
+    // Publish interval so far
+    uint32_t windowPlannedUs = 0;
+    uint32_t windowMovingUs = 0;
+    uint32_t windowSteps[StepEngine::AXIS_COUNT] = {};
+    uint32_t windowPlannedSteps[StepEngine::AXIS_COUNT] = {};
+
+    SeqlockSnapshot<MotionTelemetrySnapshot> published;
+
+    void publish(const uint32_t nowUs) {
+        const uint32_t plannedUs = engine.getPlannedUs();
+
+        for (uint8_t axis = 0; axis < StepEngine::AXIS_COUNT; axis++) {
+            const uint32_t steps = engine.getStepCount(axis);
+            const uint32_t plannedSteps = engine.getPlannedStepCount(axis);
+
+            current.commandedRate[axis] = plannedUs != windowPlannedUs
+                                              ? (plannedSteps - windowPlannedSteps[axis]) * 1e6f
+                                                / (plannedUs - windowPlannedUs)
+                                              : 0.0f;
+            current.achievedRate[axis] = windowMovingUs > 0
+                                             ? (steps - windowSteps[axis]) * 1e6f / windowMovingUs
+                                             : 0.0f;
+            current.peakCommandedRate[axis] = std::max(current.peakCommandedRate[axis],
+                                                       current.commandedRate[axis]);
+            current.peakAchievedRate[axis] = std::max(current.peakAchievedRate[axis], current.achievedRate[axis]);
+
+            current.steps[axis] = windowSteps[axis] = steps;
+            current.plannedSteps[axis] = windowPlannedSteps[axis] = plannedSteps;
+        }
+
+        windowPlannedUs = plannedUs;
+        windowMovingUs = 0;
+
+        current.uptimeMs = millis();
+        // Bucket bounds can overshoot what was actually seen
+        current.loopP50Us = std::min(periods.percentile(0.5f), current.loopMaxUs);
+        current.loopP90Us = std::min(periods.percentile(0.9f), current.loopMaxUs);
+        current.loopP99Us = std::min(periods.percentile(0.99f), current.loopMaxUs);
+        current.leadUs = engine.getLeadUs();
+        current.lowestLeadUs = engine.getLowestLeadUs();
+        current.underruns = engine.getUnderrunCount();
+        current.plannerSegments = coordinator.getPlanner().getSegmentCount();
+        current.engineMoves = engine.getQueuedMoveCount();
+        current.homing = coordinator.getHomingReport();
+
+        published.write(current);
+        lastPublishUs = nowUs;
+    }
+
+public:
+    MotionTelemetry(const StepEngine &engine, const StepperMotorCoordinator &coordinator, const ServoPWM &penServo)
+        : engine(engine), coordinator(coordinator), penServo(penServo) {
+        current.loopMinUs = UINT32_MAX;
+    }
+
+    /** Motion task, first thing in each iteration */
+    void onLoopStart(const uint32_t nowUs) {
+        if (current.loops > 0) {
+            const uint32_t periodUs = nowUs - loopStartUs;
+
+            periods.add(periodUs);
+            current.loopMinUs = std::min(current.loopMinUs, periodUs);
+            current.loopMaxUs = std::max(current.loopMaxUs, periodUs);
+            current.stateUs[lastState] += periodUs;
+            current.penWaitUs += wasWaitingOnPen ? periodUs : 0;
+            windowMovingUs += wasMoving ? periodUs : 0;
+        } else {
+            lastPublishUs = nowUs;
+        }
+
+        current.loops++;
+        loopStartUs = nowUs;
+
+        lastState = coordinator.getHomingSequence();
+        wasMoving = engine.isBusy();
+        wasWaitingOnPen = lastState == drawingPath && !wasMoving && !penServo.isSettled();
+
+        if (penServo.isUp() != wasUp) {
+            wasUp = penServo.isUp();
+            (wasUp ? current.penLifts : current.penDrops)++;
+        }
+
+        if (nowUs - lastPublishUs >= PUBLISH_INTERVAL_US) {
+            publish(nowUs);
+        }
+
+        current.overheadUs += micros() - nowUs;
+    }
+
+    /** Motion task, last thing in each iteration */
+    void onLoopEnd(const uint32_t nowUs) {
+        const uint32_t busyUs = nowUs - loopStartUs;
+        current.busyUs += busyUs;
+        current.busyMaxUs = std::max(current.busyMaxUs, busyUs);
+    }
+
+    /** Any task: what was published last, at most PUBLISH_INTERVAL_US old */
+    MotionTelemetrySnapshot read() const {
+        return published.read();
+    }
+
+    /** Any task */
+    void write(MetricsText &metrics) const {
+        const MotionTelemetrySnapshot snapshot = read();
+
+        metrics.add("uptime_ms", snapshot.uptimeMs);
+        metrics.add("motion_loops_total", snapshot.loops);
+        metrics.add("motion_loop_period_us", snapshot.loops > 1 ? snapshot.loopMinUs : 0, "quantile=\"0\"");
+        metrics.add("motion_loop_period_us", snapshot.loopP50Us, "quantile=\"0.5\"");
+        metrics.add("motion_loop_period_us", snapshot.loopP90Us, "quantile=\"0.9\"");
+        metrics.add("motion_loop_period_us", snapshot.loopP99Us, "quantile=\"0.99\"");
+        metrics.add("motion_loop_period_us", snapshot.loopMaxUs, "quantile=\"1\"");
+        metrics.add("motion_loop_busy_us_total", snapshot.busyUs);
+        metrics.add("motion_loop_busy_max_us", snapshot.busyMaxUs);
+        metrics.add("telemetry_overhead_us_total", snapshot.overheadUs);
+
+        for (uint8_t axis = 0; axis < StepEngine::AXIS_COUNT; axis++) {
+            metrics.add("steps_total", snapshot.steps[axis], AXIS_LABELS[axis]);
+            metrics.add("planned_steps_total", snapshot.plannedSteps[axis], AXIS_LABELS[axis]);
+            metrics.add("step_rate", snapshot.commandedRate[axis], COMMANDED_LABELS[axis]);
+            metrics.add("step_rate", snapshot.achievedRate[axis], ACHIEVED_LABELS[axis]);
+            metrics.add("step_rate_peak", snapshot.peakCommandedRate[axis], COMMANDED_LABELS[axis]);
+            metrics.add("step_rate_peak", snapshot.peakAchievedRate[axis], ACHIEVED_LABELS[axis]);
+        }
+
+        metrics.add("step_lead_us", snapshot.leadUs);
+        metrics.add("step_lead_lowest_us", snapshot.lowestLeadUs);
+        metrics.add("step_underruns_total", snapshot.underruns);
+        metrics.add("planner_segments", static_cast<uint32_t>(snapshot.plannerSegments));
+        metrics.add("engine_moves", static_cast<uint32_t>(snapshot.engineMoves));
+
+        metrics.add("pen_transitions_total", snapshot.penLifts, "direction=\"up\"");
+        metrics.add("pen_transitions_total", snapshot.penDrops, "direction=\"down\"");
+        metrics.add("pen_wait_us_total", snapshot.penWaitUs);
+
+        for (uint8_t state = 0; state < MotionTelemetrySnapshot::STATE_COUNT; state++) {
+            metrics.add("state_us_total", snapshot.stateUs[state], STATE_LABELS[state]);
+        }
+
+        metrics.add("homings_total", snapshot.homing.homings);
+        metrics.add("homing_duration_ms", snapshot.homing.durationMs);
+        for (uint8_t axis = 0; axis < StepEngine::AXIS_COUNT; axis++) {
+            metrics.add("homing_repeatability_steps", static_cast<int32_t>(snapshot.homing.repeatabilitySteps[axis]),
+                        AXIS_LABELS[axis]);
+            metrics.add("homing_overshoot_steps", static_cast<int32_t>(snapshot.homing.overshootSteps[axis]),
+                        AXIS_LABELS[axis]);
+        }
+    }
+};
+
+#endif //MOTION_TELEMETRY_H
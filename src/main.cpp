@@ -1,18 +1,26 @@
 #include <Arduino.h>
 #include <LiquidCrystal.h>
+#include <LittleFS.h>
 
-#include "AccelStepper.h"
 #include "ServoPWM.h"
+#include "Input/EncoderJog.h"
 #include "Input/InputManager.h"
+#include "Input/PulseCounter.h"
+#include "Job/GcodeInterpreter.h"
+#include "Job/PathStreamBuffer.h"
 #include "RemoteDevelopmentService/LoggerHelper.h"
 #include "RemoteDevelopmentService/RemoteDevelopmentService.h"
+#include "Job/JobSpool.h" // Logs through LoggerHelper.h
+#include "StepperMotor/MotionChannel.h"
 #include "StepperMotor/StepperMotor.h"
 #include "StepperMotor/StepperMotorCoordinator.h"
+#include "Telemetry/MotionTelemetry.h"
 
 // Rotary encoder
 constexpr int GPIO_ENCODER_CLK = 4;
 constexpr int GPIO_ENCODER_DT = 16;
 constexpr int GPIO_ENCODER_SW = 17;
+constexpr unsigned long ABORT_PRESS_MS = 2000; // Button held this long while a job is held aborts it
 
 // Stepper motors
 constexpr int GPIO_MOTOR_A_DIR = 18;
@@ -27,6 +35,14 @@ constexpr int GPIO_SERVO = 23;
 constexpr int GPIO_LIMIT_SWITCH_A = 34;
 constexpr int GPIO_LIMIT_SWITCH_B = 35;
 
+// Tasks: motion shares core 1 with the step timer ISR, networking and the LCD run next to the Wi-Fi stack on core 0
+constexpr BaseType_t MOTION_CORE = 1;
+constexpr BaseType_t NETWORK_CORE = 0;
+constexpr UBaseType_t MOTION_TASK_PRIORITY = configMAX_PRIORITIES - 2;
+constexpr UBaseType_t NETWORK_TASK_PRIORITY = 1;
+constexpr uint32_t MOTION_TASK_STACK = 4096;
+constexpr uint32_t NETWORK_TASK_STACK = 8192;
+
 // LCD (HD44780, 4-bit mode)
 constexpr int GPIO_LCD_RS = 32;
 constexpr int GPIO_LCD_E = 33;
@@ -39,38 +55,70 @@ constexpr int GPIO_LCD_D7 = 14;
 LiquidCrystal lcd(GPIO_LCD_RS, GPIO_LCD_E, GPIO_LCD_D4, GPIO_LCD_D5, GPIO_LCD_D6, GPIO_LCD_D7);
 LcdDisplay lcdDisplay(&lcd);
 
-// Input
-volatile uint8_t interruptTriggeredGpio = 0;
-void IRAM_ATTR onRemoteReceiverInterrupt_limitSwitchA() { interruptTriggeredGpio = GPIO_LIMIT_SWITCH_A; }
-void IRAM_ATTR onRemoteReceiverInterrupt_limitSwitchB() { interruptTriggeredGpio = GPIO_LIMIT_SWITCH_B; }
-void IRAM_ATTR onRemoteReceiverInterrupt_encoderSwitch() { interruptTriggeredGpio = GPIO_ENCODER_SW; }
-
+// Input: limit switches are handled by the motion task, the encoder by the network/UI task
 InputManager inputManager(
     GPIO_LIMIT_SWITCH_A,
     GPIO_LIMIT_SWITCH_B,
     GPIO_ENCODER_SW
 );
+void IRAM_ATTR onRemoteReceiverInterrupt_limitSwitchA() {
+    inputManager.limitSwitchEvents.onInterrupt(GPIO_LIMIT_SWITCH_A);
+}
+void IRAM_ATTR onRemoteReceiverInterrupt_limitSwitchB() {
+    inputManager.limitSwitchEvents.onInterrupt(GPIO_LIMIT_SWITCH_B);
+}
+void IRAM_ATTR onRemoteReceiverInterrupt_encoderSwitch() {
+    inputManager.encoderButtonEvents.onInterrupt(GPIO_ENCODER_SW);
+}
+
+// Rotation is counted by the PCNT, so detents turned while the loop is busy still arrive
+PulseCounter encoderCounter;
+EncoderJog encoderJog;
 
 // Motors
-AccelStepper accelStepperA(AccelStepper::DRIVER, GPIO_MOTOR_A_STEP, GPIO_MOTOR_A_DIR);
-AccelStepper accelStepperB(AccelStepper::DRIVER, GPIO_MOTOR_B_STEP, GPIO_MOTOR_B_DIR);
-StepperMotor stepperA(accelStepperA);
-StepperMotor stepperB(accelStepperB);
+StepEngine stepEngine(GPIO_MOTOR_A_STEP, GPIO_MOTOR_A_DIR, GPIO_MOTOR_B_STEP, GPIO_MOTOR_B_DIR);
+StepperMotor stepperA(stepEngine, 0);
+StepperMotor stepperB(stepEngine, 1);
 ServoPWM penServo(GPIO_SERVO);
 
-StepperMotorCoordinator stepperCoordinator(stepperA, stepperB, penServo, inputManager);
+StepperMotorCoordinator stepperCoordinator(stepEngine, stepperA, stepperB, penServo, inputManager);
+
+// Between the motion and network/UI tasks
+MotionChannel motionChannel;
+bool streamedJobPending = false; // Motion task only
+uint32_t appliedConfigVersion = 0; // Motion task only, of motionChannel.config
+uint32_t startedSpoolGeneration = 0; // Motion task only, of spooledJob
+uint32_t acknowledgedGcodeLines = 0; // Network task only, of motionChannel.gcodeLines
+
+// Recorded by the motion task, reported by the network task at /metrics and over telnet
+MotionTelemetry motionTelemetry(stepEngine, stepperCoordinator, penServo);
+TaskHandle_t motionTaskHandle = nullptr;
+TaskHandle_t networkTaskHandle = nullptr;
 
 unsigned long lastUpdate = 0;
 
 bool editingA = true;
-int lastEncoderClk = HIGH;
+unsigned long heldJobPressMs = 0; // Button pressed while a job is held: resumes on release, aborts if kept down
 
 // Wi-Fi and OTA
 RemoteDevelopmentService *gRemoteDevelopmentService = nullptr;
 
+// Log lines queued by both tasks, written out by the network task
+DeferredLog gLog;
+
 // Settings
 PreferencesManager preferencesManager;
 
+// Jobs streamed over TCP
+PathStreamBuffer pathStream;
+
+// G-code over serial
+GcodeInterpreter gcode;
+
+// Jobs uploaded to flash, drawn one after another and resumed after a power cut
+SpooledJob spooledJob;
+JobSpool jobSpool(LittleFS, spooledJob, motionChannel.flashWrites);
+
 void initHardware() {
     Serial.begin(115200);
 
@@ -82,84 +130,265 @@ void initHardware() {
     pinMode(GPIO_MOTOR_A_STEP, OUTPUT);
     pinMode(GPIO_MOTOR_B_DIR, OUTPUT);
     pinMode(GPIO_MOTOR_B_STEP, OUTPUT);
+    stepEngine.begin();
 
     // pinMode(GPIO_SERVO, OUTPUT);
 
     pinMode(GPIO_LIMIT_SWITCH_A, INPUT);
     pinMode(GPIO_LIMIT_SWITCH_B, INPUT);
 
-    attachInterrupt(digitalPinToInterrupt(GPIO_LIMIT_SWITCH_A), onRemoteReceiverInterrupt_limitSwitchA, RISING);
-    attachInterrupt(digitalPinToInterrupt(GPIO_LIMIT_SWITCH_B), onRemoteReceiverInterrupt_limitSwitchB, RISING);
-    attachInterrupt(digitalPinToInterrupt(GPIO_ENCODER_SW), onRemoteReceiverInterrupt_encoderSwitch, RISING);
+    // Both edges, so releases debounce too
+    attachInterrupt(digitalPinToInterrupt(GPIO_LIMIT_SWITCH_A), onRemoteReceiverInterrupt_limitSwitchA, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(GPIO_LIMIT_SWITCH_B), onRemoteReceiverInterrupt_limitSwitchB, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(GPIO_ENCODER_SW), onRemoteReceiverInterrupt_encoderSwitch, CHANGE);
+    inputManager.begin();
+    encoderCounter.begin(GPIO_ENCODER_CLK, GPIO_ENCODER_DT);
 
     penServo.begin();
 
-    lcd.begin(16, 2);
-    lcd.clear();
-    lcd.print(String(FW_VERSION));
+    lcdDisplay.begin();
+    lcdDisplay.print(String(FW_VERSION));
+    lcdDisplay.flushAll();
     Serial.println(String(FW_VERSION));
 }
 
 void updateValueDisplay() {
-    lcd.clear();
+    const MotionStatus status = motionChannel.status.read();
+
+    // Only the framebuffer, the network loop flushes what changed
+    lcdDisplay.clear();
 
-    lcd.setCursor(0, 0);
-    lcd.print(editingA ? ">" : " ");
-    lcd.print("A: ");
-    lcd.print(stepperA.getPosition());
+    lcdDisplay.setCursorToLine(0, 0);
+    lcdDisplay.print(editingA ? ">" : " ");
+    lcdDisplay.print("A: ");
+    lcdDisplay.print(String(status.positionA));
 
-    lcd.setCursor(0, 1);
-    lcd.print(editingA ? " " : ">");
-    lcd.print("B: ");
-    lcd.print(stepperB.getPosition());
+    lcdDisplay.setCursorToLine(0, 1);
+    lcdDisplay.print(editingA ? " " : ">");
+    lcdDisplay.print("B: ");
+    lcdDisplay.print(String(status.positionB));
+
+    if (status.feedHold != feedRunning) {
+        const String hold = status.feedHold == feedHeld ? "HELD" : "HOLD";
+        lcdDisplay.setCursorToLineRight(hold, 1);
+        lcdDisplay.print(hold);
+    }
 }
 
 
-void setup() {
-    initHardware();
-    preferencesManager.read();
+/** Network side of serial G-code: bytes from the UART to the motion task, "ok" for each line it took */
+void handleSerialGcode() {
+    // Bytes stay in the UART buffer until the ring has room, senders wait for "ok" before the next line
+    while (Serial.available() > 0 && motionChannel.gcodeBytes.push(static_cast<char>(Serial.peek()))) {
+        Serial.read();
+    }
 
-    static RemoteDevelopmentService remoteDev;
-    // remoteDev.init(preferencesManager, lcdDisplay);
-    gRemoteDevelopmentService = &remoteDev;
+    const uint32_t lines = motionChannel.gcodeLines.load(std::memory_order_acquire);
+    for (; acknowledgedGcodeLines != lines; acknowledgedGcodeLines++) {
+        Serial.println("ok");
+    }
+}
 
-    stepperCoordinator.home();
+/** Motion side of serial G-code: parses as much as the interpreter has room for */
+void takeSerialGcode() {
+    char c = 0;
+    while (gcode.canAccept() && motionChannel.gcodeBytes.pop(c)) {
+        gcode.feed(&c, 1);
+    }
 
-    printLn("ESP-32 ready. FW version: %s, %s %s\n", FW_VERSION, __DATE__, __TIME__);
-    printLn("Read from config:");
-    printLn("  enableAp: %d", preferencesManager.settings.enableAp);
-    printLn("  enableWifi: %d", preferencesManager.settings.enableWifi);
-    printLn("  wifiSSID: %s", preferencesManager.settings.wifiSSID);
-    printLn("  wifiPassword: %s", preferencesManager.settings.wifiPassword);
+    const uint16_t lines = gcode.takeAcknowledgements();
+    if (lines > 0) {
+        motionChannel.gcodeLines.fetch_add(lines, std::memory_order_release);
+    }
+
+    if (gcode.hasCommands() && stepperCoordinator.startJob(gcode)) {
+        printLn("Drawing G-code job");
+    }
 }
 
-void loop() {
-    // gRemoteDevelopmentService->loop();
-    inputManager.handleInput(interruptTriggeredGpio);
-    stepperCoordinator.run();
+void handleMotionCommand(const MotionCommand &command) {
+    if (command.type == MotionCommand::startStreamedJob) {
+        streamedJobPending = true;
+    } else if (command.type == MotionCommand::holdJob) {
+        stepperCoordinator.hold();
+    } else if (command.type == MotionCommand::resumeJob) {
+        stepperCoordinator.resume();
+    } else if (command.type == MotionCommand::abortJob) {
+        stepperCoordinator.abort();
+    }
+}
 
-    // --- Encoder rotation ---
-    const int currentClk = digitalRead(GPIO_ENCODER_CLK);
-    if (currentClk != lastEncoderClk && currentClk == LOW && stepperCoordinator.isHomed()) {
-        const int dt = digitalRead(GPIO_ENCODER_DT);
-        const int dir = (dt != currentClk) ? -1 : 1;
+void publishMotionStatus() {
+    motionChannel.status.write({
+        stepperA.getPosition(),
+        stepperB.getPosition(),
+        stepperCoordinator.getHomingSequence(),
+        stepperA.isRunning() || stepperB.isRunning(),
+        penServo.isUp(),
+        appliedConfigVersion,
+        stepperCoordinator.getFeedHold(),
+        stepperCoordinator.getUnreachableMoves()
+    });
+}
 
-        if (editingA) {
-            stepperA.moveOffset(dir * 32);
+/** Settings edited over HTTP or telnet wait for the current job (or homing) to finish */
+void applyPendingConfig() {
+    const uint32_t version = motionChannel.config.getVersion();
+    if (version == appliedConfigVersion || !stepperCoordinator.applyConfig(motionChannel.config.read())) {
+        return;
+    }
+
+    // A write between getVersion() and read() is applied now and again next loop, which is harmless
+    appliedConfigVersion = version;
+    printLn("Motion config applied");
+}
+
+/** One iteration of the motion task: inputs, commands, then the coordinator */
+void motionLoop() {
+    motionTelemetry.onLoopStart(micros());
+    inputManager.handleLimitSwitches();
+
+    // The network task is writing flash, which holds off the step ISR: jogs and commands wait until it's done
+    if (motionChannel.flashWrites.hold(!stepperA.isRunning() && !stepperB.isRunning())) {
+        publishMotionStatus();
+        motionTelemetry.onLoopEnd(micros());
+        return;
+    }
+
+    // Jogs queued since the last loop add up to one target change per arm
+    long jogSteps[2] = {};
+    MotionCommand command = {};
+    while (motionChannel.commands.pop(command)) {
+        if (command.type == MotionCommand::jog) {
+            jogSteps[command.axis == 0 ? 0 : 1] += command.steps;
         } else {
-            stepperB.moveOffset(dir * 32);
+            handleMotionCommand(command);
+        }
+    }
+    if (stepperCoordinator.isHomed()) {
+        if (jogSteps[0] != 0) {
+            stepperA.moveOffset(jogSteps[0]);
+        }
+        if (jogSteps[1] != 0) {
+            stepperB.moveOffset(jogSteps[1]);
         }
+    }
+
+    // A stream that connected mid-job waits, its credit flow control holds the sender meanwhile
+    if (streamedJobPending) {
+        if (pathStream.getState() == PathStreamBuffer::idle) {
+            streamedJobPending = false;
+        } else if (stepperCoordinator.startJob(pathStream)) {
+            streamedJobPending = false;
+            printLn("Drawing streamed job");
+        }
+    }
+
+    // Read from flash by the network task, which begins a new generation once the plotter is idle
+    if (spooledJob.getGeneration() != startedSpoolGeneration && stepperCoordinator.startJob(spooledJob)) {
+        startedSpoolGeneration = spooledJob.getGeneration();
+        printLn("Drawing spooled job");
+    }
+
+    takeSerialGcode();
+    applyPendingConfig();
+
+    stepperCoordinator.run();
+    publishMotionStatus();
+    motionTelemetry.onLoopEnd(micros());
+}
+
+void writeInputMetrics(MetricsText &metrics, const InputEventQueue::Stats &stats, const char *labels) {
+    metrics.add("input_events_total", stats.handled, labels);
+    metrics.add("input_bounces_total", stats.bounces, labels);
+    metrics.add("input_events_dropped_total", stats.dropped, labels);
+    metrics.add("input_latency_max_us", stats.maxLatencyUs, labels);
+    metrics.add("input_latency_us_total", stats.latencyUsTotal, labels);
+}
+
+/** Called by the network task for /metrics and the telnet "metrics" command */
+void writeMetrics(MetricsText &metrics) {
+    motionTelemetry.write(metrics);
+
+    const LcdDisplay::FlushStats &lcdStats = lcdDisplay.getFlushStats();
+    metrics.add("lcd_flushes_total", lcdStats.flushes);
+    metrics.add("lcd_characters_total", lcdStats.characters);
+    metrics.add("lcd_flush_us_total", lcdStats.totalUs);
+    metrics.add("lcd_flush_max_us", lcdStats.maxUs);
+
+    const DeferredLog::Stats logStats = gLog.getStats();
+    metrics.add("log_lines_total", logStats.logged);
+    metrics.add("log_dropped_total", logStats.dropped);
+    metrics.add("motion_commands_dropped_total", motionChannel.droppedCommands.load(std::memory_order_relaxed));
+    writeInputMetrics(metrics, inputManager.limitSwitchEvents.getStats(), "queue=\"limit_switches\"");
+    writeInputMetrics(metrics, inputManager.encoderButtonEvents.getStats(), "queue=\"encoder_button\"");
+
+    metrics.add("moves_out_of_reach_skipped_total", motionChannel.status.read().unreachableMoves);
+    metrics.add("stream_points_out_of_reach_total", pathStream.getUnreachablePoints());
+
+    metrics.add("spool_queued_jobs", jobSpool.getQueuedJobs());
+    metrics.add("spool_checkpoint_writes_total", jobSpool.getCheckpointWrites());
+
+    metrics.add("heap_free_bytes", ESP.getFreeHeap());
+    metrics.add("heap_free_lowest_bytes", ESP.getMinFreeHeap());
+    metrics.add("heap_largest_block_bytes", ESP.getMaxAllocHeap());
+    // High-water marks are in bytes on the ESP32 port of FreeRTOS
+    metrics.add("stack_unused_lowest_bytes", static_cast<uint32_t>(uxTaskGetStackHighWaterMark(motionTaskHandle)),
+                "task=\"motion\"");
+    metrics.add("stack_unused_lowest_bytes", static_cast<uint32_t>(uxTaskGetStackHighWaterMark(networkTaskHandle)),
+                "task=\"network\"");
+}
+
+/** One iteration of the network/UI task: Wi-Fi services, the log, the encoder and the LCD */
+void networkLoop() {
+    gRemoteDevelopmentService->loop();
+    handleSerialGcode();
+    drainLog();
+
+    // Spooled jobs start once homing (and anything else) is done, so a resumed one starts from home too
+    const MotionStatus status = motionChannel.status.read();
+    const bool motionIdle = status.homingSequence == finished && !status.moving;
+    jobSpool.loop(motionIdle, millis());
+    if (motionIdle) {
+        jobSpool.startNext();
+    }
+
+    // --- Encoder rotation: whatever turned since the last loop, as one jog ---
+    const long jogSteps = encoderJog.take(encoderCounter.read(), millis());
+    if (jogSteps != 0 && status.homingSequence == finished) {
+        motionChannel.send({MotionCommand::jog, static_cast<uint8_t>(editingA ? 0 : 1), jogSteps});
         updateValueDisplay();
     }
-    lastEncoderClk = currentClk;
 
     // --- Encoder button press ---
-    if (inputManager.encoderButton.takeActionIfPossible()) {
-        editingA = !editingA;
+    inputManager.handleEncoderButton();
+
+    // While drawing a press holds the job; while held, a press resumes it and a long one aborts it
+    if (inputManager.encoderButton.takePress()) {
+        if (status.homingSequence == drawingPath && status.feedHold == feedRunning) {
+            motionChannel.send({MotionCommand::holdJob});
+        } else if (status.feedHold == feedHeld) {
+            heldJobPressMs = millis();
+            heldJobPressMs += heldJobPressMs == 0;
+        } else {
+            editingA = !editingA;
+        }
 
         updateValueDisplay();
     }
 
+    if (heldJobPressMs != 0) {
+        if (!inputManager.encoderButton.isPressed()) {
+            motionChannel.send({MotionCommand::resumeJob});
+            heldJobPressMs = 0;
+        } else if (millis() - heldJobPressMs >= ABORT_PRESS_MS) {
+            motionChannel.send({MotionCommand::abortJob});
+            heldJobPressMs = 0;
+        }
+    }
+
+    lcdDisplay.flush();
+
     // At most 2 fps, for now
     if (lastUpdate + 500 > millis()) {
         return;
@@ -168,3 +397,66 @@ void loop() {
     updateValueDisplay();
     lastUpdate = millis();
 }
+
+/**
+ * Steps are timed by the ISR with 20 ms of lead (StepEngine::MAX_LEAD_US), so one iteration per tick keeps the
+ * queue topped up; the delay also gives the core's idle task its turn.
+ */
+void motionTask(void *) {
+    for (;;) {
+        motionLoop();
+        vTaskDelay(1);
+    }
+}
+
+void networkTask(void *) {
+    for (;;) {
+        networkLoop();
+        vTaskDelay(1);
+    }
+}
+
+void setup() {
+    initHardware();
+    preferencesManager.read();
+
+    // Before homing, which uses it too
+    stepperCoordinator.applyConfig(preferencesManager.settings.motion);
+    motionChannel.config.write(preferencesManager.settings.motion);
+    appliedConfigVersion = motionChannel.config.getVersion();
+
+    // Formatted on first use; without it jobs can't be uploaded, everything else still works
+    if (LittleFS.begin(true)) {
+        jobSpool.begin();
+    } else {
+        printLn("Flash filesystem unavailable, no spooled jobs");
+    }
+
+    static RemoteDevelopmentService remoteDev;
+    remoteDev.init(preferencesManager, lcdDisplay, pathStream, motionChannel, jobSpool);
+    gRemoteDevelopmentService = &remoteDev;
+
+    stepperCoordinator.home();
+    publishMotionStatus();
+
+    printLn("ESP-32 ready. FW version: %s, %s %s\n", FW_VERSION, __DATE__, __TIME__);
+    printLn("Read from config (%s, stored version %u):", preferencesManager.getLoadResultName(),
+            preferencesManager.getStoredVersion());
+    printLn("  enableAp: %d", preferencesManager.settings.enableAp);
+    printLn("  enableWifi: %d", preferencesManager.settings.enableWifi);
+    printLn("  wifiSSID: %s", preferencesManager.settings.wifiSSID);
+    printLn("  wifiPassword: %s", preferencesManager.settings.wifiPassword);
+    printLn("Spooled jobs: %lu, checkpoint for job %lu", static_cast<unsigned long>(jobSpool.getQueuedJobs()),
+            static_cast<unsigned long>(jobSpool.getSavedCheckpoint().jobId));
+    drainLog(DeferredLog::CAPACITY);
+
+    xTaskCreatePinnedToCore(motionTask, "motion", MOTION_TASK_STACK, nullptr, MOTION_TASK_PRIORITY,
+                            &motionTaskHandle, MOTION_CORE);
+    xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY,
+                            &networkTaskHandle, NETWORK_CORE);
+}
+
+void loop() {
+    // Everything runs in the tasks started by setup()
+    vTaskDelete(nullptr);
+}
@@ -1,10 +1,13 @@
 import {useEffect, useRef, useState} from 'react'
 import p5 from 'p5'
+import {compactJobToHeader, encodeCompactJob} from './compactJob'
 
 export default function P5Canvas() {
   const ref = useRef()
   const [sketchKey, setSketchKey] = useState(0)
   const [gcode, setGcode] = useState('');
+  const [compactJob, setCompactJob] = useState(null);
+  const [unreachablePoints, setUnreachablePoints] = useState(0);
 
   useEffect(() => {
     while (ref.current.firstChild) {
@@ -19,6 +22,20 @@ export default function P5Canvas() {
       const armLen = 150
       const fullSteps = 2900
       const fullDegrees = 200
+      const armRange = 2900
+
+      // The workspace in joint space, as the firmware checks it (PlotterKinematics::isReachable): each arm within
+      // half the range of the y axis, and B ahead of A by an opening that puts the pen between min and max distance
+      const radiansPerStep = fullDegrees * Math.PI / 180 / fullSteps
+      const openingDistance = (opening) => 2 * armLen * Math.cos(opening * radiansPerStep / 2)
+      let openingMin = 0
+      while (openingDistance(openingMin) > maxDistance) openingMin++
+      let openingMax = openingMin
+      while (openingDistance(openingMax + 1) >= minDistance) openingMax++
+
+      /** Firmware order: A is the slicer's "b" */
+      const isReachable = (a, b) => Math.abs(a) <= Math.floor(armRange / 2) && Math.abs(b) <= Math.floor(armRange / 2)
+        && b - a >= openingMin && b - a <= openingMax
 
       const drawXYLines = () => {
         p.strokeWeight(1)
@@ -111,11 +128,14 @@ export default function P5Canvas() {
 
       function sliceAndPrintPath() {
         const entries = [];
+        const jointPoints = [];
+        let unreachable = 0;
         entries.push('{ 32767, 32767 }');
 
         for (const pt of points) {
           if (!pt) {
             entries.push('{ 32767, 32767 }');
+            jointPoints.push(null);
             continue;
           }
 
@@ -125,11 +145,33 @@ export default function P5Canvas() {
             fullSteps, fullDegrees
           );
 
-          const a = kin.inRange && kin.validArmsPositions ? kin.steps.aSteps : 0;
-          const b = kin.inRange && kin.validArmsPositions ? kin.steps.bSteps : 0;
+          // The firmware's motor A is this "b", see pathSteps
+          const a = kin.steps.aSteps;
+          const b = kin.steps.bSteps;
+
+          // Out of reach the pen lifts and skips the point, drawing resumes at the next reachable one
+          if (!kin.inRange || !kin.validArmsPositions || !isReachable(b, a)) {
+            unreachable++;
+            if (jointPoints.length > 0 && jointPoints[jointPoints.length - 1] !== null) {
+              entries.push('{ 32767, 32767 }');
+              jointPoints.push(null);
+            }
+            continue;
+          }
+
           entries.push(`{ ${a}, ${b} }`);
+          jointPoints.push({a: b, b: a});
         }
 
+        if (unreachable > 0) {
+          console.warn(`${unreachable} point(s) out of reach, left out of the job`);
+        }
+        setUnreachablePoints(unreachable)
+
+        setCompactJob(encodeCompactJob(jointPoints, {
+          armLen, fullSteps, fullDegrees, minDistance, maxDistance, armRange
+        }))
+
         let builder = "";
 
         builder += "#ifndef GCODE_H\n";
@@ -272,6 +314,19 @@ export default function P5Canvas() {
           console.log('G-code copied to clipboard!');
         });
       }}>Copy G-code to Clipboard</button>
+      <button disabled={!compactJob} onClick={() => {
+        navigator.clipboard.writeText(compactJobToHeader(compactJob)).then(() => {
+          console.log(`compiledJob.h copied to clipboard (${compactJob.length} bytes)`);
+        });
+      }}>Copy compiledJob.h to Clipboard</button>
+      <button disabled={!compactJob} onClick={() => {
+        const link = document.createElement('a');
+        link.href = URL.createObjectURL(new Blob([compactJob], {type: 'application/octet-stream'}));
+        link.download = 'job.spj';
+        link.click();
+        URL.revokeObjectURL(link.href);
+      }}>Download Compact Job</button>
+      {unreachablePoints > 0 && <p>{unreachablePoints} point(s) out of reach, the pen skips them</p>}
       <div ref={ref}/>
     </>
   )
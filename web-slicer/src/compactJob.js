@@ -0,0 +1,135 @@
+// CompactPathFormat writer, see src/Job/CompactPathFormat.h in the firmware for the layout.
+
+const MAGIC = [0x53, 0x50, 0x4A, 0x43] // "SPJC"
+const VERSION = 1
+const HEADER_SIZE = 24
+const SHORT_RESIDUAL_LIMIT = 7
+
+const OP_MOVE = 0xF0
+const OP_PEN_UP = 0xF1
+const OP_PEN_DOWN = 0xF2
+const OP_END = 0xFF
+
+/** FNV-1a over the geometry as little-endian int32, matches PlotterKinematics::GEOMETRY_HASH */
+export const geometryHash = ({armLen, fullSteps, fullDegrees, minDistance, maxDistance, armRange}) => {
+  let hash = 2166136261
+  for (const parameter of [armLen, fullSteps, fullDegrees, minDistance, maxDistance, armRange]) {
+    for (let byte = 0; byte < 4; byte++) {
+      hash ^= (parameter >>> (8 * byte)) & 0xFF
+      hash = Math.imul(hash, 16777619) >>> 0
+    }
+  }
+  return hash >>> 0
+}
+
+const crcTable = Array.from({length: 256}, (_, n) => {
+  let c = n
+  for (let k = 0; k < 8; k++) {
+    c = c & 1 ? 0xEDB88320 ^ (c >>> 1) : c >>> 1
+  }
+  return c >>> 0
+})
+
+const crc32 = (bytes) => {
+  let crc = 0xFFFFFFFF
+  for (const byte of bytes) {
+    crc = crcTable[(crc ^ byte) & 0xFF] ^ (crc >>> 8)
+  }
+  return (crc ^ 0xFFFFFFFF) >>> 0
+}
+
+const zigzag = (value) => value >= 0 ? value * 2 : -value * 2 - 1
+
+/**
+ * @param {Array<{a: number, b: number}|null>} points joint steps in firmware order (A, B), null lifts the pen;
+ *   the pen is lowered once the first point after a lift is reached, like pathSteps
+ * @param {object} geometry as passed to geometryHash
+ * @returns {Uint8Array}
+ */
+export const encodeCompactJob = (points, geometry) => {
+  const body = []
+  const position = [0, 0]
+  const velocity = [0, 0]
+  let penDown = false
+  let moveCount = 0
+
+  const putVarint = (value) => {
+    while (value >= 0x80) {
+      body.push((value & 0x7F) | 0x80)
+      value = Math.floor(value / 128)
+    }
+    body.push(value)
+  }
+
+  const putMove = (a, b) => {
+    const residualA = a - position[0] - velocity[0]
+    const residualB = b - position[1] - velocity[1]
+    const limit = SHORT_RESIDUAL_LIMIT
+
+    if (Math.abs(residualA) <= limit && Math.abs(residualB) <= limit) {
+      body.push((residualA + limit) * (2 * limit + 1) + residualB + limit)
+    } else {
+      body.push(OP_MOVE)
+      putVarint(zigzag(residualA))
+      putVarint(zigzag(residualB))
+    }
+
+    velocity[0] = a - position[0]
+    velocity[1] = b - position[1]
+    position[0] = a
+    position[1] = b
+    moveCount++
+  }
+
+  const putPen = (opcode) => {
+    body.push(opcode)
+    velocity[0] = velocity[1] = 0
+  }
+
+  for (const point of points) {
+    if (!point) {
+      putPen(OP_PEN_UP)
+      penDown = false
+      continue
+    }
+
+    putMove(point.a, point.b)
+    if (!penDown) {
+      putPen(OP_PEN_DOWN)
+      penDown = true
+    }
+  }
+  body.push(OP_END)
+
+  const job = new Uint8Array(HEADER_SIZE + body.length)
+  const header = new DataView(job.buffer)
+  job.set(MAGIC, 0)
+  header.setUint8(4, VERSION)
+  header.setUint8(5, HEADER_SIZE)
+  header.setUint32(8, geometryHash(geometry), true)
+  header.setUint32(12, moveCount, true)
+  header.setUint32(16, body.length, true)
+  header.setUint32(20, crc32(body), true)
+  job.set(body, HEADER_SIZE)
+
+  return job
+}
+
+/** compiledJob.h for the firmware */
+export const compactJobToHeader = (job) => {
+  let builder = ''
+
+  builder += '#ifndef COMPILED_JOB_H\n'
+  builder += '#define COMPILED_JOB_H\n\n'
+  builder += '#include <Arduino.h>\n\n'
+  builder += '// Auto-generated by the web slicer, CompactPathFormat (' + job.length + ' bytes)\n'
+  builder += 'const uint8_t compiledJob[] = {\n'
+  for (let i = 0; i < job.length; i += 16) {
+    const row = Array.from(job.slice(i, i + 16), byte => '0x' + byte.toString(16).toUpperCase().padStart(2, '0'))
+    builder += '  ' + row.join(', ') + ',\n'
+  }
+  builder += '};\n\n'
+  builder += '#endif //COMPILED_JOB_H\n'
+
+  return builder
+}